@@ -88,6 +88,8 @@ struct CalculationParameters {
     bool conv_only_dens;        ///< If true remove bsh_residual from convergence criteria   how ugly name is...
     bool psp_calc;              ///< pseudopotential calculation for all atoms
     bool print_dipole_matels;   ///< If true output dipole matrix elements
+    double coulomb_reuse;       ///< Reuse Coulomb potential of density boxes changed by less than this times truncate_tol (0 to disable)
+    int print_level;            ///< 0 is none; 1 is default; 2 is debug
     // Next list inferred parameters
     int nalpha;                 ///< Number of alpha spin electrons
     int nbeta;                  ///< Number of beta  spin electrons
@@ -138,7 +140,7 @@ struct CalculationParameters {
         ar & xc_data & protocol_data;
         ar & gopt & gtol & gtest & gval & gprec & gmaxiter & ginitial_hessian & algopt & tdksprop
         & nuclear_corrfac & psp_calc & print_dipole_matels & pure_ae & hessian & read_cphf & restart_cphf
-        & purify_hessian & vnucextra & loadbalparts & pcm_data & ac_data;
+        & purify_hessian & vnucextra & loadbalparts & pcm_data & ac_data & coulomb_reuse & print_level;
     }
 
     CalculationParameters()
@@ -176,6 +178,8 @@ struct CalculationParameters {
     , conv_only_dens(false)
     , psp_calc(false)
     , print_dipole_matels(false)
+    , coulomb_reuse(0.0)
+    , print_level(1)
     , nalpha(0)
     , nbeta(0)
     , nmo_alpha(0)
@@ -434,6 +438,12 @@ struct CalculationParameters {
             else if (s == "print_dipole_matels") {
                 print_dipole_matels = true;
             }
+            else if (s == "coulomb_reuse") {
+                f >> coulomb_reuse;
+            }
+            else if (s == "print_level") {
+                f >> print_level;
+            }
             else if (s == "nv_factor") {
                 f >> nv_factor;
             }
@@ -560,6 +570,8 @@ struct CalculationParameters {
             madness::print(" Convergence criterion is only density delta.");
         else
             madness::print(" Convergence criteria are density delta & BSH residual.");
+        if (coulomb_reuse > 0.0)
+            madness::print("  coulomb reuse tol. ", coulomb_reuse);
         madness::print("        plot density ", plotdens);
         madness::print("        plot coulomb ", plotcoul);
         madness::print("        plot orbital ", plotlo, plothi);
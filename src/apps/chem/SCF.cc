@@ -241,7 +241,10 @@ namespace madness {
     
     void SCF::save_mos(World& world) {
         PROFILE_MEMBER_FUNC(SCF);
+        // the orbitals are written in the background, see checkpoint();
+        // opening the archive waits for the previous save to finish
         archive::ParallelOutputArchive ar(world, "restartdata", param.nio);
+        ar.set_async(true);
         ar & current_energy & param.spin_restricted;
         ar & (unsigned int) (amo.size());
         ar & aeps & aocc & aset;
@@ -253,6 +256,13 @@ namespace madness {
             for (unsigned int i = 0; i < bmo.size(); ++i)
                 ar & bmo[i];
         }
+        ar.close_async();
+        if (param.print_level > 1) {
+            double snapshot = AsyncWriter::peak_bytes();
+            world.gop.max(snapshot);
+            if (world.rank() == 0)
+                print("saving orbitals in the background, largest snapshot", snapshot/(1024.0*1024.0), "MB");
+        }
 
         tensorT Saoamo = matrix_inner(world, ao, amo);
         tensorT Saobmo = (!param.spin_restricted) ? matrix_inner(world, ao, bmo) : tensorT();
@@ -272,6 +282,10 @@ namespace madness {
         bool spinrest = false;
         amo.clear();
         bmo.clear();
+
+        // make sure a checkpoint of this run is on disk
+        AsyncWriter::wait();
+        world.gop.barrier();
         
         archive::ParallelInputArchive ar(world, "restartdata");
         
@@ -2434,7 +2448,15 @@ namespace madness {
             END_TIMER(world, "Nuclear energy");
 
             START_TIMER(world);
-            functionT vcoul = apply(*coulop, rho);
+            functionT vcoul;
+            if (param.coulomb_reuse > 0.0) {
+                vcoul = apply(*coulop, rho, coulomb_cache);
+                if (world.rank() == 0)
+                    print("Coulomb: reused", coulomb_cache.get_nreused(), "of",
+                          coulomb_cache.get_nreused() + coulomb_cache.get_napplied(), "boxes");
+            } else {
+                vcoul = apply(*coulop, rho);
+            }
             functionT vlocal;
             END_TIMER(world, "Coulomb");
             print_meminfo(world.rank(), "Coulomb");
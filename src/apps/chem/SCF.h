@@ -130,13 +130,28 @@ namespace madness {
     private:
         const Molecule& molecule;
         const AtomicBasisSet& aobasis;
+        const AtomIndex index;
     public:
         MolecularGuessDensityFunctor(const Molecule& molecule, const AtomicBasisSet& aobasis)
-            : molecule(molecule), aobasis(aobasis) {}
+            : molecule(molecule), aobasis(aobasis)
+            , index(aobasis.guess_density_index(molecule)) {}
         
         double operator()(const coordT& x) const {
             return aobasis.eval_guess_density(molecule, x[0], x[1], x[2]);
         }
+
+        virtual bool supports_vectorized() const {return true;}
+
+        void operator()(const Vector<double*,3>& xvals, double* MADNESS_RESTRICT fvals, int npts) const {
+            aobasis.eval_guess_density(molecule, index, npts, xvals[0], xvals[1], xvals[2], fvals);
+        }
+
+        /// No atomic density reaches the box spanned by c1 and c2
+        virtual bool screened(const coordT& c1, const coordT& c2) const {
+            std::vector<int> near;
+            index.near(&c1[0], &c2[0], near);
+            return near.empty();
+        }
         
         std::vector<coordT> special_points() const {return molecule.get_all_coords_vec();}
     };
@@ -154,6 +169,12 @@ namespace madness {
         double operator()(const coordT& x) const {
             return aofunc(x[0], x[1], x[2]);
         }
+
+        virtual bool supports_vectorized() const {return true;}
+
+        void operator()(const Vector<double*,3>& xvals, double* MADNESS_RESTRICT fvals, int npts) const {
+            aofunc(npts, xvals[0], xvals[1], xvals[2], fvals);
+        }
         
         std::vector<coordT> special_points() const {
             return std::vector<coordT>(1,aofunc.get_coords_vec());
@@ -177,6 +198,18 @@ namespace madness {
             return -atom.q * smoothed_potential(r*molecule.get_rcut()[iatom])
                 *molecule.get_rcut()[iatom];
         }
+
+        virtual bool supports_vectorized() const {return true;}
+
+        void operator()(const Vector<double*,3>& xvals, double* MADNESS_RESTRICT fvals, int npts) const {
+            const Atom& atom=molecule.get_atom(iatom);
+            const double rc=molecule.get_rcut()[iatom];
+            const double* x=xvals[0]; const double* y=xvals[1]; const double* z=xvals[2];
+            for (int i=0; i<npts; ++i) {
+                const double dx=x[i]-atom.x, dy=y[i]-atom.y, dz=z[i]-atom.z;
+                fvals[i] = -atom.q * smoothed_potential(std::sqrt(dx*dx+dy*dy+dz*dz)*rc)*rc;
+            }
+        }
         
         std::vector<coordT> special_points() const {
             return std::vector<coordT>(1,molecule.get_atom(iatom).get_coords());
@@ -338,6 +371,7 @@ namespace madness {
         /// orbital energies for alpha and beta orbitals
         tensorT aeps, beps;
         poperatorT coulop;
+        ApplyCache<double,3> coulomb_cache; ///< Coulomb potential of the last density, if param.coulomb_reuse
         std::vector< std::shared_ptr<real_derivative_3d> > gradop;
         double vtol;
         double current_energy;
@@ -386,6 +420,8 @@ namespace madness {
             double safety = 0.1;
             vtol = FunctionDefaults<NDIM>::get_thresh() * safety;
             coulop = poperatorT(CoulombOperatorPtr(world, param.lo, thresh));
+            coulomb_cache.clear();
+            coulomb_cache.set_reuse_tol(param.coulomb_reuse);
             gradop = gradient_operator<double,3>(world);
             mask = functionT(factoryT(world).f(mask3).initial_level(4).norefine());
             if(world.rank() == 0){
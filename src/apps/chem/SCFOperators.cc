@@ -293,7 +293,8 @@ vecfuncT DNuclear::operator()(const vecfuncT& vket) const {
 
 
 Exchange::Exchange(World& world, const SCF* calc, const int ispin)
-        : world(world), small_memory_(true), same_(false) {
+        : world(world), small_memory_(true), same_(false),
+          tiled_(false), memory_budget_(1073741824.0), screening_thresh_(-1.0) {
     if (ispin==0) { // alpha spin
         mo_ket=calc->amo;
         occ=calc->aocc;
@@ -307,7 +308,8 @@ Exchange::Exchange(World& world, const SCF* calc, const int ispin)
 }
 
 Exchange::Exchange(World& world, const Nemo* nemo, const int ispin)
-    : world(world), small_memory_(true), same_(false) {
+    : world(world), small_memory_(true), same_(false),
+          tiled_(false), memory_budget_(1073741824.0), screening_thresh_(-1.0) {
 
     if (ispin==0) { // alpha spin
         mo_ket=nemo->get_calc()->amo;
@@ -349,7 +351,9 @@ vecfuncT Exchange::operator()(const vecfuncT& vket) const {
         norm_tree(world, vket);
     }
 
-    if (small_memory_) {     // Smaller memory algorithm ... possible 2x saving using i-j sym
+    if (tiled_) {
+        apply_tiled(vket, Kf, tol);
+    } else if (small_memory_) {     // Smaller memory algorithm ... possible 2x saving using i-j sym
         for(int i=0; i<nocc; ++i){
             if(occ[i] > 0.0){
                 vecfuncT psif = mul_sparse(world, mo_bra[i], vket, tol); /// was vtol
@@ -361,36 +365,42 @@ vecfuncT Exchange::operator()(const vecfuncT& vket) const {
             }
         }
     } else {    // Larger memory algorithm ... use i-j sym if psi==f
-        vecfuncT psif;
+        // All pair products in one traversal, see mul_pairs
+        std::vector< std::pair<int,int> > pairs;
         for (int i = 0; i < nocc; ++i) {
             int jtop = nf;
             if (same)
                 jtop = i + 1;
             for (int j = 0; j < jtop; ++j) {
-                psif.push_back(mul_sparse(mo_bra[i], vket[j], tol, false));
+                pairs.push_back(std::make_pair(i, j));
             }
         }
+        vecfuncT psif = mul_pairs(world, mo_bra, vket, pairs, tol);
 
-        world.gop.fence();
         truncate(world, psif);
         psif = apply(world, *poisson.get(), psif);
         truncate(world, psif, tol);
         reconstruct(world, psif);
         norm_tree(world, psif);
-        vecfuncT psipsif = zero_functions<double, 3>(world, nf * nocc);
-        int ij = 0;
-        for (int i = 0; i < nocc; ++i) {
-            int jtop = nf;
-            if (same)
-                jtop = i + 1;
-            for (int j = 0; j < jtop; ++j, ++ij) {
-                psipsif[i * nf + j] = mul_sparse(psif[ij], mo_ket[i], false);
-                if (same && i != j) {
-                    psipsif[j * nf + i] = mul_sparse(psif[ij], mo_ket[j], false);
-                }
+
+        // psipsif[i*nf+j] = psif[ij]*mo_ket[i], and psif[ij]*mo_ket[j] for the mirrored pair
+        std::vector< std::pair<int,int> > kpairs;
+        std::vector<int> target;
+        for (unsigned int ij = 0; ij < pairs.size(); ++ij) {
+            const int i = pairs[ij].first, j = pairs[ij].second;
+            kpairs.push_back(std::make_pair(int(ij), i));
+            target.push_back(i * nf + j);
+            if (same && i != j) {
+                kpairs.push_back(std::make_pair(int(ij), j));
+                target.push_back(j * nf + i);
             }
         }
-        world.gop.fence();
+        vecfuncT kpsif = mul_pairs(world, psif, mo_ket, kpairs, 0.0);
+        vecfuncT psipsif = zero_functions<double, 3>(world, nf * nocc);
+        for (unsigned int p = 0; p < kpairs.size(); ++p) {
+            psipsif[target[p]] = kpsif[p];
+        }
+        kpsif.clear();
         psif.clear();
         world.gop.fence();
         compress(world, psipsif);
@@ -408,6 +418,203 @@ vecfuncT Exchange::operator()(const vecfuncT& vket) const {
 
 }
 
+/// coarse map of where the functions live, and their sizes
+
+/// Row i holds the norm of v[i] restricted to each box on the given level,
+/// the last column the number of coefficients of v[i]. A leaf above that
+/// level adds its norm to all boxes it covers, so the map overestimates.
+/// Collective; the functions must be reconstructed with a norm tree.
+static Tensor<double> exchange_norm_map(World& world, const vecfuncT& v,
+        const int level) {
+    const long nside=1l<<level;
+    const long nbox=nside*nside*nside;
+    Tensor<double> map(long(v.size()),nbox+1);
+    for (std::size_t i=0; i<v.size(); ++i) {
+        const FunctionImpl<double,3>::dcT& coeffs=v[i].get_impl()->get_coeffs();
+        for (auto it=coeffs.begin(); it!=coeffs.end(); ++it) {
+            const Key<3>& key=it->first;
+            const FunctionNode<double,3>& node=it->second;
+            if (node.has_coeff()) map(i,nbox)+=node.size();
+            const int n=key.level();
+            if (n>level or (n<level and node.has_children())) continue;
+            const Translation width=Translation(1)<<(level-n);
+            const Vector<Translation,3>& l=key.translation();
+            for (Translation x=l[0]*width; x<(l[0]+1)*width; ++x) {
+                for (Translation y=l[1]*width; y<(l[1]+1)*width; ++y) {
+                    for (Translation z=l[2]*width; z<(l[2]+1)*width; ++z) {
+                        map(i,x+nside*(y+nside*z))+=node.get_norm_tree();
+                    }
+                }
+            }
+        }
+    }
+    world.gop.sum(map.ptr(),map.size());
+    return map;
+}
+
+/// number of bytes of coefficients of the functions on this process
+static double exchange_local_bytes(const vecfuncT& v) {
+    double nbytes=0.0;
+    for (const real_function_3d& f : v) {
+        if (not f.is_initialized()) continue;
+        const FunctionImpl<double,3>::dcT& coeffs=f.get_impl()->get_coeffs();
+        for (auto it=coeffs.begin(); it!=coeffs.end(); ++it) {
+            if (it->second.has_coeff()) nbytes+=it->second.size()*sizeof(double);
+        }
+    }
+    return nbytes;
+}
+
+/// a batch of pairs moving through the stages of Exchange::apply_tiled
+struct ExchangeTile {
+    std::vector<std::pair<int,int> > ij;    ///< the pairs (bra index, ket index)
+    vecfuncT psif;                          ///< the pair densities bra_i f_j
+    vecfuncT Vpsif;                         ///< their Coulomb potentials
+    vecfuncT Kpsif;                         ///< the contributions ket_i Vpsif
+    std::vector<int> target;                ///< the index of K f to add Kpsif to
+    std::vector<double> factor;             ///< the occupation number of ket_i
+    int stage;
+
+    ExchangeTile() : stage(0) {}
+};
+
+void Exchange::apply_tiled(const vecfuncT& vket, vecfuncT& Kf, const double tol) const {
+    const bool same = this->same();
+    const int nocc = mo_bra.size();
+    const int nf = vket.size();
+    const int nstage = 10;      // see advance below
+    const int level = 3;        // 512 boxes in the norm maps
+
+    // screen the pairs by the overlap of the norm maps of bra_i and f_j
+    Tensor<double> bramap=exchange_norm_map(world, mo_bra, level);
+    Tensor<double> ketmap=exchange_norm_map(world, vket, level);
+    const long nbox=bramap.dim(1)-1;
+    Tensor<double> overlap=inner(copy(bramap(_,Slice(0,nbox-1))),
+            copy(ketmap(_,Slice(0,nbox-1))),1,1);
+    const double screen=(screening_thresh_<0.0) ? 0.01*tol : screening_thresh_;
+
+    // cut the surviving pairs into tiles; all tiles in flight share the
+    // budget, and a pair holds about three functions of the size of its
+    // larger factor
+    const double tile_budget=memory_budget_/nstage;
+    std::vector<ExchangeTile> tiles(1);
+    double tile_bytes=0.0;
+    long npair=0, nskipped=0;
+    for (int i=0; i<nocc; ++i) {
+        const int jtop = same ? i+1 : nf;
+        for (int j=0; j<jtop; ++j) {
+            ++npair;
+            const bool needed=(occ[i]!=0.0) or (same and occ[j]!=0.0);
+            if ((not needed) or (overlap(i,j)<screen)) {
+                ++nskipped;
+                continue;
+            }
+            const double nbytes=3.0*sizeof(double)
+                    *std::max(bramap(i,nbox),ketmap(j,nbox))/world.size();
+            if ((tile_bytes>0.0) and (tile_bytes+nbytes>tile_budget)) {
+                tiles.push_back(ExchangeTile());
+                tile_bytes=0.0;
+            }
+            tiles.back().ij.push_back(std::make_pair(i,j));
+            tile_bytes+=nbytes;
+        }
+    }
+    if (tiles.back().ij.empty()) tiles.pop_back();
+
+    // issue the next stage of a tile without fencing
+    auto advance = [&](ExchangeTile& t) {
+        switch (t.stage) {
+        case 0:
+            for (const auto& ij : t.ij) {
+                t.psif.push_back(mul_sparse(mo_bra[ij.first], vket[ij.second], tol, false));
+            }
+            break;
+        case 1:
+            for (auto& f : t.psif) f.truncate(tol, false);
+            break;
+        case 2:
+            for (auto& f : t.psif) f.nonstandard(false, false);
+            break;
+        case 3:
+            for (const auto& f : t.psif) t.Vpsif.push_back(apply_only(*poisson, f, false));
+            break;
+        case 4:
+            t.psif.clear();
+            for (const auto& f : t.Vpsif) f.reconstruct(false);
+            break;
+        case 5:
+            for (auto& f : t.Vpsif) f.truncate(tol, false);
+            break;
+        case 6:
+            for (const auto& f : t.Vpsif) f.norm_tree(false);
+            break;
+        case 7:
+            for (std::size_t k=0; k<t.ij.size(); ++k) {
+                const int i=t.ij[k].first, j=t.ij[k].second;
+                if (occ[i]!=0.0) {
+                    t.Kpsif.push_back(mul_sparse(mo_ket[i], t.Vpsif[k], tol, false));
+                    t.target.push_back(j);
+                    t.factor.push_back(occ[i]);
+                }
+                if (same and (i!=j) and (occ[j]!=0.0)) {
+                    t.Kpsif.push_back(mul_sparse(mo_ket[j], t.Vpsif[k], tol, false));
+                    t.target.push_back(i);
+                    t.factor.push_back(occ[j]);
+                }
+            }
+            break;
+        case 8:
+            t.Vpsif.clear();
+            for (const auto& f : t.Kpsif) f.compress(false);
+            break;
+        case 9:
+            for (std::size_t k=0; k<t.Kpsif.size(); ++k) {
+                Kf[t.target[k]].gaxpy(1.0, t.Kpsif[k], t.factor[k], false);
+            }
+            break;
+        default:
+            MADNESS_EXCEPTION("Exchange::apply_tiled: invalid stage", t.stage);
+        }
+        ++t.stage;
+    };
+
+    // start one tile per step and advance all others, so that the stages
+    // of consecutive tiles overlap. A step waits only for the work of the
+    // pipeline, not for a global fence; but the stages have no completion
+    // futures of their own, so all tiles in flight still wait for each
+    // other at the end of every step.
+    CompletionScope scope(world);
+    std::list<ExchangeTile*> inflight;
+    std::size_t next=0;
+    double peak=0.0;
+    while ((next<tiles.size()) or (not inflight.empty())) {
+        if (next<tiles.size()) inflight.push_back(&tiles[next++]);
+        {
+            CompletionScope::Guard guard(scope);
+            for (ExchangeTile* t : inflight) advance(*t);
+        }
+        scope.wait();
+
+        double nbytes=0.0;
+        for (ExchangeTile* t : inflight) {
+            nbytes+=exchange_local_bytes(t->psif)+exchange_local_bytes(t->Vpsif)
+                    +exchange_local_bytes(t->Kpsif);
+        }
+        peak=std::max(peak,nbytes);
+
+        // the oldest tile is in front
+        if (inflight.front()->stage==nstage) {
+            inflight.front()->Kpsif.clear();
+            inflight.pop_front();
+        }
+    }
+    world.gop.max(peak);
+    if (world.rank()==0) {
+        print("exchange:",nskipped,"of",npair,"pairs screened,",tiles.size(),
+                "tiles, peak working set",peak/(1024.0*1024.0),"MB");
+    }
+}
+
 /// custom ctor with information about the XC functional
 XCOperator::XCOperator(World& world, std::string xc_data, const bool spin_polarized,
         const real_function_3d& arho, const real_function_3d& brho)
@@ -498,7 +705,7 @@ double XCOperator::compute_xc_energy() const {
     }
 
     refine_to_common_level(world,xc_args);
-    real_function_3d vlda=multiop_values<double, xc_functional, 3>
+    real_function_3d vlda=multiop_values_batched<double, xc_functional, 3>
             (xc_functional(*xc), xc_args);
     truncate(world,xc_args);
 
@@ -515,8 +722,9 @@ real_function_3d XCOperator::make_xc_potential() const {
     refine_to_common_level(world,xc_args);
 
     // compute all the contributions to the xc kernel
+    // libxc is called on batches of many boxes to amortize its per-call cost
     xc_potential op(*xc, ispin);
-    const vecfuncT intermediates=multi_to_multi_op_values(op,xc_args);
+    const vecfuncT intermediates=multi_to_multi_op_values_batched(op,xc_args);
 
     // local part, first term in Yanai2005, Eq. (12)
     real_function_3d dft_pot = intermediates[0];
@@ -596,7 +804,7 @@ real_function_3d XCOperator::apply_xc_kernel(const real_function_3d& dens_pt,
 
     // compute all the contributions to the xc kernel
     xc_kernel_apply op(*xc, ispin);
-    const vecfuncT intermediates=multi_to_multi_op_values(op,xc_args);
+    const vecfuncT intermediates=multi_to_multi_op_values_batched(op,xc_args);
 
     // lda potential and local parts of the gga potential
     real_function_3d result=intermediates[0];
@@ -336,7 +336,8 @@ class Exchange {
 public:
 
     /// default ctor
-    Exchange(World& world) : world(world), small_memory_(true), same_(false) {};
+    Exchange(World& world) : world(world), small_memory_(true), same_(false),
+        tiled_(false), memory_budget_(1073741824.0), screening_thresh_(-1.0) {};
 
     /// ctor with a conventional calculation
     Exchange(World& world, const SCF* calc, const int ispin);
@@ -394,11 +395,52 @@ public:
         return *this;
     }
 
+    /// use the screened, tiled algorithm; takes precedence over small_memory
+    bool& tiled() {return tiled_;}
+    bool tiled() const {return tiled_;}
+    Exchange& tiled(const bool flag) {
+        tiled_=flag;
+        return *this;
+    }
+
+    /// estimated working set per process in bytes for the tiled algorithm
+    double& memory_budget() {return memory_budget_;}
+    double memory_budget() const {return memory_budget_;}
+    Exchange& memory_budget(const double bytes) {
+        memory_budget_=bytes;
+        return *this;
+    }
+
+    /// pairs with a smaller norm overlap estimate are skipped by the tiled
+    /// algorithm; a negative value means 0.01 times the truncation threshold
+    double& screening_threshold() {return screening_thresh_;}
+    double screening_threshold() const {return screening_thresh_;}
+    Exchange& screening_threshold(const double thresh) {
+        screening_thresh_=thresh;
+        return *this;
+    }
+
 private:
 
+    /// the tiled algorithm: K f_j += occ_i ket_i * poisson(bra_i * f_j)
+
+    /// Pairs (i,j) are screened by the overlap of coarse norm maps of bra_i
+    /// and f_j and grouped into tiles that fit the memory budget. The tiles
+    /// move through a pipeline of stages, and every step advances all tiles
+    /// in flight by one stage. A step waits on a completion scope of the
+    /// pipeline instead of a global fence, but it still waits for all tiles
+    /// in flight, since the stages have no per-tile completion futures.
+    /// @param[in]      vket    the functions f, reconstructed with norm tree
+    /// @param[in,out]  Kf      accumulates the result, compressed
+    /// @param[in]      tol     threshold for the multiplications and truncations
+    void apply_tiled(const vecfuncT& vket, vecfuncT& Kf, const double tol) const;
+
     World& world;
     bool small_memory_;
     bool same_;
+    bool tiled_;
+    double memory_budget_;
+    double screening_thresh_;
     vecfuncT mo_bra, mo_ket;    ///< MOs for bra and ket
     Tensor<double> occ;
     std::shared_ptr<real_convolution_3d> poisson;
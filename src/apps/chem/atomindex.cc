@@ -0,0 +1,125 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+
+  $Id$
+*/
+
+/// \file atomindex.cc
+/// \brief Implementation of the spatial index over atomic centers
+
+#include <madness/world/madness_exception.h>
+#include <chem/atomindex.h>
+#include <chem/atomutil.h>
+#include <algorithm>
+#include <cmath>
+
+namespace madness {
+
+AtomIndex::AtomIndex(const std::vector<coordT>& centers, const std::vector<double>& radii)
+    : h(1.0), rmax(0.0), radius(radii)
+{
+    const long natom = centers.size();
+    MADNESS_ASSERT(long(radii.size()) == natom);
+
+    lo[0] = lo[1] = lo[2] = 0.0;
+    n[0] = n[1] = n[2] = 0;
+    if (natom == 0) return;
+
+    xyz.resize(3*natom);
+    for (long i=0; i<natom; ++i) {
+        for (int d=0; d<3; ++d) xyz[3*i+d] = centers[i][d];
+        rmax = std::max(rmax, radii[i]);
+    }
+
+    double hi[3];
+    for (int d=0; d<3; ++d) {
+        lo[d] = hi[d] = xyz[d];
+        for (long i=1; i<natom; ++i) {
+            lo[d] = std::min(lo[d], xyz[3*i+d]);
+            hi[d] = std::max(hi[d], xyz[3*i+d]);
+        }
+    }
+
+    // Cells are no smaller than the largest cutoff so a query visits only
+    // the neighboring cells, and large enough to hold about one atom each
+    double vol = 1.0;
+    for (int d=0; d<3; ++d) vol *= std::max(hi[d]-lo[d], 1.0);
+    h = std::max(rmax, std::cbrt(vol/natom));
+    for (int d=0; d<3; ++d) n[d] = long((hi[d]-lo[d])/h) + 1;
+
+    // Counting sort of the atoms by cell
+    const long ncell = n[0]*n[1]*n[2];
+    std::vector<long> cell(natom);
+    cellstart.assign(ncell+1, 0);
+    for (long i=0; i<natom; ++i) {
+        long ijk[3];
+        for (int d=0; d<3; ++d)
+            ijk[d] = std::min(n[d]-1, long((xyz[3*i+d]-lo[d])/h));
+        cell[i] = cell_index(ijk[0], ijk[1], ijk[2]);
+        ++cellstart[cell[i]+1];
+    }
+    for (long c=0; c<ncell; ++c) cellstart[c+1] += cellstart[c];
+    atoms.resize(natom);
+    std::vector<long> next(cellstart.begin(), cellstart.end()-1);
+    for (long i=0; i<natom; ++i) atoms[next[cell[i]]++] = i;
+}
+
+
+void AtomIndex::cell_range(const double* blo, const double* bhi, double pad,
+                           long* ilo, long* ihi) const {
+    for (int d=0; d<3; ++d) {
+        // clamp before converting so distant boxes cannot overflow
+        ilo[d] = long(std::max(0.0, std::floor((blo[d]-pad-lo[d])/h)));
+        ihi[d] = long(std::min(double(n[d]-1), std::floor((bhi[d]+pad-lo[d])/h)));
+    }
+}
+
+
+void AtomIndex::near(const double* blo, const double* bhi, std::vector<int>& result) const {
+    if (natom() == 0) return;
+    long ilo[3], ihi[3];
+    cell_range(blo, bhi, rmax, ilo, ihi);
+    for (long i=ilo[0]; i<=ihi[0]; ++i) {
+        for (long j=ilo[1]; j<=ihi[1]; ++j) {
+            for (long k=ilo[2]; k<=ihi[2]; ++k) {
+                const long c = cell_index(i, j, k);
+                for (long ia=cellstart[c]; ia<cellstart[c+1]; ++ia) {
+                    const int iat = atoms[ia];
+                    const double r = radius[iat];
+                    if (box_distance_sq(blo, bhi, xyz[3*iat], xyz[3*iat+1], xyz[3*iat+2]) <= r*r)
+                        result.push_back(iat);
+                }
+            }
+        }
+    }
+}
+
+}
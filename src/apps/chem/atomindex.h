@@ -0,0 +1,95 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+
+  $Id$
+*/
+
+
+#ifndef MADNESS_CHEM_ATOMINDEX_H__INCLUDED
+#define MADNESS_CHEM_ATOMINDEX_H__INCLUDED
+
+#include <madness/world/vector.h>
+#include <vector>
+
+/// \file atomindex.h
+/// \brief Spatial index over atomic centers for per-box molecular sums
+
+namespace madness {
+
+/// Uniform cell list over atomic centers with per-atom cutoff radii
+
+/// Projecting a molecular sum onto a box only needs the atoms whose
+/// cutoff sphere reaches the box.  The index bins the centers into
+/// cubic cells no smaller than the largest cutoff so that near() only
+/// inspects the cells overlapping the box padded by that cutoff.
+class AtomIndex {
+public:
+    typedef Vector<double,3> coordT;
+
+private:
+    double h;                           ///< cell width
+    double lo[3];                       ///< lower corner of the grid
+    long n[3];                          ///< number of cells in each dimension
+    double rmax;                        ///< largest cutoff radius
+    std::vector<double> xyz;            ///< atomic centers
+    std::vector<double> radius;         ///< cutoff radius of each atom
+    std::vector<long> cellstart;        ///< atoms of cell c are atoms[cellstart[c]..cellstart[c+1])
+    std::vector<int> atoms;             ///< atom indices sorted by cell
+
+    long cell_index(long i, long j, long k) const {
+        return (i*n[1] + j)*n[2] + k;
+    }
+
+    /// Computes the range of cells overlapping [blo-pad,bhi+pad] in each dimension
+    void cell_range(const double* blo, const double* bhi, double pad, long* ilo, long* ihi) const;
+
+public:
+    /// Makes an empty index
+    AtomIndex() : h(1.0), rmax(0.0) {
+        lo[0] = lo[1] = lo[2] = 0.0;
+        n[0] = n[1] = n[2] = 0;
+    }
+
+    /// Builds the index over the given centers and cutoff radii
+    AtomIndex(const std::vector<coordT>& centers, const std::vector<double>& radii);
+
+    /// Returns the number of atoms in the index
+    long natom() const {
+        return radius.size();
+    }
+
+    /// Appends to \c result the atoms whose cutoff sphere intersects the box [blo,bhi]
+    void near(const double* blo, const double* bhi, std::vector<int>& result) const;
+};
+
+}
+
+#endif
@@ -38,6 +38,9 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 
 /// \file atomutil.cc
 /// \brief implementation of utility functions for atom
@@ -327,6 +330,72 @@ double smoothed_potential(double r) {
 }
 
 
+void vexp(long n, const double* x, double* y) {
+    // exp(x) = 2^k exp(r) with k = nint(x/ln2) and |r| <= ln2/2.  Adding
+    // 1.5*2^52 rounds x/ln2 to an integer left in the low bits of the
+    // mantissa, so 2^k is built with integer operations only and the
+    // loop has no branches.
+    static const double log2e = 1.4426950408889634074;
+    static const double ln2hi = 6.93147180369123816490e-01;
+    static const double ln2lo = 1.90821492927058770002e-10;
+    static const double shift = 6755399441055744.0;
+    int64_t shiftbits;
+    std::memcpy(&shiftbits, &shift, sizeof(shift));
+
+    for (long i=0; i<n; ++i) {
+        const double xi = std::max(x[i], -708.0);
+        const double t = xi*log2e + shift;
+        const double k = t - shift;
+        const double r = (xi - k*ln2hi) - k*ln2lo;
+
+        // Taylor series through r^12, error below 2e-16 relative
+        double p = 1.0/479001600.0;
+        p = p*r + 1.0/39916800.0;
+        p = p*r + 1.0/3628800.0;
+        p = p*r + 1.0/362880.0;
+        p = p*r + 1.0/40320.0;
+        p = p*r + 1.0/5040.0;
+        p = p*r + 1.0/720.0;
+        p = p*r + 1.0/120.0;
+        p = p*r + 1.0/24.0;
+        p = p*r + 1.0/6.0;
+        p = p*r + 0.5;
+        p = p*r + 1.0;
+        p = p*r + 1.0;
+
+        int64_t bits;
+        std::memcpy(&bits, &t, sizeof(t));
+        bits = (bits - shiftbits + 1023) << 52;
+        double scale;
+        std::memcpy(&scale, &bits, sizeof(scale));
+        y[i] = (x[i] < -708.0) ? 0.0 : p*scale;
+    }
+}
+
+
+void bounding_box(long npt, const double* x, const double* y, const double* z,
+                  double* lo, double* hi) {
+    lo[0] = lo[1] = lo[2] = std::numeric_limits<double>::max();
+    hi[0] = hi[1] = hi[2] = -std::numeric_limits<double>::max();
+    for (long i=0; i<npt; ++i) {
+        lo[0] = std::min(lo[0],x[i]); hi[0] = std::max(hi[0],x[i]);
+        lo[1] = std::min(lo[1],y[i]); hi[1] = std::max(hi[1],y[i]);
+        lo[2] = std::min(lo[2],z[i]); hi[2] = std::max(hi[2],z[i]);
+    }
+}
+
+
+double box_distance_sq(const double* lo, const double* hi, double x, double y, double z) {
+    const double r[3] = {x, y, z};
+    double sum = 0.0;
+    for (int d=0; d<3; ++d) {
+        double dd = std::max(0.0, std::max(lo[d]-r[d], r[d]-hi[d]));
+        sum += dd*dd;
+    }
+    return sum;
+}
+
+
 /// Derivative of the regularized 1/r potential
 
 /// dV/dx = (x/r) * du(r/c)/(c*c)
@@ -78,6 +78,19 @@ double smoothed_potential(double r);
 double dsmoothed_potential(double r);
 double d2smoothed_potential(double r);
 double smoothed_density(double r);
+
+/// Computes y[i] = exp(x[i]) for 0<=i<n in a loop that compilers vectorize
+
+/// Accurate to a few ulp; arguments below -708 give zero and arguments
+/// must not exceed 708.
+void vexp(long n, const double* x, double* y);
+
+/// Computes the bounding box lo[3], hi[3] of npt points
+void bounding_box(long npt, const double* x, const double* y, const double* z,
+                  double* lo, double* hi);
+
+/// Returns the square of the distance from (x,y,z) to the box [lo,hi] (zero inside)
+double box_distance_sq(const double* lo, const double* hi, double x, double y, double z);
 }
 #endif
 
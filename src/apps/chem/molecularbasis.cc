@@ -78,6 +78,140 @@ void AtomicBasisFunction::print_me(std::ostream& s) const {
     s << "atomic basis function: center " << xx << " " << yy << " " << zz << " : ibf " << ibf << " nbf " << nbf << " : shell " << shell << std::endl;
 }
 
+void ContractedGaussianShell::eval(long npt, const double* rsq, const double* x,
+                                   const double* y, const double* z, double* bf) const {
+    // Radial part accumulated primitive by primitive.  The scalar cutoffs
+    // are kept as selects so the loops stay free of branches.
+    std::vector<double> R(npt, 0.0), work(npt);
+    for (unsigned int p=0; p<coeff.size(); ++p) {
+        const double a = expnt[p];
+        for (long i=0; i<npt; ++i) {
+            double ersq = a*rsq[i];
+            work[i] = (ersq < 27.6) ? -ersq : -1000.0; // 27.6 = log(1e12)
+        }
+        vexp(npt, work.data(), work.data());
+        const double c = coeff[p];
+        for (long i=0; i<npt; ++i) R[i] += c*work[i];
+    }
+    for (long i=0; i<npt; ++i) {
+        if (rsq[i] > rsqmax || std::fabs(R[i]) < 1e-12) R[i] = 0.0;
+    }
+
+    switch (type) {
+    case 0:
+        for (long i=0; i<npt; ++i) bf[i] = R[i];
+        break;
+    case 1:
+        for (long i=0; i<npt; ++i) {
+            bf[i      ] = R[i]*x[i];
+            bf[i+  npt] = R[i]*y[i];
+            bf[i+2*npt] = R[i]*z[i];
+        }
+        break;
+    case 2:
+        for (long i=0; i<npt; ++i) {
+            bf[i      ] = R[i]*x[i]*x[i];
+            bf[i+  npt] = R[i]*x[i]*y[i];
+            bf[i+2*npt] = R[i]*x[i]*z[i];
+            bf[i+3*npt] = R[i]*y[i]*y[i];
+            bf[i+4*npt] = R[i]*y[i]*z[i];
+            bf[i+5*npt] = R[i]*z[i]*z[i];
+        }
+        break;
+    case 3:
+        for (long i=0; i<npt; ++i) {
+            bf[i      ] = R[i]*x[i]*x[i]*x[i];
+            bf[i+  npt] = R[i]*x[i]*x[i]*y[i];
+            bf[i+2*npt] = R[i]*x[i]*x[i]*z[i];
+            bf[i+3*npt] = R[i]*x[i]*y[i]*y[i];
+            bf[i+4*npt] = R[i]*x[i]*y[i]*z[i];
+            bf[i+5*npt] = R[i]*x[i]*z[i]*z[i];
+            bf[i+6*npt] = R[i]*y[i]*y[i]*y[i];
+            bf[i+7*npt] = R[i]*y[i]*y[i]*z[i];
+            bf[i+8*npt] = R[i]*y[i]*z[i]*z[i];
+            bf[i+9*npt] = R[i]*z[i]*z[i]*z[i];
+        }
+        break;
+    default:
+        throw "UNKNOWN ANGULAR MOMENTUM";
+    }
+}
+
+void AtomicBasis::eval_guess_density(long npt, const double* x, const double* y,
+                                     const double* z, bool pspat, double* rho) const {
+    MADNESS_ASSERT(has_guess_info());
+    std::vector<double> rsq(npt), bf(numbf*npt), sumj(npt);
+    for (long i=0; i<npt; ++i) rsq[i] = x[i]*x[i] + y[i]*y[i] + z[i]*z[i];
+
+    double* b = bf.data();
+    for (unsigned int s=0; s<g.size(); ++s) {
+        g[s].eval(npt, rsq.data(), x, y, z, b);
+        b += g[s].nbf()*npt;
+    }
+
+    const double* p = pspat ? dmatpsp.ptr() : dmat.ptr();
+    for (int i=0; i<numbf; ++i, p+=numbf) {
+        for (long k=0; k<npt; ++k) sumj[k] = 0.0;
+        for (int j=0; j<numbf; ++j) {
+            const double pij = p[j];
+            const double* bj = &bf[j*npt];
+            for (long k=0; k<npt; ++k) sumj[k] += pij*bj[k];
+        }
+        const double* bi = &bf[i*npt];
+        for (long k=0; k<npt; ++k) rho[k] += bi[k]*sumj[k];
+    }
+}
+
+void AtomicBasisFunction::operator()(long npt, const double* x, const double* y,
+                                     const double* z, double* f) const {
+    double lo[3], hi[3];
+    bounding_box(npt, x, y, z, lo, hi);
+    if (box_distance_sq(lo, hi, xx, yy, zz) > shell.rangesq()) {
+        for (long i=0; i<npt; ++i) f[i] = 0.0;
+        return;
+    }
+
+    std::vector<double> xs(npt), ys(npt), zs(npt), rsq(npt), bf(nbf*npt);
+    for (long i=0; i<npt; ++i) {
+        xs[i] = x[i]-xx;
+        ys[i] = y[i]-yy;
+        zs[i] = z[i]-zz;
+        rsq[i] = xs[i]*xs[i] + ys[i]*ys[i] + zs[i]*zs[i];
+    }
+    shell.eval(npt, rsq.data(), xs.data(), ys.data(), zs.data(), bf.data());
+    std::copy(&bf[ibf*npt], &bf[ibf*npt]+npt, f);
+}
+
+AtomIndex AtomicBasisSet::guess_density_index(const Molecule& molecule) const {
+    std::vector<double> radii(molecule.natom());
+    for (int i=0; i<molecule.natom(); ++i)
+        radii[i] = std::sqrt(ag[molecule.get_atom(i).atomic_number].rangesq());
+    return AtomIndex(molecule.get_all_coords_vec(), radii);
+}
+
+void AtomicBasisSet::eval_guess_density(const Molecule& molecule, const AtomIndex& index,
+                                        long npt, const double* x, const double* y,
+                                        const double* z, double* rho) const {
+    for (long i=0; i<npt; ++i) rho[i] = 0.0;
+
+    double lo[3], hi[3];
+    bounding_box(npt, x, y, z, lo, hi);
+    std::vector<int> near;
+    index.near(lo, hi, near);
+
+    std::vector<double> xs(npt), ys(npt), zs(npt);
+    for (int iat : near) {
+        const Atom& atom = molecule.get_atom(iat);
+        for (long i=0; i<npt; ++i) {
+            xs[i] = x[i]-atom.x;
+            ys[i] = y[i]-atom.y;
+            zs[i] = z[i]-atom.z;
+        }
+        ag[atom.atomic_number].eval_guess_density(npt, xs.data(), ys.data(), zs.data(),
+                                                  atom.pseudo_atom, rho);
+    }
+}
+
 /// Print basis info for atoms in the molecule (once for each unique atom type)
 void AtomicBasisSet::print(const Molecule& molecule) const {
     molecule.print();
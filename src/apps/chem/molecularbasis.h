@@ -166,6 +166,14 @@ public:
     }
 
 
+    /// Evaluates the entire shell at npt points
+
+    /// Coordinates x, y, z are relative to the center and rsq holds the
+    /// squared distances.  Function ibf at point i is stored in bf[ibf*npt+i].
+    void eval(long npt, const double* rsq, const double* x, const double* y,
+              const double* z, double* bf) const;
+
+
     /// Returns the shell angular momentum
     int angular_momentum() const {
         return type;
@@ -258,6 +266,11 @@ public:
         return g;
     };
 
+    /// Returns square of the distance beyond which all functions on the center vanish
+    double rangesq() const {
+        return rmaxsq;
+    }
+
     /// Evaluates the basis functions at point x, y, z relative to atomic center
 
     /// The array bf[] must be large enough to hold nbf() values.
@@ -303,6 +316,10 @@ public:
         return sum;
     }
 
+    /// Adds the guess atomic density at npt points relative to the atomic center to rho[]
+    void eval_guess_density(long npt, const double* x, const double* y, const double* z,
+                            bool pspat, double* rho) const;
+
     /// Return shell that contains basis function ibf and also return index of function in the shell
     const ContractedGaussianShell& get_shell_from_basis_function(int ibf, int& ibf_in_shell) const {
         int n=0;
@@ -421,6 +438,10 @@ public:
         return bf[ibf];
     }
 
+    /// Evaluates the function at npt points storing the values in f[]
+    void operator()(long npt, const double* x, const double* y, const double* z,
+                    double* f) const;
+
     void print_me(std::ostream& s) const;
 
     const ContractedGaussianShell& get_shell() const {
@@ -596,6 +617,17 @@ public:
         return sum;
     }
 
+    /// Returns a spatial index over the atoms with the range of their basis as cutoff
+    AtomIndex guess_density_index(const Molecule& molecule) const;
+
+    /// Evaluates the guess density at npt points
+
+    /// Only the atoms of \c index whose basis reaches the bounding box of
+    /// the points are visited.
+    void eval_guess_density(const Molecule& molecule, const AtomIndex& index, long npt,
+                            const double* x, const double* y, const double* z,
+                            double* rho) const;
+
     bool is_supported(int atomic_number) const {
         return ag[atomic_number].nbf() > 0;
     }
@@ -777,6 +777,46 @@ double Molecule::nuclear_attraction_potential(double x, double y, double z) cons
     return sum;
 }
 
+AtomIndex Molecule::nuclear_attraction_index() const {
+    std::vector<double> radii(atoms.size());
+    for (unsigned int i=0; i<atoms.size(); ++i) radii[i] = 7.0/rcut[i];
+    return AtomIndex(get_all_coords_vec(), radii);
+}
+
+void Molecule::nuclear_attraction_potential(const AtomIndex& index, long npt,
+                                            const double* x, const double* y,
+                                            const double* z, double* v) const {
+    MADNESS_ASSERT(index.natom() == long(atoms.size()));
+    for (long k=0; k<npt; ++k) v[k] = field[0]*x[k] + field[1]*y[k] + field[2]*z[k];
+
+    double lo[3], hi[3];
+    bounding_box(npt, x, y, z, lo, hi);
+    std::vector<int> near;
+    index.near(lo, hi, near);
+    std::vector<char> isnear(atoms.size(), 0);
+    for (int i : near) isnear[i] = 1;
+
+    for (unsigned int i=0; i<atoms.size(); ++i) {
+        if (atoms[i].pseudo_atom) continue;
+
+        const double ax=atoms[i].x, ay=atoms[i].y, az=atoms[i].z, q=atoms[i].q;
+        if (isnear[i]) {
+            const double rc = rcut[i];
+            for (long k=0; k<npt; ++k) {
+                const double r = distance(ax, ay, az, x[k], y[k], z[k]);
+                v[k] -= q*smoothed_potential(r*rc)*rc;
+            }
+        }
+        else {
+            // smoothed_potential(r) is exactly 1/r beyond r=7
+            for (long k=0; k<npt; ++k) {
+                const double dx=x[k]-ax, dy=y[k]-ay, dz=z[k]-az;
+                v[k] -= q/std::sqrt(dx*dx + dy*dy + dz*dz);
+            }
+        }
+    }
+}
+
 double Molecule::atomic_attraction_potential(int iatom, double x, double y,
         double z) const {
 
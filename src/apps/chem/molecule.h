@@ -37,6 +37,7 @@
 
 #include <chem/corepotential.h>
 #include <chem/atomutil.h>
+#include <chem/atomindex.h>
 #include <madness/world/vector.h>
 #include <vector>
 #include <string>
@@ -308,6 +309,21 @@ public:
     /// nuclear attraction potential for the whole molecule
     double nuclear_attraction_potential(double x, double y, double z) const;
 
+    /// spatial index over the atoms for nuclear_attraction_potential()
+
+    /// The cutoff radius of each atom is the distance 7/rcut beyond which
+    /// its smoothed potential is exactly 1/r.
+    AtomIndex nuclear_attraction_index() const;
+
+    /// nuclear attraction potential for the whole molecule at npt points
+
+    /// Only the atoms that \c index finds near the bounding box of the
+    /// points need the smoothed potential; the tails of all others are
+    /// summed as exact 1/r in a vectorizable loop.
+    void nuclear_attraction_potential(const AtomIndex& index, long npt,
+                                      const double* x, const double* y,
+                                      const double* z, double* v) const;
+
     /// nuclear attraction potential for a specific atom in the molecule
     double atomic_attraction_potential(int iatom, double x, double y, double z) const;
 
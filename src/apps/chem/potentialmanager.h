@@ -53,14 +53,21 @@ namespace madness {
 class MolecularPotentialFunctor : public FunctionFunctorInterface<double,3> {
 private:
     const Molecule& molecule;
+    const AtomIndex index;
 public:
     MolecularPotentialFunctor(const Molecule& molecule)
-        : molecule(molecule) {}
+        : molecule(molecule), index(molecule.nuclear_attraction_index()) {}
 
     double operator()(const coord_3d& x) const {
         return molecule.nuclear_attraction_potential(x[0], x[1], x[2]);
     }
 
+    virtual bool supports_vectorized() const {return true;}
+
+    void operator()(const Vector<double*,3>& xvals, double* MADNESS_RESTRICT fvals, int npts) const {
+        molecule.nuclear_attraction_potential(index, npts, xvals[0], xvals[1], xvals[2], fvals);
+    }
+
     std::vector<coord_3d> special_points() const {return molecule.get_all_coords_vec();}
 };
 
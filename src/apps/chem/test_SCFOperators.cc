@@ -35,6 +35,7 @@
 #include <chem/SCF.h>
 #include <chem/nemo.h>
 #include <chem/correlationfactor.h>
+#include <chem/atomindex.h>
 
 using namespace madness;
 
@@ -438,6 +439,30 @@ int test_exchange(World& world) {
     success=test_asymmetric<Exchange,3>(world, K, thresh);
     if (success>0) return 1;
 
+    // repeat with the large memory algorithm, which forms all pair products at once
+    K.small_memory(false);
+    success=exchange_anchor_test(world, K, thresh);
+    if (success>0) return 1;
+
+    success=test_asymmetric<Exchange,3>(world, K, thresh);
+    if (success>0) return 1;
+
+    K.same(true);
+    success=exchange_anchor_test(world, K, thresh);
+    if (success>0) return 1;
+    K.same(false).small_memory(true);
+
+    // repeat with the screened, tiled algorithm and a budget of a few pairs
+    K.tiled(true).memory_budget(1.e6);
+    success=exchange_anchor_test(world, K, thresh);
+    if (success>0) return 1;
+
+    success=test_hermiticity<Exchange,3>(world, K, thresh);
+    if (success>0) return 1;
+
+    success=test_asymmetric<Exchange,3>(world, K, thresh);
+    if (success>0) return 1;
+
     return 0;
 }
 
@@ -743,6 +768,181 @@ int test_dnuclear(World& world) {
     return ierr;
 }
 
+/// largest difference between the scalar and the vectorized call of a functor
+
+/// The points are drawn in boxes of random center and size, and each box
+/// is passed to the vectorized call at once, as fcube does.
+double vectorized_error(const FunctionFunctorInterface<double,3>& f,
+        const Tensor<double>& cell, const int nbox, const int npt) {
+    MADNESS_ASSERT(f.supports_vectorized());
+    std::vector<double> x(npt), y(npt), z(npt), fval(npt);
+    double err=0.0;
+    for (int ibox=0; ibox<nbox; ++ibox) {
+        coord_3d center, width;
+        for (int d=0; d<3; ++d) {
+            center[d]=cell(d,0)+RandomValue<double>()*(cell(d,1)-cell(d,0));
+            width[d]=0.01+2.0*RandomValue<double>();
+        }
+        for (int i=0; i<npt; ++i) {
+            x[i]=center[0]+(RandomValue<double>()-0.5)*width[0];
+            y[i]=center[1]+(RandomValue<double>()-0.5)*width[1];
+            z[i]=center[2]+(RandomValue<double>()-0.5)*width[2];
+        }
+        Vector<double*,3> xvals{&x[0],&y[0],&z[0]};
+        f(xvals,&fval[0],npt);
+        for (int i=0; i<npt; ++i) {
+            const double fs=f(coord_3d{x[i],y[i],z[i]});
+            err=std::max(err,std::abs(fs-fval[i])/std::max(1.0,std::abs(fs)));
+        }
+    }
+    return err;
+}
+
+/// the vectorized molecular functors must agree with their scalar versions
+int test_vectorized_functors(World& world) {
+    if (world.rank()==0) print("\nentering test_vectorized_functors");
+
+    // water and a distant hydrogen atom, so that atoms are skipped
+    Molecule molecule;
+    molecule.add_atom( 0.0,  0.0,  0.0, 8.0, 8);
+    molecule.add_atom( 1.43, 1.1,  0.0, 1.0, 1);
+    molecule.add_atom(-1.43, 1.1,  0.0, 1.0, 1);
+    molecule.add_atom( 0.0,  0.0, 12.0, 1.0, 1);
+    molecule.set_eprec(1.e-4);
+
+    AtomicBasisSet aobasis;
+    aobasis.read_file("6-31g");
+
+    Tensor<double> cell(3,2);
+    cell(_,0)=-6.0;
+    cell(_,1)=6.0;
+    cell(2,1)=16.0;
+    const int nbox=100, npt=40;     // 4000 points
+
+    double err=vectorized_error(MolecularGuessDensityFunctor(molecule,aobasis),cell,nbox,npt);
+    if (world.rank()==0) print("guess density error  ",err);
+    if (check_err(err,1.e-13,"vectorized guess density")) return 1;
+
+    err=vectorized_error(MolecularPotentialFunctor(molecule),cell,nbox,npt);
+    if (world.rank()==0) print("nuclear potential error",err);
+    if (check_err(err,1.e-13,"vectorized nuclear potential")) return 1;
+
+    for (int iatom=0; iatom<molecule.natom(); ++iatom) {
+        err=vectorized_error(AtomicAttractionFunctor(molecule,iatom),cell,nbox,npt);
+        if (check_err(err,1.e-13,"vectorized atomic attraction")) return 1;
+    }
+
+    err=0.0;
+    for (int ibf=0; ibf<aobasis.nbf(molecule); ++ibf) {
+        AtomicBasisFunctor aof(aobasis.get_atomic_basis_function(molecule,ibf));
+        err=std::max(err,vectorized_error(aof,cell,nbox/10,npt));
+    }
+    if (world.rank()==0) print("basis function error  ",err);
+    if (check_err(err,1.e-13,"vectorized basis functions")) return 1;
+
+    return 0;
+}
+
+/// AtomIndex::near must find the same atoms as a scan over all atoms
+int atom_index_check(const std::vector<coord_3d>& centers,
+        const std::vector<double>& radii, const double extent) {
+    AtomIndex index(centers,radii);
+    std::vector<int> near, brute;
+    for (int ibox=0; ibox<500; ++ibox) {
+        // boxes of all sizes, many of them partly or fully outside the grid
+        double blo[3], bhi[3];
+        for (int d=0; d<3; ++d) {
+            const double c=(RandomValue<double>()-0.5)*3.0*extent;
+            const double w=std::pow(10.0,2.0*RandomValue<double>()-1.5);
+            blo[d]=c-w;
+            bhi[d]=c+w;
+        }
+        near.clear();
+        index.near(blo,bhi,near);
+        brute.clear();
+        for (std::size_t iat=0; iat<centers.size(); ++iat) {
+            double rsq=0.0;
+            for (int d=0; d<3; ++d) {
+                const double dx=std::max(0.0,std::max(blo[d]-centers[iat][d],centers[iat][d]-bhi[d]));
+                rsq+=dx*dx;
+            }
+            if (rsq<=radii[iat]*radii[iat]) brute.push_back(iat);
+        }
+        std::sort(near.begin(),near.end());
+        if (near!=brute) return 1;
+    }
+    return 0;
+}
+
+int test_atom_index(World& world) {
+    if (world.rank()==0) print("\nentering test_atom_index");
+    std::vector<coord_3d> centers;
+    std::vector<double> radii;
+
+    // the empty index finds nothing
+    if (check_err(atom_index_check(centers,radii,10.0),0.0,"empty atom index")) return 1;
+
+    // a random cluster with cutoffs of very different sizes
+    for (int i=0; i<200; ++i) {
+        coord_3d c;
+        for (int d=0; d<3; ++d) c[d]=(RandomValue<double>()-0.5)*20.0;
+        centers.push_back(c);
+        radii.push_back(std::pow(10.0,RandomValue<double>()*1.5-1.0));
+    }
+    if (check_err(atom_index_check(centers,radii,10.0),0.0,"atom index of a cluster")) return 1;
+
+    // atoms along a line make a grid one cell thick in two dimensions
+    centers.clear();
+    radii.clear();
+    for (int i=0; i<100; ++i) {
+        centers.push_back(coord_3d{0.3*i-15.0,1.0,-2.0});
+        radii.push_back(0.5+RandomValue<double>());
+    }
+    if (check_err(atom_index_check(centers,radii,15.0),0.0,"atom index of a chain")) return 1;
+
+    return 0;
+}
+
+/// the guess density without screening of boxes
+struct UnscreenedGuessDensity : public FunctionFunctorInterface<double,3> {
+    const MolecularGuessDensityFunctor& f;
+    UnscreenedGuessDensity(const MolecularGuessDensityFunctor& f) : f(f) {}
+    double operator()(const coord_3d& x) const {return f(x);}
+    bool supports_vectorized() const {return true;}
+    void operator()(const Vector<double*,3>& xvals, double* MADNESS_RESTRICT fvals, int npts) const {
+        f(xvals,fvals,npts);
+    }
+    std::vector<coord_3d> special_points() const {return f.special_points();}
+};
+
+/// screening boxes no atomic density reaches must not change the projection
+int test_screened_guess(World& world) {
+    if (world.rank()==0) print("\nentering test_screened_guess");
+    FunctionDefaults<3>::set_thresh(1.e-5);
+    FunctionDefaults<3>::set_k(6);
+    FunctionDefaults<3>::set_cubic_cell(-30, 30);
+
+    Molecule molecule;
+    molecule.add_atom( 0.0,  0.0,  0.0, 8.0, 8);
+    molecule.add_atom( 1.43, 1.1,  0.0, 1.0, 1);
+    molecule.add_atom(-1.43, 1.1,  0.0, 1.0, 1);
+    molecule.add_atom( 0.0,  0.0, 12.0, 1.0, 1);
+    AtomicBasisSet aobasis;
+    aobasis.read_file("6-31g");
+
+    std::shared_ptr<MolecularGuessDensityFunctor> screened(
+            new MolecularGuessDensityFunctor(molecule,aobasis));
+    real_function_3d rho=real_factory_3d(world).functor(screened);
+    real_function_3d rhoref=real_factory_3d(world)
+            .functor(std::shared_ptr<FunctionFunctorInterface<double,3> >(
+                    new UnscreenedGuessDensity(*screened)));
+
+    const double err=(rho-rhoref).norm2();
+    if (world.rank()==0) print("guess density with and without screening",rho.trace(),rhoref.trace(),err);
+    if (check_err(err,1.e-10,"screened guess density")) return 1;
+    return 0;
+}
+
 int test_SCF(World& world) {
     FunctionDefaults<3>::set_thresh(1.e-5);
     double thresh=FunctionDefaults<3>::get_thresh();
@@ -794,6 +994,9 @@ int main(int argc, char** argv) {
     result+=test_XCOperator(world);
     result+=test_nuclear(world);
     result+=test_dnuclear(world);
+    result+=test_vectorized_functors(world);
+    result+=test_atom_index(world);
+    result+=test_screened_guess(world);
     result+=test_SCF(world);
     result+=test_nemo(world);
 
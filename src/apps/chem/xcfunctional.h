@@ -263,6 +263,8 @@ public:
     /// \f$ E[\rho] = \int \epsilon[\rho(x)] dx\f$
     /// Any HF exchange contribution must be separately computed. Items in the
     /// vector argument \c t are interpreted similarly to the xc_arg enum.
+    /// The evaluation is pointwise, so \c t may hold a single box or a flattened
+    /// batch of many boxes; the results of exc, vxc and fxc_apply have the shape of t[0].
     /// @param[in] t The input densities and derivatives as required by the functional
     /// @return The exchange-correlation energy functional
     madness::Tensor<double> exc(const std::vector< madness::Tensor<double> >& t) const;
@@ -81,7 +81,7 @@ bool XCfunctional::has_kxc() const
 madness::Tensor<double> XCfunctional::exc(const std::vector< madness::Tensor<double> >& t) const
 {
     const double* arho = t[0].ptr();
-    madness::Tensor<double> result(3L, t[0].dims(), false);
+    madness::Tensor<double> result(t[0].ndim(), t[0].dims(), false);
     double* f = result.ptr();
     if (spin_polarized) {
         const double* brho = t[1].ptr();
@@ -122,7 +122,7 @@ std::vector<madness::Tensor<double> > XCfunctional::vxc(const std::vector< madne
     //MADNESS_ASSERT(what == 0);
     const double* arho = t[0].ptr();
     std::vector<madness::Tensor<double> > result(1);
-    result[0]=madness::Tensor<double>(3L, t[0].dims(), false);
+    result[0]=madness::Tensor<double>(t[0].ndim(), t[0].dims(), false);
     double* f = result[0].ptr();
 
     if (spin_polarized) {
@@ -168,6 +168,49 @@ bool XCfunctional::has_kxc() const
     return false;
 }
 
+/// indices of the points where any spin component of the munged density is nonzero
+
+/// libxc returns zero at vanishing density, so only these points are passed to it;
+/// with the default rhomin=0 this skips everything below rhotol
+static std::vector<int> live_points(const Tensor<double>& rho, const int nspin) {
+    const long np=rho.size()/nspin;
+    const double * MADNESS_RESTRICT dens = rho.ptr();
+    std::vector<int> live;
+    live.reserve(np);
+    for (long i=0; i<np; i++) {
+        bool any=false;
+        for (int s=0; s<nspin; s++) any = any or (dens[nspin*i+s]!=0.0);
+        if (any) live.push_back(i);
+    }
+    return live;
+}
+
+/// gather the stride values of each live point into a contiguous tensor
+static Tensor<double> gather_points(const Tensor<double>& a, const std::vector<int>& live,
+        const int stride) {
+    if (a.size()==0 or long(live.size()*stride)==a.size()) return a;
+    Tensor<double> r(std::vector<long>(1,live.size()*stride), false);
+    const double * MADNESS_RESTRICT p = a.ptr();
+    double * MADNESS_RESTRICT q = r.ptr();
+    for (std::size_t i=0; i<live.size(); i++) {
+        for (int s=0; s<stride; s++) q[stride*i+s] = p[stride*live[i]+s];
+    }
+    return r;
+}
+
+/// scatter the stride values of each live point back into a zeroed tensor of np points
+static Tensor<double> scatter_points(const Tensor<double>& a, const std::vector<int>& live,
+        const int stride, const long np) {
+    if (long(live.size())==np) return a;
+    Tensor<double> r(np*stride);
+    const double * MADNESS_RESTRICT p = a.ptr();
+    double * MADNESS_RESTRICT q = r.ptr();
+    for (std::size_t i=0; i<live.size(); i++) {
+        for (int s=0; s<stride; s++) q[stride*live[i]+s] = p[stride*i+s];
+    }
+    return r;
+}
+
 
 void XCfunctional::make_libxc_args(const std::vector< madness::Tensor<double> >& xc_args,
            madness::Tensor<double>& rho, madness::Tensor<double>& sigma,
@@ -368,30 +411,37 @@ madness::Tensor<double> XCfunctional::exc(const std::vector< madness::Tensor<dou
     make_libxc_args(t, rho, sigma, rho_pt, sigma_pt, ddens, ddens_pt, false);
 
     const int np = t[0].size();
+    const int nspin = spin_polarized ? 2 : 1;
     const double * MADNESS_RESTRICT dens = rho.ptr();
-    const double * MADNESS_RESTRICT sig = sigma.ptr();
 
-    madness::Tensor<double> result(3L, t[0].dims());
+    // pass only points with non-vanishing density to libxc
+    const std::vector<int> live=live_points(rho,nspin);
+    const int npl=live.size();
+    const Tensor<double> rhol=gather_points(rho,live,nspin);
+    const Tensor<double> sigmal=gather_points(sigma,live,2*nspin-1);
+
+    madness::Tensor<double> result(t[0].ndim(), t[0].dims());
     double * MADNESS_RESTRICT res = result.ptr();
-    for (long j=0; j<np; j++) res[j] = 0.0;
 
     for (unsigned int i=0; i<funcs.size(); i++) {
-        madness::Tensor<double> zk(3L, t[0].dims(), false);
-        double * MADNESS_RESTRICT work = zk.ptr();
+        if (npl==0) break;
+        madness::Tensor<double> zk(npl);
 
         switch(funcs[i].first->info->family) {
         case XC_FAMILY_LDA:
-            xc_lda_exc(funcs[i].first, np, dens, work);
+            xc_lda_exc(funcs[i].first, npl, rhol.ptr(), zk.ptr());
             break;
         case XC_FAMILY_GGA:
-            xc_gga_exc(funcs[i].first, np, dens, sig, work);
+            xc_gga_exc(funcs[i].first, npl, rhol.ptr(), sigmal.ptr(), zk.ptr());
             break;
         case XC_FAMILY_HYB_GGA:
-            xc_gga_exc(funcs[i].first, np, dens, sig, work);
+            xc_gga_exc(funcs[i].first, npl, rhol.ptr(), sigmal.ptr(), zk.ptr());
             break;
         default:
             throw "HOW DID WE GET HERE?";
         }
+        zk=scatter_points(zk,live,1,np);
+        const double * MADNESS_RESTRICT work = zk.ptr();
         if (spin_polarized) {
             for (long j=0; j<np; j++) {
                 res[j] +=  work[j]*(dens[2*j+1] + dens[2*j])*funcs[i].second;
@@ -439,23 +489,29 @@ std::vector<madness::Tensor<double> > XCfunctional::vxc(
     if (is_gga() and (is_spin_polarized())) result_size= 7;
     MADNESS_ASSERT(result_size>0);
 
-    Tensor<double> r(3L, t[0].dims());
-    r=0.0;
+    Tensor<double> r(t[0].ndim(), t[0].dims());
     std::vector<Tensor<double> > result(result_size);
     for (Tensor<double>& rr : result) rr=copy(r);
 
-    const double * MADNESS_RESTRICT dens = rho.ptr();   // nspin * np
+    // pass only points with non-vanishing density to libxc
+    const std::vector<int> live=live_points(rho,nvrho);
+    const int npl=live.size();
+    const Tensor<double> rhol=gather_points(rho,live,nvrho);
+    const Tensor<double> sigmal=gather_points(sigma,live,nvsig);
+
     const double * MADNESS_RESTRICT ddensx = drho[0].ptr();  // nspin * np
     const double * MADNESS_RESTRICT ddensy = drho[1].ptr();  // nspin * np
     const double * MADNESS_RESTRICT ddensz = drho[2].ptr();  // nspin * np
 
     for (unsigned int i=0; i<funcs.size(); i++) {
+        if (npl==0) break;
         switch(funcs[i].first->info->family) {
         case XC_FAMILY_LDA:
         {
-            madness::Tensor<double> vrho(nvrho*np);
-            double * MADNESS_RESTRICT vr = vrho.ptr();
-            xc_lda_vxc(funcs[i].first, np, dens, vr);
+            madness::Tensor<double> vrho(nvrho*npl);
+            xc_lda_vxc(funcs[i].first, npl, rhol.ptr(), vrho.ptr());
+            vrho=scatter_points(vrho,live,nvrho,np);
+            const double * MADNESS_RESTRICT vr = vrho.ptr();
             double * MADNESS_RESTRICT r0 = result[0].ptr();
 
             for (long j=0; j<np; j++) r0[j] += vr[nvrho*j+ispin]*funcs[i].second;
@@ -466,17 +522,18 @@ std::vector<madness::Tensor<double> > XCfunctional::vxc(
         case XC_FAMILY_HYB_GGA:
         case XC_FAMILY_GGA:
         {
-            madness::Tensor<double> vrho(nvrho*np), vsig(nvsig*np);
-            double * MADNESS_RESTRICT vr = vrho.ptr();
-            double * MADNESS_RESTRICT vs = vsig.ptr();
-            const double * MADNESS_RESTRICT sig = sigma.ptr();
+            madness::Tensor<double> vrho(nvrho*npl), vsig(nvsig*npl);
             // in: funcs[i].first
-            // in: np      number of points
-            // in: dens    the density [a,b]
-            // in: sig     contracted density gradients \nabla \rho . \nabla \rho [aa,ab,bb]
-            // out: vr     \del e/\del \rho_alpha [a,b]
-            // out: vs     \del e/\del sigma_alpha [aa,ab,bb]
-            xc_gga_vxc(funcs[i].first, np, dens, sig, vr, vs);
+            // in: npl     number of live points
+            // in: rhol    the density [a,b]
+            // in: sigmal  contracted density gradients \nabla \rho . \nabla \rho [aa,ab,bb]
+            // out: vrho   \del e/\del \rho_alpha [a,b]
+            // out: vsig   \del e/\del sigma_alpha [aa,ab,bb]
+            xc_gga_vxc(funcs[i].first, npl, rhol.ptr(), sigmal.ptr(), vrho.ptr(), vsig.ptr());
+            vrho=scatter_points(vrho,live,nvrho,np);
+            vsig=scatter_points(vsig,live,nvsig,np);
+            const double * MADNESS_RESTRICT vr = vrho.ptr();
+            const double * MADNESS_RESTRICT vs = vsig.ptr();
 
             if (spin_polarized) {
                 double * MADNESS_RESTRICT r0 = result[0].ptr();
@@ -563,25 +620,32 @@ std::vector<madness::Tensor<double> > XCfunctional::fxc_apply(
     const int nspin2=nspin*(nspin+1)/2;         // rhf: 1; uhf: 3
     const int nspin3=nspin2*(nspin2+1)/2;       // rhf: 1; uhf: 6
 
-    // intermediate tensors: partial derivatives of f_xc wrt rho/sigma
-    Tensor<double> v2rho2(nspin2*np);       // lda, gga
-    Tensor<double> v2rhosigma(nspin3*np);   // gga
-    Tensor<double> v2sigma2(nspin3*np);     // gga
-    Tensor<double> vrho(nspin*np);          // gga
-    Tensor<double> vsigma(nspin2*np);       // gga
+    // pass only points with non-vanishing density to libxc
+    const std::vector<int> live=live_points(rho,nspin);
+    const int npl=live.size();
+    const Tensor<double> rhol=gather_points(rho,live,nspin);
+    const Tensor<double> sigmal=gather_points(sigma,live,nspin2);
 
     // result tensor
-    Tensor<double> r(3L, t[0].dims());
+    Tensor<double> r(t[0].ndim(), t[0].dims());
     int result_size= this->is_gga() ? 4 : 1;
     std::vector<Tensor<double> > result(result_size);
     for (Tensor<double>& rr : result) rr=copy(r);
 
     for (unsigned int i=0; i<funcs.size(); i++) {
+        if (npl==0) break;
+
+        // intermediate tensors: partial derivatives of f_xc wrt rho/sigma
+        Tensor<double> v2rho2(nspin2*npl);       // lda, gga
+        Tensor<double> v2rhosigma(nspin3*npl);   // gga
+        Tensor<double> v2sigma2(nspin3*npl);     // gga
+        Tensor<double> vrho(nspin*npl);          // gga
+        Tensor<double> vsigma(nspin2*npl);       // gga
+
         switch(funcs[i].first->info->family) {
         case XC_FAMILY_LDA: {
-            double * MADNESS_RESTRICT vr = v2rho2.ptr();
-            const double * MADNESS_RESTRICT dens = rho.ptr();
-            xc_lda_fxc(funcs[i].first, np, dens, vr);
+            xc_lda_fxc(funcs[i].first, npl, rhol.ptr(), v2rho2.ptr());
+            v2rho2=scatter_points(v2rho2,live,nspin2,np);
 
             // only local terms
             result[0]+=v2rho2.emul(rho_pt);
@@ -592,7 +656,30 @@ std::vector<madness::Tensor<double> > XCfunctional::fxc_apply(
         case XC_FAMILY_HYB_GGA:
         case XC_FAMILY_GGA:
         {
-            const double * MADNESS_RESTRICT sig = sigma.ptr();
+            // in: funcs[i].first
+            // in: npl     number of live points
+            // in: rhol    the density [a,b], or 2*\rho_alpha
+            // in: sigmal  contracted density gradients \nabla \rho . \nabla \rho [aa,ab,bb]
+            // out: v2rho2      \del^2 e/\del \rho^2_alpha [a,b]
+            // out: v2rhosigma  \del^2 e/\del \sigma_alpha\rho [aa,ab,bb]
+            // out: v2sigma2    \del^2 e/\del \sigma^2_alpha [aa,ab,bb]
+            xc_gga_fxc(funcs[i].first, npl, rhol.ptr(), sigmal.ptr(),
+                    v2rho2.ptr(), v2rhosigma.ptr(), v2sigma2.ptr());
+
+            // in: funcs[i].first
+            // in: npl     number of live points
+            // in: rhol    the density [a,b]
+            // in: sigmal  contracted density gradients \nabla \rho . \nabla \rho [aa,ab,bb]
+            // out: vrho   \del e/\del \rho_alpha [a,b]
+            // out: vsigma \del e/\del sigma_alpha [aa,ab,bb]
+            xc_gga_vxc(funcs[i].first, npl, rhol.ptr(), sigmal.ptr(), vrho.ptr(), vsigma.ptr());
+
+            v2rho2=scatter_points(v2rho2,live,nspin2,np);
+            v2rhosigma=scatter_points(v2rhosigma,live,nspin3,np);
+            v2sigma2=scatter_points(v2sigma2,live,nspin3,np);
+            vrho=scatter_points(vrho,live,nspin,np);
+            vsigma=scatter_points(vsigma,live,nspin2,np);
+
             const double * MADNESS_RESTRICT dens = rho.ptr();
             const double * MADNESS_RESTRICT sig_pt = sigma_pt.ptr();
             const double * MADNESS_RESTRICT dens_pt = rho_pt.ptr();
@@ -603,35 +690,16 @@ std::vector<madness::Tensor<double> > XCfunctional::fxc_apply(
             const double * MADNESS_RESTRICT ddensy = drho[1].ptr();
             const double * MADNESS_RESTRICT ddensz = drho[2].ptr();
 
-            double * MADNESS_RESTRICT vr = vrho.ptr();
-            double * MADNESS_RESTRICT vs = vsigma.ptr();
-            double * MADNESS_RESTRICT vrr = v2rho2.ptr();
-            double * MADNESS_RESTRICT vrs = v2rhosigma.ptr();
-            double * MADNESS_RESTRICT vss = v2sigma2.ptr();
+            const double * MADNESS_RESTRICT vs = vsigma.ptr();
+            const double * MADNESS_RESTRICT vrr = v2rho2.ptr();
+            const double * MADNESS_RESTRICT vrs = v2rhosigma.ptr();
+            const double * MADNESS_RESTRICT vss = v2sigma2.ptr();
 
             double * MADNESS_RESTRICT r0 = result[0].ptr();
             double * MADNESS_RESTRICT r1 = result[1].ptr();
             double * MADNESS_RESTRICT r2 = result[2].ptr();
             double * MADNESS_RESTRICT r3 = result[3].ptr();
 
-            // in: funcs[i].first
-            // in: np      number of points
-            // in: dens    the density [a,b], or 2*\rho_alpha
-            // in: sig     contracted density gradients \nabla \rho . \nabla \rho [aa,ab,bb]
-            // out: vrr     \del^2 e/\del \rho^2_alpha [a,b]
-            // out: vrs     \del^2 e/\del \sigma_alpha\rho [aa,ab,bb]
-            // out: vss     \del^2 e/\del \sigma^2_alpha [aa,ab,bb]
-            xc_gga_fxc(funcs[i].first, np, dens, sig, vrr, vrs, vss);
-
-            // in: funcs[i].first
-            // in: np      number of points
-            // in: dens    the density [a,b]
-            // in: sig     contracted density gradients \nabla \rho . \nabla \rho [aa,ab,bb]
-            // out: vr     \del e/\del \rho_alpha [a,b]
-            // out: vs     \del e/\del sigma_alpha [aa,ab,bb]
-            xc_gga_vxc(funcs[i].first, np, dens, sig, vr, vs);
-
-
             for (long i=0; i<np; i++) {
 
                 // local terms
@@ -185,6 +185,7 @@ namespace madness {
         static bool truncate_on_project; ///< If true initial projection inserts at n-1 not n
         static bool apply_randomize;   ///< If true use randomization for load balancing in apply integral operator
         static bool project_randomize; ///< If true use randomization for load balancing in project/refine
+        static std::size_t apply_aggregation_size; ///< Bytes per destination at which aggregated apply results are sent (0 disables aggregation)
         static BoundaryConditions<NDIM> bc; ///< Default boundary conditions
         static Tensor<double> cell ;   ///< cell[NDIM][2] Simulation cell, cell(0,0)=xlo, cell(0,1)=xhi, ...
         static Tensor<double> cell_width;///< Width of simulation cell in each dimension
@@ -347,6 +348,23 @@ namespace madness {
         }
 
 
+        /// Gets the size of the per-destination buffers used to aggregate apply results
+        static std::size_t get_apply_aggregation_size() {
+            return apply_aggregation_size;
+        }
+
+        /// Sets the size of the per-destination buffers used to aggregate apply results
+
+        /// If nonzero, results of the integral operator apply that land on
+        /// the same destination box are summed locally by each thread and
+        /// sent to the owner in batches of about this many bytes rather than
+        /// one active message per box and displacement.  Zero (the default)
+        /// disables aggregation.  Only functions created afterwards are
+        /// affected.
+        static void set_apply_aggregation_size(std::size_t value) {
+            apply_aggregation_size=value;
+        }
+
         /// Gets the random load balancing for projection flag
         static bool get_project_randomize() {
             return project_randomize;
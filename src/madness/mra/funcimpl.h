@@ -35,6 +35,7 @@
 /// \file funcimpl.h
 /// \brief Provides FunctionCommonData, FunctionImpl and FunctionFactory
 
+#include <algorithm>
 #include <iostream>
 #include <type_traits>
 #include <madness/world/MADworld.h>
@@ -879,6 +880,23 @@ namespace madness {
 
         dcT coeffs; ///< The coefficients
 
+        /// Apply results destined for one process, summed by destination key
+        struct ApplyBatch {
+            std::size_t nbyte;                  ///< Bytes of coefficients in the batch
+            std::map<keyT,tensorT> blocks;      ///< Pre-summed result blocks
+
+            ApplyBatch() : nbyte(0) {}
+        };
+
+        /// Per-thread aggregation buffers for do_apply (see accumulate_aggregated)
+        struct ApplyAggregate {
+            Spinlock lock;                              ///< Only contended if a non-pool thread runs tasks
+            std::map<ProcessID,ApplyBatch> batches;     ///< Batches by destination process
+        };
+
+        std::unique_ptr<ApplyAggregate[]> apply_agg; ///< One slot per pool thread plus one, or null if not aggregating
+        AtomicInt apply_flush_pending; ///< Nonzero if a task to flush apply_agg has been submitted
+
         // Disable the default copy constructor
         FunctionImpl(const FunctionImpl<T,NDIM>& p);
 
@@ -913,8 +931,11 @@ namespace madness {
             , compressed(factory._compressed)
             , redundant(false)
             , coeffs(world,factory._pmap,false)
+            , apply_agg(FunctionDefaults<NDIM>::get_apply_aggregation_size() ?
+                        new ApplyAggregate[ThreadPool::size()+1] : nullptr)
             //, bc(factory._bc)
         {
+            apply_flush_pending = 0;
             // PROFILE_MEMBER_FUNC(FunctionImpl); // No need to profile this
             // !!! Ensure that all local state is correctly formed
             // before invoking process_pending for the coeffs and
@@ -977,8 +998,11 @@ namespace madness {
                          , compressed(other.compressed)
                          , redundant(other.redundant)
                          , coeffs(world, pmap ? pmap : other.coeffs.get_pmap())
+                         , apply_agg(FunctionDefaults<NDIM>::get_apply_aggregation_size() ?
+                                     new ApplyAggregate[ThreadPool::size()+1] : nullptr)
                          //, bc(other.bc)
         {
+            apply_flush_pending = 0;
             if (dozero) {
                 initial_level = 1;
                 insert_zero_down_to_initial_level(cdata.key0);
@@ -1106,8 +1130,9 @@ namespace madness {
 
         // saves a function impl to persistence
         // @param[in] ar   the archive where the function impl is to be stored
+        // @param[in] fence    fence after storing
         template <typename Archive>
-        void store(Archive& ar) {
+        void store(Archive& ar, bool fence=true) {
             // WE RELY ON K BEING STORED FIRST
 
             // note that functor should not be (re)stored
@@ -1115,7 +1140,7 @@ namespace madness {
                 & autorefine & truncate_on_project & nonstandard & compressed ; //& bc;
 
             ar & coeffs;
-            world.gop.fence();
+            if (fence) world.gop.fence();
         }
 
         /// Returns true if the function is compressed.
@@ -2496,6 +2521,117 @@ namespace madness {
             if (fence) world.gop.fence();
         }
 
+        /// Adapts a single-output op to the interface of multi_to_multi_op_values
+        template <typename opT>
+        struct multiop_to_multi_op {
+            opT op;
+            multiop_to_multi_op(const opT& op) : op(op) {}
+            std::vector<tensorT> operator()(const keyT& key, const std::vector<tensorT>& t) const {
+                return std::vector<tensorT>(1,op(key,t));
+            }
+        };
+
+        /// Operate on many functions with an operator acting on the values of many boxes at once
+
+        /// The values of all input functions in the given boxes are gathered into
+        /// contiguous 1-D tensors of length keys.size()*npt^NDIM, op is called once
+        /// on these, and its results are scattered back into the boxes of vout.
+        /// @param[in] keys the keys of the function nodes (boxes) in this batch
+        /// @param[in] op the pointwise operator; called with the key of the first box
+        /// @param[in] vin the vector of function impl's on which to be operated
+        /// @param[out] vout the resulting vector of function impl's
+        template <typename opT>
+        void multi_to_multi_op_values_batch_doit(const std::vector<keyT>& keys, const opT& op,
+                const std::vector<implT*>& vin, std::vector<implT*>& vout) {
+            const long nbox=keys.size();
+            const long npbox=power<NDIM>(cdata.npt);
+            std::vector<tensorT> c(vin.size());
+            for (unsigned int i=0; i<vin.size(); i++) {
+                if (vin[i]) {
+                    c[i]=tensorT(std::vector<long>(1,nbox*npbox),false);
+                    T* MADNESS_RESTRICT p=c[i].ptr();
+                    for (long j=0; j<nbox; ++j) {
+                        const tensorT v=coeffs2values(keys[j],
+                                vin[i]->coeffs.find(keys[j]).get()->second.coeff()).full_tensor();
+                        std::copy(v.ptr(), v.ptr()+npbox, p+j*npbox);
+                    }
+                }
+            }
+            const std::vector<tensorT> r = op(keys.front(), c);
+            MADNESS_ASSERT(r.size()==vout.size());
+            for (std::size_t i=0; i<vout.size(); ++i) {
+                MADNESS_ASSERT(r[i].size()==nbox*npbox);
+                const T* MADNESS_RESTRICT p=r[i].ptr();
+                for (long j=0; j<nbox; ++j) {
+                    tensorT v(cdata.vq,false);
+                    std::copy(p+j*npbox, p+(j+1)*npbox, v.ptr());
+                    vout[i]->coeffs.replace(keys[j],
+                            nodeT(coeffT(values2coeffs(keys[j], v),targs),false));
+                }
+            }
+        }
+
+        /// Operate on many functions with a pointwise operator acting on batches of boxes
+
+        /// Same result as multi_to_multi_op_values, but op is called once per batch of
+        /// about batchsize points instead of once per box, which amortizes the per-call
+        /// overhead of ops that wrap external libraries.  op must act pointwise and
+        /// must not depend on the shape of its input tensors or on the key.
+        /// Assumes all functions have been refined down to the same level
+        /// @param[in] op the pointwise operator
+        /// @param[in] vin the vector of function impl's on which to be operated
+        /// @param[out] vout the resulting vector of function impl's
+        /// @param[in] batchsize the approximate number of points per call to op
+        template <typename opT>
+        void multi_to_multi_op_values_batched(const opT& op, const std::vector<implT*>& vin,
+                std::vector<implT*>& vout, const long batchsize, const bool fence=true) {
+            // rough check on refinement level (ignore non-initialized functions
+            for (std::size_t i=1; i<vin.size(); ++i) {
+                if (vin[i] and vin[i-1]) {
+                    MADNESS_ASSERT(vin[i]->coeffs.size()==vin[i-1]->coeffs.size());
+                }
+            }
+            std::vector<keyT> keys;
+            typename dcT::iterator end = vin[0]->coeffs.end();
+            for (typename dcT::iterator it=vin[0]->coeffs.begin(); it!=end; ++it) {
+                const keyT& key = it->first;
+                if (it->second.has_coeff()) keys.push_back(key);
+                else {
+                    // fill result functions with empty box in this key
+                    for (implT* it2 : vout) {
+                        it2->coeffs.replace(key, nodeT(coeffT(),true));
+                    }
+                }
+            }
+
+            // keep every thread busy if there are too few boxes to fill whole batches
+            const long nthread=ThreadPool::size()+1;
+            const long nkey=keys.size();
+            long nperbatch=std::max(1L,batchsize/long(power<NDIM>(cdata.npt)));
+            nperbatch=std::min(nperbatch,std::max(1L,(nkey+nthread-1)/nthread));
+
+            for (long lo=0; lo<nkey; lo+=nperbatch) {
+                const long hi=std::min(nkey,lo+nperbatch);
+                std::vector<keyT> batch(keys.begin()+lo, keys.begin()+hi);
+                world.taskq.add(*this, &implT:: template multi_to_multi_op_values_batch_doit<opT>,
+                        batch, op, vin, vout);
+            }
+            if (fence) world.gop.fence();
+        }
+
+        /// Inplace operate on many functions with a pointwise operator acting on batches of boxes
+
+        /// See multi_to_multi_op_values_batched
+        /// @param[in] op the pointwise operator
+        /// @param[in] v the vector of function impl's on which to be operated
+        /// @param[in] batchsize the approximate number of points per call to op
+        template <typename opT>
+        void multiop_values_batched(const opT& op, const std::vector<implT*>& v,
+                const long batchsize) {
+            std::vector<implT*> vout(1,this);
+            multi_to_multi_op_values_batched(multiop_to_multi_op<opT>(op), v, vout, batchsize, true);
+        }
+
         /// Transforms a vector of functions left[i] = sum[j] right[j]*c[j,i] using sparsity
         /// @param[in] vright vector of functions (impl's) on which to be transformed
         /// @param[in] c the tensor (matrix) transformer
@@ -2912,6 +3048,211 @@ namespace madness {
                 world.gop.fence();
         }
 
+        /// Transforms a batch of cubes with one matrix product per dimension
+
+        /// Row i of \c rows holds a cube with dimensions c.dim(0)^NDIM; row i
+        /// of the result holds transform(cube_i, c).  Putting the batch index
+        /// last lets each dimension be done as a single mTxm over all cubes.
+        template <typename Q>
+        static Tensor<Q> transform_rows(const Tensor<Q>& rows, const Tensor<double>& c) {
+            const long nb = rows.dim(0);
+            std::vector<long> dims(NDIM+1, c.dim(0));
+            dims[NDIM] = nb;
+            Tensor<Q> t = copy(rows.swapdim(0,1)).reshape(dims);
+            for (std::size_t d=0; d<NDIM; ++d) t = inner(t, c, 0, 0);
+            return t.reshape(nb, t.size()/nb);
+        }
+
+        /// Multiplies pairs of functions from two vectors in one recursive descent
+
+        /// Same distribution and scaling function basis are assumed, as in
+        /// mulXXveca().  At each box the leaf coefficients of all left and
+        /// right functions involved are converted to values together with
+        /// transform_rows(), every pair that is a leaf here is multiplied, and
+        /// the products are converted back together.  Pairs screened by their
+        /// norm_tree estimates become zero leaves; the others descend.
+        /// @param[in] key the key to the current function node (box)
+        /// @param[in] vleft the left function impl's
+        /// @param[in] vlcin coefficients of the left functions projected from the
+        ///            parent box (empty if the function has a node here)
+        /// @param[in] vright the right function impl's
+        /// @param[in] vrcin as vlcin for the right functions
+        /// @param[in] pairs the (left,right) index pairs still to be multiplied
+        /// @param[out] vresult the result impl for each pair
+        template <typename L, typename R>
+        void mulXXpairsa(const keyT& key,
+                         const std::vector<const FunctionImpl<L,NDIM>*>& vleft,
+                         const std::vector< Tensor<L> >& vlcin,
+                         const std::vector<const FunctionImpl<R,NDIM>*>& vright,
+                         const std::vector< Tensor<R> >& vrcin,
+                         const std::vector< std::pair<int,int> >& pairs,
+                         const std::vector<FunctionImpl<T,NDIM>*>& vresult,
+                         double tol) {
+            typedef typename FunctionImpl<L,NDIM>::dcT::const_iterator literT;
+            typedef typename FunctionImpl<R,NDIM>::dcT::const_iterator riterT;
+            const long nl = vleft.size(), nr = vright.size();
+
+            std::vector<bool> lused(nl, false), rused(nr, false);
+            for (const std::pair<int,int>& p : pairs) {
+                lused[p.first] = true;
+                rused[p.second] = true;
+            }
+
+            // Coefficients (empty for interior nodes) and norms of the inputs
+            std::vector< Tensor<L> > vlc(nl);
+            std::vector< Tensor<R> > vrc(nr);
+            std::vector<double> lnorm(nl, 0.0), rnorm(nr, 0.0);
+            for (long i=0; i<nl; ++i) {
+                if (!lused[i]) continue;
+                if (vlcin[i].size()) {
+                    vlc[i] = vlcin[i];
+                    lnorm[i] = vlc[i].normf();
+                }
+                else {
+                    literT it = vleft[i]->coeffs.find(key).get();
+                    MADNESS_ASSERT(it != vleft[i]->coeffs.end());
+                    lnorm[i] = it->second.get_norm_tree();
+                    if (it->second.has_coeff())
+                        vlc[i] = it->second.coeff().full_tensor_copy();
+                }
+            }
+            for (long j=0; j<nr; ++j) {
+                if (!rused[j]) continue;
+                if (vrcin[j].size()) {
+                    vrc[j] = vrcin[j];
+                    rnorm[j] = vrc[j].normf();
+                }
+                else {
+                    riterT it = vright[j]->coeffs.find(key).get();
+                    MADNESS_ASSERT(it != vright[j]->coeffs.end());
+                    rnorm[j] = it->second.get_norm_tree();
+                    if (it->second.has_coeff())
+                        vrc[j] = it->second.coeff().full_tensor_copy();
+                }
+            }
+
+            // Sort the pairs into products formed here, zero leaves and pairs that descend
+            std::vector<long> leaves;
+            std::vector< std::pair<int,int> > next;
+            std::vector<FunctionImpl<T,NDIM>*> vnext;
+            for (unsigned int p=0; p<pairs.size(); ++p) {
+                const int i = pairs[p].first, j = pairs[p].second;
+                FunctionImpl<T,NDIM>* result = vresult[p];
+                if (vlc[i].size() && vrc[j].size()) {
+                    leaves.push_back(p);
+                }
+                else if (tol && lnorm[i]*rnorm[j] < truncate_tol(tol, key)) {
+                    result->coeffs.replace(key, nodeT(coeffT(cdata.vk,targs),false)); // Zero leaf
+                }
+                else {  // Interior node
+                    result->coeffs.replace(key, nodeT(coeffT(),true));
+                    next.push_back(pairs[p]);
+                    vnext.push_back(result);
+                }
+            }
+
+            if (leaves.size()) {
+                // One row of values per distinct function taking part in a product here
+                std::vector<long> lrow(nl, -1), rrow(nr, -1);
+                long nlrow = 0, nrrow = 0;
+                for (long p : leaves) {
+                    if (lrow[pairs[p].first] < 0) lrow[pairs[p].first] = nlrow++;
+                    if (rrow[pairs[p].second] < 0) rrow[pairs[p].second] = nrrow++;
+                }
+                long kd = 1;
+                for (std::size_t d=0; d<NDIM; ++d) kd *= cdata.k;
+                Tensor<L> lrows(nlrow, kd);
+                Tensor<R> rrows(nrrow, kd);
+                for (long i=0; i<nl; ++i)
+                    if (lrow[i] >= 0) lrows(lrow[i],_) = vlc[i].reshape(kd);
+                for (long j=0; j<nr; ++j)
+                    if (rrow[j] >= 0) rrows(rrow[j],_) = vrc[j].reshape(kd);
+
+                // Values of both factors carry the coeffs2values() scale
+                const double vscale = pow(2.0,0.5*NDIM*key.level())/sqrt(FunctionDefaults<NDIM>::get_cell_volume());
+                Tensor<L> lval = transform_rows(lrows, cdata.quad_phit);
+                Tensor<R> rval = transform_rows(rrows, cdata.quad_phit);
+
+                const long npt = lval.dim(1);
+                Tensor<T> tval(long(leaves.size()), npt);
+                for (unsigned int q=0; q<leaves.size(); ++q) {
+                    const L* MADNESS_RESTRICT lp = &lval(lrow[pairs[leaves[q]].first],0L);
+                    const R* MADNESS_RESTRICT rp = &rval(rrow[pairs[leaves[q]].second],0L);
+                    T* MADNESS_RESTRICT tp = &tval(long(q),0L);
+                    for (long m=0; m<npt; ++m) tp[m] = lp[m]*rp[m];
+                }
+
+                const double cscale = pow(0.5,0.5*NDIM*key.level())*sqrt(FunctionDefaults<NDIM>::get_cell_volume());
+                Tensor<T> tcoeff = transform_rows(tval, cdata.quad_phiw).scale(vscale*vscale*cscale);
+                for (unsigned int q=0; q<leaves.size(); ++q) {
+                    Tensor<T> c = copy(tcoeff(long(q),_)).reshape(cdata.vk);
+                    vresult[leaves[q]]->coeffs.replace(key, nodeT(coeffT(c,targs),false));
+                }
+            }
+
+            if (next.size()) {
+                // Unfilter only the leaf coefficients that are still needed below
+                std::vector<bool> lnext(nl, false), rnext(nr, false);
+                for (const std::pair<int,int>& p : next) {
+                    lnext[p.first] = true;
+                    rnext[p.second] = true;
+                }
+                std::vector< Tensor<L> > vlss(nl);
+                std::vector< Tensor<R> > vrss(nr);
+                for (long i=0; i<nl; ++i) {
+                    if (lnext[i] && vlc[i].size()) {
+                        Tensor<L> ld(cdata.v2k);
+                        ld(cdata.s0) = vlc[i](___);
+                        vlss[i] = vleft[i]->unfilter(ld);
+                    }
+                }
+                for (long j=0; j<nr; ++j) {
+                    if (rnext[j] && vrc[j].size()) {
+                        Tensor<R> rd(cdata.v2k);
+                        rd(cdata.s0) = vrc[j](___);
+                        vrss[j] = vright[j]->unfilter(rd);
+                    }
+                }
+
+                for (KeyChildIterator<NDIM> kit(key); kit; ++kit) {
+                    const keyT& child = kit.key();
+                    std::vector<Slice> cp = child_patch(child);
+
+                    std::vector< Tensor<L> > vll(nl);
+                    std::vector< Tensor<R> > vrr(nr);
+                    for (long i=0; i<nl; ++i)
+                        if (vlss[i].size()) vll[i] = copy(vlss[i](cp));
+                    for (long j=0; j<nr; ++j)
+                        if (vrss[j].size()) vrr[j] = copy(vrss[j](cp));
+
+                    woT::task(coeffs.owner(child), &implT:: template mulXXpairsa<L,R>,
+                              child, vleft, vll, vright, vrr, next, vnext, tol);
+                }
+            }
+        }
+
+        /// Multiplies pairs of functions from two vectors (impl's). Delegates to the
+        /// mulXXpairsa() method.
+        /// @param[in] vleft vector of pointers to the left function impl's
+        /// @param[in] vright vector of pointers to the right function impl's
+        /// @param[in] pairs the (left,right) index pair for each result
+        /// @param[out] vresult vector of pointers to the resulting function impl's
+        /// @param[in] tol numerical tolerance
+        template <typename L, typename R>
+        void mulXXpairs(const std::vector<const FunctionImpl<L,NDIM>*>& vleft,
+                        const std::vector<const FunctionImpl<R,NDIM>*>& vright,
+                        const std::vector< std::pair<int,int> >& pairs,
+                        const std::vector<FunctionImpl<T,NDIM>*>& vresult,
+                        double tol,
+                        bool fence) {
+            std::vector< Tensor<L> > vl(vleft.size());
+            std::vector< Tensor<R> > vr(vright.size());
+            if (world.rank() == coeffs.owner(cdata.key0))
+                mulXXpairsa(cdata.key0, vleft, vl, vright, vr, pairs, vresult, tol);
+            if (fence)
+                world.gop.fence();
+        }
+
         Future<double> get_norm_tree_recursive(const keyT& key) const;
 
         mutable long box_leaf[1000];
@@ -2992,6 +3333,31 @@ namespace madness {
                   const keyT& keyin,
                   const typename Future<T>::remote_refT& ref);
 
+        /// Values of a batch of points, each paired with the position of its point
+        typedef std::vector< std::pair<long,T> > evalbatchT;
+
+        /// Evaluate the function at a batch of points in \em simulation coordinates
+
+        /// Point \c i lies in box \c keys[i] and \c x[i] are its
+        /// coordinates within that box.  Points are followed down the
+        /// local part of the tree and those reaching boxes held elsewhere
+        /// are forwarded with one message per process.  Points in the
+        /// same leaf are evaluated together.  Only the invoking process
+        /// gets the values, paired with \c index[i], via the remote
+        /// reference to a future.
+        void eval_batch(const std::vector<keyT>& keys,
+                        const std::vector< Vector<double,NDIM> >& x,
+                        const std::vector<long>& index,
+                        const typename Future<evalbatchT>::remote_refT& ref);
+
+        /// Completes eval_batch() with the values returned by other processes
+        void eval_batch_join(const evalbatchT& local,
+                             const std::vector< Future<evalbatchT> >& remote,
+                             const typename Future<evalbatchT>::remote_refT& ref);
+
+        /// Returns the values of a batch in the order of their points
+        std::vector<T> eval_batch_order(const evalbatchT& values) const;
+
         /// Get the depth of the tree at a point in \em simulation coordinates
 
         /// Only the invoking process will get the result via the
@@ -3436,6 +3802,7 @@ namespace madness {
 
                             if (result.normf() > tol*0.3) {
                                 Key<NDIM> dest(n,lnew);
+                                TensorWire::Tolerance wire(tol*0.1);
                                 coeffs.task(dest, &nodeT::accumulate2, result, coeffs, dest, TaskAttributes::hipri());
                             }
                         }
@@ -3926,6 +4293,12 @@ namespace madness {
 
         T eval_cube(Level n, coordT& x, const tensorT& c) const;
 
+        /// Evaluates at points \c x within a box the expansion \c c at level \c n
+
+        /// The first dimension of the sum is contracted for all points
+        /// with one matrix product.
+        void eval_cube_batch(Level n, const std::vector<coordT>& x, const tensorT& c, T* values) const;
+
         /// Transform sum coefficients at level n to sums+differences at level n-1
 
         /// Given scaling function coefficients s[n][l][i] and s[n][l+1][i]
@@ -4180,6 +4553,9 @@ namespace madness {
             // and also to ensure we don't needlessly widen the tree when
             // applying the operator
             if (result.normf()> 0.3*args.tol/args.fac) {
+                // Results smaller than 0.3*tol/fac are discarded, so an
+                // error of a third of that in sending them is harmless
+                TensorWire::Tolerance wire(0.1*args.tol/args.fac);
                 Future<double> time=coeffs.task(args.dest, &nodeT::accumulate2, result, coeffs, args.dest, TaskAttributes::hipri());
                 //woT::task(world.rank(),&implT::accumulate_timer,time,TaskAttributes::hipri());
                 // UGLY BUT ADDED THE OPTIMIZATION BACK IN HERE EXPLICITLY/
@@ -4220,6 +4596,7 @@ namespace madness {
                 //double cpu1=cpu_time();
                 //timer_lr_result.accumulate(cpu1-cpu0);
 
+                TensorWire::Tolerance wire(0.1*args.tol/args.fac);
                 Future<double> time=coeffs.task(args.dest, &nodeT::accumulate, result, coeffs, args.dest, apply_targs,
                                                 TaskAttributes::hipri());
 
@@ -4258,6 +4635,7 @@ namespace madness {
                 timer_lr_result.accumulate(cpu1-cpu0);
 
                 // accumulate also expects result in SVD form
+                TensorWire::Tolerance wire(0.1*args.tol/args.fac);
                 Future<double> time=coeffs.task(args.dest, &nodeT::accumulate, result, coeffs, args.dest, apply_targs,
                                                 TaskAttributes::hipri());
                 woT::task(world.rank(),&implT::accumulate_timer,time,TaskAttributes::hipri());
@@ -4350,9 +4728,15 @@ namespace madness {
 		        ndone++;
 		        tensorT result = op->apply(source, *it, c, tol/fac/cnorm);
 			if (result.normf() > 0.3*tol/fac) {
+			    if (apply_agg) {
+			        accumulate_aggregated(dest, result);
+			    }
+			    else {
 			      // Switched back to send in order to get rid of a zillion small tasks and to preserve
 			      // direct call optimization.  Also reduces remote memory foot print.
+			      TensorWire::Tolerance wire(0.1*tol/fac);
 			      coeffs.send(dest, &nodeT::accumulate2, result, coeffs, dest);
+			    }
                         }
                     }
                 }
@@ -4360,6 +4744,78 @@ namespace madness {
         }
 
 
+        /// Add an apply result into the aggregation buffer of the calling thread
+
+        /// Contributions to the same destination key are summed locally.
+        /// Once the batch for the owner of \c dest exceeds
+        /// FunctionDefaults::get_apply_aggregation_size() bytes it is sent
+        /// as a single message.  Anything left over is sent by a flush task
+        /// that is queued when the buffer is first used, so that a fence
+        /// cannot complete while results are still buffered.
+        /// @param[in] dest     key of the destination node
+        /// @param[in] result   coefficients to be accumulated into \c dest
+        void accumulate_aggregated(const keyT& dest, const tensorT& result) {
+            const ThreadBase* thread = ThreadBase::this_thread();
+            const int slot = (thread ? thread->get_pool_thread_index() : -1) + 1;
+            const ProcessID owner = coeffs.owner(dest);
+
+            ApplyBatch full;
+            {
+                ApplyAggregate& agg = apply_agg[slot];
+                ScopedMutex<Spinlock> hold(agg.lock);
+                ApplyBatch& batch = agg.batches[owner];
+                typename std::map<keyT,tensorT>::iterator it = batch.blocks.find(dest);
+                if (it == batch.blocks.end()) {
+                    batch.blocks.insert(std::make_pair(dest, result));
+                    batch.nbyte += result.size()*sizeof(T);
+                }
+                else {
+                    it->second += result;
+                }
+                if (batch.nbyte >= FunctionDefaults<NDIM>::get_apply_aggregation_size()) {
+                    std::swap(full, batch);
+                }
+            }
+            if (full.nbyte) send_apply_batch(owner, full);
+
+            // Must come after the data is in the buffer (see flush_apply_buffers)
+            if (apply_flush_pending++ == 0)
+                woT::task(world.rank(), &implT::flush_apply_buffers);
+        }
+
+        /// Send all buffered apply results
+        void flush_apply_buffers() {
+            apply_flush_pending = 0;
+            const int nslot = ThreadPool::size()+1;
+            for (int slot=0; slot<nslot; ++slot) {
+                std::map<ProcessID,ApplyBatch> batches;
+                {
+                    ScopedMutex<Spinlock> hold(apply_agg[slot].lock);
+                    std::swap(batches, apply_agg[slot].batches);
+                }
+                typename std::map<ProcessID,ApplyBatch>::iterator it;
+                for (it=batches.begin(); it!=batches.end(); ++it) {
+                    if (it->second.nbyte) send_apply_batch(it->first, it->second);
+                }
+            }
+        }
+
+        /// Send one batch of pre-summed apply results to process \c owner
+        void send_apply_batch(ProcessID owner, const ApplyBatch& batch) {
+            if (owner == world.rank())
+                accumulate_batch(batch.blocks);
+            else
+                woT::task(owner, &implT::accumulate_batch, batch.blocks, TaskAttributes::hipri());
+        }
+
+        /// Accumulate a batch of apply results into the local nodes
+        void accumulate_batch(const std::map<keyT,tensorT>& blocks) {
+            typename std::map<keyT,tensorT>::const_iterator it;
+            for (it=blocks.begin(); it!=blocks.end(); ++it) {
+                coeffs.send(it->first, &nodeT::accumulate2, it->second, coeffs, it->first);
+            }
+        }
+
         /// apply an operator on f to return this
         template <typename opT, typename R>
         void apply(opT& op, const FunctionImpl<R,NDIM>& f, bool fence) {
@@ -4387,6 +4843,65 @@ namespace madness {
 
         }
 
+        /// Forms the change of this nonstandard form relative to a reference
+
+        /// Considers the boxes to which apply() applies an operator (those
+        /// with 2k coefficients).  The change of a box relative to \c ref is
+        /// put into \c delta if its norm exceeds tol_fac*truncate_tol(thresh,key),
+        /// and \c ref is then updated; smaller changes are neglected.  Boxes
+        /// only in \c ref go into \c delta with their coefficients negated
+        /// and are removed from \c ref.  \c ref and \c delta must have the
+        /// same distribution as this.  Collective, fences.
+        /// @return the number of boxes whose change was neglected and the number put into \c delta
+        std::pair<long,long> nonstandard_delta(implT& ref, implT& delta, double tol_fac) {
+            PROFILE_MEMBER_FUNC(FunctionImpl);
+            MADNESS_ASSERT(ref.get_pmap() == get_pmap() && delta.get_pmap() == get_pmap());
+            world.gop.fence();
+            long nclean=0, ndirty=0;
+            typename dcT::iterator end = coeffs.end();
+            for (typename dcT::iterator it=coeffs.begin(); it!=end; ++it) {
+                const keyT& key = it->first;
+                const nodeT& node = it->second;
+                if (!node.has_coeff() || node.coeff().dim(0) == k) continue;
+                typename dcT::iterator rit = ref.coeffs.find(key).get();
+                if (rit != ref.coeffs.end() && rit->second.has_coeff() && rit->second.coeff().dim(0) != k) {
+                    tensorT d = node.coeff().full_tensor_copy() - rit->second.coeff().full_tensor_copy();
+                    if (d.normf() <= tol_fac*truncate_tol(thresh,key)) {
+                        ++nclean;
+                        continue;
+                    }
+                    delta.coeffs.replace(key, nodeT(coeffT(d,targs), false));
+                    rit->second.set_coeff(copy(node.coeff()));
+                }
+                else {
+                    delta.coeffs.replace(key, nodeT(copy(node.coeff()), false));
+                    ref.coeffs.replace(key, nodeT(copy(node.coeff()), false));
+                }
+                ++ndirty;
+            }
+
+            std::vector<keyT> gone;
+            end = ref.coeffs.end();
+            for (typename dcT::iterator rit=ref.coeffs.begin(); rit!=end; ++rit) {
+                const keyT& key = rit->first;
+                const nodeT& node = rit->second;
+                if (!node.has_coeff() || node.coeff().dim(0) == k) continue;
+                typename dcT::iterator it = coeffs.find(key).get();
+                if (it == coeffs.end() || !it->second.has_coeff() || it->second.coeff().dim(0) == k) {
+                    tensorT d = node.coeff().full_tensor_copy()*T(-1.0);
+                    delta.coeffs.replace(key, nodeT(coeffT(d,targs), false));
+                    gone.push_back(key);
+                    ++ndirty;
+                }
+            }
+            for (std::size_t i=0; i<gone.size(); ++i) ref.coeffs.erase(gone[i]);
+
+            world.gop.fence();
+            world.gop.sum(nclean);
+            world.gop.sum(ndirty);
+            return std::make_pair(nclean, ndirty);
+        }
+
 
 
         /// apply an operator on the coeffs c (at node key)
@@ -4991,6 +5506,63 @@ namespace madness {
         }
 
 
+        /// Edge of the square tiles of the result of inner_local(left,right,sym)
+        static const long inner_tile = 64;
+
+        /// Rows of the panels multiplied at once by do_inner_localX
+        static const long inner_panel = 64;
+
+        /// Packs the coefficients of the blocks of one key into the rows of a matrix
+
+        /// Row \c iv of \c buf holds the (conjugated if requested) coefficients
+        /// of \c v[iv] converted to \c resultT.
+        /// \return The length of a row, or -1 if the blocks are empty or differ in size
+        template <typename Q, typename resultT>
+        static long pack_inner_blocks(const std::vector< std::pair<int,const GenTensor<Q>*> >& v,
+                                      std::vector<resultT>& buf, const bool conjugate) {
+            long k = -1;
+            for (std::size_t iv=0; iv<v.size(); iv++) {
+                const GenTensor<Q>* ptr = v[iv].second;
+                Tensor<Q> t = (ptr->tensor_type()==TT_FULL) ? Tensor<Q>(ptr->full_tensor())
+                                                            : Tensor<Q>(ptr->full_tensor_copy());
+                if (!t.iscontiguous()) t = copy(t);
+                if (iv == 0) {
+                    k = t.size();
+                    if (k == 0) return -1;
+                    buf.resize(v.size()*k);
+                }
+                else if (t.size() != k) {
+                    return -1;
+                }
+                const Q* MADNESS_RESTRICT p = t.ptr();
+                resultT* MADNESS_RESTRICT q = &buf[iv*k];
+                if (conjugate) for (long l=0; l<k; l++) q[l] = conj(resultT(p[l]));
+                else for (long l=0; l<k; l++) q[l] = p[l];
+            }
+            return k;
+        }
+
+        /// Adds \c value to element (i,j) of the result held as a list of tiles
+        template <typename resultT>
+        static void add_to_inner_tile(std::vector< Tensor<resultT> >& tiles, const long n,
+                                      const long m, const long i, const long j,
+                                      const resultT value) {
+            const long ntj = (m-1)/inner_tile+1;
+            const long it = i/inner_tile, jt = j/inner_tile;
+            Tensor<resultT>& tile = tiles[it*ntj+jt];
+            if (tile.size() == 0)
+                tile = Tensor<resultT>(std::min(long(inner_tile),n-it*inner_tile),
+                                       std::min(long(inner_tile),m-jt*inner_tile));
+            tile(i-it*inner_tile,j-jt*inner_tile) += value;
+        }
+
+        /// Computes the contributions of a range of keys to inner_local(left,right,sym)
+
+        /// For each key the blocks of the left and right functions are packed
+        /// into matrices and multiplied with mxmT a panel of rows at a time;
+        /// with \c sym and a single map only the panels on and above the diagonal
+        /// are computed.  Results go to tiles that are allocated when first
+        /// touched and are added to \c result under the lock of each tile.
         template <typename R>
         static void do_inner_localX(const typename mapT::iterator lstart,
                                     const typename mapT::iterator lend,
@@ -4998,34 +5570,66 @@ namespace madness {
                                     const bool sym,
                                     Tensor< TENSOR_RESULT_TYPE(T,R) >* result_ptr,
                                     Mutex* mutex) {
-            Tensor< TENSOR_RESULT_TYPE(T,R) >& result = *result_ptr;
-            Tensor< TENSOR_RESULT_TYPE(T,R) > r(result.dim(0),result.dim(1));
+            typedef TENSOR_RESULT_TYPE(T,R) resultT;
+            Tensor<resultT>& result = *result_ptr;
+            const long n = result.dim(0), m = result.dim(1);
+            const long ntj = (m-1)/inner_tile+1;
+            std::vector< Tensor<resultT> > tiles(((n-1)/inner_tile+1)*ntj);
+            std::vector<resultT> a, b, c;
+
             for (typename mapT::iterator lit=lstart; lit!=lend; ++lit) {
                 const keyT& key = lit->first;
                 typename FunctionImpl<R,NDIM>::mapT::iterator rit=rmap_ptr->find(key);
-                if (rit != rmap_ptr->end()) {
-                    const mapvecT& leftv = lit->second;
-                    const typename FunctionImpl<R,NDIM>::mapvecT& rightv =rit->second;
-                    const int nleft = leftv.size();
-                    const int nright= rightv.size();
-
-                    for (int iv=0; iv<nleft; iv++) {
+                if (rit == rmap_ptr->end()) continue;
+
+                // Only this task touches the vectors of this key, so they can be
+                // sorted in place; with sorted indices the upper panels of a
+                // symmetric product are the pairs with i<=j
+                mapvecT& leftv = lit->second;
+                typename FunctionImpl<R,NDIM>::mapvecT& rightv = rit->second;
+                const bool same = ((void*)(&leftv) == (void*)(&rightv));
+                std::sort(leftv.begin(), leftv.end());
+                if (!same) std::sort(rightv.begin(), rightv.end());
+                const long nleft = leftv.size();
+                const long nright= rightv.size();
+
+                const long k = pack_inner_blocks(leftv, a, TensorTypeData<T>::iscomplex);
+                if (k<0 || FunctionImpl<R,NDIM>::pack_inner_blocks(rightv, b, false)!=k) {
+                    // Mixed block sizes or empty blocks: contract pair by pair
+                    for (long iv=0; iv<nleft; iv++) {
                         const int i = leftv[iv].first;
-                        const GenTensor<T>* iptr = leftv[iv].second;
-
-                        for (int jv=0; jv<nright; jv++) {
+                        for (long jv=0; jv<nright; jv++) {
                             const int j = rightv[jv].first;
-                            const GenTensor<R>* jptr = rightv[jv].second;
+                            if (!sym || i<=j)
+                                add_to_inner_tile(tiles, n, m, i, j,
+                                                  resultT(leftv[iv].second->trace_conj(*(rightv[jv].second))));
+                        }
+                    }
+                    continue;
+                }
 
-                            if (!sym || (sym && i<=j))
-                                r(i,j) += iptr->trace_conj(*jptr);
+                for (long i0=0; i0<nleft; i0+=inner_panel) {
+                    const long ni = std::min(long(inner_panel), nleft-i0);
+                    const long j0 = (sym && same) ? i0 : 0;
+                    const long nj = nright-j0;
+                    c.assign(ni*nj, resultT(0.0));
+                    mxmT(ni, nj, k, &c[0], &a[i0*k], &b[j0*k]);
+                    for (long ii=0; ii<ni; ii++) {
+                        const int i = leftv[i0+ii].first;
+                        for (long jj=0; jj<nj; jj++) {
+                            const int j = rightv[j0+jj].first;
+                            if (!sym || i<=j) add_to_inner_tile(tiles, n, m, i, j, c[ii*nj+jj]);
                         }
                     }
                 }
             }
-            mutex->lock();
-            result += r;
-            mutex->unlock();
+
+            for (std::size_t t=0; t<tiles.size(); t++) {
+                if (tiles[t].size() == 0) continue;
+                const long i0 = (t/ntj)*inner_tile, j0 = (t%ntj)*inner_tile;
+                ScopedMutex<Mutex> lock(mutex+t);
+                result(Slice(i0,i0+tiles[t].dim(0)-1),Slice(j0,j0+tiles[t].dim(1)-1)) += tiles[t];
+            }
         }
 
         static double conj(double x) {
@@ -5049,14 +5653,13 @@ namespace madness {
             // This is basically a sparse matrix^T * matrix product
             // Rij = sum(k) Aki * Bkj
             // where i and j index functions and k index the wavelet coeffs
-            // eventually the goal is this structure (don't have jtile yet)
-            //
-            // do in parallel tiles of k (tensors of coeffs)
-            //    do tiles of j
-            //       do i
-            //          do j in jtile
-            //             do k in ktile
-            //                Rij += Aki*Bkj
+            // The keys are split into chunks done in parallel; for each key
+            // the blocks of all functions present are packed into matrices
+            // so that the sum over the coefficients of that key is one
+            // matrix product (see do_inner_localX).
+
+            Tensor< TENSOR_RESULT_TYPE(T,R) > r(left.size(), right.size());
+            if (left.empty() || right.empty()) return r;
 
             mapT lmap = make_key_vec_map(left);
             typename FunctionImpl<R,NDIM>::mapT rmap;
@@ -5068,14 +5671,13 @@ namespace madness {
 
             size_t chunk = (lmap.size()-1)/(3*4*5)+1;
 
-            Tensor< TENSOR_RESULT_TYPE(T,R) > r(left.size(), right.size());
-            Mutex mutex;
+            std::vector<Mutex> mutex(((left.size()-1)/inner_tile+1)*((right.size()-1)/inner_tile+1));
 
             typename mapT::iterator lstart=lmap.begin();
             while (lstart != lmap.end()) {
                 typename mapT::iterator lend = lstart;
                 advance(lend,chunk);
-                left[0]->world.taskq.add(&FunctionImpl<T,NDIM>::do_inner_localX<R>, lstart, lend, rmap_ptr, sym, &r, &mutex);
+                left[0]->world.taskq.add(&FunctionImpl<T,NDIM>::do_inner_localX<R>, lstart, lend, rmap_ptr, sym, &r, &mutex[0]);
                 lstart = lend;
             }
             left[0]->world.taskq.fence();
@@ -396,13 +396,16 @@ namespace madness {
         World& world = f.world();
         f.reconstruct();
         if (world.rank() == 0) {
+            std::vector<coordT> r(npt);
+            for (int i=0; i<npt; ++i) r[i] = lo + h*double(i);
+            Future< std::vector<T> > ffut = f.eval_many(r);
+            const std::vector<T>& fv = ffut.get();
             FILE* file = fopen(filename,"w");
 	    if(!file)
 	      MADNESS_EXCEPTION("plot_line: failed to open the plot file", 0);
             for (int i=0; i<npt; ++i) {
-                coordT r = lo + h*double(i);
                 fprintf(file, "%.14e ", i*sum);
-                plot_line_print_value(file, f.eval(r));
+                plot_line_print_value(file, fv[i]);
                 fprintf(file,"\n");
             }
             fclose(file);
@@ -427,14 +430,19 @@ namespace madness {
         f.reconstruct();
         g.reconstruct();
         if (world.rank() == 0) {
+            std::vector<coordT> r(npt);
+            for (int i=0; i<npt; ++i) r[i] = lo + h*double(i);
+            Future< std::vector<T> > ffut = f.eval_many(r);
+            Future< std::vector<U> > gfut = g.eval_many(r);
+            const std::vector<T>& fv = ffut.get();
+            const std::vector<U>& gv = gfut.get();
             FILE* file = fopen(filename,"w");
 	    if(!file)
 	      MADNESS_EXCEPTION("plot_line: failed to open the plot file", 0);
             for (int i=0; i<npt; ++i) {
-                coordT r = lo + h*double(i);
                 fprintf(file, "%.14e ", i*sum);
-                plot_line_print_value(file, f.eval(r));
-                plot_line_print_value(file, g.eval(r));
+                plot_line_print_value(file, fv[i]);
+                plot_line_print_value(file, gv[i]);
                 fprintf(file,"\n");
             }
             fclose(file);
@@ -461,15 +469,22 @@ namespace madness {
         g.reconstruct();
         a.reconstruct();
         if (world.rank() == 0) {
+            std::vector<coordT> r(npt);
+            for (int i=0; i<npt; ++i) r[i] = lo + h*double(i);
+            Future< std::vector<T> > ffut = f.eval_many(r);
+            Future< std::vector<U> > gfut = g.eval_many(r);
+            Future< std::vector<V> > afut = a.eval_many(r);
+            const std::vector<T>& fv = ffut.get();
+            const std::vector<U>& gv = gfut.get();
+            const std::vector<V>& av = afut.get();
             FILE* file = fopen(filename,"w");
 	    if(!file)
 	      MADNESS_EXCEPTION("plot_line: failed to open the plot file", 0);
             for (int i=0; i<npt; ++i) {
-                coordT r = lo + h*double(i);
                 fprintf(file, "%.14e ", i*sum);
-                plot_line_print_value(file, f.eval(r));
-                plot_line_print_value(file, g.eval(r));
-                plot_line_print_value(file, a.eval(r));
+                plot_line_print_value(file, fv[i]);
+                plot_line_print_value(file, gv[i]);
+                plot_line_print_value(file, av[i]);
                 fprintf(file,"\n");
             }
             fclose(file);
@@ -496,14 +511,23 @@ namespace madness {
         a.reconstruct();
         b.reconstruct();
         if (world.rank() == 0) {
+            std::vector<coordT> r(npt);
+            for (int i=0; i<npt; ++i) r[i] = lo + h*double(i);
+            Future< std::vector<T> > ffut = f.eval_many(r);
+            Future< std::vector<U> > gfut = g.eval_many(r);
+            Future< std::vector<V> > afut = a.eval_many(r);
+            Future< std::vector<W> > bfut = b.eval_many(r);
+            const std::vector<T>& fv = ffut.get();
+            const std::vector<U>& gv = gfut.get();
+            const std::vector<V>& av = afut.get();
+            const std::vector<W>& bv = bfut.get();
             FILE* file = fopen(filename,"w");
             for (int i=0; i<npt; ++i) {
-                coordT r = lo + h*double(i);
                 fprintf(file, "%.14e ", i*sum);
-                plot_line_print_value(file, f.eval(r));
-                plot_line_print_value(file, g.eval(r));
-                plot_line_print_value(file, a.eval(r));
-                plot_line_print_value(file, b.eval(r));
+                plot_line_print_value(file, fv[i]);
+                plot_line_print_value(file, gv[i]);
+                plot_line_print_value(file, av[i]);
+                plot_line_print_value(file, bv[i]);
                 fprintf(file,"\n");
             }
             fclose(file);
@@ -978,6 +1002,7 @@ namespace madness {
 
     	 const bool psdot=false;
 
+    	 function.reconstruct();
     	 if(world.rank() == 0) {
     		 f = fopen(filename.c_str(), "w");
     		 if(!f) MADNESS_EXCEPTION("plot_along: failed to open the plot file", 0);
@@ -991,13 +1016,15 @@ namespace madness {
     		 }
 
     		 // walk along the line
+    		 std::vector< Vector<double,NDIM> > coords(npt);
+    		 for (int ipt=0; ipt<npt; ipt++) coords[ipt]=traj(ipt);
+    		 const std::vector<double> values=function.eval_many(coords).get();
     		 for (int ipt=0; ipt<npt; ipt++) {
-    			 Vector<double,NDIM> coord=traj(ipt);
     			 if (psdot) {
-    			     long rank=function.evalR(coord);
-    			     trajectory<NDIM>::print_psdot(f,ipt,function(coord),trajectory<NDIM>::hueCode(rank));
+    			     long rank=function.evalR(coords[ipt]);
+    			     trajectory<NDIM>::print_psdot(f,ipt,values[ipt],trajectory<NDIM>::hueCode(rank));
     			 } else {
-    			     fprintf(f,"%4i %12.6f\n",ipt, function(coord));
+    			     fprintf(f,"%4i %12.6f\n",ipt, values[ipt]);
     			 }
     		 }
 
@@ -319,6 +319,16 @@ namespace madness {
         return s;
     }
 
+    /// Hash deciding the NUMA domain owning a key (see WorldContainer::task)
+
+    /// Boxes below level 3 go with their ancestor at level 3, so that
+    /// a subtree is worked on and kept in memory by a single domain.
+    template<std::size_t NDIM, typename hashfunT>
+    hashT
+    numa_hash(const Key<NDIM>& key, const hashfunT&) {
+        return (key.level() > 3) ? key.parent(key.level()-3).hash() : key.hash();
+    }
+
     /// given a source and a target, return the displacement in translation
 
     /// @param[in]  source  the source key
@@ -34,6 +34,9 @@
 #define MADNESS_MRA_IBDEUX_H__INCLUDED
 
 #include <madness/madness_config.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <map>
 #include <queue>
 #include <madness/world/atomicint.h>
@@ -92,6 +95,73 @@ namespace madness {
 
 
 
+    /// Process map that cuts a Morton (Z-order) curve through the tree into contiguous segments
+
+    /// Keys are ordered by a depth-first traversal of the tree in which
+    /// the children of each box are visited in Morton order, so a parent
+    /// precedes all of its descendants.  Process \c p owns all keys from
+    /// \c cuts[p] up to (but not including) \c cuts[p+1].  Since boxes that
+    /// are close in space are close on the curve, neighbors mostly end up
+    /// on the same process.
+    template <std::size_t NDIM>
+    class LBSFCPmap : public WorldDCPmapInterface< Key<NDIM> > {
+        typedef Key<NDIM> keyT;
+        std::vector<keyT> cuts; ///< First key owned by each process
+
+        /// True if the most significant set bit of \c x is below that of \c y
+        static bool less_msb(uint64_t x, uint64_t y) {
+            return x < y && x < (x^y);
+        }
+
+    public:
+        /// Constructs the map from the first key of each process along the curve
+
+        /// \c cuts[0] must be the root key and the cuts must be in curve order
+        LBSFCPmap(const std::vector<keyT>& cuts) : cuts(cuts) {
+            MADNESS_ASSERT(cuts.size() > 0 && cuts[0].level() == 0);
+        }
+
+        /// Returns true if \c a precedes \c b along the curve
+        static bool morton_less(const keyT& a, const keyT& b) {
+            // Compare at the coarser of the two levels
+            const Level n = std::min(a.level(), b.level());
+            uint64_t la[NDIM], lb[NDIM];
+            bool same = true;
+            for (std::size_t d=0; d<NDIM; ++d) {
+                la[d] = uint64_t(a.translation()[d]) >> (a.level() - n);
+                lb[d] = uint64_t(b.translation()[d]) >> (b.level() - n);
+                same = same && (la[d] == lb[d]);
+            }
+            // An ancestor precedes its descendants
+            if (same) return a.level() < b.level();
+
+            // The dimension with the highest differing bit decides; the last
+            // dimension is the most significant within each level
+            std::size_t dmax = NDIM-1;
+            uint64_t xmax = la[dmax]^lb[dmax];
+            for (std::size_t d=NDIM-1; d-- > 0;) {
+                uint64_t x = la[d]^lb[d];
+                if (less_msb(xmax, x)) {
+                    dmax = d;
+                    xmax = x;
+                }
+            }
+            return la[dmax] < lb[dmax];
+        }
+
+        ProcessID owner(const keyT& key) const {
+            typename std::vector<keyT>::const_iterator it =
+                std::upper_bound(cuts.begin(), cuts.end(), key, morton_less);
+            return ProcessID(it - cuts.begin()) - 1;
+        }
+
+        void print() const {
+            madness::print("LBSFCPmap");
+            for (unsigned int p=0; p<cuts.size(); ++p) madness::print("   ", p, cuts[p]);
+        }
+    };
+
+
     template <std::size_t NDIM>
     class LBNodeDeux {
         static const int nchild = (1<<NDIM);
@@ -103,6 +173,14 @@ namespace madness {
         volatile double total_cost;
         volatile bool gotkids;
         AtomicInt nsummed;
+        int cut_lo, cut_hi; ///< Curve cuts [cut_lo,cut_hi) that fall on this node
+
+        /// Returns the key of the child with index \c ind
+        static keyT child_key(const keyT& key, int ind) {
+            Vector<Translation,NDIM> l;
+            for (std::size_t d=0; d<NDIM; ++d) l[d] = 2*key.translation()[d] + ((ind>>d)&0x1);
+            return keyT(key.level()+1, l);
+        }
 
         /// Computes index of child key in this node using last bit of translations
         int index(const keyT& key) {
@@ -113,14 +191,15 @@ namespace madness {
 
     public:
         LBNodeDeux()
-                : my_cost(0.0), total_cost(0.0), gotkids(false) {
+                : my_cost(0.0), total_cost(0.0), gotkids(false), cut_lo(0), cut_hi(0) {
             nsummed = 0;
             for (int i=0; i<nchild; ++i)
                 child_cost[i] = 0.0;
         }
 
         LBNodeDeux(const LBNodeDeux<NDIM>& other) :
-            my_cost(other.my_cost), total_cost(other.total_cost), gotkids(other.gotkids)
+            my_cost(other.my_cost), total_cost(other.total_cost), gotkids(other.gotkids),
+            cut_lo(other.cut_lo), cut_hi(other.cut_hi)
         {
             nsummed = other.nsummed;
             for (int i=0; i<nchild; ++i)
@@ -134,6 +213,8 @@ namespace madness {
             total_cost = other.total_cost;
             gotkids = other.gotkids;
             nsummed = other.nsummed;
+            cut_lo = other.cut_lo;
+            cut_hi = other.cut_hi;
 
             return *this;
         }
@@ -215,6 +296,38 @@ namespace madness {
             }
         }
 
+        /// Returns the range of curve cuts that fall on this node
+        std::pair<int,int> get_cuts() const {
+            return std::make_pair(cut_lo, cut_hi);
+        }
+
+        /// Locates the curve cuts at cost \c p*avg for \c p in [plo,phi) within this subtree
+
+        /// \c offset is the cost of everything preceding this node along the
+        /// curve.  The node itself comes first, followed by its children in
+        /// Morton order.  Cuts are passed down only into the children that
+        /// contain them, so just O(nproc*depth) nodes are visited.
+        void sfc_cut(const treeT& tree, const keyT& key, double offset, double avg, int plo, int phi) {
+            double start = offset + my_cost;
+            int p = plo;
+            while (p < phi && (p*avg < start || !has_children())) ++p;
+            cut_lo = plo;
+            cut_hi = p;
+
+            for (int ind=0; ind<nchild && p<phi; ++ind) {
+                double end = start + child_cost[ind];
+                int q = p;
+                // Roundoff can leave a cut just beyond the last child
+                while (q < phi && (q*avg < end || ind == nchild-1)) ++q;
+                if (q > p) {
+                    const keyT child = child_key(key, ind);
+                    const_cast<treeT&>(tree).task(child, &nodeT::sfc_cut, tree, child, start, avg, p, q);
+                }
+                start = end;
+                p = q;
+            }
+        }
+
         template <typename Archive>
         void serialize(Archive& ar) {
             ar & archive::wrap_opaque(this,1);
@@ -311,8 +424,60 @@ namespace madness {
             }
         };
 
+        /// Returns true if the environment selects the space-filling-curve partitioner
+
+        /// Set \c MAD_LOAD_BALANCE=sfc to make load_balance() call load_balance_sfc().
+        static bool use_sfc() {
+            const char* s = std::getenv("MAD_LOAD_BALANCE");
+            return s && std::strcmp(s, "sfc") == 0;
+        }
+
+        /// Partitions the tree by cutting a Morton curve into segments of equal cost
+
+        /// The subtree costs from sum() give the cost preceding every node
+        /// along the curve, so the node holding each cut is found by
+        /// descending from the root into only those children that contain
+        /// a cut.  Each process then reports the (at most nproc-1) cuts it
+        /// found; no per-node data is gathered onto a single process.
+        std::shared_ptr< WorldDCPmapInterface<keyT> > load_balance_sfc(bool printstuff=false) {
+            world.gop.fence();
+            const int nproc = world.size();
+            double avg = sum()/nproc;
+
+            // Find the nodes holding the cuts
+            keyT key0(0);
+            if (world.rank() == tree.owner(key0) && nproc > 1) {
+                tree.send(key0, &nodeT::sfc_cut, tree, key0, 0.0, avg, 1, nproc);
+            }
+            world.gop.fence();
+
+            std::vector< std::pair<keyT,ProcessID> > found;
+            const_iteratorT end = tree.end();
+            for (const_iteratorT it=tree.begin(); it!=end; ++it) {
+                std::pair<int,int> c = it->second.get_cuts();
+                for (int p=c.first; p<c.second; ++p) found.push_back(std::make_pair(it->first,p));
+            }
+            found = world.gop.concat0(found);
+            world.gop.fence();
+
+            std::vector<keyT> cuts(nproc, key0);
+            if (world.rank() == 0) {
+                for (unsigned int i=0; i<found.size(); ++i) cuts[found[i].second] = found[i].first;
+            }
+            world.gop.broadcast_serializable(cuts, 0);
+            world.gop.fence();
+
+            std::shared_ptr< WorldDCPmapInterface<keyT> > pmap(new LBSFCPmap<NDIM>(cuts));
+            if (printstuff && world.rank() == 0) {
+                print("THESE ARE THE CURVE CUTS FOR AVERAGE COST", avg);
+                pmap->print();
+            }
+            return pmap;
+        }
+
         /// Actually does the partitioning of the tree
         std::shared_ptr< WorldDCPmapInterface<keyT> > load_balance(double fac = 1.0, bool printstuff=false) {
+            if (use_sfc()) return load_balance_sfc(printstuff);
             world.gop.fence();
             // Compute full tree of costs
             double avg = sum()/(world.size()*fac);
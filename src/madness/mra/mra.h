@@ -211,6 +211,50 @@ namespace madness {
             return result;
         }
 
+        /// Evaluates the function at many points in user coordinates.  Possible non-blocking comm.
+
+        /// Only the invoking process will receive the values, in the order
+        /// of the points, via the future.  Unlike calling eval() for each
+        /// point, the points travel together with one message to each
+        /// process holding part of the tree, and points in the same box
+        /// are evaluated together.
+        ///
+        /// Throws if function is not initialized.
+        Future< std::vector<T> > eval_many(const std::vector<coordT>& xuser) const {
+            PROFILE_MEMBER_FUNC(Function);
+            const double eps=1e-15;
+            verify();
+            MADNESS_ASSERT(!is_compressed());
+            if (xuser.empty()) return Future< std::vector<T> >(std::vector<T>());
+
+            std::vector<coordT> xsim(xuser.size());
+            std::vector<long> index(xuser.size());
+            for (std::size_t i=0; i<xuser.size(); ++i) {
+                user_to_sim(xuser[i],xsim[i]);
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    if (xsim[i][d] < -eps) {
+                        MADNESS_EXCEPTION("eval_many: coordinate lower-bound error in dimension", d);
+                    }
+                    else if (xsim[i][d] < eps) {
+                        xsim[i][d] = eps;
+                    }
+
+                    if (xsim[i][d] > 1.0+eps) {
+                        MADNESS_EXCEPTION("eval_many: coordinate upper-bound error in dimension", d);
+                    }
+                    else if (xsim[i][d] > 1.0-eps) {
+                        xsim[i][d] = 1.0-eps;
+                    }
+                }
+                index[i] = i;
+            }
+
+            Future<typename implT::evalbatchT> values;
+            impl->eval_batch(std::vector< Key<NDIM> >(xuser.size(), impl->key0()), xsim, index,
+                             values.remote_ref(impl->world));
+            return impl->task(impl->world.rank(), &implT::eval_batch_order, values);
+        }
+
         /// Evaluate function only if point is local returning (true,value); otherwise return (false,0.0)
 
         /// maxlevel is the maximum depth to search down to --- the max local depth can be
@@ -1392,14 +1436,16 @@ namespace madness {
         /// Archive can be sequential or parallel.
         ///
         /// The & operator for serializing will only work with parallel archives.
+        /// @param[in] ar   the archive
+        /// @param[in] fence    fence after storing
         template <typename Archive>
-        void store(Archive& ar) const {
+        void store(Archive& ar, bool fence=true) const {
             PROFILE_MEMBER_FUNC(Function);
             verify();
             // For type checking, etc.
             ar & long(7776768) & long(TensorTypeData<T>::id) & long(NDIM) & long(k());
 
-            impl->store(ar);
+            impl->store(ar, fence);
         }
 
         /// change the tensor type of the coefficients in the FunctionNode
@@ -1447,6 +1493,21 @@ namespace madness {
             return *this;
         }
 
+        /// Like multiop_values, but op acts pointwise on batches of about batchsize points
+        template <typename opT>
+        Function<T,NDIM>& multiop_values_batched(const opT& op, const std::vector< Function<T,NDIM> >& vf,
+                const long batchsize) {
+            std::vector<implT*> v(vf.size(),NULL);
+            for (unsigned int i=0; i<v.size(); ++i) {
+                if (vf[i].is_initialized()) v[i] = vf[i].get_impl().get();
+            }
+            impl->multiop_values_batched(op, v, batchsize);
+            world().gop.fence();
+            if (VERIFY_TREE) verify_tree();
+
+            return *this;
+        }
+
         /// apply op on the input vector yielding an output vector of functions
 
         /// (*this) is just a dummy Function to be able to call internal methods in FuncImpl
@@ -1472,6 +1533,32 @@ namespace madness {
 
         }
 
+        /// apply a pointwise op on the input vector yielding an output vector of functions
+
+        /// Like multi_to_multi_op_values, but op is called on batches of about
+        /// batchsize points gathered from many boxes; see FunctionImpl::multi_to_multi_op_values_batched
+        /// @param[in]  op   the pointwise operator working on vin
+        /// @param[in]  vin  vector of input Functions
+        /// @param[out] vout vector of output Functions vout = op(vin)
+        /// @param[in]  batchsize approximate number of points per call to op
+        template <typename opT>
+        void multi_to_multi_op_values_batched(const opT& op,
+                const std::vector< Function<T,NDIM> >& vin,
+                std::vector< Function<T,NDIM> >& vout,
+                const long batchsize, const bool fence=true) {
+            std::vector<implT*> vimplin(vin.size(),NULL);
+            for (unsigned int i=0; i<vin.size(); ++i) {
+                if (vin[i].is_initialized()) vimplin[i] = vin[i].get_impl().get();
+            }
+            std::vector<implT*> vimplout(vout.size(),NULL);
+            for (unsigned int i=0; i<vout.size(); ++i) {
+                if (vout[i].is_initialized()) vimplout[i] = vout[i].get_impl().get();
+            }
+
+            impl->multi_to_multi_op_values_batched(op, vimplin, vimplout, batchsize, fence);
+            if (VERIFY_TREE) verify_tree();
+        }
+
 
         /// Multiplication of function * vector of functions using recursive algorithm of mulxx
         template <typename L, typename R>
@@ -1494,6 +1581,32 @@ namespace madness {
             vresult[0]->mulXXvec(left.get_impl().get(), vright, vresult, tol, fence);
         }
 
+
+        /// Multiplication of pairs of functions from two vectors in a single recursive traversal
+        template <typename L, typename R>
+        void vmulXXpairs(const std::vector< Function<L,NDIM> >& left,
+                         const std::vector< Function<R,NDIM> >& right,
+                         const std::vector< std::pair<int,int> >& pairs,
+                         std::vector< Function<T,NDIM> >& result,
+                         double tol,
+                         bool fence) {
+            PROFILE_MEMBER_FUNC(Function);
+
+            std::vector<const FunctionImpl<L,NDIM>*> vleft(left.size());
+            std::vector<const FunctionImpl<R,NDIM>*> vright(right.size());
+            for (unsigned int i=0; i<left.size(); ++i) vleft[i] = left[i].get_impl().get();
+            for (unsigned int i=0; i<right.size(); ++i) vright[i] = right[i].get_impl().get();
+
+            std::vector<FunctionImpl<T,NDIM>*> vresult(pairs.size());
+            for (unsigned int p=0; p<pairs.size(); ++p) {
+                result[p].set_impl(left[pairs[p].first],false);
+                vresult[p] = result[p].impl.get();
+            }
+
+            left[0].world().gop.fence();
+            vresult[0]->mulXXpairs(vleft, vright, pairs, vresult, tol, fence);
+        }
+
         /// Same as \c operator* but with optional fence and no automatic reconstruction
 
         /// f or g are on-demand functions
@@ -1581,6 +1694,16 @@ namespace madness {
         return r;
     }
 
+    /// Like multiop_values, but the pointwise op is called on batches of about batchsize points
+    template <typename T, typename opT, std::size_t NDIM>
+    Function<T,NDIM> multiop_values_batched(const opT& op, const std::vector< Function<T,NDIM> >& vf,
+            const long batchsize=32768) {
+        Function<T,NDIM> r;
+        r.set_impl(vf[0], false);
+        r.multiop_values_batched(op, vf, batchsize);
+        return r;
+    }
+
     /// Returns new function equal to alpha*f(x) with optional fence
     template <typename Q, typename T, std::size_t NDIM>
     Function<TENSOR_RESULT_TYPE(Q,T),NDIM>
@@ -1697,6 +1820,20 @@ namespace madness {
         return vresult;
     }
 
+    /// Use the vmra/mul_pairs(...) interface instead
+
+    /// If using sparsity (tol != 0) you must have created the tree of norms
+    /// already for both left and right.
+    template <typename L, typename R, std::size_t D>
+    std::vector< Function<TENSOR_RESULT_TYPE(L,R),D> >
+    vmulXXpairs(const std::vector< Function<L,D> >& left, const std::vector< Function<R,D> >& right,
+                const std::vector< std::pair<int,int> >& pairs, double tol, bool fence=true) {
+        if (pairs.size() == 0) return std::vector< Function<TENSOR_RESULT_TYPE(L,R),D> >();
+        std::vector< Function<TENSOR_RESULT_TYPE(L,R),D> > vresult(pairs.size());
+        vresult[0].vmulXXpairs(left, right, pairs, vresult, tol, fence);
+        return vresult;
+    }
+
     /// Multiplies two functions with the new result being of type TensorResultType<L,R>
 
     /// Using operator notation forces a global fence after each operation but also
@@ -2099,6 +2236,123 @@ namespace madness {
     }
 
 
+    /// Holds the state for applying an operator incrementally to a function that changes little
+
+    /// Keeps the nonstandard form of the input of the last apply with this
+    /// cache and of its result.  The next apply only applies the operator
+    /// to the change of the input in the boxes where it exceeds
+    /// reuse_tol*truncate_tol(thresh,key), and adds that to the cached
+    /// result; the results of the other boxes are reused.  Since the
+    /// change of a box is always taken relative to the coefficients last
+    /// applied, the neglected changes do not accumulate over iterations.
+    ///
+    /// The cache is reset when the operator, the distribution, the
+    /// wavelet order or the threshold change, but cannot tell if the
+    /// operator object was modified in place; call clear() then.
+    template <typename T, std::size_t NDIM>
+    class ApplyCache {
+        template <typename opT, typename R, std::size_t D>
+        friend Function<R,D> apply(const opT& op, const Function<R,D>& f, ApplyCache<R,D>& cache);
+
+        double reuse_tol;           ///< Changes below reuse_tol*truncate_tol are neglected
+        const void* op;             ///< The operator of the cached result
+        Function<T,NDIM> input;     ///< Nonstandard form of the input that was applied
+        Function<T,NDIM> result;    ///< Nonstandard form of the result
+        long nreused;               ///< Boxes of the last apply whose results were reused
+        long napplied;              ///< Boxes of the last apply to which the operator was applied
+
+    public:
+        /// Makes an empty cache
+        explicit ApplyCache(double reuse_tol=0.1)
+            : reuse_tol(reuse_tol), op(0), nreused(0), napplied(0) {}
+
+        /// Discards the cached input and result
+        void clear() {
+            op = 0;
+            input.clear(false);
+            result.clear(false);
+        }
+
+        /// Sets the tolerance for neglecting changes, relative to truncate_tol
+        void set_reuse_tol(double tol) {reuse_tol = tol;}
+
+        /// Returns the tolerance for neglecting changes, relative to truncate_tol
+        double get_reuse_tol() const {return reuse_tol;}
+
+        /// Returns the number of boxes of the last apply whose results were reused
+        long get_nreused() const {return nreused;}
+
+        /// Returns the number of boxes of the last apply to which the operator was applied
+        long get_napplied() const {return napplied;}
+
+        /// Returns the fraction of boxes of the last apply whose results were reused
+        double reuse_ratio() const {
+            return (nreused+napplied) ? double(nreused)/(nreused+napplied) : 0.0;
+        }
+
+    private:
+        /// True if the cached result may be reused for applying op to f
+        template <typename opT>
+        bool compatible(const opT& opin, const Function<T,NDIM>& f) const {
+            if (op != static_cast<const void*>(&opin)) return false;
+            if (!input.is_initialized() || !result.is_initialized()) return false;
+            return input.get_pmap() == f.get_pmap() && input.k() == f.k()
+                && input.thresh() == f.thresh();
+        }
+    };
+
+
+    /// Apply operator reusing the results of boxes whose input changed little since the last apply
+
+    /// Behaves like apply(op,f) but applies the operator only to the boxes
+    /// of the nonstandard form of \c f that changed since the last apply
+    /// with \c cache (see ApplyCache).  Operators that use the modified
+    /// nonstandard form or leaf coefficients, destructive operators, and
+    /// functions of more than 3 dimensions are applied fully.  Always fences.
+    template <typename opT, typename T, std::size_t NDIM>
+    Function<T,NDIM> apply(const opT& op, const Function<T,NDIM>& f, ApplyCache<T,NDIM>& cache) {
+        static_assert(std::is_same<TENSOR_RESULT_TYPE(typename opT::opT,T), T>::value,
+                      "the incremental apply requires the result to have the type of the input");
+        if (NDIM > 3 || op.modified() || op.doleaves || op.destructive() || op.is_slaterf12) {
+            cache.clear();
+            cache.nreused = 0;
+            cache.napplied = 0;
+            return apply(op, f);
+        }
+
+        Function<T,NDIM>& ff = const_cast< Function<T,NDIM>& >(f);
+        MADNESS_ASSERT(not f.is_on_demand());
+        if (VERIFY_TREE) ff.verify_tree();
+        ff.reconstruct();
+        ff.nonstandard(false, true);
+
+        if (!cache.compatible(op, ff)) {
+            cache.op = &op;
+            cache.input = Function<T,NDIM>();
+            cache.input.set_impl(ff, false);
+            cache.result = Function<T,NDIM>();
+            cache.result.set_impl(ff, false);
+        }
+
+        Function<T,NDIM> delta;
+        delta.set_impl(ff, false);
+        std::pair<long,long> n = ff.get_impl()->nonstandard_delta(*cache.input.get_impl(),
+                                                                 *delta.get_impl(), cache.reuse_tol);
+        cache.nreused = n.first;
+        cache.napplied = n.second;
+
+        if (n.second) {
+            Function<T,NDIM> r = apply_only(op, delta, true);
+            cache.result.gaxpy(T(1.0), r, T(1.0), true);
+        }
+        ff.standard();
+
+        Function<T,NDIM> result = copy(cache.result);
+        result.reconstruct();
+        return result;
+    }
+
+
     template <typename opT, typename R, std::size_t NDIM>
     Function<TENSOR_RESULT_TYPE(typename opT::opT,R), NDIM>
     apply_1d_realspace_push(const opT& op, const Function<R,NDIM>& f, int axis, bool fence=true) {
@@ -2392,15 +2646,41 @@ namespace madness {
         template <class T, std::size_t NDIM>
         struct ArchiveStoreImpl< ParallelOutputArchive, Function<T,NDIM> > {
             static inline void store(const ParallelOutputArchive& ar, const Function<T,NDIM>& f) {
-                f.store(ar);
+                f.store(ar, ar.dofence());
             }
         };
     }
 
+    /// Writes the function to disk
+
+    /// @param[in] f       the function
+    /// @param[in] name    the base name of the files
+    /// @param[in] indexed write the indexed format (see ParallelOutputArchive::set_indexed),
+    ///                    which any number of processes can read back
+    template <class T, std::size_t NDIM>
+    void save(const Function<T,NDIM>& f, const std::string name, bool indexed=false) {
+        archive::ParallelOutputArchive ar2(f.world(), name.c_str(), 1);
+        ar2.set_indexed(indexed);
+        ar2 & f;
+    }
+
+    /// Writes the function to disk in the background
+
+    /// Writes the same files as \c save, and \c load reads them back. Every
+    /// process serializes its coefficients into a snapshot, which is then
+    /// written by the \c AsyncWriter thread while tasks keep running, so
+    /// \c f may be modified as soon as this returns. Collective, but does
+    /// not fence: the operations that compute \c f must be complete.
+    /// @param[in] f    the function
+    /// @param[in] name the base name of the files
+    /// @return a future that is set to true once the data of this process is on disk
     template <class T, std::size_t NDIM>
-    void save(const Function<T,NDIM>& f, const std::string name) {
+    Future<bool> checkpoint(const Function<T,NDIM>& f, const std::string name) {
         archive::ParallelOutputArchive ar2(f.world(), name.c_str(), 1);
+        ar2.set_async(true);
+        ar2.set_dofence(false);
         ar2 & f;
+        return ar2.close_async();
     }
 
     template <class T, std::size_t NDIM>
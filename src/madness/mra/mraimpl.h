@@ -1977,6 +1977,42 @@ namespace madness {
         return sum*pow(2.0,0.5*NDIM*n)/sqrt(FunctionDefaults<NDIM>::get_cell_volume());
     }
 
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::eval_cube_batch(Level n, const std::vector<coordT>& x,
+                                               const tensorT& c, T* values) const {
+        PROFILE_MEMBER_FUNC(FunctionImpl);
+        typedef TENSOR_RESULT_TYPE(double,T) resultT;
+        const int k = cdata.k;
+        const long npt = x.size();
+        const long rest = c.size()/k;
+
+        std::vector< Tensor<double> > p(NDIM);
+        for (std::size_t d=0; d<NDIM; ++d) {
+            p[d] = Tensor<double>(npt,long(k));
+            for (long i=0; i<npt; ++i) legendre_scaling_functions(x[i][d],k,&(p[d](i,0L)));
+        }
+
+        // (npt,k) x (k,k^(NDIM-1)), then the remaining dimensions point by point
+        Tensor<resultT> r = inner(p[0], c.reshape(long(k),rest));
+        const double fac = pow(2.0,0.5*NDIM*n)/sqrt(FunctionDefaults<NDIM>::get_cell_volume());
+        std::vector<resultT> work(rest);
+        for (long i=0; i<npt; ++i) {
+            const resultT* v = r.ptr() + i*rest;
+            long m = rest;
+            for (std::size_t d=1; d<NDIM; ++d) {
+                m /= k;
+                const double* pd = p[d].ptr() + i*k;
+                for (long j=0; j<m; ++j) {
+                    resultT sum = resultT(0.0);
+                    for (int q=0; q<k; ++q) sum += pd[q]*v[q*m+j];
+                    work[j] = sum;
+                }
+                v = &work[0];
+            }
+            values[i] = T(v[0]*fac);
+        }
+    }
+
     template <typename T, std::size_t NDIM>
     void FunctionImpl<T,NDIM>::reconstruct_op(const keyT& key, const coeffT& s) {
         //PROFILE_MEMBER_FUNC(FunctionImpl);
@@ -2751,6 +2787,104 @@ namespace madness {
     }
 
 
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::eval_batch(const std::vector<keyT>& keys,
+                                          const std::vector< Vector<double,NDIM> >& xin,
+                                          const std::vector<long>& index,
+                                          const typename Future<evalbatchT>::remote_refT& ref) {
+        PROFILE_MEMBER_FUNC(FunctionImpl);
+        const ProcessID me = world.rank();
+        const std::size_t npt = keys.size();
+        std::vector<keyT> key(keys);
+        std::vector< Vector<double,NDIM> > x(xin);
+
+        // Follow each point down to its leaf or to a box held elsewhere
+        std::vector< std::pair<keyT,long> > leaf;
+        std::map< ProcessID, std::vector<long> > away;
+        for (std::size_t ip=0; ip<npt; ++ip) {
+            Vector<Translation,NDIM> l = key[ip].translation();
+            while (1) {
+                ProcessID owner = coeffs.owner(key[ip]);
+                if (owner != me) {
+                    away[owner].push_back(ip);
+                    break;
+                }
+                typename dcT::iterator it = coeffs.find(key[ip]).get();
+                if (it->second.has_coeff()) {
+                    leaf.push_back(std::make_pair(key[ip],long(ip)));
+                    break;
+                }
+                for (std::size_t i=0; i<NDIM; ++i) {
+                    double xi = x[ip][i]*2.0;
+                    int li = int(xi);
+                    if (li == 2) li = 1;
+                    x[ip][i] = xi - li;
+                    l[i] = 2*l[i] + li;
+                }
+                key[ip] = keyT(key[ip].level()+1,l);
+            }
+        }
+
+        // Forward the others with one message per process
+        std::vector< Future<evalbatchT> > remote;
+        for (typename std::map< ProcessID, std::vector<long> >::const_iterator it=away.begin(); it!=away.end(); ++it) {
+            const std::vector<long>& ipt = it->second;
+            std::vector<keyT> fkey(ipt.size());
+            std::vector< Vector<double,NDIM> > fx(ipt.size());
+            std::vector<long> findex(ipt.size());
+            for (std::size_t j=0; j<ipt.size(); ++j) {
+                fkey[j] = key[ipt[j]];
+                fx[j] = x[ipt[j]];
+                findex[j] = index[ipt[j]];
+            }
+            remote.push_back(Future<evalbatchT>());
+            woT::task(it->first, &implT::eval_batch, fkey, fx, findex, remote.back().remote_ref(world),
+                      TaskAttributes::hipri());
+        }
+
+        // Evaluate the points of each local leaf together
+        std::sort(leaf.begin(), leaf.end());
+        evalbatchT local(leaf.size());
+        std::vector< Vector<double,NDIM> > xbox;
+        std::vector<T> vbox;
+        for (std::size_t lo=0; lo<leaf.size(); ) {
+            std::size_t hi = lo+1;
+            while (hi<leaf.size() && leaf[hi].first == leaf[lo].first) ++hi;
+            xbox.resize(hi-lo);
+            vbox.resize(hi-lo);
+            for (std::size_t j=lo; j<hi; ++j) xbox[j-lo] = x[leaf[j].second];
+            const nodeT& node = coeffs.find(leaf[lo].first).get()->second;
+            eval_cube_batch(leaf[lo].first.level(), xbox, node.coeff().full_tensor_copy(), &vbox[0]);
+            for (std::size_t j=lo; j<hi; ++j) local[j] = std::make_pair(index[leaf[j].second], vbox[j-lo]);
+            lo = hi;
+        }
+
+        if (remote.empty()) Future<evalbatchT>(ref).set(local);
+        else woT::task(me, &implT::eval_batch_join, local, remote, ref, TaskAttributes::hipri());
+    }
+
+
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::eval_batch_join(const evalbatchT& local,
+                                               const std::vector< Future<evalbatchT> >& remote,
+                                               const typename Future<evalbatchT>::remote_refT& ref) {
+        evalbatchT values(local);
+        for (std::size_t i=0; i<remote.size(); ++i) {
+            const evalbatchT& r = remote[i].get();
+            values.insert(values.end(), r.begin(), r.end());
+        }
+        Future<evalbatchT>(ref).set(values);
+    }
+
+
+    template <typename T, std::size_t NDIM>
+    std::vector<T> FunctionImpl<T,NDIM>::eval_batch_order(const evalbatchT& values) const {
+        std::vector<T> result(values.size());
+        for (std::size_t i=0; i<values.size(); ++i) result[values[i].first] = values[i].second;
+        return result;
+    }
+
+
     template <typename T, std::size_t NDIM>
     std::pair<bool,T>
     FunctionImpl<T,NDIM>::eval_local_only(const Vector<double,NDIM>& xin, Level maxlevel) {
@@ -3302,6 +3436,7 @@ namespace madness {
         truncate_on_project = true;
         apply_randomize = false;
         project_randomize = false;
+        apply_aggregation_size = 0;
         bc = BoundaryConditions<NDIM>(BC_FREE);
         tt = TT_FULL;
         cell = Tensor<double>(NDIM,2);
@@ -3328,6 +3463,7 @@ namespace madness {
     		std::cout << "             truncate_on_project" <<  ": " << truncate_on_project << std::endl;
     		std::cout << "                 apply_randomize" <<  ": " << apply_randomize << std::endl;
     		std::cout << "               project_randomize" <<  ": " << project_randomize << std::endl;
+    		std::cout << "          apply_aggregation_size" <<  ": " << apply_aggregation_size << std::endl;
     		std::cout << "                              bc" <<  ": " << bc << std::endl;
     		std::cout << "                              tt" <<  ": " << tt << std::endl;
     		std::cout << "                            cell" <<  ": " << cell << std::endl;
@@ -3348,6 +3484,7 @@ namespace madness {
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::truncate_on_project;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::apply_randomize;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::project_randomize;
+    template <std::size_t NDIM> std::size_t FunctionDefaults<NDIM>::apply_aggregation_size;
     template <std::size_t NDIM> BoundaryConditions<NDIM> FunctionDefaults<NDIM>::bc;
     template <std::size_t NDIM> TensorType FunctionDefaults<NDIM>::tt;
     template <std::size_t NDIM> Tensor<double> FunctionDefaults<NDIM>::cell;
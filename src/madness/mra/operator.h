@@ -121,6 +121,7 @@ namespace madness {
         bool modified_;     ///< use modified NS form
         int particle_;
         bool destructive_;	///< destroy the argument or restore it (expensive for 6d functions)
+        bool batched_;      ///< stack the last transformation of full-rank terms into one mTxmq
 
         typedef Key<NDIM> keyT;
         const static size_t opdim=NDIM;
@@ -159,6 +160,9 @@ namespace madness {
         bool& destructive() {return destructive_;}
         const bool& destructive() const {return destructive_;}
 
+        bool& batched() {return batched_;}
+        const bool& batched() const {return batched_;}
+
         const double& gamma() const {return mu_;}
         const double& mu() const {return mu_;}
 
@@ -352,6 +356,53 @@ namespace madness {
         }
 
 
+        /// Choose the (possibly low) rank of the R or T part of one separated term in each dimension
+
+        /// @param[in]      ops_1d  the 1D operators of the term
+        /// @param[in]      t_part  select the T part instead of the R part
+        /// @param[in,out]  tol     the tolerance, on output made relative to the norm of the part
+        /// @param[out]     trans   the transformation in each dimension
+        /// @return false if the part is negligible (zero norm or zero rank)
+        bool select_transformation(const ConvolutionData1D<Q>* const ops_1d[NDIM],
+                                   bool t_part, double& tol,
+                                   Transformation trans[NDIM]) const {
+            double norm = 1.0;
+            for (std::size_t d=0; d<NDIM; ++d) norm *= t_part ? ops_1d[d]->Tnorm : ops_1d[d]->Rnorm;
+            if (t_part ? !(norm > 0.0) : !(norm > 1.e-20)) return false;
+
+            tol = tol/(norm*NDIM);  // Errors are relative within here
+
+            // Determine rank of SVD to use or if to use the full matrix
+            long twok = 2*k;
+            if (t_part or modified()) twok=k;
+
+            long break_even;
+            if (NDIM==1) break_even = long(0.5*twok);
+            else if (NDIM==2) break_even = long(0.6*twok);
+            else if (NDIM==3) break_even=long(0.65*twok);
+            else break_even=long(0.7*twok);
+            for (std::size_t d=0; d<NDIM; ++d) {
+                const Tensor<typename Tensor<Q>::scalar_type>& s = t_part ? ops_1d[d]->Ts : ops_1d[d]->Rs;
+                long r;
+                for (r=0; r<twok; ++r) {
+                    if (s[r] < tol) break;
+                }
+                if (r >= break_even) {
+                    trans[d].r = twok;
+                    trans[d].U = t_part ? ops_1d[d]->T.ptr() : ops_1d[d]->R.ptr();
+                    trans[d].VT = 0;
+                }
+                else {
+                    //r = std::max(2L,r+(r&1L)); // NOLONGER NEED TO FORCE OPERATOR RANK TO BE EVEN
+                    if (r == 0) return false;
+                    trans[d].r = r;
+                    trans[d].U = t_part ? ops_1d[d]->TU.ptr() : ops_1d[d]->RU.ptr();
+                    trans[d].VT = t_part ? ops_1d[d]->TVT.ptr() : ops_1d[d]->RVT.ptr();
+                }
+            }
+            return true;
+        }
+
         /// Apply one of the separated terms, accumulating into the result
         template <typename T>
         void muopxv_fast(ApplyTerms at,
@@ -366,94 +417,144 @@ namespace madness {
 
             //PROFILE_MEMBER_FUNC(SeparatedConvolution); // Too fine grain for routine profiling
             Transformation trans[NDIM];
-            Tensor<T> trans2[NDIM];
 
-            double Rnorm = 1.0;
-            for (std::size_t d=0; d<NDIM; ++d) Rnorm *= ops_1d[d]->Rnorm;
+            if (at.r_term and select_transformation(ops_1d, false, tol, trans)) {
+                long twok = 2*k;
+                if (modified()) twok=k;
+                apply_transformation(twok, trans, f, work1, work2, mufac, result);
+            }
+
+            if (at.t_term and select_transformation(ops_1d, true, tol, trans)) {
+                apply_transformation(k, trans, f0, work1, work2, -mufac, result0);
+            }
+        }
 
-            if (at.r_term and (Rnorm > 1.e-20)) {
 
-                tol = tol/(Rnorm*NDIM);  // Errors are relative within here
+        /// Full-rank separated terms waiting for their last transformation
+        template <typename R>
+        struct TermBatch {
+            long dimk;          ///< Size of the transformation matrices
+            long nmax;          ///< Max. number of terms per batch
+            long n;             ///< Number of terms in the batch
+            Tensor<R> x;        ///< The terms transformed in all but the last dimension
+            Tensor<Q> u;        ///< The (scaled) matrices of the last dimension, stacked
+            Tensor<R> sum;      ///< The sum over the batch
+
+            TermBatch(long dimk, long nmax) : dimk(dimk), nmax(nmax), n(0) {
+                long size = 1;
+                for (std::size_t d=0; d<NDIM; ++d) size *= dimk;
+                x = Tensor<R>(std::vector<long>(1,nmax*size), false);
+                u = Tensor<Q>(std::vector<long>(1,nmax*dimk*dimk), false);
+                sum = Tensor<R>(std::vector<long>(1,size), false);
+            }
+        };
 
-                // Determine rank of SVD to use or if to use the full matrix
-                long twok = 2*k;
-                if (modified()) twok=k;
+        /// Add a full-rank term to the batch, flushing it into result when full
 
-                long break_even;
-                if (NDIM==1) break_even = long(0.5*twok);
-                else if (NDIM==2) break_even = long(0.6*twok);
-                else if (NDIM==3) break_even=long(0.65*twok);
-                else break_even=long(0.7*twok);
-                bool rank_is_zero = false;
-                for (std::size_t d=0; d<NDIM; ++d) {
-                    long r;
-                    for (r=0; r<twok; ++r) {
-                        if (ops_1d[d]->Rs[r] < tol) break;
-                    }
-                    if (r >= break_even) {
-                        trans[d].r = twok;
-                        trans[d].U = ops_1d[d]->R.ptr();
-                        trans[d].VT = 0;
-                    }
-                    else {
-                        //r = std::max(2L,r+(r&1L)); // NOLONGER NEED TO FORCE OPERATOR RANK TO BE EVEN
-                        if (r == 0) {
-                            rank_is_zero = true;
-                            break;
-                        }
-                        trans[d].r = r;
-                        trans[d].U = ops_1d[d]->RU.ptr();
-                        trans[d].VT = ops_1d[d]->RVT.ptr();
-                    }
-                    trans2[d]=ops_1d[d]->R;
-                }
+        /// The term is transformed in all but the last dimension.  The last
+        /// transformation of all terms in the batch is then one mTxmq with the
+        /// terms stacked along the contracted index, so the sum over terms
+        /// happens inside that product.
+        template <typename T, typename R>
+        void batch_transformation(const Transformation trans[NDIM],
+                                  const Tensor<T>& f,
+                                  Tensor<R>& work1,
+                                  Tensor<R>& work2,
+                                  const Q mufac,
+                                  TermBatch<R>& batch,
+                                  Tensor<R>& result) const {
+            const long dimk = batch.dimk;
+            long size = 1;
+            for (std::size_t i=0; i<NDIM; ++i) size *= dimk;
+            const long dimi = size/dimk;
 
-                if (!rank_is_zero)
-                    apply_transformation(twok, trans, f, work1, work2, mufac, result);
+            R* MADNESS_RESTRICT w1=work1.ptr();
+            R* MADNESS_RESTRICT w2=work2.ptr();
+            R* MADNESS_RESTRICT x=batch.x.ptr() + batch.n*size;
 
-                //            apply_transformation2(n, twok, tol, trans2, f, work1, work2, mufac, result);
-//                apply_transformation3(trans2, f, mufac, result);
+            mTxmq(dimi, dimk, dimk, (NDIM==2) ? x : w1, f.ptr(), trans[0].U);
+            for (std::size_t d=1; d<NDIM-1; ++d) {
+                mTxmq(dimi, dimk, dimk, (d==NDIM-2) ? x : w2, w1, trans[d].U);
+                std::swap(w1,w2);
             }
 
-            double Tnorm = 1.0;
-            for (std::size_t d=0; d<NDIM; ++d) Tnorm *= ops_1d[d]->Tnorm;
+            Q* MADNESS_RESTRICT u=batch.u.ptr() + batch.n*dimk*dimk;
+            const Q* MADNESS_RESTRICT U=trans[NDIM-1].U;
+            for (long i=0; i<dimk*dimk; ++i) u[i] = mufac*U[i];
 
-            if (at.t_term and (Tnorm>0.0)) {
-                tol = tol/(Tnorm*NDIM);  // Errors are relative within here
+            if (++batch.n == batch.nmax) flush_batch(batch, result);
+        }
 
-                long break_even;
-                if (NDIM==1) break_even = long(0.5*k);
-                else if (NDIM==2) break_even = long(0.6*k);
-                else if (NDIM==3) break_even=long(0.65*k);
-                else break_even=long(0.7*k);
-                bool rank_is_zero = false;
-                for (std::size_t d=0; d<NDIM; ++d) {
-                    long r;
-                    for (r=0; r<k; ++r) {
-                        if (ops_1d[d]->Ts[r] < tol) break;
-                    }
-                    if (r >= break_even) {
-                        trans[d].r = k;
-                        trans[d].U = ops_1d[d]->T.ptr();
-                        trans[d].VT = 0;
+        /// Apply the last transformation to all terms of the batch and accumulate into result
+        template <typename R>
+        void flush_batch(TermBatch<R>& batch, Tensor<R>& result) const {
+            if (batch.n == 0) return;
+            const long dimk = batch.dimk;
+            const long size = batch.sum.size();
+            mTxmq(size/dimk, dimk, batch.n*dimk, batch.sum.ptr(), batch.x.ptr(), batch.u.ptr());
+            // Assuming here that result is contiguous and aligned
+            aligned_axpy(size, result.ptr(), batch.sum.ptr(), 1.0);
+            batch.n = 0;
+        }
+
+        /// Apply all significant separated terms, accumulating into the result
+
+        /// Does the same as calling muopxv_fast for each term, but the
+        /// full-rank terms are collected in batches (see batch_transformation).
+        /// Terms with low-rank transformations are applied individually.
+        template <typename T>
+        void muopxv_batched(ApplyTerms at,
+                            const SeparatedConvolutionData<Q,NDIM>* op,
+                            const Tensor<T>& f, const Tensor<T>& f0,
+                            Tensor<TENSOR_RESULT_TYPE(T,Q)>& result,
+                            Tensor<TENSOR_RESULT_TYPE(T,Q)>& result0,
+                            double tol,
+                            Tensor<TENSOR_RESULT_TYPE(T,Q)>& work1,
+                            Tensor<TENSOR_RESULT_TYPE(T,Q)>& work2) const {
+            typedef TENSOR_RESULT_TYPE(T,Q) resultT;
+
+            long twok = 2*k;
+            if (modified()) twok=k;
+
+            // Size the batches so the stacked terms stay in cache
+            long size = 1;
+            for (std::size_t d=0; d<NDIM; ++d) size *= twok;
+            const long nmax = std::max(2L, std::min(long(rank), long((1<<19)/(size*sizeof(resultT)))));
+            TermBatch<resultT> rbatch(twok, nmax);
+            TermBatch<resultT> tbatch(k, (at.t_term ? nmax : 1));
+
+            Transformation trans[NDIM];
+            for (int mu=0; mu<rank; ++mu) {
+                const SeparatedConvolutionInternal<Q,NDIM>& muop =  op->muops[mu];
+                if (muop.norm > tol) {
+                    const Q fac = ops[mu].getfac();
+                    double mutol = tol/std::abs(fac);
+
+                    if (at.r_term and select_transformation(muop.ops, false, mutol, trans)) {
+                        if (full_rank(trans))
+                            batch_transformation(trans, f, work1, work2, fac, rbatch, result);
+                        else
+                            apply_transformation(twok, trans, f, work1, work2, fac, result);
                     }
-                    else {
-                        //r = std::max(2L,r+(r&1L)); // NOLONGER NEED TO FORCE OPERATOR RANK TO BE EVEN
-                        if (r == 0) {
-                            rank_is_zero = true;
-                            break;
-                        }
-                        trans[d].r = r;
-                        trans[d].U = ops_1d[d]->TU.ptr();
-                        trans[d].VT = ops_1d[d]->TVT.ptr();
+
+                    if (at.t_term and select_transformation(muop.ops, true, mutol, trans)) {
+                        if (full_rank(trans))
+                            batch_transformation(trans, f0, work1, work2, -fac, tbatch, result0);
+                        else
+                            apply_transformation(k, trans, f0, work1, work2, -fac, result0);
                     }
-                    trans2[d]=ops_1d[d]->T;
                 }
-                if (!rank_is_zero)
-                    apply_transformation(k, trans, f0, work1, work2, -mufac, result0);
-//                apply_transformation2(n, k, tol, trans2, f0, work1, work2, -mufac, result0);
-//                apply_transformation3(trans2, f0, -mufac, result0);
             }
+            flush_batch(rbatch, result);
+            flush_batch(tbatch, result0);
+        }
+
+        /// True if no dimension of the transformation uses the low-rank (SVD) form
+        static bool full_rank(const Transformation trans[NDIM]) {
+            for (std::size_t d=0; d<NDIM; ++d) {
+                if (trans[d].VT) return false;
+            }
+            return true;
         }
 
 
@@ -874,6 +975,7 @@ namespace madness {
                 , modified_(false)
                 , particle_(1)
                 , destructive_(false)
+                , batched_(true)
                 , is_slaterf12(false)
                 , mu_(0.0)
                 , bc(bc)
@@ -909,6 +1011,7 @@ namespace madness {
                 , modified_(false)
                 , particle_(1)
                 , destructive_(false)
+                , batched_(true)
                 , is_slaterf12(false)
                 , mu_(0.0)
                 , ops(argops)
@@ -940,6 +1043,7 @@ namespace madness {
                 , modified_(false)
                 , particle_(1)
                 , destructive_(false)
+                , batched_(true)
                 , is_slaterf12(mu>0.0)
                 , mu_(mu)
                 , ops(coeff.dim(0))
@@ -985,6 +1089,7 @@ namespace madness {
                 , modified_(false)
                 , particle_(1)
                 , destructive_(false)
+                , batched_(true)
                 , is_slaterf12(false)
                 , mu_(0.0)
                 , ops(coeff.dim(0))
@@ -1160,14 +1265,19 @@ namespace madness {
             }
 
             const Tensor<T> f0 = copy(coeff(s0));
-            for (int mu=0; mu<rank; ++mu) {
-                // SeparatedConvolutionInternal keeps data for 1 term and all dimensions and 1 displacement
-                const SeparatedConvolutionInternal<Q,NDIM>& muop =  op->muops[mu];
-                if (muop.norm > tol) {
-                    // ops is of ConvolutionND, returns data for 1 term and all dimensions
-                    Q fac = ops[mu].getfac();
-                    muopxv_fast(at, muop.ops, *input, f0, r, r0, tol/std::abs(fac), fac,
-                                work1, work2);
+            if (batched() and NDIM>1) {
+                muopxv_batched(at, op, *input, f0, r, r0, tol, work1, work2);
+            }
+            else {
+                for (int mu=0; mu<rank; ++mu) {
+                    // SeparatedConvolutionInternal keeps data for 1 term and all dimensions and 1 displacement
+                    const SeparatedConvolutionInternal<Q,NDIM>& muop =  op->muops[mu];
+                    if (muop.norm > tol) {
+                        // ops is of ConvolutionND, returns data for 1 term and all dimensions
+                        Q fac = ops[mu].getfac();
+                        muopxv_fast(at, muop.ops, *input, f0, r, r0, tol/std::abs(fac), fac,
+                                    work1, work2);
+                    }
                 }
             }
 
@@ -44,7 +44,11 @@ namespace madness {
     template <typename Q, std::size_t NDIM>
     class SimpleCache {
     private:
+#ifdef MADNESS_RESIZABLE_HASHMAP
+        typedef ResizableHashMap< Key<NDIM>, Q > mapT;
+#else
         typedef ConcurrentHashMap< Key<NDIM>, Q > mapT;
+#endif
         typedef std::pair<Key<NDIM>, Q> pairT;
         mapT cache;
 
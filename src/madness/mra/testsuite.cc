@@ -220,6 +220,19 @@ int test_basic(World& world) {
     CHECK(err, 3*thresh, "err");
     CHECK(val-(*functor)(point), thresh, "error at a point");
 
+    std::vector<coordT> points(200);
+    for (std::size_t i=0; i<points.size(); ++i) {
+        for (std::size_t d=0; d<NDIM; ++d) {
+            points[i][d] = cell(d,0) + (cell(d,1)-cell(d,0))*RandomValue<double>();
+        }
+    }
+    std::vector<T> values = f.eval_many(points).get();
+    double evalerr = 0.0;
+    for (std::size_t i=0; i<points.size(); ++i) {
+        evalerr = std::max(evalerr, double(std::abs(values[i]-f.eval(points[i]).get())));
+    }
+    CHECK(evalerr, 1e-12, "eval_many");
+
     f.compress();
     double new_norm = f.norm2();
     CHECK(new_norm-norm, 1e-14, "new_norm");
@@ -770,6 +783,66 @@ int test_op(World& world) {
     return 1;
 }
 
+template <typename T, std::size_t NDIM>
+int test_apply_cache(World& world) {
+
+    if (world.rank() == 0) {
+        print("\nTest incremental apply - type =", archive::get_type_name<T>(),", ndim =",NDIM,"\n");
+    }
+
+    typedef Vector<double,NDIM> coordT;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
+
+    bool ok=true;
+    const double thresh=1.e-7;
+    FunctionDefaults<NDIM>::set_k(8);
+    FunctionDefaults<NDIM>::set_thresh(thresh);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+    FunctionDefaults<NDIM>::set_truncate_mode(1);
+    FunctionDefaults<NDIM>::set_cubic_cell(-10,10);
+
+    functorT g1(new Gaussian<T,NDIM>(coordT(-1.0), 100.0, 1.0));
+    functorT g2(new Gaussian<T,NDIM>(coordT(2.0), 100.0, 1.0));
+    functorT g3(new Gaussian<T,NDIM>(coordT(2.0), 100.0, 1.001));
+    Function<T,NDIM> f = FunctionFactory<T,NDIM>(world).functor(g1);
+    f += Function<T,NDIM>(FunctionFactory<T,NDIM>(world).functor(g2));
+    f.truncate();
+
+    Tensor<double> coeffs(1), exponents(1);
+    exponents(0L) = 10.0;
+    coeffs(0L) = pow(exponents(0L)/PI, 0.5*NDIM);
+    SeparatedConvolution<T,NDIM> op(world, coeffs, exponents);
+
+    // The first apply fills the cache, the second reuses all boxes
+    ApplyCache<T,NDIM> cache;
+    Function<T,NDIM> r = apply(op,f);
+    double err = (apply(op,f,cache) - r).norm2();
+    CHECK(err, thresh*1e-3, "first incremental apply");
+    CHECK(double(cache.get_nreused()), 0.5, "boxes reused on first apply");
+    err = (apply(op,f,cache) - r).norm2();
+    CHECK(err, thresh*1e-3, "unchanged incremental apply");
+    CHECK(1.0-cache.reuse_ratio(), 1e-12, "reuse ratio of unchanged function");
+
+    // Change one Gaussian slightly
+    Function<T,NDIM> g = FunctionFactory<T,NDIM>(world).functor(g1);
+    g += Function<T,NDIM>(FunctionFactory<T,NDIM>(world).functor(g3));
+    g.truncate();
+    r = apply(op,g);
+    err = (apply(op,g,cache) - r).norm2();
+    double ratio = cache.reuse_ratio();
+    if (world.rank() == 0) {
+        print("     reused", cache.get_nreused(), "applied", cache.get_napplied(), "ratio", ratio);
+        print("      error", err);
+    }
+    CHECK(err, 10*thresh, "changed incremental apply");
+    CHECK(ratio-0.5, 0.45, "reuse ratio of changed function");
+
+    world.gop.fence();
+    if (ok) return 0;
+    return 1;
+}
+
 /// Computes the electrostatic potential due to a Gaussian charge distribution
 class GaussianPotential : public FunctionFunctorInterface<double,3> {
 public:
@@ -896,6 +969,36 @@ int test_coulomb(World& world) {
     }
     CHECK(rerr, 10.0*thresh, "err in test_coulomb");
 
+    // Same again with the results aggregated by destination before sending
+    FunctionDefaults<3>::set_apply_aggregation_size(256*1024);
+    START_TIMER;
+    Function<double,3> ragg = apply_only(op,f);
+    END_TIMER("aggregated apply");
+    FunctionDefaults<3>::set_apply_aggregation_size(0);
+    ragg.reconstruct();
+    ragg.verify_tree();
+    double aggdiff = (ragg-r).norm2();
+    CHECK(aggdiff, thresh, "aggregated apply in test_coulomb");
+
+    // The batched last transformation must agree with the term-by-term one,
+    // for the Coulomb operator as well as for a BSH operator
+    op.batched() = false;
+    Function<double,3> runb = apply_only(op,f);
+    op.batched() = true;
+    runb.reconstruct();
+    double batchdiff = (runb-r).norm2();
+    CHECK(batchdiff, 1e-12, "batched coulomb in test_coulomb");
+
+    SeparatedConvolution<double,3> bsh = BSHOperator3D(world, 1.0, 1e-5, thresh);
+    Function<double,3> rbsh = apply_only(bsh,f);
+    bsh.batched() = false;
+    Function<double,3> rbshunb = apply_only(bsh,f);
+    rbsh.reconstruct();
+    rbshunb.reconstruct();
+    double bshdiff = (rbsh-rbshunb).norm2();
+    if (world.rank() == 0) print("  bsh*f norm is", rbsh.norm2());
+    CHECK(bshdiff, 1e-12, "batched bsh in test_coulomb");
+
     if (ok) return 0;
     return 1;
 }
@@ -1218,6 +1321,59 @@ int test_io(World& world) {
     if (world.rank() == 0) print("err = ", err);
     CHECK(err,1e-12,"test_io");
 
+    // the indexed format
+    archive::ParallelOutputArchive outi(world, "mary");
+    outi.set_indexed(true);
+    outi & f;
+    outi.close();
+
+    Function<T,NDIM> h;
+
+    archive::ParallelInputArchive ini(world, "mary");
+    ini & h;
+    ini.close();
+    ini.remove();
+
+    err = (h-f).norm2();
+
+    if (world.rank() == 0) print("err = ", err);
+    CHECK(err,1e-12,"test_io indexed");
+
+    // in the background; changing f must not change the snapshot
+    Future<bool> written = checkpoint(f, "mary");
+    f.scale(2.0);
+    if (!written.get()) ok = false;
+    world.gop.fence();
+
+    Function<T,NDIM> c;
+    archive::ParallelInputArchive inc(world, "mary");
+    inc & c;
+    inc.close();
+    inc.remove();
+
+    err = (c.scale(2.0)-f).norm2();
+
+    if (world.rank() == 0) print("err = ", err);
+    CHECK(err,1e-12,"test_io checkpoint");
+
+    // a second checkpoint of the same name waits for the first one
+    Future<bool> first = checkpoint(f, "mary");
+    f.scale(0.5);
+    Future<bool> second = checkpoint(f, "mary");
+    if (!first.get() || !second.get()) ok = false;
+    world.gop.fence();
+
+    Function<T,NDIM> d;
+    archive::ParallelInputArchive ind(world, "mary");
+    ind & d;
+    ind.close();
+    ind.remove();
+
+    err = (d-f).norm2();
+
+    if (world.rank() == 0) print("err = ", err);
+    CHECK(err,1e-12,"test_io repeated checkpoint");
+
     //    MADNESS_ASSERT(err == 0.0);
 
     if (world.rank() == 0) print("test_io OK");
@@ -1226,6 +1382,73 @@ int test_io(World& world) {
     return 1;
 }
 
+/// Visits keys down to level \c n in the order used by LBSFCPmap and checks owners never decrease
+template <std::size_t NDIM>
+bool check_sfc_order(const WorldDCPmapInterface< Key<NDIM> >& pmap, const Key<NDIM>& key, Level n, ProcessID& last) {
+    ProcessID p = pmap.owner(key);
+    if (p < last) return false;
+    last = p;
+    if (key.level() == n) return true;
+    for (int ind=0; ind<(1<<NDIM); ++ind) {
+        Vector<Translation,NDIM> l;
+        for (std::size_t d=0; d<NDIM; ++d) l[d] = 2*key.translation()[d] + ((ind>>d)&0x1);
+        if (!check_sfc_order(pmap, Key<NDIM>(key.level()+1,l), n, last)) return false;
+    }
+    return true;
+}
+
+template <typename T, std::size_t NDIM>
+int test_loadbal(World& world) {
+    bool ok = true;
+    typedef Vector<double,NDIM> coordT;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
+    typedef std::shared_ptr< WorldDCPmapInterface< Key<NDIM> > > pmapT;
+
+    if (world.rank() == 0)
+        print("Test space-filling-curve load balance, type =",archive::get_type_name<T>(),", ndim =",NDIM);
+
+    // Cuts for a pretend three-process run must give owners monotone along the curve
+    std::vector< Key<NDIM> > cuts;
+    cuts.push_back(Key<NDIM>(0));
+    cuts.push_back(Key<NDIM>(1, Vector<Translation,NDIM>(1)));
+    cuts.push_back(Key<NDIM>(2, Vector<Translation,NDIM>(3)));
+    LBSFCPmap<NDIM> fake(cuts);
+    ProcessID last = 0;
+    bool ordered = check_sfc_order(fake, Key<NDIM>(0), 4, last);
+    CHECK(ordered ? 0.0 : 1.0, 0.5, "curve order");
+    CHECK(double(last-2), 0.5, "last owner");
+    CHECK(double(fake.owner(Key<NDIM>(3, Vector<Translation,NDIM>(7)))-2), 0.5, "owner of last box");
+
+    FunctionDefaults<NDIM>::set_cubic_cell(-10.0,10.0);
+    FunctionDefaults<NDIM>::set_k(6);
+    FunctionDefaults<NDIM>::set_thresh(1e-6);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+
+    functorT functor(new Gaussian<T,NDIM>(coordT(0.5), 1.0, 1.0));
+    Function<T,NDIM> f = FunctionFactory<T,NDIM>(world).functor(functor);
+    double norm = f.norm2();
+
+    LoadBalanceDeux<NDIM> lb(world);
+    lb.add_tree(f, lbcost<T,NDIM>(), true);
+    pmapT oldpmap = FunctionDefaults<NDIM>::get_pmap();
+    pmapT pmap = lb.load_balance_sfc();
+
+    last = 0;
+    ordered = check_sfc_order(*pmap, Key<NDIM>(0), 3, last);
+    CHECK(ordered ? 0.0 : 1.0, 0.5, "curve order");
+
+    FunctionDefaults<NDIM>::redistribute(world, pmap);
+    CHECK(f.norm2()-norm, 1e-12, "norm after redistribute");
+    CHECK(f.err(*functor), 1e-5, "err after redistribute");
+    FunctionDefaults<NDIM>::redistribute(world, oldpmap);
+
+    world.gop.fence();
+    if (world.rank() == 0) print("space-filling-curve load balance OK",ok,"\n\n");
+    if (not ok) return 1;
+    return 0;
+}
+
 template <typename T, std::size_t NDIM>
 int test_apply_push_1d(World& world) {
     typedef Vector<double,NDIM> coordT;
@@ -1332,9 +1555,11 @@ int main(int argc, char**argv) {
         nfail+=test_math<double,1>(world);
         nfail+=test_diff<double,1>(world);
         nfail+=test_op<double,1>(world);
+        nfail+=test_apply_cache<double,1>(world);
         nfail+=test_plot<double,1>(world);
         nfail+=test_apply_push_1d<double,1>(world);
         nfail+=test_io<double,1>(world);
+        nfail+=test_loadbal<double,1>(world);
 
         // stupid location for this test
         GenericConvolution1D<double,GaussianGenericFunctor<double> > gen(10,GaussianGenericFunctor<double>(100.0,100.0),0);
@@ -1362,8 +1587,10 @@ int main(int argc, char**argv) {
         nfail+=test_math<double,2>(world);
         nfail+=test_diff<double,2>(world);
         nfail+=test_op<double,2>(world);
+        nfail+=test_apply_cache<double,2>(world);
         nfail+=test_plot<double,2>(world);
         nfail+=test_io<double,2>(world);
+        nfail+=test_loadbal<double,2>(world);
 
         nfail+=test_basic<double,3>(world);
         nfail+=test_conv<double,3>(world);
@@ -1373,6 +1600,7 @@ int main(int argc, char**argv) {
         nfail+=test_coulomb(world);
         nfail+=test_plot<double,3>(world);
         nfail+=test_io<double,3>(world);
+        nfail+=test_loadbal<double,3>(world);
 
         test_plot<double,4>(world); // slow unless reduce npt in test_plot
 
@@ -136,8 +136,17 @@ void test_inner(World& world) {
     Tensor<TENSOR_RESULT_TYPE(T,R)> rold = matrix_inner_old(world,left,*pright,sym);
     END_TIMER("old");
 
+    const double err = (rold-rnew).normf();
     if (world.rank() == 0) 
-        print("error norm",(rold-rnew).normf(),"\n");
+        print("error norm",err,"\n");
+    MADNESS_ASSERT(err < 1e-10);
+
+    // An empty vector on either side gives an empty matrix
+    if (!sym) {
+        std::vector< Function<R,NDIM> > none;
+        Tensor<TENSOR_RESULT_TYPE(T,R)> rempty = matrix_inner(world,left,none);
+        MADNESS_ASSERT(rempty.dim(0) == nleft && rempty.dim(1) == 0);
+    }
 }
 
 template <std::size_t NDIM>
@@ -172,6 +181,9 @@ void test_multi_to_multi_op(World& world) {
 
     vecfuncT vout=multi_to_multi_op_values(op, vin);
 
+    // batches of a few boxes must give the same result as one box at a time
+    vecfuncT vbatch=multi_to_multi_op_values_batched(op, vin, 3*power<NDIM>(8));
+
     std::vector<functionT> result(2);
     result[0]=2.0*vin[0]-vout[0];
     result[1]=vout[1]-vin[1]-vin[2];
@@ -181,6 +193,115 @@ void test_multi_to_multi_op(World& world) {
     double error=norm2(world,result);
     if (world.rank()==0) print("error in multi_to_multi ",error,norm_in,norm_out);
 
+    double batch_error=norm2(world,sub(world,vout,vbatch));
+    if (world.rank()==0) print("error in batched multi_to_multi ",batch_error);
+    MADNESS_ASSERT(batch_error<1.e-12);
+}
+
+void test_scoped(World& world) {
+    typedef Function<double,3> functionT;
+    typedef std::vector<functionT> vecfuncT;
+    typedef std::shared_ptr< FunctionFunctorInterface<double,3> > ffunctorT;
+
+    const double thresh=1.e-5;
+    FunctionDefaults<3>::set_cubic_cell(-10.0,10.0);
+    FunctionDefaults<3>::set_k(6);
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_refine(true);
+    FunctionDefaults<3>::set_initial_level(2);
+    FunctionDefaults<3>::set_truncate_mode(1);
+
+    vecfuncT f(4), g(4);
+    for (int i=0; i<4; ++i) {
+        ffunctorT ff(RandomGaussian<double,3>(FunctionDefaults<3>::get_cell(),10.0));
+        f[i] = FunctionFactory<double,3>(world).functor(ff);
+        ffunctorT gg(RandomGaussian<double,3>(FunctionDefaults<3>::get_cell(),10.0));
+        g[i] = FunctionFactory<double,3>(world).functor(gg);
+    }
+    SeparatedConvolution<double,3> op = CoulombOperator(world, 1.e-3, thresh);
+
+    // Reference results with global fences
+    vecfuncT rf = apply(world, op, f);
+    vecfuncT tg = copy(world, g);
+    truncate(world, tg, 10.0*thresh);
+    reconstruct(world, tg);
+
+    // Truncate g and apply to f in two scopes.  Neither call waits, so
+    // both have stages left when they return, and waiting on the apply
+    // leaves the truncation of g pending.
+    CompletionScope sg(world), sf(world);
+    truncate(world, g, 10.0*thresh, sg);
+    vecfuncT rs = apply(world, op, f, sf);
+    MADNESS_ASSERT(sg.nstep() > 0 && sf.nstep() > 0);
+    sf.wait();
+    MADNESS_ASSERT(sf.nstep() == 0 && sg.nstep() > 0);
+    sg.wait();
+    reconstruct(world, g, sg);
+    sg.wait();
+
+    double err_apply=norm2(world,sub(world,rf,rs));
+    double err_truncate=norm2(world,sub(world,tg,g));
+    if (world.rank()==0) print("error in scoped apply and truncate",err_apply,err_truncate);
+    MADNESS_ASSERT(err_apply < thresh && err_truncate < thresh);
+}
+
+template <typename T, typename R, std::size_t NDIM>
+void test_mul_pairs(World& world) {
+    typedef TENSOR_RESULT_TYPE(T,R) resultT;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > ffunctorT;
+    typedef std::shared_ptr< FunctionFunctorInterface<R,NDIM> > gfunctorT;
+
+    const double thresh=1.e-5;
+    FunctionDefaults<NDIM>::set_cubic_cell(-10.0,10.0);
+    FunctionDefaults<NDIM>::set_k(6);
+    FunctionDefaults<NDIM>::set_thresh(thresh);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+    FunctionDefaults<NDIM>::set_truncate_mode(1);
+
+    if (world.rank() == 0)
+        print("testing mul_pairs<",archive::get_type_name<T>(),",",archive::get_type_name<R>(),">",NDIM);
+
+    const int na=4, nb=3;
+    std::vector< Function<T,NDIM> > a(na);
+    std::vector< Function<R,NDIM> > b(nb);
+    for (int i=0; i<na; ++i) {
+        ffunctorT f(RandomGaussian<T,NDIM>(FunctionDefaults<NDIM>::get_cell(),10.0));
+        a[i] = FunctionFactory<T,NDIM>(world).functor(f);
+    }
+    for (int j=0; j<nb; ++j) {
+        gfunctorT g(RandomGaussian<R,NDIM>(FunctionDefaults<NDIM>::get_cell(),10.0));
+        b[j] = FunctionFactory<R,NDIM>(world).functor(g);
+    }
+
+    // Reference products one left function at a time
+    std::vector< Function<resultT,NDIM> > ref;
+    for (int i=0; i<na; ++i) {
+        std::vector< Function<resultT,NDIM> > row = mul(world, a[i], b);
+        ref.insert(ref.end(), row.begin(), row.end());
+    }
+
+    std::vector< Function<resultT,NDIM> > exact = mul_outer(world, a, b, 0.0);
+    double err_exact = norm2(world, sub(world, ref, exact));
+    std::vector< Function<resultT,NDIM> > sparse = mul_outer(world, a, b, thresh);
+    double err_sparse = norm2(world, sub(world, ref, sparse));
+
+    // Lower triangle of a*a as the exchange operator needs it
+    std::vector< std::pair<int,int> > pairs;
+    std::vector< Function<T,NDIM> > tri_ref;
+    for (int i=0; i<na; ++i) {
+        for (int j=0; j<=i; ++j) {
+            pairs.push_back(std::make_pair(i,j));
+            tri_ref.push_back(mul(a[i], a[j], false));
+        }
+    }
+    world.gop.fence();
+    std::vector< Function<T,NDIM> > tri = mul_pairs(world, a, a, pairs, thresh);
+    double err_tri = norm2(world, sub(world, tri_ref, tri));
+
+    // Screening drops products below the truncation threshold in each box
+    if (world.rank()==0) print("error in mul_pairs",err_exact,err_sparse,err_tri);
+    MADNESS_ASSERT(err_exact < 1e-12 && err_sparse < 10*thresh && err_tri < 10*thresh);
 }
 
 int main(int argc, char**argv) {
@@ -195,11 +316,15 @@ int main(int argc, char**argv) {
         test_multi_to_multi_op<1>(world);
         test_multi_to_multi_op<2>(world);
         test_multi_to_multi_op<3>(world);
+        test_scoped(world);
+        test_mul_pairs<double,double,1>(world);
+        test_mul_pairs<double,double,3>(world);
 #if !HAVE_GENTENSOR
         test_inner<double,std::complex<double>,1,false>(world);
         test_inner<std::complex<double>,double,1,false>(world);
         test_inner<std::complex<double>,std::complex<double>,1,false>(world);
         test_inner<std::complex<double>,std::complex<double>,1,true>(world);
+        test_mul_pairs<double,std::complex<double>,2>(world);
 #endif
     }
     catch (const SafeMPI::Exception& e) {
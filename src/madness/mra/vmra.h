@@ -100,6 +100,7 @@
 	*) sub
 	*) mul
 	   - mul_sparse
+	   - mul_pairs, mul_outer
 	*) square
 	*) gaxpy
 	*) apply
@@ -164,6 +165,31 @@ namespace madness {
         if (fence && must_fence) world.gop.fence();
     }
 
+    /// Compress a vector of functions within a completion scope
+
+    /// Does not fence; the functions are compressed once \c scope.wait()
+    /// has returned, while other work may still be running.
+    template <typename T, std::size_t NDIM>
+    void compress(World& world,
+                  const std::vector< Function<T,NDIM> >& v,
+                  CompletionScope& scope) {
+        CompletionScope::Guard guard(scope);
+        compress(world, v, false);
+    }
+
+
+    /// Reconstruct a vector of functions within a completion scope
+
+    /// Does not fence; the functions are reconstructed once \c scope.wait()
+    /// has returned, while other work may still be running.
+    template <typename T, std::size_t NDIM>
+    void reconstruct(World& world,
+                     const std::vector< Function<T,NDIM> >& v,
+                     CompletionScope& scope) {
+        CompletionScope::Guard guard(scope);
+        reconstruct(world, v, false);
+    }
+
     /// refine the functions according to the autorefine criteria
     template <typename T, std::size_t NDIM>
     void refine(World& world, const std::vector<Function<T,NDIM> >& vf,
@@ -245,6 +271,28 @@ namespace madness {
         if (fence) world.gop.fence();
     }
 
+    /// Truncates a vector of functions within a completion scope
+
+    /// Does not wait; the truncation is a step of \c scope that runs once
+    /// the compression is done, and the functions are truncated once
+    /// \c scope.wait() has returned.  \c v must live until then.
+    template <typename T, std::size_t NDIM>
+    void truncate(World& world,
+                  std::vector< Function<T,NDIM> >& v,
+                  double tol,
+                  CompletionScope& scope) {
+        PROFILE_BLOCK(Vtruncate);
+
+        compress(world, v, scope);
+
+        std::vector< Function<T,NDIM> >* pv = &v;
+        scope.then([pv, tol] () {
+            for (unsigned int i=0; i<pv->size(); ++i) {
+                (*pv)[i].truncate(tol, false);
+            }
+        });
+    }
+
     /// Truncates a vector of functions
 
     /// @return the truncated vector for chaining
@@ -665,6 +713,50 @@ namespace madness {
         return vmulXX(a, v, tol, fence);
     }
 
+    /// Multiplies pairs of functions from two vectors --- q[p] = a[pairs[p].first] * b[pairs[p].second]
+
+    /// All products are formed in one traversal of the union of the trees.
+    /// At each box the coefficients of every function involved are turned
+    /// into values with one matrix product per dimension, so a function
+    /// that appears in many pairs is transformed once.  Pairs whose
+    /// norm_tree estimate at a box is below tol are screened there.
+    template <typename T, typename R, std::size_t NDIM>
+    std::vector< Function<TENSOR_RESULT_TYPE(T,R), NDIM> >
+    mul_pairs(World& world,
+              const std::vector< Function<T,NDIM> >& a,
+              const std::vector< Function<R,NDIM> >& b,
+              const std::vector< std::pair<int,int> >& pairs,
+              double tol,
+              bool fence=true) {
+        PROFILE_BLOCK(Vmulpairs);
+        const bool same = (static_cast<const void*>(&a) == static_cast<const void*>(&b));
+        reconstruct(world, a, true);
+        if (!same) reconstruct(world, b, true);
+        if (tol) {
+            norm_tree(world, a, true);
+            if (!same) norm_tree(world, b, true);
+        }
+        return vmulXXpairs(a, b, pairs, tol, fence);
+    }
+
+    /// Multiplies every function of a against every function of b --- q[i*b.size()+j] = a[i] * b[j]
+
+    /// See mul_pairs().
+    template <typename T, typename R, std::size_t NDIM>
+    std::vector< Function<TENSOR_RESULT_TYPE(T,R), NDIM> >
+    mul_outer(World& world,
+              const std::vector< Function<T,NDIM> >& a,
+              const std::vector< Function<R,NDIM> >& b,
+              double tol,
+              bool fence=true) {
+        std::vector< std::pair<int,int> > pairs;
+        pairs.reserve(a.size()*b.size());
+        for (unsigned int i=0; i<a.size(); ++i)
+            for (unsigned int j=0; j<b.size(); ++j)
+                pairs.push_back(std::make_pair(int(i),int(j)));
+        return mul_pairs(world, a, b, pairs, tol, fence);
+    }
+
     /// Makes the norm tree for all functions in a vector
     template <typename T, std::size_t NDIM>
     void norm_tree(World& world,
@@ -948,6 +1040,49 @@ namespace madness {
         return result;
     }
 
+    /// Applies an operator to a vector of functions within a completion scope --- q[i] = apply(op,f[i])
+
+    /// Does not wait; the stages that depend on each other are steps of
+    /// \c scope, so work outside the scope keeps running.  The result
+    /// functions are made at once and hold the reconstructed result once
+    /// \c scope.wait() has returned.  \c op must live until then.
+    template <typename T, typename R, std::size_t NDIM>
+    std::vector< Function<TENSOR_RESULT_TYPE(T,R), NDIM> >
+    apply(World& world,
+          const SeparatedConvolution<T,NDIM>& op,
+          const std::vector< Function<R,NDIM> > f,
+          CompletionScope& scope) {
+        PROFILE_BLOCK(Vapply);
+        MADNESS_ASSERT(not op.is_slaterf12);
+        MADNESS_ASSERT(NDIM <= 3);   // higher dimensions fence in apply_only
+
+        typedef std::vector< Function<TENSOR_RESULT_TYPE(T,R), NDIM> > resultT;
+
+        reconstruct(world, f, scope);
+
+        // The functions share their impls with the caller's, so these
+        // copies see every stage
+        std::vector< Function<R,NDIM> > ncf = f;
+        resultT result(f.size());
+        for (unsigned int i=0; i<f.size(); ++i) result[i].set_impl(f[i], false);
+
+        const SeparatedConvolution<T,NDIM>* pop = &op;
+        scope.then([ncf] () mutable {
+            for (unsigned int i=0; i<ncf.size(); ++i) ncf[i].nonstandard(false,false);
+        });
+        scope.then([pop, ncf, result] () {
+            for (unsigned int i=0; i<ncf.size(); ++i) {
+                result[i].get_impl()->apply(*pop, *ncf[i].get_impl(), false);
+            }
+        });
+        scope.then([world_ptr=&world, ncf, result] () mutable {
+            standard(*world_ptr, ncf, false);  // restores promise of logical constness
+            reconstruct(*world_ptr, result, false);
+        });
+
+        return result;
+    }
+
     /// Normalizes a vector of functions --- v[i] = v[i].scale(1.0/v[i].norm2())
     template <typename T, std::size_t NDIM>
     void normalize(World& world, std::vector< Function<T,NDIM> >& v, bool fence=true) {
@@ -1017,6 +1152,29 @@ namespace madness {
         return vout;
     }
 
+    /// apply a pointwise op on the input vector yielding an output vector of functions
+
+    /// op is called on batches of about batchsize points gathered from many boxes
+    /// instead of once per box; it must act pointwise and ignore the key.
+    /// @param[in]  op   the pointwise operator working on vin
+    /// @param[in]  vin  vector of input Functions; needs to be refined to common level!
+    /// @param[in]  batchsize approximate number of points per call to op
+    /// @return vector of output Functions vout = op(vin)
+    template <typename T, typename opT, std::size_t NDIM>
+    std::vector<Function<T,NDIM> > multi_to_multi_op_values_batched(const opT& op,
+            const std::vector< Function<T,NDIM> >& vin,
+            const long batchsize=32768, const bool fence=true) {
+        MADNESS_ASSERT(vin.size()>0);
+        MADNESS_ASSERT(vin[0].is_initialized()); // might be changed
+        World& world=vin[0].world();
+        Function<T,NDIM> dummy;
+        dummy.set_impl(vin[0], false);
+        std::vector<Function<T,NDIM> > vout=zero_functions<T,NDIM>(world, op.get_result_size());
+        for (auto& out : vout) out.set_impl(vin[0],false);
+        dummy.multi_to_multi_op_values_batched(op, vin, vout, batchsize, fence);
+        return vout;
+    }
+
 
 
 
@@ -1143,18 +1301,40 @@ namespace madness {
     }
 
     /// save a vector of functions
+
+    /// @param[in] indexed  write the indexed format (see ParallelOutputArchive::set_indexed),
+    ///                     which any number of processes can read back
     template<typename T, size_t NDIM>
-    void save_function(const std::vector<Function<T,NDIM> >& f, const std::string name) {
+    void save_function(const std::vector<Function<T,NDIM> >& f, const std::string name,
+            bool indexed=false) {
         if (f.size()>0) {
             World& world=f.front().world();
             if (world.rank()==0) print("saving vector of functions",name);
             archive::ParallelOutputArchive ar(world, name.c_str(), 1);
+            ar.set_indexed(indexed);
             std::size_t fsize=f.size();
             ar & fsize;
             for (std::size_t i=0; i<fsize; ++i) ar & f[i];
         }
     }
 
+    /// save a vector of functions in the background, see checkpoint
+
+    /// @return a future that is set to true once the data of this process is on disk
+    template<typename T, size_t NDIM>
+    Future<bool> checkpoint_function(const std::vector<Function<T,NDIM> >& f,
+            const std::string name) {
+        if (f.size()==0) return Future<bool>(true);
+        World& world=f.front().world();
+        archive::ParallelOutputArchive ar(world, name.c_str(), 1);
+        ar.set_async(true);
+        ar.set_dofence(false);
+        std::size_t fsize=f.size();
+        ar & fsize;
+        for (std::size_t i=0; i<fsize; ++i) ar & f[i];
+        return ar.close_async();
+    }
+
 
 }
 #endif // MADNESS_MRA_VMRA_H__INCLUDED
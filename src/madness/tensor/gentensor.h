@@ -252,17 +252,11 @@ namespace madness {
 
 
 	namespace archive {
-	/// Serialize a tensor
+	/// Serialize a tensor ... same format as Tensor, including the compact form of active messages
 	template <class Archive, typename T>
 	struct ArchiveStoreImpl< Archive, GenTensor<T> > {
 		static void store(const Archive& s, const GenTensor<T>& t) {
-			if (t.iscontiguous()) {
-				s & t.size() & t.id();
-				if (t.size()) s & t.ndim() & wrap(t.dims(),TENSOR_MAXDIM) & wrap(t.ptr(),t.size());
-			}
-			else {
-				s & copy(t);
-			}
+			ArchiveStoreImpl< Archive, Tensor<T> >::store(s, t);
 		};
 	};
 
@@ -271,19 +265,9 @@ namespace madness {
 	template <class Archive, typename T>
 	struct ArchiveLoadImpl< Archive, GenTensor<T> > {
 		static void load(const Archive& s, GenTensor<T>& t) {
-			long sz = 0l, id =0l;
-			s & sz & id;
-			if (id != t.id()) throw "type mismatch deserializing a tensor";
-			if (sz) {
-				long _ndim=0l, _dim[TENSOR_MAXDIM];
-				s & _ndim & wrap(_dim,TENSOR_MAXDIM);
-				t = Tensor<T>(_ndim, _dim, false);
-				if (sz != t.size()) throw "size mismatch deserializing a tensor";
-				s & wrap(t.ptr(), t.size());
-			}
-			else {
-				t = Tensor<T>();
-			}
+			Tensor<T> tt;
+			ArchiveLoadImpl< Archive, Tensor<T> >::load(s, tt);
+			t = tt;
 		};
 	};
 
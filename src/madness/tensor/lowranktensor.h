@@ -881,8 +881,10 @@ namespace archive {
             int i=int(t.type);
             ar & exist & i;
             if (exist) {
-                if (t.impl.svd) ar & *t.impl.svd.get();
                 if (t.impl.full) ar & *t.impl.full.get();
+                // an error in the factors is not bounded by the tolerance, so send them exactly
+                TensorWire::Tolerance lossless(0.0);
+                if (t.impl.svd) ar & *t.impl.svd.get();
                 if (t.impl.tt) ar & *t.impl.tt.get();
             }
         };
@@ -0,0 +1,457 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/mtxmq_simd.cc
+/// \brief Register-blocked mTxmq kernels with runtime CPU dispatch
+
+// Used when MADNESS is built without MKL.  Computes
+//
+//    c(i,j) = sum(k) a(k,i)*b(k,j)   with a(dimk,dimi), b(dimk,ldb), c(dimi,dimj)
+//
+// The operands are the small blocks of the MRA (dimk and dimj are k or
+// 2k, dimi is a power of these) so the kernels keep a 4 x (2 vector)
+// block of c in registers for the whole k loop, mask the partial
+// vector at the end of each row of c, and never pack or copy a or b.
+//
+// There are three double precision kernels: generic C++ (relying on the
+// compiler to vectorize at the baseline ISA), AVX2+FMA and AVX-512F.
+// The latter two are compiled with function target attributes so that
+// the library does not need to be built with -mavx2 to use them.  The
+// kernel is chosen on first use from the CPU features; the environment
+// variable MAD_MTXMQ_KERNEL (reference, generic, avx2 or avx512)
+// overrides the choice.
+//
+// The complex cases are all mapped onto the real kernel:
+//
+//  - real a, complex b: b and c are reinterpreted as real arrays with
+//    twice the number of columns (exact, no copies).
+//  - complex a, real b: a is reinterpreted as a real array with twice
+//    the number of columns (re, im interleaved), which gives the real
+//    and imaginary parts of c directly.
+//  - complex a, complex b: one real product of twice the size in both
+//    i and j is formed in blocks of rows and then combined
+//    (re = D(re,re) - D(im,im), im = D(re,im) + D(im,re)).
+
+#include <madness/madness_config.h>
+#include <madness/world/madness_exception.h>
+#include <madness/tensor/mxm.h>
+
+#include <algorithm>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(X86_64) && (defined(__GNUC__) || defined(__clang__)) && !defined(__INTEL_COMPILER)
+#define MADNESS_MTXMQ_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace madness {
+
+    namespace {
+
+        /// Signature of the real kernels: c(i,j) = sum(k) a(k*lda+i)*b(k*ldb+j), c dense with ldc
+        typedef void (*mtxmq_kernelT)(long dimi, long dimj, long dimk,
+                                      double* MADNESS_RESTRICT c, long ldc,
+                                      const double* a, long lda,
+                                      const double* b, long ldb);
+
+        // ------------------------------------------------------------------
+        // Reference ... the scalar loop from mxm.h with explicit strides
+        // ------------------------------------------------------------------
+
+        void mtxmq_reference(long dimi, long dimj, long dimk,
+                             double* MADNESS_RESTRICT c, long ldc,
+                             const double* a, long lda,
+                             const double* b, long ldb) {
+            for (long i=0; i<dimi; ++i, c+=ldc, ++a) {
+                for (long j=0; j<dimj; ++j) c[j] = 0.0;
+                const double* ak = a;
+                const double* bk = b;
+                for (long k=0; k<dimk; ++k, ak+=lda, bk+=ldb) {
+                    const double aki = *ak;
+                    for (long j=0; j<dimj; ++j) c[j] += aki*bk[j];
+                }
+            }
+        }
+
+        // ------------------------------------------------------------------
+        // Generic ... register blocked C++
+        // ------------------------------------------------------------------
+
+        template <int NI, int NJ>
+        inline void generic_block(long nj, long dimk,
+                                  double* MADNESS_RESTRICT c, long ldc,
+                                  const double* a, long lda,
+                                  const double* b, long ldb) {
+            double s[NI][NJ];
+            for (int r=0; r<NI; ++r)
+                for (int q=0; q<NJ; ++q) s[r][q] = 0.0;
+
+            if (nj == NJ) {
+                for (long k=0; k<dimk; ++k, a+=lda, b+=ldb) {
+                    for (int r=0; r<NI; ++r) {
+                        const double ar = a[r];
+                        for (int q=0; q<NJ; ++q) s[r][q] += ar*b[q];
+                    }
+                }
+            }
+            else {
+                for (long k=0; k<dimk; ++k, a+=lda, b+=ldb) {
+                    for (int r=0; r<NI; ++r) {
+                        const double ar = a[r];
+                        for (int q=0; q<nj; ++q) s[r][q] += ar*b[q];
+                    }
+                }
+            }
+
+            for (int r=0; r<NI; ++r)
+                for (int q=0; q<nj; ++q) c[r*ldc+q] = s[r][q];
+        }
+
+        template <int NI>
+        inline void generic_rows(long dimj, long dimk,
+                                 double* MADNESS_RESTRICT c, long ldc,
+                                 const double* a, long lda,
+                                 const double* b, long ldb) {
+            const long NJ = 8;
+            for (long j=0; j<dimj; j+=NJ) {
+                generic_block<NI,NJ>(std::min(NJ,dimj-j), dimk, c+j, ldc, a, lda, b+j, ldb);
+            }
+        }
+
+        void mtxmq_generic(long dimi, long dimj, long dimk,
+                           double* MADNESS_RESTRICT c, long ldc,
+                           const double* a, long lda,
+                           const double* b, long ldb) {
+            long i=0;
+            for (; i+4<=dimi; i+=4) generic_rows<4>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb);
+            switch (dimi-i) {
+            case 3: generic_rows<3>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb); break;
+            case 2: generic_rows<2>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb); break;
+            case 1: generic_rows<1>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb); break;
+            }
+        }
+
+#ifdef MADNESS_MTXMQ_HAVE_X86
+
+        // ------------------------------------------------------------------
+        // AVX2 + FMA ... 4 rows x 2 vectors of 4 = 8 accumulators
+        // ------------------------------------------------------------------
+
+        __attribute__((target("avx2,fma")))
+        inline __m256i avx2_mask(long n) {
+            return _mm256_set_epi64x(n>3 ? -1 : 0, n>2 ? -1 : 0, n>1 ? -1 : 0, n>0 ? -1 : 0);
+        }
+
+        template <int NI, int NV>
+        __attribute__((target("avx2,fma"), always_inline))
+        inline void avx2_block(long nj, long dimk,
+                               double* MADNESS_RESTRICT c, long ldc,
+                               const double* a, long lda,
+                               const double* b, long ldb) {
+            __m256d s[NI][NV];
+            for (int r=0; r<NI; ++r)
+                for (int v=0; v<NV; ++v) s[r][v] = _mm256_setzero_pd();
+
+            if (nj == 4*NV) {
+                for (long k=0; k<dimk; ++k, a+=lda, b+=ldb) {
+                    __m256d bv[NV];
+                    for (int v=0; v<NV; ++v) bv[v] = _mm256_loadu_pd(b+4*v);
+                    for (int r=0; r<NI; ++r) {
+                        const __m256d ar = _mm256_broadcast_sd(a+r);
+                        for (int v=0; v<NV; ++v) s[r][v] = _mm256_fmadd_pd(ar, bv[v], s[r][v]);
+                    }
+                }
+                for (int r=0; r<NI; ++r)
+                    for (int v=0; v<NV; ++v) _mm256_storeu_pd(c+r*ldc+4*v, s[r][v]);
+            }
+            else {
+                __m256i mask[NV];
+                for (int v=0; v<NV; ++v) mask[v] = avx2_mask(nj-4*v);
+                for (long k=0; k<dimk; ++k, a+=lda, b+=ldb) {
+                    __m256d bv[NV];
+                    for (int v=0; v<NV; ++v) bv[v] = _mm256_maskload_pd(b+4*v, mask[v]);
+                    for (int r=0; r<NI; ++r) {
+                        const __m256d ar = _mm256_broadcast_sd(a+r);
+                        for (int v=0; v<NV; ++v) s[r][v] = _mm256_fmadd_pd(ar, bv[v], s[r][v]);
+                    }
+                }
+                for (int r=0; r<NI; ++r)
+                    for (int v=0; v<NV; ++v) _mm256_maskstore_pd(c+r*ldc+4*v, mask[v], s[r][v]);
+            }
+        }
+
+        template <int NI>
+        __attribute__((target("avx2,fma")))
+        void avx2_rows(long dimj, long dimk,
+                       double* MADNESS_RESTRICT c, long ldc,
+                       const double* a, long lda,
+                       const double* b, long ldb) {
+            for (long j=0; j<dimj; j+=8) {
+                const long nj = std::min(8L, dimj-j);
+                if (nj > 4) avx2_block<NI,2>(nj, dimk, c+j, ldc, a, lda, b+j, ldb);
+                else        avx2_block<NI,1>(nj, dimk, c+j, ldc, a, lda, b+j, ldb);
+            }
+        }
+
+        __attribute__((target("avx2,fma")))
+        void mtxmq_avx2(long dimi, long dimj, long dimk,
+                        double* MADNESS_RESTRICT c, long ldc,
+                        const double* a, long lda,
+                        const double* b, long ldb) {
+            long i=0;
+            for (; i+4<=dimi; i+=4) avx2_rows<4>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb);
+            switch (dimi-i) {
+            case 3: avx2_rows<3>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb); break;
+            case 2: avx2_rows<2>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb); break;
+            case 1: avx2_rows<1>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb); break;
+            }
+        }
+
+        // ------------------------------------------------------------------
+        // AVX-512F ... 4 rows x 2 vectors of 8 = 8 accumulators
+        // ------------------------------------------------------------------
+
+        template <int NI, int NV>
+        __attribute__((target("avx512f"), always_inline))
+        inline void avx512_block(long nj, long dimk,
+                                 double* MADNESS_RESTRICT c, long ldc,
+                                 const double* a, long lda,
+                                 const double* b, long ldb) {
+            __m512d s[NI][NV];
+            __mmask8 mask[NV];
+            for (int v=0; v<NV; ++v) {
+                const long n = nj - 8*v;
+                mask[v] = (n >= 8) ? __mmask8(0xff) : __mmask8((1u<<n)-1);
+            }
+            for (int r=0; r<NI; ++r)
+                for (int v=0; v<NV; ++v) s[r][v] = _mm512_setzero_pd();
+
+            for (long k=0; k<dimk; ++k, a+=lda, b+=ldb) {
+                __m512d bv[NV];
+                for (int v=0; v<NV; ++v) bv[v] = _mm512_maskz_loadu_pd(mask[v], b+8*v);
+                for (int r=0; r<NI; ++r) {
+                    const __m512d ar = _mm512_set1_pd(a[r]);
+                    for (int v=0; v<NV; ++v) s[r][v] = _mm512_fmadd_pd(ar, bv[v], s[r][v]);
+                }
+            }
+            for (int r=0; r<NI; ++r)
+                for (int v=0; v<NV; ++v) _mm512_mask_storeu_pd(c+r*ldc+8*v, mask[v], s[r][v]);
+        }
+
+        template <int NI>
+        __attribute__((target("avx512f")))
+        void avx512_rows(long dimj, long dimk,
+                         double* MADNESS_RESTRICT c, long ldc,
+                         const double* a, long lda,
+                         const double* b, long ldb) {
+            for (long j=0; j<dimj; j+=16) {
+                const long nj = std::min(16L, dimj-j);
+                if (nj > 8) avx512_block<NI,2>(nj, dimk, c+j, ldc, a, lda, b+j, ldb);
+                else        avx512_block<NI,1>(nj, dimk, c+j, ldc, a, lda, b+j, ldb);
+            }
+        }
+
+        __attribute__((target("avx512f")))
+        void mtxmq_avx512(long dimi, long dimj, long dimk,
+                          double* MADNESS_RESTRICT c, long ldc,
+                          const double* a, long lda,
+                          const double* b, long ldb) {
+            long i=0;
+            for (; i+4<=dimi; i+=4) avx512_rows<4>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb);
+            switch (dimi-i) {
+            case 3: avx512_rows<3>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb); break;
+            case 2: avx512_rows<2>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb); break;
+            case 1: avx512_rows<1>(dimj, dimk, c+i*ldc, ldc, a+i, lda, b, ldb); break;
+            }
+        }
+
+#endif // MADNESS_MTXMQ_HAVE_X86
+
+        // ------------------------------------------------------------------
+        // Dispatch
+        // ------------------------------------------------------------------
+
+        struct KernelEntry {
+            const char* name;
+            mtxmq_kernelT kernel;
+        };
+
+        const KernelEntry kernels[] = {
+            {"reference", &mtxmq_reference},
+            {"generic", &mtxmq_generic},
+#ifdef MADNESS_MTXMQ_HAVE_X86
+            {"avx2", &mtxmq_avx2},
+            {"avx512", &mtxmq_avx512},
+#endif
+        };
+        const int nkernels = sizeof(kernels)/sizeof(KernelEntry);
+
+        bool kernel_supported(int i) {
+#ifdef MADNESS_MTXMQ_HAVE_X86
+            const std::string name = kernels[i].name;
+            if (name == "avx2") return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            if (name == "avx512") return __builtin_cpu_supports("avx512f");
+#endif
+            return i < nkernels;
+        }
+
+        int find_kernel(const char* name) {
+            for (int i=0; i<nkernels; ++i) {
+                if (std::strcmp(name, kernels[i].name) == 0) return i;
+            }
+            return -1;
+        }
+
+        /// Index of the default kernel ... the best the CPU supports unless overridden by MAD_MTXMQ_KERNEL
+        int default_kernel() {
+            const char* env = std::getenv("MAD_MTXMQ_KERNEL");
+            if (env) {
+                const int i = find_kernel(env);
+                if (i >= 0 && kernel_supported(i)) return i;
+                std::cerr << "MAD_MTXMQ_KERNEL=" << env
+                          << " is not available on this machine ... using the default\n";
+            }
+            int best = find_kernel("generic");
+            for (int i=0; i<nkernels; ++i) {
+                if (kernel_supported(i) && i > best) best = i; // Table is ordered by preference
+            }
+            return best;
+        }
+
+        int& current_kernel() {
+            static int kernel = default_kernel();
+            return kernel;
+        }
+
+        inline mtxmq_kernelT kernel() {
+            return kernels[current_kernel()].kernel;
+        }
+
+        /// Rows of c formed per pass of the complex*complex case (bounds the stack buffer)
+        const long ZBUF = 4096;
+
+    } // namespace
+
+
+    const char* mTxmq_kernel_name() {
+        return kernels[current_kernel()].name;
+    }
+
+    bool set_mTxmq_kernel(const char* name) {
+        const int i = find_kernel(name);
+        if (i < 0 || !kernel_supported(i)) return false;
+        current_kernel() = i;
+        return true;
+    }
+
+    std::vector<std::string> mTxmq_available_kernels() {
+        std::vector<std::string> names;
+        for (int i=0; i<nkernels; ++i) {
+            if (kernel_supported(i)) names.push_back(kernels[i].name);
+        }
+        return names;
+    }
+
+    void mTxmq_kernel(long dimi, long dimj, long dimk,
+                      double* MADNESS_RESTRICT c, const double* a, const double* b, long ldb) {
+        if (ldb == -1) ldb = dimj;
+        MADNESS_ASSERT(ldb >= dimj);
+        kernel()(dimi, dimj, dimk, c, dimj, a, dimi, b, ldb);
+    }
+
+    void mTxmq_kernel(long dimi, long dimj, long dimk,
+                      std::complex<double>* MADNESS_RESTRICT c, const double* a,
+                      const std::complex<double>* b, long ldb) {
+        if (ldb == -1) ldb = dimj;
+        MADNESS_ASSERT(ldb >= dimj);
+        kernel()(dimi, 2*dimj, dimk, reinterpret_cast<double*>(c), 2*dimj,
+                 a, dimi, reinterpret_cast<const double*>(b), 2*ldb);
+    }
+
+    void mTxmq_kernel(long dimi, long dimj, long dimk,
+                      std::complex<double>* MADNESS_RESTRICT c, const std::complex<double>* a,
+                      const double* b, long ldb) {
+        if (ldb == -1) ldb = dimj;
+        MADNESS_ASSERT(ldb >= dimj);
+        // D(2i+p,j) = sum(k) a(k,i)[p]*b(k,j) with p=re,im ... formed a block of rows at a time
+        if (dimj > ZBUF/2) {
+            mTxmq_reference(dimi, dimj, dimk, c, a, b, ldb);
+            return;
+        }
+        double d[ZBUF];
+        const long nrow = std::max(1L, ZBUF/(2*dimj));
+        const double* ad = reinterpret_cast<const double*>(a);
+        for (long i0=0; i0<dimi; i0+=nrow) {
+            const long ni = std::min(nrow, dimi-i0);
+            kernel()(2*ni, dimj, dimk, d, dimj, ad+2*i0, 2*dimi, b, ldb);
+            std::complex<double>* MADNESS_RESTRICT ci = c + i0*dimj;
+            for (long i=0; i<ni; ++i) {
+                const double* re = d + 2*i*dimj;
+                const double* im = re + dimj;
+                for (long j=0; j<dimj; ++j) ci[i*dimj+j] = std::complex<double>(re[j], im[j]);
+            }
+        }
+    }
+
+    void mTxmq_kernel(long dimi, long dimj, long dimk,
+                      std::complex<double>* MADNESS_RESTRICT c, const std::complex<double>* a,
+                      const std::complex<double>* b, long ldb) {
+        if (ldb == -1) ldb = dimj;
+        MADNESS_ASSERT(ldb >= dimj);
+        // D(2i+p,2j+q) = sum(k) a(k,i)[p]*b(k,j)[q] with p,q=re,im ... formed a block of rows at a time
+        if (dimj > ZBUF/4) {
+            mTxmq_reference(dimi, dimj, dimk, c, a, b, ldb);
+            return;
+        }
+        double d[ZBUF];
+        const long nrow = std::max(1L, ZBUF/(4*dimj));
+        const double* ad = reinterpret_cast<const double*>(a);
+        const double* bd = reinterpret_cast<const double*>(b);
+        for (long i0=0; i0<dimi; i0+=nrow) {
+            const long ni = std::min(nrow, dimi-i0);
+            kernel()(2*ni, 2*dimj, dimk, d, 2*dimj, ad+2*i0, 2*dimi, bd, 2*ldb);
+            std::complex<double>* MADNESS_RESTRICT ci = c + i0*dimj;
+            for (long i=0; i<ni; ++i) {
+                const double* re = d + 4*i*dimj;   // Row from re(a)
+                const double* im = re + 2*dimj;    // Row from im(a)
+                for (long j=0; j<dimj; ++j) {
+                    ci[i*dimj+j] = std::complex<double>(re[2*j] - im[2*j+1], re[2*j+1] + im[2*j]);
+                }
+            }
+        }
+    }
+
+} // namespace madness
@@ -36,6 +36,9 @@
 #define MADNESS_TENSOR_MXM_H__INCLUDED
 
 #include <madness/madness_config.h>
+#include <complex>
+#include <string>
+#include <vector>
 
 #ifdef HAVE_INTEL_MKL
 #include <madness/tensor/cblas.h>
@@ -178,6 +181,34 @@ namespace madness {
         }
     }
     
+    /// Optimized mTxmq (see mtxmq_simd.cc) ... same semantics as mTxmq_reference
+
+    /// The kernel (generic C++, AVX2 or AVX-512) is picked at runtime from the
+    /// CPU features or by the environment variable \c MAD_MTXMQ_KERNEL.
+    void mTxmq_kernel(long dimi, long dimj, long dimk,
+                      double* MADNESS_RESTRICT c, const double* a, const double* b, long ldb=-1);
+    void mTxmq_kernel(long dimi, long dimj, long dimk,
+                      std::complex<double>* MADNESS_RESTRICT c, const double* a,
+                      const std::complex<double>* b, long ldb=-1);
+    void mTxmq_kernel(long dimi, long dimj, long dimk,
+                      std::complex<double>* MADNESS_RESTRICT c, const std::complex<double>* a,
+                      const double* b, long ldb=-1);
+    void mTxmq_kernel(long dimi, long dimj, long dimk,
+                      std::complex<double>* MADNESS_RESTRICT c, const std::complex<double>* a,
+                      const std::complex<double>* b, long ldb=-1);
+
+    /// Returns the name of the kernel used by mTxmq_kernel
+    const char* mTxmq_kernel_name();
+
+    /// Selects the kernel used by mTxmq_kernel
+
+    /// \param[in] name One of the names returned by mTxmq_available_kernels()
+    /// \return False (and the kernel is unchanged) if the name is unknown or not supported by this CPU
+    bool set_mTxmq_kernel(const char* name);
+
+    /// Returns the names of the mTxmq kernels supported by this CPU
+    std::vector<std::string> mTxmq_available_kernels();
+
 
 #ifdef HAVE_INTEL_MKL
 
@@ -597,25 +628,59 @@ namespace madness {
         bgpmTxmq(ni, nj, nk, c, a, b);
     }
 
-// #elif defined(X86_64) && !defined(DISABLE_SSE3)
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double* MADNESS_RESTRICT c, const double* a, const double* b);
-
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double_complex* MADNESS_RESTRICT c, const double_complex* a, const double_complex* b);
-
-// #ifndef __INTEL_COMPILER
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double_complex* MADNESS_RESTRICT c, const double_complex* a, const double* b);
-// #endif
-
-// #elif defined(X86_32)
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double* MADNESS_RESTRICT c, const double* a, const double* b);
+#else
+    template <>
+    inline void mTxmq(long dimi, long dimj, long dimk,
+                      double* MADNESS_RESTRICT c, const double* a, const double* b, long ldb) {
+        mTxmq_kernel(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    inline void mTxmq(long dimi, long dimj, long dimk,
+                      std::complex<double>* MADNESS_RESTRICT c, const double* a,
+                      const std::complex<double>* b, long ldb) {
+        mTxmq_kernel(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    inline void mTxmq(long dimi, long dimj, long dimk,
+                      std::complex<double>* MADNESS_RESTRICT c, const std::complex<double>* a,
+                      const double* b, long ldb) {
+        mTxmq_kernel(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    inline void mTxmq(long dimi, long dimj, long dimk,
+                      std::complex<double>* MADNESS_RESTRICT c, const std::complex<double>* a,
+                      const std::complex<double>* b, long ldb) {
+        mTxmq_kernel(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    // The kernels take the leading dimension of b directly so need no padding
+
+    template <>
+    inline void mTxmq_padding(long dimi, long dimj, long dimk, long ext_b,
+                              double* c, const double* a, const double* b) {
+        mTxmq_kernel(dimi, dimj, dimk, c, a, b, ext_b);
+    }
+
+    template <>
+    inline void mTxmq_padding(long dimi, long dimj, long dimk, long ext_b,
+                              std::complex<double>* c, const double* a, const std::complex<double>* b) {
+        mTxmq_kernel(dimi, dimj, dimk, c, a, b, ext_b);
+    }
+
+    template <>
+    inline void mTxmq_padding(long dimi, long dimj, long dimk, long ext_b,
+                              std::complex<double>* c, const std::complex<double>* a, const double* b) {
+        mTxmq_kernel(dimi, dimj, dimk, c, a, b, ext_b);
+    }
+
+    template <>
+    inline void mTxmq_padding(long dimi, long dimj, long dimk, long ext_b,
+                              std::complex<double>* c, const std::complex<double>* a, const std::complex<double>* b) {
+        mTxmq_kernel(dimi, dimj, dimk, c, a, b, ext_b);
+    }
 #endif // HAVE_IBMBGQ
 
 #endif // HAVE_INTEL_MKL
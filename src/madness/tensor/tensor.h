@@ -35,6 +35,7 @@
 #include <madness/madness_config.h>
 #include <madness/misc/ran.h>
 #include <madness/world/posixmem.h>
+#include <madness/world/worldmem.h>
 
 #include <memory>
 #include <complex>
@@ -44,6 +45,7 @@
 #include <cstddef>
 
 #include <madness/world/archive.h>
+#include <madness/world/buffer_archive.h>
 // #include <madness/world/print.h>
 //
 // typedef std::complex<float> float_complex;
@@ -59,6 +61,7 @@
 #include <madness/tensor/mxm.h>
 #include <madness/tensor/tensorexcept.h>
 #include <madness/tensor/tensoriter.h>
+#include <madness/tensor/tensor_wire.h>
 
 #ifdef USE_GENTENSOR
 #define HAVE_GENTENSOR 1
@@ -297,14 +300,21 @@ namespace madness {
         template <typename T> class SharedAlignedArray {
             T* volatile p;
             AtomicInt* cnt;
-            void dec() {if (p && ((*cnt)-- == 1)) {free(p); p = 0;}}
+            void dec() {
+                if (p && ((*cnt)-- == 1)) {
+                    if (PoolAllocator::enabled()) PoolAllocator::deallocate(p);
+                    else free(p);
+                    p = 0;
+                }
+            }
             void inc() {if (p) (*cnt)++;}
         public:
             SharedAlignedArray() : p(0), cnt(0) {}
             T* allocate(std::size_t size, unsigned int alignment) {
                 std::size_t offset = (size*sizeof(T)-1)/sizeof(AtomicInt) + 1; // Where the counter will be
                 std::size_t nbyte = (offset+1)*sizeof(AtomicInt);
-                if (posix_memalign((void **) &p, alignment, nbyte)) throw 1;
+                if (PoolAllocator::enabled()) p = (T*) PoolAllocator::allocate(nbyte);
+                else if (posix_memalign((void **) &p, alignment, nbyte)) throw 1;
                 cnt = (AtomicInt*)(p) + offset;
                 *cnt = 1;
                 return p;
@@ -372,8 +382,14 @@ namespace madness {
                     _p = new T[_size];
                     _shptr = std::shared_ptr<T>(_p);
 #else
-                    if (posix_memalign((void **) &_p, TENSOR_ALIGNMENT, sizeof(T)*_size)) throw 1;
-                    _shptr.reset(_p, &free);
+                    if (PoolAllocator::enabled()) {
+                        _p = (T*) PoolAllocator::allocate(sizeof(T)*_size);
+                        _shptr.reset(_p, &PoolAllocator::deallocate);
+                    }
+                    else {
+                        if (posix_memalign((void **) &_p, TENSOR_ALIGNMENT, sizeof(T)*_size)) throw 1;
+                        _shptr.reset(_p, &free);
+                    }
 #endif
                 }
                 catch (...) {
@@ -1879,11 +1895,130 @@ namespace madness {
 
 
     namespace archive {
+
+        /// Tensors are stored plain except in active messages
+        template <class Archive>
+        TensorWire::Mode tensor_wire_mode(const Archive& s) {
+            return TensorWire::OFF;
+        }
+
+        /// Returns the encoding mode of the active message, chosen once per message
+        inline TensorWire::Mode tensor_wire_mode(const BufferOutputArchive& s) {
+            if (!s.is_active_message()) return TensorWire::OFF;
+            return TensorWire::Mode(s.wire_mode(TensorWire::mode()));
+        }
+
+        /// Types that cannot be compacted are always stored plain
+        template <class Archive, typename T>
+        bool store_compact_tensor(const Archive& s, const Tensor<T>& t, TensorWire::Mode mode, std::false_type) {
+            return false;
+        }
+
+        /// Stores a contiguous tensor in compact form if that pays off (see TensorWire)
+
+        /// The size is stored negated to mark the encoding.
+        /// \return False if nothing was stored and the plain form should be used
+        template <class Archive, typename T>
+        bool store_compact_tensor(const Archive& s, const Tensor<T>& t, TensorWire::Mode mode, std::true_type) {
+            typedef typename madness::detail::TensorWireTraits<T>::lowp_type lowpT;
+            const long n = t.size();
+            const T* p = t.ptr();
+            madness::detail::TensorWirePlan plan;
+            if (!madness::detail::tensor_wire_plan(p, n, TensorWire::tolerance(mode), plan)) return false;
+
+            s & (-n) & t.id() & t.ndim() & wrap(t.dims(),TENSOR_MAXDIM) & plan.flags & plan.nnz;
+            if (plan.flags & madness::detail::TensorWirePlan::BITMAP) {
+                std::vector<unsigned char> bits((n+7)/8, 0);
+                for (long i=0; i<n; ++i) {
+                    const double a2 = madness::detail::wire_abs2(p[i]);
+                    if (a2 > 0.0 && a2 >= plan.cut2) bits[i>>3] |= (1u << (i&7));
+                }
+                s & wrap(&bits[0], bits.size());
+            }
+            if (plan.nnz == 0) return true;
+            if (plan.flags & madness::detail::TensorWirePlan::LOWP) {
+                std::vector<lowpT> val;
+                val.reserve(plan.nnz);
+                for (long i=0; i<n; ++i) {
+                    const double a2 = madness::detail::wire_abs2(p[i]);
+                    if (a2 > 0.0 && a2 >= plan.cut2) val.push_back(lowpT(p[i]));
+                }
+                s & wrap(&val[0], val.size());
+            }
+            else if (plan.nnz == n) {
+                s & wrap(p, n);
+            }
+            else {
+                std::vector<T> val;
+                val.reserve(plan.nnz);
+                for (long i=0; i<n; ++i) {
+                    const double a2 = madness::detail::wire_abs2(p[i]);
+                    if (a2 > 0.0 && a2 >= plan.cut2) val.push_back(p[i]);
+                }
+                s & wrap(&val[0], val.size());
+            }
+            return true;
+        }
+
+        /// Only types that can be compacted are ever stored compact
+        template <class Archive, typename T>
+        void load_compact_tensor(const Archive& s, long sz, Tensor<T>& t, std::false_type) {
+            throw "compact encoding of a tensor of this type";
+        }
+
+        /// Loads the rest of a tensor stored by store_compact_tensor after its negated size and id
+        template <class Archive, typename T>
+        void load_compact_tensor(const Archive& s, long sz, Tensor<T>& t, std::true_type) {
+            typedef typename madness::detail::TensorWireTraits<T>::lowp_type lowpT;
+            long _ndim = 0l, _dim[TENSOR_MAXDIM], nnz = 0l;
+            int flags = 0;
+            s & _ndim & wrap(_dim,TENSOR_MAXDIM) & flags & nnz;
+            const bool bitmap = flags & madness::detail::TensorWirePlan::BITMAP;
+            t = Tensor<T>(_ndim, _dim, bitmap);
+            if (sz != t.size()) throw "size mismatch deserializing a tensor";
+            std::vector<unsigned char> bits;
+            if (bitmap) {
+                bits.resize((sz+7)/8);
+                s & wrap(&bits[0], bits.size());
+            }
+            if (nnz == 0) return;
+            T* p = t.ptr();
+            if (flags & madness::detail::TensorWirePlan::LOWP) {
+                std::vector<lowpT> val(nnz);
+                s & wrap(&val[0], nnz);
+                if (bitmap) {
+                    long j = 0;
+                    for (long i=0; i<sz; ++i) if (bits[i>>3] & (1u << (i&7))) p[i] = T(val[j++]);
+                }
+                else {
+                    for (long i=0; i<sz; ++i) p[i] = T(val[i]);
+                }
+            }
+            else if (bitmap) {
+                std::vector<T> val(nnz);
+                s & wrap(&val[0], nnz);
+                long j = 0;
+                for (long i=0; i<sz; ++i) if (bits[i>>3] & (1u << (i&7))) p[i] = val[j++];
+            }
+            else {
+                s & wrap(p, sz);
+            }
+        }
+
         /// Serialize a tensor
+
+        /// Into an active message the tensor may be stored in compact form,
+        /// see TensorWire.
         template <class Archive, typename T>
         struct ArchiveStoreImpl< Archive, Tensor<T> > {
             static void store(const Archive& s, const Tensor<T>& t) {
                 if (t.iscontiguous()) {
+                    if (t.size() >= TensorWire::min_size) {
+                        const TensorWire::Mode mode = tensor_wire_mode(s);
+                        if (mode != TensorWire::OFF &&
+                            store_compact_tensor(s, t, mode, std::integral_constant<bool,madness::detail::TensorWireTraits<T>::enabled>()))
+                            return;
+                    }
                     s & t.size() & t.id();
                     if (t.size()) s & t.ndim() & wrap(t.dims(),TENSOR_MAXDIM) & wrap(t.ptr(),t.size());
                 }
@@ -1901,7 +2036,10 @@ namespace madness {
                 long sz = 0l, id = 0l;
                 s & sz & id;
                 if (id != t.id()) throw "type mismatch deserializing a tensor";
-                if (sz) {
+                if (sz < 0) {
+                    load_compact_tensor(s, -sz, t, std::integral_constant<bool,madness::detail::TensorWireTraits<T>::enabled>());
+                }
+                else if (sz) {
                     long _ndim = 0l, _dim[TENSOR_MAXDIM];
                     s & _ndim & wrap(_dim,TENSOR_MAXDIM);
                     t = Tensor<T>(_ndim, _dim, false);
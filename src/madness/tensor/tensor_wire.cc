@@ -0,0 +1,82 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor_wire.cc
+/// \brief Settings of the compact encoding of tensors in active messages
+
+#include <madness/tensor/tensor_wire.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace madness {
+
+    namespace {
+
+        int mode_from_environment() {
+            const char* env = std::getenv("MAD_WIRE_COMPRESSION");
+            if (!env) return TensorWire::OFF;
+            if (std::strcmp(env, "lossy") == 0) return TensorWire::LOSSY;
+            if (std::strcmp(env, "lossless") == 0 || std::strcmp(env, "1") == 0 ||
+                std::strcmp(env, "on") == 0 || std::strcmp(env, "yes") == 0) return TensorWire::LOSSLESS;
+            return TensorWire::OFF;
+        }
+
+        std::atomic<int>& wire_mode() {
+            static std::atomic<int> m(mode_from_environment());
+            return m;
+        }
+
+        thread_local double wire_tolerance = 0.0;
+
+    }
+
+    TensorWire::Mode TensorWire::mode() {
+        return Mode(wire_mode().load(std::memory_order_relaxed));
+    }
+
+    void TensorWire::set_mode(Mode m) {
+        wire_mode().store(m, std::memory_order_relaxed);
+    }
+
+    double TensorWire::tolerance(Mode m) {
+        return (m == LOSSY) ? wire_tolerance : 0.0;
+    }
+
+    TensorWire::Tolerance::Tolerance(double tol) : saved(wire_tolerance) {
+        wire_tolerance = tol;
+    }
+
+    TensorWire::Tolerance::~Tolerance() {
+        wire_tolerance = saved;
+    }
+
+}
@@ -0,0 +1,219 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_TENSOR_TENSOR_WIRE_H__INCLUDED
+#define MADNESS_TENSOR_TENSOR_WIRE_H__INCLUDED
+
+/// \file tensor_wire.h
+/// \brief Compact encoding of tensors serialized into active messages
+
+#include <complex>
+#include <cmath>
+#include <cstddef>
+
+namespace madness {
+
+    /// Controls the compact encoding of tensors in active messages
+
+    /// Tensors stored into an active message or remote task (a
+    /// \c BufferOutputArchive marked with \c set_active_message) may be
+    /// sent in a compact form instead of the full array of values:
+    ///  - entries that are zero, or that may be dropped within the
+    ///    current tolerance, are omitted and a bitmap marks the entries
+    ///    sent;
+    ///  - if the tolerance allows, double precision values are sent in
+    ///    single precision.
+    ///
+    /// The encoding is chosen per tensor, and only if it is at least 1/8
+    /// smaller than the plain one; the receiver recognizes it from the
+    /// header, so it needs no configuration.
+    ///
+    /// The tolerance is zero (lossless) unless a sender sets it for the
+    /// calling thread with a Tolerance object; the Frobenius norm of the
+    /// difference between a tensor sent and the tensor received is then
+    /// at most that tolerance.  Lossy encoding also requires mode LOSSY.
+    ///
+    /// Other archives, including buffers that are written to files, always
+    /// store tensors plain.  The mode is read once per message and used
+    /// both to size and to fill its buffer.
+    ///
+    /// The mode is read from the environment variable
+    /// \c MAD_WIRE_COMPRESSION (\c lossless or \c lossy) when first
+    /// needed, and may be changed with set_mode().  It defaults to OFF.
+    class TensorWire {
+    public:
+        /// How tensors are encoded
+        enum Mode {OFF, LOSSLESS, LOSSY};
+
+        /// Tensors with fewer entries are always sent plain
+        static const long min_size = 64;
+
+        /// Returns the current mode
+        static Mode mode();
+
+        /// Sets the mode ... every process must use a setting understood by the receivers
+        static void set_mode(Mode m);
+
+        /// Returns the error allowed for tensors stored by this thread (zero unless LOSSY)
+        static double tolerance() {return tolerance(mode());}
+
+        /// Returns the error allowed for tensors stored by this thread in the given mode (zero unless LOSSY)
+        static double tolerance(Mode m);
+
+        /// Sets the error allowed for tensors stored by this thread while in scope
+        class Tolerance {
+            double saved;
+        public:
+            explicit Tolerance(double tol);
+            ~Tolerance();
+        private:
+            Tolerance(const Tolerance&);
+            Tolerance& operator=(const Tolerance&);
+        };
+    };
+
+    namespace detail {
+
+        /// The types that may be compacted, and their reduced precision type
+        template <typename T>
+        struct TensorWireTraits {
+            static const bool enabled = false;
+            static const bool reduces = false;
+            typedef T lowp_type;
+        };
+
+        template <>
+        struct TensorWireTraits<float> {
+            static const bool enabled = true;
+            static const bool reduces = false;
+            typedef float lowp_type;
+        };
+
+        template <>
+        struct TensorWireTraits<double> {
+            static const bool enabled = true;
+            static const bool reduces = true;
+            typedef float lowp_type;
+        };
+
+        template <>
+        struct TensorWireTraits< std::complex<float> > {
+            static const bool enabled = true;
+            static const bool reduces = false;
+            typedef std::complex<float> lowp_type;
+        };
+
+        template <>
+        struct TensorWireTraits< std::complex<double> > {
+            static const bool enabled = true;
+            static const bool reduces = true;
+            typedef std::complex<float> lowp_type;
+        };
+
+        inline double wire_abs2(float x) {return double(x)*x;}
+        inline double wire_abs2(double x) {return x*x;}
+        template <typename Q>
+        inline double wire_abs2(const std::complex<Q>& x) {return std::norm(std::complex<double>(x));}
+
+        /// How the values of a tensor are encoded
+        struct TensorWirePlan {
+            static const int BITMAP = 1;    ///< A bitmap of the entries sent precedes the values
+            static const int LOWP = 2;      ///< Values are sent in reduced precision
+
+            int flags;          ///< Combination of BITMAP and LOWP
+            double cut2;        ///< Entries with squared magnitude below this are not sent
+            long nnz;           ///< Number of values sent
+        };
+
+        /// Decides how to encode the \c n contiguous values at \c p
+
+        /// Entries whose squared magnitudes sum to at most (tol/2)^2 are
+        /// dropped, smallest first by binary order of magnitude, and the
+        /// values are reduced in precision if that costs at most tol/2.
+        /// \return False if the plain encoding should be used
+        template <typename T>
+        bool tensor_wire_plan(const T* p, long n, double tol, TensorWirePlan& plan) {
+            typedef TensorWireTraits<T> traitsT;
+            if (!traitsT::enabled || n < TensorWire::min_size) return false;
+
+            // Histogram of the squared magnitudes by binary exponent over
+            // the range that can be dropped; smaller ones go in bucket 0
+            static const int nbucket = 128;
+            double hist[nbucket+1];
+            const double budget2 = 0.25*tol*tol;
+            int ebase = 0;
+            if (tol > 0.0) {
+                for (int b=0; b<=nbucket; ++b) hist[b] = 0.0;
+                ebase = std::ilogb(budget2) + 1 - nbucket;
+            }
+
+            double sumsq = 0.0;
+            for (long i=0; i<n; ++i) {
+                const double a2 = wire_abs2(p[i]);
+                sumsq += a2;
+                if (tol > 0.0 && a2 > 0.0) {
+                    int b = std::ilogb(a2) - ebase + 1;
+                    if (b < nbucket+1) hist[b < 0 ? 0 : b] += a2;
+                }
+            }
+
+            // Drop whole buckets while within budget
+            plan.cut2 = 0.0;
+            if (tol > 0.0) {
+                double dropped = 0.0;
+                int b = 0;
+                while (b <= nbucket && dropped + hist[b] <= budget2) dropped += hist[b++];
+                if (b > 0) plan.cut2 = std::ldexp(1.0, ebase + b - 1);
+            }
+
+            plan.nnz = 0;
+            for (long i=0; i<n; ++i) {
+                const double a2 = wire_abs2(p[i]);
+                if (a2 > 0.0 && a2 >= plan.cut2) ++plan.nnz;
+            }
+
+            // Rounding to single precision changes each component by at most 2^-24 relative
+            plan.flags = 0;
+            if (plan.nnz < n) plan.flags |= TensorWirePlan::BITMAP;
+            if (traitsT::reduces && tol > 0.0 && std::ldexp(std::sqrt(sumsq), -23) <= 0.5*tol)
+                plan.flags |= TensorWirePlan::LOWP;
+
+            const std::size_t plain = n*sizeof(T);
+            std::size_t nbyte = 2*sizeof(long);
+            if (plan.flags & TensorWirePlan::BITMAP) nbyte += (n+7)/8;
+            nbyte += plan.nnz*((plan.flags & TensorWirePlan::LOWP) ? sizeof(typename traitsT::lowp_type) : sizeof(T));
+            return nbyte < plain - plain/8;
+        }
+
+    }
+}
+
+#endif // MADNESS_TENSOR_TENSOR_WIRE_H__INCLUDED
@@ -44,6 +44,9 @@ int main() {std::cout << "x86 only\n"; return 0;}
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string>
+#include <typeinfo>
+#include <vector>
 //#include <xmmintrin.h>
 
 #include <madness/world/safempi.h>
@@ -94,8 +97,8 @@ void crap(double rate, double fastest, double start) {
 }
 
 
-void timer(const char* s, long ni, long nj, long nk, double *a, double *b, double *c) {
-  double fastest=0.0, fastest_dgemm=0.0;
+double time_kernel(long ni, long nj, long nk, double *a, double *b, double *c, bool dgemm) {
+  double fastest=0.0;
 
   double nflop = 2.0*ni*nj*nk;
   long loop;
@@ -103,6 +106,10 @@ void timer(const char* s, long ni, long nj, long nk, double *a, double *b, doubl
     double rate;
     double start = SafeMPI::Wtime();
     for (loop=0; loop<100; ++loop) {
+#ifdef TIME_DGEMM
+      if (dgemm) mTxm_dgemm(ni,nj,nk,c,a,b);
+      else
+#endif
       mTxmq(ni,nj,nk,c,a,b);
     }
     start = SafeMPI::Wtime() - start;
@@ -110,20 +117,23 @@ void timer(const char* s, long ni, long nj, long nk, double *a, double *b, doubl
     crap(rate,fastest,start);
     if (rate > fastest) fastest = rate;
   }
-#ifdef TIME_DGEMM
-  for (int t=0; t<100; t++) {
-    double rate;
-    double start = SafeMPI::Wtime();
-    for (loop=0; loop<100; ++loop) {
-      mTxm_dgemm(ni,nj,nk,c,a,b);
-    }
-    start = SafeMPI::Wtime() - start;
-    rate = 1.e-9*nflop/(start/100.0);
-    crap(rate,fastest_dgemm,start);
-    if (rate > fastest_dgemm) fastest_dgemm = rate;
+  return fastest;
+}
+
+/// Times mTxmq with each available kernel and dgemm (if enabled)
+void timer(const char* s, long ni, long nj, long nk, double *a, double *b, double *c) {
+  const std::vector<std::string> kernels = mTxmq_available_kernels();
+  const std::string current = mTxmq_kernel_name();
+  printf("%20s %3ld %3ld %3ld",s, ni,nj,nk);
+  for (const std::string& kernel : kernels) {
+    set_mTxmq_kernel(kernel.c_str());
+    printf(" %8.2f", time_kernel(ni,nj,nk,a,b,c,false));
   }
+  set_mTxmq_kernel(current.c_str());
+#ifdef TIME_DGEMM
+  printf(" %8.2f", time_kernel(ni,nj,nk,a,b,c,true));
 #endif
-  printf("%20s %3ld %3ld %3ld %8.2f %8.2f\n",s, ni,nj,nk, fastest, fastest_dgemm);
+  printf("\n");
 }
 
 void trantimer(const char* s, long ni, long nj, long nk, double *a, double *b, double *c) {
@@ -162,8 +172,24 @@ void trantimer(const char* s, long ni, long nj, long nk, double *a, double *b, d
   printf("%20s %3ld %3ld %3ld %8.2f %8.2f\n",s, ni,nj,nk, fastest, fastest_dgemm);
 }
 
+/// Checks the complex and ldb>nj variants of mTxmq_kernel against mTxmq_reference
+template <typename aT, typename bT, typename cT>
+void test_variant(const char* kernel, long ni, long nj, long nk, long ldb,
+                  const aT* a, const bT* b, cT* c, cT* d) {
+    mTxmq_reference(ni,nj,nk,c,a,b,ldb);
+    mTxmq_kernel(ni,nj,nk,d,a,b,ldb);
+    for (long i=0; i<ni*nj; ++i) {
+        double err = std::abs(d[i]-c[i]);
+        if (err > 1e-12) {
+            printf("test_mtxmq: %s error %s %ld %ld %ld %ld %e\n", kernel,
+                   typeid(cT).name(), ni, nj, nk, ldb, err);
+            exit(1);
+        }
+    }
+}
+
 int main(int argc, char * argv[]) {
-    const long nimax=30*30;
+    const long nimax=60*60;
     const long njmax=100;
     const long nkmax=100;
     long ni, nj, nk, i, m;
@@ -192,37 +218,75 @@ int main(int argc, char * argv[]) {
 /*     } */
 /*     return 0; */
 
-    printf("Starting to test ... \n");
-    for (ni=1; ni<60; ni+=1) {
-        for (nj=1; nj<100; nj+=1) {
-            for (nk=1; nk<100; nk+=1) {
-                for (i=0; i<ni*nj; ++i) d[i] = c[i] = 0.0;
-                mTxm (ni,nj,nk,c,a,b);
-                mTxmq(ni,nj,nk,d,a,b);
-                for (i=0; i<ni*nj; ++i) {
-                    double err = std::abs(d[i]-c[i]);
-                    /* This test is sensitive to the compilation options.
-                       Be sure to have the reference code above compiled
-                       -msse2 -fpmath=sse if using GCC.  Otherwise, to
-                       pass the test you may need to change the threshold
-                       to circa 1e-13.
-                    */
-                    if (err > 1e-13) {
-                        printf("test_mtxmq: error %ld %ld %ld %e\n",ni,nj,nk,err);
-                        exit(1);
+    const std::vector<std::string> kernels = mTxmq_available_kernels();
+    const std::string default_kernel = mTxmq_kernel_name();
+    printf("Default mTxmq kernel is %s\n", default_kernel.c_str());
+
+    for (const std::string& kernel : kernels) {
+        set_mTxmq_kernel(kernel.c_str());
+        printf("Starting to test %s ... \n", kernel.c_str());
+        // The kernels have tails in i and j but not in k, so step through large ni and nk
+        for (ni=1; ni<60; ni+=(ni<16 ? 1 : 5)) {
+            for (nj=1; nj<100; nj+=1) {
+                for (nk=1; nk<100; nk+=(nk<8 ? 1 : 7)) {
+                    for (i=0; i<ni*nj; ++i) d[i] = c[i] = 0.0;
+                    mTxm (ni,nj,nk,c,a,b);
+                    mTxmq(ni,nj,nk,d,a,b);
+                    for (i=0; i<ni*nj; ++i) {
+                        double err = std::abs(d[i]-c[i]);
+                        /* This test is sensitive to the compilation options.
+                           Be sure to have the reference code above compiled
+                           -msse2 -fpmath=sse if using GCC.  Otherwise, to
+                           pass the test you may need to change the threshold
+                           to circa 1e-13.
+                        */
+                        if (err > 1e-13) {
+                            printf("test_mtxmq: %s error %ld %ld %ld %e\n",kernel.c_str(),ni,nj,nk,err);
+                            exit(1);
+                        }
                     }
                 }
             }
         }
+
+        // Low rank (ldb>nj) and complex variants for the MADNESS block shapes
+        {
+            const long n = 2*30;
+            std::vector<double_complex> za(n*n*n), zb(n*n), zc(n*n*n), zd(n*n*n);
+            for (i=0; i<n*n*n; ++i) za[i] = double_complex(ran()-0.5, ran()-0.5);
+            for (i=0; i<n*n; ++i) zb[i] = double_complex(ran()-0.5, ran()-0.5);
+            for (long k=4; k<=30; ++k) {
+                for (long kk=k; kk<=2*k; kk+=k) {
+                    for (long ndim=1; ndim<=3; ndim+=2) {
+                        long nii = (ndim == 1) ? kk : kk*kk;
+                        for (long r=1; r<=kk; r+=(kk+2)/3) {
+                            test_variant(kernel.c_str(), nii, r, kk, kk, a, b, c, d);
+                        }
+                        test_variant(kernel.c_str(), nii, kk, kk, kk, a, zb.data(), zc.data(), zd.data());
+                        test_variant(kernel.c_str(), nii, kk, kk, kk, za.data(), b, zc.data(), zd.data());
+                        test_variant(kernel.c_str(), nii, kk, kk, kk, za.data(), zb.data(), zc.data(), zd.data());
+                        test_variant(kernel.c_str(), nii, kk-1, kk, kk, za.data(), zb.data(), zc.data(), zd.data());
+                    }
+                }
+            }
+        }
+        printf("... OK!\n");
     }
-    printf("... OK!\n");
+    set_mTxmq_kernel(default_kernel.c_str());
 
-    printf("%20s %3s %3s %3s %8s %8s (GF/s)\n", "type", "M", "N", "K", "LOOP", "BLAS");
+    printf("%20s %3s %3s %3s", "type", "M", "N", "K");
+    for (const std::string& kernel : kernels) printf(" %8s", kernel.c_str());
+#ifdef TIME_DGEMM
+    printf(" %8s", "BLAS");
+#endif
+    printf(" (GF/s)\n");
     for (ni=2; ni<60; ni+=2) timer("(m*m)T*(m*m)", ni,ni,ni,a,b,c);
     for (m=2; m<=30; m+=2) timer("(m*m,m)T*(m*m)", m*m,m,m,a,b,c);
-    for (m=2; m<=30; m+=2) trantimer("tran(m,m,m)", m*m,m,m,a,b,c);
     for (m=2; m<=20; m+=2) timer("(20*20,20)T*(20,m)", 20*20,m,20,a,b,c);
 
+    printf("%20s %3s %3s %3s %8s %8s (GF/s)\n", "type", "M", "N", "K", mTxmq_kernel_name(), "BLAS");
+    for (m=2; m<=30; m+=2) trantimer("tran(m,m,m)", m*m,m,m,a,b,c);
+
     SafeMPI::Finalize();
 
     return 0;
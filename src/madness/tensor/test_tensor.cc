@@ -34,6 +34,7 @@
 
 #include <madness/tensor/tensor.h>
 #include <madness/world/print.h>
+#include <madness/world/buffer_archive.h>
 
 #ifdef MADNESS_HAS_GOOGLE_TEST
 
@@ -415,6 +416,86 @@ namespace {
         ITERATOR3(b,ASSERT_EQ(b(_i,_j,_k), a(_j,_i,_k)));
     }
 
+    // Round trip through the buffer archive used by active messages
+    template <typename T>
+    std::size_t wire_round_trip(const madness::Tensor<T>& a, madness::Tensor<T>& b, bool am=true) {
+        madness::archive::BufferOutputArchive count;
+        if (am) count.set_active_message();
+        count & a;
+        std::vector<unsigned char> buf(count.size());
+        madness::archive::BufferOutputArchive ar(&buf[0], buf.size());
+        if (am) ar.set_active_message(count.wire_mode());
+        ar & a;
+        EXPECT_EQ(ar.size(), count.size());
+        madness::archive::BufferInputArchive in(&buf[0], buf.size());
+        in & b;
+        return buf.size();
+    }
+
+    TYPED_TEST(TensorTest, WireEncoding) {
+        // Every third entry zero, the rest decaying over 12 orders of magnitude
+        madness::Tensor<TypeParam> a(10,10,10);
+        for (long i=0; i<a.size(); ++i) {
+            if (i%3) a.ptr()[i] = TypeParam(1000.0*std::pow(10.0,-12.0*i/a.size()));
+        }
+
+        madness::Tensor<TypeParam> b;
+        const std::size_t plain = wire_round_trip(a, b);
+        ASSERT_EQ((a-b).normf(), 0.0);
+
+        madness::TensorWire::set_mode(madness::TensorWire::LOSSLESS);
+        const std::size_t lossless = wire_round_trip(a, b);
+        ASSERT_EQ((a-b).normf(), 0.0);
+
+        madness::TensorWire::set_mode(madness::TensorWire::LOSSY);
+        const double tol = 1e-3;
+        std::size_t lossy;
+        {
+            madness::TensorWire::Tolerance wire(tol);
+            lossy = wire_round_trip(a, b);
+        }
+        ASSERT_LE((a-b).normf(), tol);
+        madness::TensorWire::set_mode(madness::TensorWire::OFF);
+
+        if (madness::detail::TensorWireTraits<TypeParam>::enabled) {
+            EXPECT_LT(lossless, plain);
+            EXPECT_LT(lossy, lossless);
+        }
+        else {
+            EXPECT_EQ(lossless, plain);
+            EXPECT_EQ(lossy, plain);
+        }
+
+        // Archives that are not active messages always store plain
+        madness::TensorWire::set_mode(madness::TensorWire::LOSSLESS);
+        ASSERT_EQ(wire_round_trip(a, b, false), plain);
+        ASSERT_EQ((a-b).normf(), 0.0);
+
+        // A message is stored with the mode it was counted with
+        {
+            madness::archive::BufferOutputArchive count;
+            count.set_active_message();
+            count & a;
+            madness::TensorWire::set_mode(madness::TensorWire::OFF);
+            std::vector<unsigned char> buf(count.size());
+            madness::archive::BufferOutputArchive ar(&buf[0], buf.size());
+            ar.set_active_message(count.wire_mode());
+            ar & a;
+            EXPECT_EQ(ar.size(), count.size());
+            EXPECT_EQ(ar.size(), lossless);
+            madness::archive::BufferInputArchive in(&buf[0], buf.size());
+            in & b;
+            ASSERT_EQ((a-b).normf(), 0.0);
+        }
+
+        // Small tensors are always sent plain
+        madness::Tensor<TypeParam> c(3,3);
+        const std::size_t plain_small = wire_round_trip(c, b);
+        madness::TensorWire::set_mode(madness::TensorWire::LOSSLESS);
+        ASSERT_EQ(wire_round_trip(c, b), plain_small);
+        madness::TensorWire::set_mode(madness::TensorWire::OFF);
+    }
+
 //     TYPED_TEST(TensorTest, Container) {
 //         typedef madness::ConcurrentHashMap< int, Tensor<TypeParam> > containerT;
 //         static const int N = 100;
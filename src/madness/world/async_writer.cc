@@ -0,0 +1,222 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file async_writer.cc
+ \brief Implementation of \c AsyncWriter.
+ \ingroup parallel_runtime
+*/
+
+#include <madness/world/async_writer.h>
+#include <madness/world/parallel_archive.h>
+#include <madness/world/print.h>
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace madness {
+
+    AsyncWriter* AsyncWriter::instance = nullptr;
+
+    namespace {
+        Mutex async_writer_mutex; // Guards creation of the singleton
+
+        /// The files of a batch, closed when it goes out of scope
+        struct BatchFiles {
+            std::map<std::string, int> fds; // Descriptor+1 by file name, 0 if not open
+
+            ~BatchFiles() {
+                for (const auto& file : fds)
+                    if (file.second) ::close(file.second-1);
+            }
+        };
+    }
+
+    AsyncWriter::AsyncWriter()
+        : max_nbytes(std::size_t(1) << 30)
+        , pending_nbytes(0)
+        , peak_nbytes(0)
+        , finish(false)
+        , running(false)
+    {
+        const char* buf = getenv("MAD_ASYNC_WRITE_BYTES");
+        if (buf) {
+            std::stringstream ss(buf);
+            ss >> max_nbytes;
+        }
+    }
+
+    AsyncWriter& AsyncWriter::get() {
+        if (!instance) {
+            ScopedMutex<Mutex> lock(async_writer_mutex);
+            if (!instance) instance = new AsyncWriter();
+        }
+        return *instance;
+    }
+
+    void AsyncWriter::write(const Batch& batch) {
+        BatchFiles files;
+        for (const AsyncWritePiece& piece : batch.pieces) {
+            int& fd = files.fds[piece.filename];
+            if (!fd) fd = archive::detail::open_indexed(piece.filename, O_WRONLY) + 1;
+            if (piece.data.size())
+                archive::detail::pwrite_all(fd-1, piece.data.data(), piece.data.size(), piece.offset);
+        }
+        for (const auto& file : files.fds) {
+            if (fsync(file.second-1))
+                MADNESS_EXCEPTION("AsyncWriter: fsync failed", errno);
+        }
+    }
+
+    void AsyncWriter::run() {
+        cv.lock();
+        while (true) {
+            while (queue.empty() && !finish) cv.wait();
+            if (queue.empty()) break;
+            Batch& batch = queue.front();
+            cv.unlock();
+
+            bool ok = true;
+            try {
+                write(batch);
+            }
+            catch (const MadnessException& e) {
+                print("AsyncWriter: write failed:", e);
+                ok = false;
+            }
+            batch.done.set(ok);
+
+            cv.lock();
+            pending_nbytes -= batch.nbytes;
+            queue.pop_front();
+            cv.broadcast();
+        }
+        running = false;
+        cv.broadcast();
+        cv.unlock();
+    }
+
+    Future<bool> AsyncWriter::submit(std::vector<AsyncWritePiece>& pieces, const std::string& name) {
+        AsyncWriter& w = get();
+        Batch batch;
+        batch.pieces.swap(pieces);
+        batch.name = name;
+        batch.nbytes = 0;
+        for (const AsyncWritePiece& piece : batch.pieces) batch.nbytes += piece.data.size();
+        Future<bool> done = batch.done;
+
+        w.cv.lock();
+        while (w.pending_nbytes && (w.pending_nbytes + batch.nbytes > w.max_nbytes)) w.cv.wait();
+        w.pending_nbytes += batch.nbytes;
+        if (w.pending_nbytes > w.peak_nbytes) w.peak_nbytes = w.pending_nbytes;
+        w.queue.push_back(std::move(batch));
+        if (!w.running) {
+            w.running = true;
+            w.finish = false;
+            w.start();
+        }
+        w.cv.signal();
+        w.cv.unlock();
+        return done;
+    }
+
+    void AsyncWriter::wait() {
+        if (!instance) return;
+        AsyncWriter& w = *instance;
+        w.cv.lock();
+        while (!w.queue.empty()) w.cv.wait();
+        w.cv.unlock();
+    }
+
+    void AsyncWriter::wait(const std::string& name) {
+        if (!instance) return;
+        AsyncWriter& w = *instance;
+        w.cv.lock();
+        while (true) {
+            bool pending = false;
+            for (const Batch& batch : w.queue) {
+                if (batch.name == name) {
+                    pending = true;
+                    break;
+                }
+            }
+            if (!pending) break;
+            w.cv.wait();
+        }
+        w.cv.unlock();
+    }
+
+    void AsyncWriter::end() {
+        if (!instance) return;
+        AsyncWriter& w = *instance;
+        w.cv.lock();
+        w.finish = true;
+        w.cv.broadcast();
+        while (w.running) w.cv.wait();
+        w.cv.unlock();
+    }
+
+    std::size_t AsyncWriter::max_bytes() {
+        AsyncWriter& w = get();
+        w.cv.lock();
+        std::size_t nbytes = w.max_nbytes;
+        w.cv.unlock();
+        return nbytes;
+    }
+
+    void AsyncWriter::set_max_bytes(std::size_t nbytes) {
+        AsyncWriter& w = get();
+        w.cv.lock();
+        w.max_nbytes = nbytes;
+        w.cv.broadcast();
+        w.cv.unlock();
+    }
+
+    std::size_t AsyncWriter::bytes_pending() {
+        AsyncWriter& w = get();
+        w.cv.lock();
+        std::size_t nbytes = w.pending_nbytes;
+        w.cv.unlock();
+        return nbytes;
+    }
+
+    std::size_t AsyncWriter::peak_bytes() {
+        AsyncWriter& w = get();
+        w.cv.lock();
+        std::size_t nbytes = w.peak_nbytes;
+        w.cv.unlock();
+        return nbytes;
+    }
+
+} // namespace madness
@@ -0,0 +1,153 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_ASYNC_WRITER_H__INCLUDED
+#define MADNESS_WORLD_ASYNC_WRITER_H__INCLUDED
+
+/**
+ \file async_writer.h
+ \brief A thread that writes data to files in the background.
+ \ingroup parallel_runtime
+*/
+
+#include <madness/world/thread.h>
+#include <madness/world/future.h>
+#include <madness/world/worldmutex.h>
+#include <sys/types.h>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace madness {
+
+    /// A piece of data to be written at a given offset of a file.
+    struct AsyncWritePiece {
+        std::string filename;             ///< The file, which must exist.
+        off_t offset;                     ///< Where to write the data.
+        std::vector<unsigned char> data;  ///< The data; if empty the file is only synced.
+
+        AsyncWritePiece() : offset(0) {}
+
+        AsyncWritePiece(const std::string& filename, off_t offset)
+            : filename(filename), offset(offset) {}
+    };
+
+    /// Writes data to files from a dedicated I/O thread.
+
+    /// A batch of pieces handed to \c submit is written with \c pwrite in
+    /// the order of submission, after which every file touched by the batch
+    /// is synced to disk and the future returned by \c submit is set. The
+    /// thread is started by the first submission and stopped by \c end,
+    /// which \c madness::finalize calls.
+    ///
+    /// The data of batches not yet written is bounded by \c max_bytes,
+    /// which defaults to 1 GiB per process and can be set with the
+    /// environment variable \c MAD_ASYNC_WRITE_BYTES. A submission that
+    /// would exceed the bound blocks the caller until enough older batches
+    /// are written; a single batch larger than the bound is accepted once
+    /// all others are done.
+    class AsyncWriter : private ThreadBase {
+        /// A submitted batch.
+        struct Batch {
+            std::vector<AsyncWritePiece> pieces;
+            std::string name;           ///< Base name of the archive written, if any.
+            std::size_t nbytes;
+            Future<bool> done;
+        };
+
+        static AsyncWriter* instance;   ///< The singleton, or null if not started.
+
+        mutable PthreadConditionVariable cv; ///< Protects and signals the state below.
+        std::list<Batch> queue;         ///< Batches waiting to be written, oldest first.
+        std::size_t max_nbytes;         ///< Bound on the bytes of pending batches.
+        std::size_t pending_nbytes;     ///< Bytes of batches submitted but not written.
+        std::size_t peak_nbytes;        ///< Largest value of pending_nbytes.
+        bool finish;                    ///< If true the thread exits once the queue is empty.
+        bool running;                   ///< True while the thread is running.
+
+        AsyncWriter();
+
+        /// The loop of the I/O thread.
+        void run();
+
+        /// Writes the pieces of a batch and syncs the files.
+
+        /// \throw MadnessException if a file cannot be opened, written or synced.
+        /// \param[in] batch The batch.
+        static void write(const Batch& batch);
+
+        /// Returns the singleton, starting the thread if needed.
+        static AsyncWriter& get();
+
+    public:
+        /// Queues pieces for writing.
+
+        /// Blocks while the pending data would exceed the bound.
+        /// \param[in,out] pieces The pieces to write; they are moved into the queue and cleared.
+        /// \param[in] name The base name of the archive the pieces belong to, if any.
+        /// \return A future that is set to true once the pieces are written and synced.
+        static Future<bool> submit(std::vector<AsyncWritePiece>& pieces,
+                                   const std::string& name = std::string());
+
+        /// Waits until all submitted batches are written.
+        static void wait();
+
+        /// Waits until the submitted batches of the named archive are written.
+
+        /// \param[in] name The base name of the archive.
+        static void wait(const std::string& name);
+
+        /// Returns true if anything was ever submitted on this process.
+        static bool started() {
+            return instance != nullptr;
+        }
+
+        /// Writes all submitted batches and stops the thread.
+        static void end();
+
+        /// Returns the bound on the data of pending batches, in bytes.
+        static std::size_t max_bytes();
+
+        /// Sets the bound on the data of pending batches.
+
+        /// \param[in] nbytes The bound, in bytes.
+        static void set_max_bytes(std::size_t nbytes);
+
+        /// Returns the data of batches submitted but not yet written, in bytes.
+        static std::size_t bytes_pending();
+
+        /// Returns the largest amount of pending data so far, in bytes.
+        static std::size_t peak_bytes();
+    }; // class AsyncWriter
+
+} // namespace madness
+
+#endif // MADNESS_WORLD_ASYNC_WRITER_H__INCLUDED
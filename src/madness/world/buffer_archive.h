@@ -62,18 +62,20 @@ namespace madness {
             const std::size_t nbyte; ///< Buffer size.
             mutable std::size_t i; /// Current output location.
             bool countonly; ///< If true just count, don't copy.
+            bool am; ///< If true the buffer holds an active message.
+            mutable int wire; ///< Mode of the compact encodings of the message, -1 until chosen.
 
         public:
             /// Default constructor; the buffer will only count data.
             BufferOutputArchive()
-                    : ptr(nullptr), nbyte(0), i(0), countonly(true) {}
+                    : ptr(nullptr), nbyte(0), i(0), countonly(true), am(false), wire(-1) {}
 
             /// Constructor that assigns a buffer.
 
             /// \param[in] ptr Pointer to the buffer.
             /// \param[in] nbyte Size of the buffer.
             BufferOutputArchive(void* ptr, std::size_t nbyte)
-                    : ptr((unsigned char *) ptr), nbyte(nbyte), i(0), countonly(false) {}
+                    : ptr((unsigned char *) ptr), nbyte(nbyte), i(0), countonly(false), am(false), wire(-1) {}
 
             /// Stores (counts) data into the memory buffer.
 
@@ -114,6 +116,37 @@ namespace madness {
             /// \return True if this buffer is only used for counting.
             bool count_only() const { return countonly; }
 
+            /// Marks the buffer as holding an active message.
+
+            /// Only active messages may store data in a compact encoding
+            /// (see \c TensorWire). The counting and the storing pass of a
+            /// message must use the same encoding, so the storing archive
+            /// is given the mode chosen by the counting one.
+            /// \param[in] mode The mode of the compact encodings, -1 to choose it when first needed.
+            void set_active_message(int mode = -1) {
+                am = true;
+                wire = mode;
+            }
+
+            /// Determine if this buffer holds an active message.
+
+            /// \return True if this buffer holds an active message.
+            bool is_active_message() const { return am; }
+
+            /// Return the mode of the compact encodings of the message.
+
+            /// \return The mode, -1 if it has not been chosen yet.
+            int wire_mode() const { return wire; }
+
+            /// Choose the mode of the compact encodings of the message, unless already chosen.
+
+            /// \param[in] mode The mode to use if none has been chosen.
+            /// \return The mode chosen for the message.
+            int wire_mode(int mode) const {
+                if (wire < 0) wire = mode;
+                return wire;
+            }
+
             /// Return the amount of data stored (counted) in the buffer.
 
             /// \return The amount of data stored (counted) in the buffer.
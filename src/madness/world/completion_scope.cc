@@ -0,0 +1,122 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file completion_scope.cc
+ \brief Implementation of \c CompletionScope.
+ \ingroup parallel_runtime
+*/
+
+#include <madness/world/completion_scope.h>
+#include <madness/world/MADworld.h>
+#include <madness/world/worldtrace.h>
+#include <cstdint>
+#include <map>
+#include <utility>
+
+namespace madness {
+
+    thread_local CompletionScope::Counters* CompletionScope::current_counters = nullptr;
+
+    namespace {
+        typedef std::pair<unsigned long, unsigned long> scope_keyT;
+
+        Mutex scope_mutex;  // Guards the two maps below
+        std::map<scope_keyT, CompletionScope::Counters*> scope_counters; // Counters by (world id, scope id)
+        std::map<unsigned long, unsigned long> scope_next_id;            // Last scope id by world id
+
+        CompletionScope::Counters* find_or_make(unsigned long worldid, unsigned long id) {
+            CompletionScope::Counters*& c = scope_counters[scope_keyT(worldid, id)];
+            if (!c) c = new CompletionScope::Counters(worldid, id);
+            return c;
+        }
+    }
+
+    CompletionScope::CompletionScope(World& world)
+        : world(world)
+    {
+        ScopedMutex<Mutex> lock(scope_mutex);
+        counters = find_or_make(world.id(), ++scope_next_id[world.id()]);
+    }
+
+    CompletionScope::~CompletionScope() {
+        ScopedMutex<Mutex> lock(scope_mutex);
+        scope_counters.erase(scope_keyT(counters->worldid, counters->id));
+        delete counters;
+    }
+
+    CompletionScope::Counters* CompletionScope::find(unsigned long worldid, unsigned long id) {
+        ScopedMutex<Mutex> lock(scope_mutex);
+        return find_or_make(worldid, id);
+    }
+
+    void CompletionScope::wait() {
+        MADNESS_TRACE_BLOCK("completion scope wait");
+        wait_quiescent();
+        while (!steps.empty()) {
+            std::function<void()> step;
+            step.swap(steps.front());
+            steps.pop_front();
+            {
+                Guard guard(*this);
+                step();
+            }
+            wait_quiescent();
+        }
+    }
+
+    void CompletionScope::wait_quiescent() {
+        Counters* const c = counters;
+        std::uint64_t nsent_prev = 0, nrecv_prev = 1; // invalid initial condition
+
+        while (true) {
+            // Counts are read twice to make sure they are consistent,
+            // as in WorldGopInterface::fence
+            int ntask;
+            std::uint64_t nsent1, nrecv1, nsent2, nrecv2;
+            do {
+                World::await([c]() { return c->ntask == 0; });
+                nsent1 = (unsigned int)(c->nsent);
+                nrecv1 = (unsigned int)(c->nrecv);
+                ntask = c->ntask;
+                nsent2 = (unsigned int)(c->nsent);
+                nrecv2 = (unsigned int)(c->nrecv);
+            } while (ntask != 0 || nsent1 != nsent2 || nrecv1 != nrecv2);
+
+            std::uint64_t sum[2] = {nsent2, nrecv2};
+            world.gop.sum(sum, 2);
+            if (sum[0] == sum[1] && sum[0] == nsent_prev && sum[1] == nrecv_prev) break;
+            nsent_prev = sum[0];
+            nrecv_prev = sum[1];
+        }
+    }
+
+} // namespace madness
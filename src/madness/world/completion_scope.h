@@ -0,0 +1,185 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_COMPLETION_SCOPE_H__INCLUDED
+#define MADNESS_WORLD_COMPLETION_SCOPE_H__INCLUDED
+
+/**
+ \file completion_scope.h
+ \brief Termination detection for a group of tasks and active messages.
+ \ingroup parallel_runtime
+*/
+
+#include <madness/world/atomicint.h>
+#include <functional>
+#include <list>
+
+namespace madness {
+
+    class World;
+
+    /// Tracks the completion of the tasks and active messages of a group of operations.
+
+    /// \c WorldGopInterface::fence waits until every task and active message
+    /// on every process is done.  A completion scope instead counts only
+    /// the work started while it is current, so that \c wait returns once
+    /// that work is done even if unrelated work is still running.
+    ///
+    /// A scope is made current on a thread with a \c Guard.  Tasks added
+    /// to a task queue and active messages sent while a scope is current
+    /// belong to it, and the scope is current while they run, so the tasks
+    /// and messages they start in turn belong to it as well.  Messages
+    /// carry the id of their scope to the receiving process.  (With the
+    /// TBB task scheduler a task does not make its scope current while it
+    /// runs, so only work started directly under a \c Guard is counted.)
+    ///
+    /// Scopes are collective: every process of the world must construct
+    /// its scopes in the same order (their ids are matched by that order)
+    /// and must call \c wait before the scope is destroyed.
+    ///
+    /// An operation made of several dependent stages adds the later stages
+    /// with \c then instead of waiting between them, so that it returns at
+    /// once.  \c wait runs each step when the work before it is done.
+    ///
+    /// \code
+    ///     CompletionScope s1(world), s2(world);
+    ///     apply(world, op, f, s1);
+    ///     truncate(world, g, tol, s2);
+    ///     s2.wait();   // g is truncated; the apply may still be running
+    ///     s1.wait();
+    /// \endcode
+    class CompletionScope {
+    public:
+        /// Counters of a scope on this process.
+        struct Counters {
+            const unsigned long worldid;  ///< Id of the world of the scope.
+            const unsigned long id;       ///< Id of the scope in its world; never zero.
+            AtomicInt ntask;              ///< Tasks (and deferred messages) not yet done.
+            AtomicInt nsent;              ///< Active messages sent.
+            AtomicInt nrecv;              ///< Active messages handled.
+
+            Counters(unsigned long worldid, unsigned long id)
+                : worldid(worldid), id(id)
+            {
+                ntask = 0;
+                nsent = 0;
+                nrecv = 0;
+            }
+        };
+
+        /// Makes a scope current on this thread for its lifetime.
+        class Guard {
+            Counters* prev;
+
+            Guard(const Guard&);
+            Guard& operator=(const Guard&);
+
+        public:
+            explicit Guard(CompletionScope& scope) : prev(set_current(scope.counters)) {}
+
+            ~Guard() { set_current(prev); }
+        };
+
+    private:
+        static thread_local Counters* current_counters; ///< The current scope of this thread.
+
+        World& world;
+        Counters* counters;
+        std::list< std::function<void()> > steps; ///< Steps not yet run by \c wait.
+
+        /// Waits until the work of the scope started so far is done on all processes.
+        void wait_quiescent();
+
+        CompletionScope(const CompletionScope&);
+        CompletionScope& operator=(const CompletionScope&);
+
+    public:
+        /// Makes a new scope; collective.
+
+        /// \param[in] world The world whose tasks and messages are counted.
+        explicit CompletionScope(World& world);
+
+        /// Destroys the scope; \c wait must have returned on all processes.
+        ~CompletionScope();
+
+        /// Waits until all work of the scope is done on all processes; collective.
+
+        /// While waiting this thread runs tasks, so other work continues.
+        /// Uses the same termination detection as \c WorldGopInterface::fence
+        /// (local quiescence, then global sums of messages sent and handled
+        /// that agree and are unchanged over two passes) applied to the
+        /// counters of this scope.  Each time the work is done the next
+        /// step added by \c then is run, with the scope current, until no
+        /// steps are left.  The scope may be used again afterwards.
+        void wait();
+
+        /// Adds a step to be run by \c wait once the work started before it is done.
+
+        /// Steps run in the order they were added, on the thread calling
+        /// \c wait, and may start more work and add more steps.  Every
+        /// process must add the same steps in the same order.
+        /// \param[in] step The step; what it refers to must outlive \c wait.
+        void then(const std::function<void()>& step) { steps.push_back(step); }
+
+        /// Returns the number of steps that \c wait has not run yet.
+        std::size_t nstep() const { return steps.size(); }
+
+        /// Returns true if no task of the scope is pending on this process.
+        bool probe_local() const { return counters->ntask == 0; }
+
+        /// Returns the id of the scope, which is the same on all processes.
+        unsigned long id() const { return counters->id; }
+
+        /// Returns the counters of the current scope of this thread, or null if none.
+        static Counters* current() { return current_counters; }
+
+        /// Sets the current scope of this thread.
+
+        /// \param[in] c The counters of the new scope, or null for none.
+        /// \return The counters of the previous scope.
+        static Counters* set_current(Counters* c) {
+            Counters* prev = current_counters;
+            current_counters = c;
+            return prev;
+        }
+
+        /// Returns the counters of a scope named by an incoming message.
+
+        /// Messages may arrive before this process has constructed the
+        /// scope, so the counters are made if they do not exist yet.
+        /// \param[in] worldid The id of the world of the scope.
+        /// \param[in] id The id of the scope.
+        static Counters* find(unsigned long worldid, unsigned long id);
+    }; // class CompletionScope
+
+} // namespace madness
+
+#endif // MADNESS_WORLD_COMPLETION_SCOPE_H__INCLUDED
@@ -54,9 +54,10 @@ namespace madness {
         uint64_t npop_front;    ///< #calls to pop_front
         uint64_t ngrow;         ///< #calls to grow
         uint64_t nmax;          ///< Lifetime max. entries in the queue
+        uint64_t nsteal;        ///< #tasks stolen from other threads (work-stealing scheduler only)
 
         DQStats()
-                : npush_back(0), npush_front(0), npop_front(0), ngrow(0), nmax(0) {}
+                : npush_back(0), npush_front(0), npop_front(0), ngrow(0), nmax(0), nsteal(0) {}
     };
 
 
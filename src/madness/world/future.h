@@ -38,6 +38,8 @@
 #ifndef MADNESS_WORLD_FUTURE_H__INCLUDED
 #define MADNESS_WORLD_FUTURE_H__INCLUDED
 
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <stack>
 #include <new>
@@ -187,6 +189,291 @@ namespace madness {
     std::ostream& operator<<(std::ostream& out, const Future<T>& f);
 
 
+#ifdef MADNESS_LOCKFREE_FUTURES
+
+    /// Implements the functionality of futures without locks.
+
+    /// The callbacks and assignments waiting for the value form a
+    /// Treiber stack whose head is a single atomic word.  Registering
+    /// pushes with a compare-and-swap, and assignment swaps in a tag that
+    /// marks the future as assigned and takes the whole list at once, so
+    /// \c probe is one atomic load.  The first few callbacks use entries
+    /// stored in the future itself, so in the common case registering
+    /// allocates nothing.  Selected by \c ENABLE_LOCKFREE_FUTURES;
+    /// otherwise the implementation below, which guards the lists with a
+    /// spinlock, is used.
+    /// \tparam T The type of future.
+    template <typename T>
+    class FutureImpl {
+        friend class Future<T>;
+        friend std::ostream& operator<< <T>(std::ostream& out, const Future<T>& f);
+
+    private:
+        /// An entry of the list of callbacks and assignments.
+        struct Waiter {
+            Waiter* next;                 ///< The entry registered before this one.
+            CallbackInterface* callback;  ///< The callback, or null for an assignment.
+        };
+
+        /// An entry for a future to be set to the value of this one.
+        struct Assignment : public Waiter {
+            std::shared_ptr< FutureImpl<T> > future;
+        };
+
+        /// The number of entries stored in the future itself.
+        static const int NWAITERS = 4;
+
+        /// Head of the list of waiters, or \c assigned_tag() once assigned.
+        std::atomic<Waiter*> head;
+
+        /// The number of entries of \c waiters handed out.
+        std::atomic<int> nwaiters;
+
+        /// Entries for the first callbacks.
+        Waiter waiters[NWAITERS];
+
+        /// Reference to a remote future pimpl.
+        RemoteReference< FutureImpl<T> > remote_ref;
+
+        T t; ///< The future data.
+
+        /// The value of \c head once the future is assigned.
+        static Waiter* assigned_tag() {
+            return reinterpret_cast<Waiter*>(std::uintptr_t(1));
+        }
+
+        /// Returns true if the entry was allocated on the heap.
+        bool on_heap(const Waiter* w) const {
+            return w < waiters || w >= waiters + NWAITERS;
+        }
+
+        /// Pushes an entry onto the list unless the future is assigned.
+
+        /// \param[in] w The entry.
+        /// \return False if the future is assigned, in which case the entry was not pushed.
+        bool push(Waiter* w) {
+            Waiter* h = head.load(std::memory_order_acquire);
+            do {
+                if (h == assigned_tag()) return false;
+                w->next = h;
+            } while (!head.compare_exchange_weak(h, w, std::memory_order_release,
+                                                 std::memory_order_acquire));
+            return true;
+        }
+
+        /// AM handler for remote set operations.
+
+        /// \param[in] arg The active message holding the reference and the value.
+        static void set_handler(const AmArg& arg) {
+            RemoteReference< FutureImpl<T> > ref;
+            archive::BufferInputArchive input_arch = arg & ref;
+            // The remote reference holds a copy of the shared_ptr, so no need
+            // to take another.
+            {
+                FutureImpl<T>* pimpl = ref.get();
+
+                if(pimpl->remote_ref) {
+                    // Unarchive the value to a temporary since it is going to
+                    // be forwarded to another node.
+                    T value;
+                    input_arch & value;
+
+                    // Copy world and owner from remote_ref since sending remote_ref
+                    // will invalidate it.
+                    World& world = pimpl->remote_ref.get_world();
+                    const ProcessID owner = pimpl->remote_ref.owner();
+                    world.am.send(owner, FutureImpl<T>::set_handler,
+                            new_am_arg(pimpl->remote_ref, value));
+
+                    pimpl->set_assigned(value);
+                } else {
+                    // Unarchive the value of the future
+                    input_arch & pimpl->t;
+
+                    pimpl->set_assigned(pimpl->t);
+                }
+            }
+            ref.reset();
+        }
+
+        /// Marks the future as assigned and runs what was waiting for it.
+
+        /// Invoked by the set routines after the value is stored; the
+        /// exchange publishes the value to threads that see the future
+        /// assigned.  The caller holds a copy of our shared pointer so
+        /// that a callback cannot destroy this object while we run.
+        /// \param[in] value The value.
+        inline void set_assigned(const T& value) {
+            Waiter* w = head.exchange(assigned_tag(), std::memory_order_acq_rel);
+            MADNESS_ASSERT(w != assigned_tag());
+
+            // Reverse the stack into the order of registration
+            Waiter* first = nullptr;
+            while (w) {
+                Waiter* next = w->next;
+                w->next = first;
+                first = w;
+                w = next;
+            }
+
+            // Assignments first, then callbacks, as in the locked implementation
+            for (w = first; w; w = w->next) {
+                if (!w->callback) static_cast<Assignment*>(w)->future->set(value);
+            }
+            for (w = first; w; ) {
+                Waiter* next = w->next;
+                if (w->callback) {
+                    w->callback->notify();
+                    if (on_heap(w)) delete w;
+                }
+                else {
+                    delete static_cast<Assignment*>(w);
+                }
+                w = next;
+            }
+        }
+
+        /// Arranges for \c f to be set to the value of this future.
+
+        /// Pass by value with implied copy to manage lifetime of \c f.
+        /// \param[in] f The future to be set.
+        inline void add_assignment(const std::shared_ptr< FutureImpl<T> > f) {
+            Assignment* a = new Assignment;
+            a->callback = nullptr;
+            a->future = f;
+            if (!push(a)) {
+                delete a;
+                f->set(t);
+            }
+        }
+
+    public:
+
+        /// Constructor that uses a local unassigned value.
+        FutureImpl()
+                : head(nullptr)
+                , nwaiters(0)
+                , remote_ref()
+                , t()
+        { }
+
+
+        /// Constructor that uses a wrapper for a remote future.
+
+        /// \param[in] remote_ref The remote reference.
+        FutureImpl(const RemoteReference< FutureImpl<T> >& remote_ref)
+                : head(nullptr)
+                , nwaiters(0)
+                , remote_ref(remote_ref)
+                , t()
+        { }
+
+
+        /// Checks if the value has been assigned.
+
+        /// \return True if the value has been assigned; false otherwise.
+        inline bool probe() const {
+            return head.load(std::memory_order_acquire) == assigned_tag();
+        }
+
+
+        /// Registers a function to be invoked when future is assigned.
+
+        /// Callbacks are invoked in the order registered. If the
+        /// future is already assigned, the callback is immediately
+        /// invoked.
+        /// \param callback The callback.
+        inline void register_callback(CallbackInterface* callback) {
+            if (probe()) {
+                callback->notify();
+                return;
+            }
+            const int i = nwaiters.fetch_add(1, std::memory_order_relaxed);
+            Waiter* w = (i < NWAITERS) ? waiters + i : new Waiter;
+            w->callback = callback;
+            if (!push(w)) {
+                if (on_heap(w)) delete w;
+                callback->notify();
+            }
+        }
+
+
+        /// Sets the value of the future (assignment).
+
+        /// \tparam U The type of the value, convertible to \c T.
+        /// \param[in] value The value.
+        template <typename U>
+        void set(const U& value) {
+            if(remote_ref) {
+                // Copy world and owner from remote_ref since sending remote_ref
+                // will invalidate it.
+                World& world = remote_ref.get_world();
+                const ProcessID owner = remote_ref.owner();
+                world.am.send(owner, FutureImpl<T>::set_handler,
+                        new_am_arg(remote_ref, value));
+                set_assigned(value);
+            } else {
+                set_assigned((t = value));
+            }
+        }
+
+
+        /// Sets the value of the future from an archive.
+
+        /// \param[in] input_arch The archive holding the value.
+        void set(const archive::BufferInputArchive& input_arch) {
+            MADNESS_ASSERT(! remote_ref);
+            input_arch & t;
+            set_assigned(t);
+        }
+
+
+        /// Gets/forces the value, waiting if necessary.
+
+        /// \attention Throws an error if not local.
+        /// \return The value.
+        T& get() {
+            MADNESS_ASSERT(! remote_ref);  // Only for local futures
+            World::await([this] () -> bool { return this->probe(); });
+            return t;
+        }
+
+
+        /// Gets/forces the value, waiting if necessary.
+
+        /// \attention Throws an error if not local.
+        /// \return The value.
+        const T& get() const {
+            MADNESS_ASSERT(! remote_ref);  // Only for local futures
+            World::await([this] () -> bool { return this->probe(); });
+            return t;
+        }
+
+        /// Returns true if the future is not a wrapper for a remote future.
+        bool is_local() const {
+            return ! remote_ref;
+        }
+
+        /// Not implemented.
+        bool replace_with(FutureImpl<T>* f) {
+            MADNESS_EXCEPTION("IS THIS WORKING? maybe now we have the mutex", 0);
+            return true;
+        }
+
+        /// Destructor.
+
+        /// Aborts if callbacks or assignments were never invoked.
+        virtual ~FutureImpl() {
+            Waiter* h = head.load(std::memory_order_acquire);
+            if (h != assigned_tag() && h != nullptr) {
+                print("Future: uninvoked callbacks or assignments being destroyed?", false);
+                abort();
+            }
+        }
+    }; // class FutureImpl
+
+#else // MADNESS_LOCKFREE_FUTURES
+
     /// Implements the functionality of futures.
 
     /// \tparam T The type of future.
@@ -308,6 +595,14 @@ namespace madness {
             }
         }
 
+        /// Arranges for \c f to be set to the value of this future.
+
+        /// \param[in] f The future to be set.
+        inline void add_assignment(const std::shared_ptr< FutureImpl<T> > f) {
+            ScopedMutex<Spinlock> fred(this);
+            add_to_assignments(f); // Recheck of assigned is performed in here
+        }
+
 
     public:
 
@@ -457,6 +752,8 @@ namespace madness {
         }
     }; // class FutureImpl
 
+#endif // MADNESS_LOCKFREE_FUTURES
+
 
     /// A future is a possibly yet unevaluated value.
 
@@ -501,7 +798,11 @@ namespace madness {
 
         /// Makes an unassigned future.
         Future() :
+#ifdef MADNESS_LOCKFREE_FUTURES
+            f(std::make_shared< FutureImpl<T> >()), value(nullptr) // One allocation
+#else
             f(new FutureImpl<T>()), value(nullptr)
+#endif
         { }
 
         /// Makes an assigned future.
@@ -620,10 +921,7 @@ namespace madness {
                     std::shared_ptr< FutureImpl<T> > ff = f; // manage lifetime of me
                     std::shared_ptr< FutureImpl<T> > of = other.f; // manage lifetime of other
 
-                    { // BEGIN CRITICAL SECTION
-                        ScopedMutex<Spinlock> fred(of.get());
-                        of->add_to_assignments(ff); // Recheck of assigned is performed in here
-                    } // END CRITICAL SECTION
+                    of->add_assignment(ff);
                 }
             }
         }
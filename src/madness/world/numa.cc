@@ -0,0 +1,131 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file numa.cc
+ \brief NUMA domains of the node.
+ \ingroup threads
+*/
+
+#include <madness/world/numa.h>
+#include <madness/world/thread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace madness {
+
+    namespace {
+
+        /// Parses a Linux cpu list such as "0-3,8-11".
+        std::vector<int> parse_cpulist(const std::string& s) {
+            std::vector<int> cpus;
+            std::istringstream in(s);
+            std::string range;
+            while (std::getline(in, range, ',')) {
+                int lo = 0, hi = 0;
+                const int n = std::sscanf(range.c_str(), "%d-%d", &lo, &hi);
+                if (n < 1) continue;
+                if (n == 1) hi = lo;
+                for (int c=lo; c<=hi; ++c) cpus.push_back(c);
+            }
+            return cpus;
+        }
+
+        struct Domains {
+            std::vector< std::vector<int> > cpus;
+
+            Domains() {
+                const int ncpu = ThreadBase::num_hw_processors();
+                const char* env = std::getenv("MAD_NUMA_DOMAINS");
+                if (env) {
+                    int n = std::atoi(env);
+                    if (n < 1) n = 1;
+                    cpus.resize(n);
+                    if (n <= ncpu)
+                        for (int c=0; c<ncpu; ++c) cpus[(long(c)*n)/ncpu].push_back(c);
+                    else // more domains than cpus ... they have to share
+                        for (int d=0; d<n; ++d) cpus[d].push_back(d % ncpu);
+                    return;
+                }
+#ifdef __linux__
+                for (int d=0; ; ++d) {
+                    std::ifstream f("/sys/devices/system/node/node" + std::to_string(d) + "/cpulist");
+                    if (!f) break;
+                    std::string s;
+                    std::getline(f, s);
+                    std::vector<int> c = parse_cpulist(s);
+                    if (!c.empty()) cpus.push_back(c);
+                }
+#endif
+                if (cpus.empty()) {
+                    cpus.resize(1);
+                    for (int c=0; c<ncpu; ++c) cpus[0].push_back(c);
+                }
+            }
+        };
+
+        const Domains& domains() {
+            static const Domains d;
+            return d;
+        }
+
+    } // namespace
+
+    bool NumaTopology::enabled() {
+        static const bool on = [] {
+            const char* env = std::getenv("MAD_BIND_NUMA");
+            if (!env) return false;
+            return std::strcmp(env, "1") == 0 || std::strcmp(env, "on") == 0 || std::strcmp(env, "yes") == 0;
+        }();
+        return on;
+    }
+
+    int NumaTopology::ndomain() {
+        return int(domains().cpus.size());
+    }
+
+    const std::vector<int>& NumaTopology::cpus(int domain) {
+        return domains().cpus.at(domain);
+    }
+
+    int NumaTopology::domain_of_cpu(int cpu) {
+        const Domains& d = domains();
+        for (std::size_t i=0; i<d.cpus.size(); ++i) {
+            for (int c : d.cpus[i]) if (c == cpu) return int(i);
+        }
+        return 0;
+    }
+
+} // namespace madness
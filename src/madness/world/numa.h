@@ -0,0 +1,101 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_NUMA_H__INCLUDED
+#define MADNESS_WORLD_NUMA_H__INCLUDED
+
+/**
+ \file numa.h
+ \brief NUMA domains of the node and placement of pool threads on them.
+ \ingroup threads
+*/
+
+#include <vector>
+#include <cstddef>
+
+namespace madness {
+
+    /// The NUMA domains (memory nodes) of this node.
+
+    /// The domains and their cpus are read from
+    /// \c /sys/devices/system/node on Linux; elsewhere, or if that
+    /// fails, there is a single domain holding every cpu.  Setting
+    /// \c MAD_NUMA_DOMAINS to \c n instead splits the cpus into \c n
+    /// contiguous domains, which is useful for testing.
+    ///
+    /// NUMA placement is used only if \c MAD_BIND_NUMA is set to \c 1,
+    /// \c on or \c yes.  Pool threads are then dealt round robin to the
+    /// domains (thread \c i to domain \c i%ndomain()) and bound to the
+    /// cpus of their domain, or to a single cpu of it if \c MAD_BIND
+    /// binds pool threads.  With the work-stealing scheduler each domain
+    /// also gets a task queue; tasks that carry a domain hint (see
+    /// \c TaskAttributes::set_numa_domain) go there and are run by
+    /// threads of that domain before those steal elsewhere.
+    class NumaTopology {
+    public:
+        /// Returns true if NUMA placement was requested (\c MAD_BIND_NUMA).
+        static bool enabled();
+
+        /// Returns the number of domains (at least one).
+        static int ndomain();
+
+        /// Returns the cpus of a domain.
+
+        /// \param[in] domain The domain.
+        /// \return The cpus, in increasing order.
+        static const std::vector<int>& cpus(int domain);
+
+        /// Returns the domain of a cpu, or 0 if unknown.
+
+        /// \param[in] cpu The cpu.
+        /// \return The domain.
+        static int domain_of_cpu(int cpu);
+
+        /// Returns the domain of a pool thread when NUMA placement is enabled.
+
+        /// \param[in] ind The index of the thread in the pool.
+        /// \return The domain.
+        static int domain_of_thread(int ind) {
+            return ind % ndomain();
+        }
+
+        /// Returns the domain owning data with the given hash.
+
+        /// \param[in] hash The hash.
+        /// \return The domain.
+        static int domain_of_hash(std::size_t hash) {
+            return int(hash % std::size_t(ndomain()));
+        }
+    };
+
+} // namespace madness
+
+#endif // MADNESS_WORLD_NUMA_H__INCLUDED
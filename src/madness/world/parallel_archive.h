@@ -43,10 +43,15 @@
 #include <madness/world/binary_fstream_archive.h>
 #include <madness/world/world.h>
 #include <madness/world/worldgop.h>
+#include <madness/world/async_writer.h>
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
 #include <cstring>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 namespace madness {
     namespace archive {
@@ -57,6 +62,63 @@ namespace madness {
         /// Objects that implement their own parallel archive interface should derive from this class.
         class ParallelSerializableObject {};
 
+        namespace detail {
+
+            /// Opens a file of an indexed parallel archive.
+
+            /// \throw MadnessException if the file cannot be opened.
+            /// \param[in] filename Name of the file.
+            /// \param[in] flags Flags passed to \c open.
+            /// \return The file descriptor.
+            inline int open_indexed(const std::string& filename, int flags) {
+                int fd = ::open(filename.c_str(), flags, 0644);
+                if (fd < 0) {
+                    std::string msg = "open_indexed: cannot open " + filename;
+                    MADNESS_EXCEPTION(msg.c_str(), errno);
+                }
+                return fd;
+            }
+
+            /// Writes \c n bytes at the given offset, retrying partial writes.
+
+            /// \throw MadnessException if the write fails.
+            /// \param[in] fd The file descriptor.
+            /// \param[in] buf The data.
+            /// \param[in] n The number of bytes.
+            /// \param[in] offset The offset in the file.
+            inline void pwrite_all(int fd, const void* buf, std::size_t n, off_t offset) {
+                const char* p = static_cast<const char*>(buf);
+                while (n) {
+                    ssize_t m = ::pwrite(fd, p, n, offset);
+                    if (m < 0 && errno == EINTR) continue;
+                    if (m <= 0) MADNESS_EXCEPTION("pwrite_all: write failed", errno);
+                    p += m;
+                    n -= m;
+                    offset += m;
+                }
+            }
+
+            /// Reads \c n bytes at the given offset, retrying partial reads.
+
+            /// \throw MadnessException if the read fails or hits the end of the file.
+            /// \param[in] fd The file descriptor.
+            /// \param[out] buf Where to store the data.
+            /// \param[in] n The number of bytes.
+            /// \param[in] offset The offset in the file.
+            inline void pread_all(int fd, void* buf, std::size_t n, off_t offset) {
+                char* p = static_cast<char*>(buf);
+                while (n) {
+                    ssize_t m = ::pread(fd, p, n, offset);
+                    if (m < 0 && errno == EINTR) continue;
+                    if (m <= 0) MADNESS_EXCEPTION("pread_all: read failed", errno);
+                    p += m;
+                    n -= m;
+                    offset += m;
+                }
+            }
+
+        } // namespace detail
+
 
         /// Base class for input and output parallel archives.
 
@@ -70,13 +132,15 @@ namespace madness {
             bool do_fence; ///< If true (default), a read/write of parallel objects fences before and after I/O.
             char fname[256]; ///< Name of the archive.
             int nclient; ///< Number of clients of this node, including self. Zero if not I/O node.
+            bool indexed; ///< If true, containers are written in the indexed format.
+            mutable int nindexed; ///< Number of containers written in the indexed format.
 
         public:
             static const bool is_parallel_archive = true; ///< Mark this class as a parallel archive.
 
             /// Default constructor.
             BaseParallelArchive()
-                : world(nullptr), ar(), nio(0), do_fence(true) {}
+                : world(nullptr), ar(), nio(0), do_fence(true), indexed(false), nindexed(0) {}
 
             /// Returns the process doing I/O for given node.
 
@@ -120,6 +184,13 @@ namespace madness {
                 return world;
             }
 
+            /// Returns the base name of the archive.
+
+            /// \return The base name of the archive.
+            const char* get_filename() const {
+                return fname;
+            }
+
             /// Opens the parallel archive.
 
             /// \attention When writing to a new archive, the number of writers
@@ -152,7 +223,18 @@ namespace madness {
 
                 MADNESS_ASSERT(filename);
                 MADNESS_ASSERT(strlen(filename)-1<sizeof(fname));
+
+                // A checkpoint of the same name may still be written in the
+                // background, by any process.  Checkpoints are collective,
+                // so either all processes have started the writer or none.
+                if (AsyncWriter::started()) {
+                    AsyncWriter::wait(filename);
+                    world.gop.barrier();
+                }
+
                 strcpy(fname,filename); // Save the filename for later
+                indexed = false;
+                nindexed = 0;
                 char buf[256];
                 MADNESS_ASSERT(strlen(filename)+7 <= sizeof(buf));
                 sprintf(buf, "%s.%5.5d", filename, world.rank());
@@ -243,6 +325,9 @@ namespace madness {
                         sprintf(buf, "%s.%5.5d", filename, p);
                         if (::remove(buf)) break;
                     }
+                    for (int seq=0; ; ++seq) {
+                        if (::remove(indexed_filename(filename, seq).c_str())) break;
+                    }
                 }
             }
 
@@ -265,6 +350,69 @@ namespace madness {
             void set_dofence(bool dofence) {
                 do_fence = dofence;
             }
+
+            /// Check if containers are written in the indexed format.
+
+            /// \return True if containers are written in the indexed format.
+            bool is_indexed() const {
+                return indexed;
+            }
+
+            /// Set the format for containers written to an output archive.
+
+            /// In the indexed format every process writes its own entries
+            /// of a container directly into a shared file, `filename.dcNNNNN`,
+            /// that starts with a table of fixed-size (key, offset, length)
+            /// records. On reading, every process reads a contiguous part of
+            /// that table and of the data, and sends the entries to their
+            /// owners, so any number of processes can read the archive. Only
+            /// the cookie and sequence number go through the local archive.
+            /// Reading detects the format, so this has no effect on input
+            /// archives. Reset by \c open.
+            ///
+            /// \attention The files are written with \c pwrite, which
+            /// requires a shared file system. Open the archive with one
+            /// writer so that the local archive can be read by any number
+            /// of processes.
+            /// \param[in] flag True to use the indexed format.
+            void set_indexed(bool flag) {
+                indexed = flag;
+            }
+
+            /// Returns the name of the local archive of this process.
+
+            /// \return The file name.
+            std::string local_filename() const {
+                char buf[256];
+                sprintf(buf, "%s.%5.5d", fname, world->rank());
+                return buf;
+            }
+
+            /// Returns the sequence number of the next indexed container.
+
+            /// \return The sequence number, counting from zero.
+            int next_indexed() const {
+                return nindexed++;
+            }
+
+            /// Returns the name of the file holding an indexed container.
+
+            /// \param[in] seq The sequence number of the container.
+            /// \return The file name.
+            std::string indexed_filename(int seq) const {
+                return indexed_filename(fname, seq);
+            }
+
+            /// Returns the name of the file holding an indexed container.
+
+            /// \param[in] filename Base name of the archive.
+            /// \param[in] seq The sequence number of the container.
+            /// \return The file name.
+            static std::string indexed_filename(const char* filename, int seq) {
+                char buf[32];
+                sprintf(buf, ".dc%5.5d", seq);
+                return std::string(filename) + buf;
+            }
         };
 
 
@@ -281,16 +429,19 @@ namespace madness {
         /// Process zero records the number of writers so that, when the archive is opened
         /// for reading, the number of readers is forced to match.
         class ParallelOutputArchive : public BaseParallelArchive<BinaryFstreamOutputArchive>, public BaseOutputArchive {
+            bool async; ///< If true, indexed containers are written by the I/O thread.
+            mutable std::vector<AsyncWritePiece> deferred; ///< Writes queued by \c close_async.
+
         public:
             /// Default constructor.
-            ParallelOutputArchive() {}
+            ParallelOutputArchive() : async(false) {}
 
             /// Creates a parallel archive for output with given base filename and number of I/O nodes.
 
             /// \param[in] world The world.
             /// \param[in] filename Base name of the file.
             /// \param[in] nio The number of I/O nodes.
-            ParallelOutputArchive(World& world, const char* filename, int nio=1)  {
+            ParallelOutputArchive(World& world, const char* filename, int nio=1) : async(false) {
                 open(world, filename, nio);
             }
 
@@ -298,6 +449,50 @@ namespace madness {
             void flush() {
                 if (is_io_node()) local_archive().flush();
             }
+
+            /// Check if containers are written in the background.
+
+            /// \return True if containers are written in the background.
+            bool is_async() const {
+                return async;
+            }
+
+            /// Write containers in the background.
+
+            /// Containers are stored in the indexed format (see \c set_indexed),
+            /// but each process only serializes its entries into buffers, which
+            /// are the snapshot of the container, and keeps them until
+            /// \c close_async hands them to the \c AsyncWriter thread. The
+            /// memory of the snapshots is bounded by \c AsyncWriter::max_bytes.
+            /// Reset by \c close_async.
+            /// \param[in] flag True to write in the background.
+            void set_async(bool flag) {
+                async = flag;
+                if (flag) set_indexed(true);
+            }
+
+            /// Keep a buffer for writing by \c close_async.
+
+            /// \param[in] filename The file.
+            /// \param[in] offset Where to write the data.
+            /// \param[in,out] data The data; moved into the archive and cleared.
+            void defer(const std::string& filename, off_t offset, std::vector<unsigned char>& data) const {
+                deferred.push_back(AsyncWritePiece(filename, offset));
+                deferred.back().data.swap(data);
+            }
+
+            /// Closes the archive and writes the deferred buffers in the background.
+
+            /// Not collective. The local archive is closed immediately and
+            /// synced by the I/O thread after the buffers are written.
+            /// \return A future that is set to true once the data of this
+            /// process is on disk, and to false if writing failed.
+            Future<bool> close_async() {
+                if (is_io_node()) deferred.push_back(AsyncWritePiece(local_filename(), 0));
+                close();
+                async = false;
+                return AsyncWriter::submit(deferred, get_filename());
+            }
         };
 
         /// An archive for storing local or parallel data, wrapping a \c BinaryFstreamInputArchive.
@@ -311,6 +506,9 @@ namespace madness {
         /// forced to be the same as the original number of writers and,
         /// therefore, you cannot presently read an archive from a parallel job
         /// with fewer total processes than the number of writers.
+        /// Containers written in the indexed format (see
+        /// \c BaseParallelArchive::set_indexed) are read by all processes,
+        /// whatever their number.
         class ParallelInputArchive : public BaseParallelArchive<BinaryFstreamInputArchive>, public  BaseInputArchive {
         public:
             /// Default constructor.
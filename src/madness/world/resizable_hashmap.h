@@ -0,0 +1,915 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_RESIZABLE_HASHMAP_H__INCLUDED
+#define MADNESS_WORLD_RESIZABLE_HASHMAP_H__INCLUDED
+
+/// \file resizable_hashmap.h
+/// \brief Defines and implements a concurrent hashmap that grows with its contents
+
+// ResizableHashMap is a drop-in alternative to ConcurrentHashMap.  The
+// interface, the accessors and the per-entry reader/writer locks are the
+// same, and an accessor or an iterator stays valid while other threads
+// insert, but the table is different:
+//
+// - A bucket is one cache line holding the hash tags of and pointers
+//   to five entries.  Full buckets chain further cache-line buckets.
+//
+// - Each bucket has a sequence lock.  Writers take it, readers that do
+//   not lock an entry (find returning an iterator, the probe of
+//   WorldContainer) only read the version before and after scanning the
+//   bucket, and retry if it changed.  This requires a trivially
+//   destructible key; other keys are read under the lock.
+//
+// - When the map holds more than two entries per bucket a table of twice
+//   the size is allocated, and every insert, erase and locking find
+//   copies a few buckets to it until all are copied.  A bucket is always
+//   copied before a writer touches the key in the new table.  The old
+//   table keeps its pointers and lives until clear() or destruction, so
+//   iterators over it stay valid.
+//
+// - The memory of erased entries goes to a free list of the map instead
+//   of back to the heap, and an erased entry is marked dead.  So readers
+//   and iterators never touch freed memory; a stale pointer left in an
+//   old table shows either a dead entry, which is skipped, or an entry
+//   inserted later.  The memory is returned by clear() or destruction.
+
+#include <madness/world/worldhashmap.h>
+#include <madness/world/posixmem.h>
+#include <madness/world/timers.h>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <stdio.h>
+
+namespace madness {
+
+    namespace Hash_private {
+
+        /// An entry of a ResizableHashMap
+        template <typename keyT, typename valueT>
+        class resizable_entry : public madness::MutexReaderWriter {
+        public:
+            typedef std::pair<const keyT, valueT> datumT;
+            datumT datum;
+
+            std::atomic<bool> alive;    ///< False once erased
+
+            resizable_entry(const datumT& datum) : datum(datum), alive(true) {}
+
+            /// True if the pointer is to an entry that was not erased
+            static bool live(const resizable_entry* e) {
+                return e && e->alive.load(std::memory_order_acquire);
+            }
+        };
+
+        /// A cache line of a ResizableHashMap table
+        template <typename entryT>
+        struct ResizableBucket {
+            static const int NSLOT = 5;
+
+            std::atomic<unsigned int> version;          ///< Odd while a writer holds the bucket (head of chain only)
+            std::atomic<unsigned short> tag[NSLOT];     ///< Hash tags of the entries
+            std::atomic<entryT*> slot[NSLOT];           ///< The entries, or null
+            std::atomic<ResizableBucket*> next;         ///< Overflow bucket, or null
+
+            ResizableBucket() : version(0), next(nullptr) {
+                for (int i=0; i<NSLOT; ++i) {
+                    tag[i].store(0, std::memory_order_relaxed);
+                    slot[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+
+            /// Allocates a bucket aligned to a cache line
+            static ResizableBucket* allocate(std::size_t n) {
+                void* p = nullptr;
+                if (posix_memalign(&p, 64, n*sizeof(ResizableBucket)))
+                    throw std::bad_alloc();
+                ResizableBucket* b = static_cast<ResizableBucket*>(p);
+                for (std::size_t i=0; i<n; ++i) new (b+i) ResizableBucket();
+                return b;
+            }
+
+            /// Frees the overflow buckets of a chain
+            void free_chain() {
+                ResizableBucket* b = next.load(std::memory_order_relaxed);
+                while (b) {
+                    ResizableBucket* n = b->next.load(std::memory_order_relaxed);
+                    b->~ResizableBucket();
+                    free(b);
+                    b = n;
+                }
+                next.store(nullptr, std::memory_order_relaxed);
+            }
+
+            /// Number of entries in the chain starting here
+            std::size_t count() const {
+                std::size_t n = 0;
+                for (const ResizableBucket* b=this; b; b=b->next.load(std::memory_order_acquire))
+                    for (int i=0; i<NSLOT; ++i)
+                        if (entryT::live(b->slot[i].load(std::memory_order_acquire))) ++n;
+                return n;
+            }
+
+            /// Takes the sequence lock of the chain
+            void lock() {
+                MutexWaiter waiter;
+                while (true) {
+                    unsigned int v = version.load(std::memory_order_relaxed);
+                    if (!(v & 1u) &&
+                        version.compare_exchange_weak(v, v+1, std::memory_order_acquire)) break;
+                    waiter.wait();
+                }
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+
+            /// Releases the sequence lock of the chain
+            void unlock() {
+                version.fetch_add(1, std::memory_order_release);
+            }
+
+            /// Adds an entry to the chain; the caller holds the lock
+            void add(entryT* entry, unsigned short t) {
+                ResizableBucket* b = this;
+                while (true) {
+                    for (int i=0; i<NSLOT; ++i) {
+                        if (!b->slot[i].load(std::memory_order_relaxed)) {
+                            b->tag[i].store(t, std::memory_order_relaxed);
+                            b->slot[i].store(entry, std::memory_order_release);
+                            return;
+                        }
+                    }
+                    ResizableBucket* n = b->next.load(std::memory_order_relaxed);
+                    if (!n) {
+                        n = allocate(1);
+                        b->next.store(n, std::memory_order_release);
+                    }
+                    b = n;
+                }
+            }
+        };
+
+        /// A table of a ResizableHashMap
+        template <typename entryT>
+        struct ResizableTable {
+            typedef ResizableBucket<entryT> bucketT;
+
+            static const std::size_t CHUNK = 16; ///< Buckets copied at a time while resizing
+
+            const std::size_t nbucket;          ///< Number of buckets, a power of two
+            const int shift;                    ///< 64 - log2(nbucket)
+            bucketT* const buckets;             ///< The buckets
+            std::atomic<bool>* const moved;     ///< Bucket was copied to the next table
+            std::atomic<ResizableTable*> next;  ///< The table this one is copied to, or null
+            std::atomic<std::size_t> claimed;   ///< Buckets claimed for copying
+            std::atomic<std::size_t> copied;    ///< Buckets claimed and copied
+
+            static int log2(std::size_t n) {
+                int k = 0;
+                while ((std::size_t(1) << k) < n) ++k;
+                return k;
+            }
+
+            explicit ResizableTable(std::size_t n)
+                : nbucket(n)
+                , shift(64 - log2(n))
+                , buckets(bucketT::allocate(n))
+                , moved(new std::atomic<bool>[n])
+                , next(nullptr)
+                , claimed(0)
+                , copied(0)
+            {
+                for (std::size_t i=0; i<n; ++i) moved[i].store(false, std::memory_order_relaxed);
+            }
+
+            ~ResizableTable() {
+                for (std::size_t i=0; i<nbucket; ++i) {
+                    buckets[i].free_chain();
+                    buckets[i].~bucketT();
+                }
+                free(buckets);
+                delete [] moved;
+            }
+
+            /// The bucket of a mixed hash
+            std::size_t index(std::uint64_t h) const {
+                return (nbucket == 1) ? 0 : std::size_t(h >> shift);
+            }
+
+        private:
+            ResizableTable(const ResizableTable&);
+            ResizableTable& operator=(const ResizableTable&);
+        };
+
+
+        /// iterator for ResizableHashMap
+
+        /// Walks the table that was current when \c begin was called.
+        template <class hashT> class ResizableHashIterator {
+        public:
+            typedef typename std::conditional<std::is_const<hashT>::value,
+                    typename std::add_const<typename hashT::entryT>::type,
+                    typename hashT::entryT>::type entryT;
+            typedef typename std::conditional<std::is_const<hashT>::value,
+                    typename std::add_const<typename hashT::datumT>::type,
+                    typename hashT::datumT>::type datumT;
+            typedef typename hashT::tableT tableT;
+            typedef typename hashT::bucketT bucketT;
+            typedef std::forward_iterator_tag iterator_category;
+            typedef datumT value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef datumT* pointer;
+            typedef datumT& reference;
+
+        private:
+            hashT* h;               // Associated hash table
+            tableT* t;              // Table being walked
+            std::size_t ibucket;    // Current bucket of the table
+            bucketT* b;             // Current cache line of the chain
+            int islot;              // Current slot of the cache line
+            entryT* entry;          // Current entry ... zero means at end
+
+            template <class otherHashT>
+            friend class ResizableHashIterator;
+
+            /// Moves to the next slot holding an entry, or to the end
+            void next_entry() {
+                while (true) {
+                    if (++islot == bucketT::NSLOT) {
+                        islot = 0;
+                        b = b->next.load(std::memory_order_acquire);
+                        if (!b) {
+                            if (++ibucket == t->nbucket) {
+                                entry = 0;
+                                return;
+                            }
+                            b = t->buckets + ibucket;
+                        }
+                    }
+                    entry = b->slot[islot].load(std::memory_order_acquire);
+                    if (entryT::live(entry)) return;
+                }
+            }
+
+        public:
+
+            /// Makes invalid iterator
+            ResizableHashIterator() : h(0), t(0), ibucket(0), b(0), islot(0), entry(0) {}
+
+            /// Makes end iterator
+            explicit ResizableHashIterator(hashT* h) : h(h), t(0), ibucket(0), b(0), islot(0), entry(0) {}
+
+            /// Makes begin iterator
+            ResizableHashIterator(hashT* h, tableT* t)
+                    : h(h), t(t), ibucket(0), b(t->buckets), islot(-1), entry(0) {
+                next_entry();
+            }
+
+            /// Makes iterator to specific entry
+            ResizableHashIterator(hashT* h, tableT* t, std::size_t ibucket, bucketT* b, int islot, entryT* entry)
+                    : h(h), t(t), ibucket(ibucket), b(b), islot(islot), entry(entry) {}
+
+            /// Copy constructor
+            ResizableHashIterator(const ResizableHashIterator& other)
+                    : h(other.h), t(other.t), ibucket(other.ibucket), b(other.b)
+                    , islot(other.islot), entry(other.entry) {}
+
+            /// Implicit conversion of another hash type to this hash type
+
+            /// This allows implicit conversion from hash types to const hash
+            /// types.
+            template <class otherHashT>
+            ResizableHashIterator(const ResizableHashIterator<otherHashT>& other)
+                    : h(other.h), t(other.t), ibucket(other.ibucket), b(other.b)
+                    , islot(other.islot), entry(other.entry) {}
+
+            ResizableHashIterator& operator=(const ResizableHashIterator& other) {
+                h = other.h;
+                t = other.t;
+                ibucket = other.ibucket;
+                b = other.b;
+                islot = other.islot;
+                entry = other.entry;
+                return *this;
+            }
+
+            ResizableHashIterator& operator++() {
+                if (!entry) return *this;
+                next_entry();
+                return *this;
+            }
+
+            ResizableHashIterator operator++(int) {
+                ResizableHashIterator old(*this);
+                operator++();
+                return old;
+            }
+
+            /// Difference between iterators \em only supported for this=start and other=end
+
+            /// This exists to support construction of range for parallel iteration
+            /// over the entire container.
+            int distance(const ResizableHashIterator& other) const {
+                MADNESS_ASSERT(h && h == other.h  &&  other == h->end()  &&  *this == h->begin());
+                return h->size();
+            }
+
+            /// Only positive increments are supported
+
+            /// This exists to support splitting of range for parallel iteration.
+            void advance(int n) {
+                if (n==0 || !entry) return;
+                MADNESS_ASSERT(n>=0);
+
+                // Linear increment up to the end of this chain
+                while (n) {
+                    do {
+                        if (++islot == bucketT::NSLOT) {
+                            islot = 0;
+                            b = b->next.load(std::memory_order_acquire);
+                            if (!b) break;
+                        }
+                        entry = b->slot[islot].load(std::memory_order_acquire);
+                    } while (!entryT::live(entry));
+                    if (!b) break;
+                    --n;
+                }
+                if (n == 0) return;
+
+                // Skip whole chains
+                while (true) {
+                    if (++ibucket == t->nbucket) {
+                        entry = 0;
+                        return; // end
+                    }
+                    std::size_t c = t->buckets[ibucket].count();
+                    if (std::size_t(n) <= c) break;
+                    n -= c;
+                }
+
+                // Linear increment to the target, the first entry counting as one
+                b = t->buckets + ibucket;
+                islot = -1;
+                while (n--) next_entry();
+            }
+
+            bool operator==(const ResizableHashIterator& a) const {
+                return entry==a.entry;
+            }
+
+            bool operator!=(const ResizableHashIterator& a) const {
+                return entry!=a.entry;
+            }
+
+            reference operator*() const {
+                MADNESS_ASSERT(entry);
+                return entry->datum;
+            }
+
+            pointer operator->() const {
+                MADNESS_ASSERT(entry);
+                return &entry->datum;
+            }
+        };
+
+    } // End of namespace Hash_private
+
+
+    /// A concurrent hashmap that grows with its contents
+
+    /// Same interface and semantics as ConcurrentHashMap.  See the notes at
+    /// the top of resizable_hashmap.h.
+    template < class keyT, class valueT, class hashfunT = Hash<keyT> >
+    class ResizableHashMap {
+    public:
+        typedef ResizableHashMap<keyT,valueT,hashfunT> hashT;
+        typedef std::pair<const keyT,valueT> datumT;
+        typedef Hash_private::resizable_entry<keyT,valueT> entryT;
+        typedef Hash_private::ResizableBucket<entryT> bucketT;
+        typedef Hash_private::ResizableTable<entryT> tableT;
+        typedef Hash_private::ResizableHashIterator<hashT> iterator;
+        typedef Hash_private::ResizableHashIterator<const hashT> const_iterator;
+        typedef Hash_private::HashAccessor<hashT,entryT::WRITELOCK> accessor;
+        typedef Hash_private::HashAccessor<const hashT,entryT::READLOCK> const_accessor;
+
+        friend class Hash_private::ResizableHashIterator<hashT>;
+        friend class Hash_private::ResizableHashIterator<const hashT>;
+
+    private:
+        /// True if readers may scan buckets without the lock
+        static const bool optimistic = std::is_trivially_destructible<keyT>::value;
+
+        mutable hashfunT hashfun;
+        const std::size_t nbucket0;                 // Size of the first table
+        mutable std::atomic<tableT*> current;       // Where new entries go
+        mutable std::atomic<tableT*> old;           // Table being copied to current, or null
+        mutable std::atomic<std::size_t> count;     // Number of entries
+        mutable Spinlock resize_mutex;              // Serializes starting and finishing resizes
+        mutable std::vector<tableT*> retired;       // Copied tables, kept for iterators
+        mutable std::atomic<std::size_t> nresize;   // Number of resizes so far
+        Spinlock pool_mutex;                        // Guards free_entries
+        void* free_entries;                         // Memory of erased entries
+
+        static std::size_t nbucket_pow2(int n) {
+            std::size_t nb = 16;
+            while (nb < std::size_t(n)/2) nb *= 2;
+            return nb;
+        }
+
+        /// Fibonacci hashing spreads the hash over the high bits used for the index
+        std::uint64_t mixed_hash(const keyT& key) const {
+            return std::uint64_t(hashfun(key)) * 0x9E3779B97F4A7C15ull;
+        }
+
+        static unsigned short tag_of(std::uint64_t h) {
+            return (unsigned short)(h >> 8);
+        }
+
+        entryT* new_entry(const datumT& datum) {
+            void* p = nullptr;
+            pool_mutex.lock();
+            if (free_entries) {
+                p = free_entries;
+                free_entries = *static_cast<void**>(p);
+            }
+            pool_mutex.unlock();
+            if (!p) p = ::operator new(sizeof(entryT));
+            return new (p) entryT(datum);
+        }
+
+        /// Destroys an entry, keeping its memory in the map
+        void delete_entry(entryT* e) {
+            e->~entryT();
+            pool_mutex.lock();
+            *reinterpret_cast<void**>(e) = free_entries;
+            free_entries = e;
+            pool_mutex.unlock();
+        }
+
+        void free_pool() {
+            while (free_entries) {
+                void* p = free_entries;
+                free_entries = *static_cast<void**>(p);
+                ::operator delete(p);
+            }
+        }
+
+        /// Scans a chain for the key; the caller holds the lock or validates the version
+        static entryT* match(bucketT* head, const keyT& key, unsigned short tag,
+                             bucketT*& where, int& islot) {
+            for (bucketT* b=head; b; b=b->next.load(std::memory_order_acquire)) {
+                for (int i=0; i<bucketT::NSLOT; ++i) {
+                    if (b->tag[i].load(std::memory_order_relaxed) != tag) continue;
+                    entryT* e = b->slot[i].load(std::memory_order_acquire);
+                    if (entryT::live(e) && e->datum.first == key) {
+                        where = b;
+                        islot = i;
+                        return e;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        /// Scans a chain for the key without taking the lock
+        static entryT* optimistic_match(bucketT* head, const keyT& key, unsigned short tag,
+                                        bucketT*& where, int& islot) {
+            MutexWaiter waiter;
+            while (true) {
+                unsigned int v = head->version.load(std::memory_order_acquire);
+                if (v & 1u) {
+                    waiter.wait();
+                    continue;
+                }
+                entryT* e = match(head, key, tag, where, islot);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (head->version.load(std::memory_order_relaxed) == v) return e;
+            }
+        }
+
+        /// Copies bucket i of table o to the next table, if not done yet
+        void copy_bucket(tableT* o, std::size_t i) const {
+            if (o->moved[i].load(std::memory_order_acquire)) return;
+            tableT* n = o->next.load(std::memory_order_acquire);
+            bucketT& head = o->buckets[i];
+            head.lock();
+            if (!o->moved[i].load(std::memory_order_relaxed)) {
+                for (bucketT* b=&head; b; b=b->next.load(std::memory_order_relaxed)) {
+                    for (int s=0; s<bucketT::NSLOT; ++s) {
+                        entryT* e = b->slot[s].load(std::memory_order_relaxed);
+                        if (!entryT::live(e)) continue;
+                        std::uint64_t h = mixed_hash(e->datum.first);
+                        bucketT& target = n->buckets[n->index(h)];
+                        target.lock();
+                        target.add(e, tag_of(h));
+                        target.unlock();
+                    }
+                }
+                o->moved[i].store(true, std::memory_order_release);
+            }
+            head.unlock();
+        }
+
+        /// Copies a chunk of buckets of the table being resized, if any
+
+        /// \return False if no resize is in progress
+        bool help_resize() const {
+            tableT* o = old.load(std::memory_order_acquire);
+            if (!o) return false;
+            std::size_t lo = o->claimed.fetch_add(tableT::CHUNK, std::memory_order_relaxed);
+            if (lo >= o->nbucket) return true;
+            std::size_t hi = std::min(lo + tableT::CHUNK, o->nbucket);
+            for (std::size_t i=lo; i<hi; ++i) copy_bucket(o, i);
+            if (o->copied.fetch_add(hi-lo, std::memory_order_acq_rel) + (hi-lo) == o->nbucket) {
+                resize_mutex.lock();
+                retired.push_back(o);
+                old.store(nullptr, std::memory_order_release);
+                resize_mutex.unlock();
+            }
+            return true;
+        }
+
+        /// Finishes the resize in progress, if any
+        void finish_resize() const {
+            while (help_resize()) cpu_relax();
+        }
+
+        /// Starts a resize if the table is more than two entries per bucket full
+        void maybe_resize() {
+            tableT* t = current.load(std::memory_order_acquire);
+            if (count.load(std::memory_order_relaxed) <= 2*t->nbucket) return;
+            if (old.load(std::memory_order_acquire)) return;
+            // Another thread is already starting a resize
+            if (!resize_mutex.try_lock()) return;
+            if (!old.load(std::memory_order_relaxed) && t == current.load(std::memory_order_relaxed)) {
+                tableT* n = new tableT(2*t->nbucket);
+                t->next.store(n, std::memory_order_release);
+                old.store(t, std::memory_order_release);
+                current.store(n, std::memory_order_release);
+                nresize.fetch_add(1, std::memory_order_relaxed);
+            }
+            resize_mutex.unlock();
+        }
+
+        /// Locks the bucket of the key in the current table
+
+        /// Copies the bucket of the key from the table being resized first,
+        /// so the current table is the only place to look for the key.
+        bucketT& lock_bucket(std::uint64_t h, tableT*& t) const {
+            while (true) {
+                help_resize();
+                t = current.load(std::memory_order_acquire);
+                tableT* o = old.load(std::memory_order_acquire);
+                if (o && o != t) copy_bucket(o, o->index(h));
+                bucketT& head = t->buckets[t->index(h)];
+                head.lock();
+                if (!t->moved[t->index(h)].load(std::memory_order_relaxed)) return head;
+                head.unlock();
+            }
+        }
+
+        std::pair<iterator,bool> insert_entry(const datumT& datum, int lockmode, entryT*& result) {
+            const std::uint64_t h = mixed_hash(datum.first);
+            const unsigned short tag = tag_of(h);
+            bool inserted;
+            tableT* t;
+            bucketT* where = nullptr;
+            int islot = -1;
+            MutexWaiter waiter;
+            while (true) {
+                bucketT& head = lock_bucket(h, t);
+                result = match(&head, datum.first, tag, where, islot);
+                inserted = !result;
+                if (inserted) {
+                    result = new_entry(datum);
+                    head.add(result, tag);
+                    match(&head, datum.first, tag, where, islot);
+                    count.fetch_add(1, std::memory_order_relaxed);
+                }
+                bool gotlock = result->try_lock(lockmode);
+                head.unlock();
+                if (gotlock) break;
+                waiter.wait();
+            }
+            if (inserted) maybe_resize();
+            return std::pair<iterator,bool>(iterator(this,t,t->index(h),where,islot,result),inserted);
+        }
+
+        bool del(const keyT& key, int lockmode) {
+            const std::uint64_t h = mixed_hash(key);
+            tableT* t;
+            bucketT* where = nullptr;
+            int islot = -1;
+            bucketT& head = lock_bucket(h, t);
+            entryT* e = match(&head, key, tag_of(h), where, islot);
+            if (e) {
+                where->slot[islot].store(nullptr, std::memory_order_relaxed);
+                e->alive.store(false, std::memory_order_release);
+                count.fetch_sub(1, std::memory_order_relaxed);
+            }
+            head.unlock();
+            if (!e) return false;
+            e->unlock(lockmode);
+            delete_entry(e);
+            return true;
+        }
+
+        entryT* find_entry(const keyT& key, int lockmode, tableT*& t, std::size_t& ibucket,
+                             bucketT*& where, int& islot) const {
+            const std::uint64_t h = mixed_hash(key);
+            const unsigned short tag = tag_of(h);
+            if (optimistic && lockmode == entryT::NOLOCK) {
+                // Look in the table being resized if the bucket is not copied yet
+                t = current.load(std::memory_order_acquire);
+                tableT* o = old.load(std::memory_order_acquire);
+                if (o && o != t && !o->moved[o->index(h)].load(std::memory_order_acquire)) {
+                    ibucket = o->index(h);
+                    entryT* e = optimistic_match(o->buckets + ibucket, key, tag, where, islot);
+                    if (!o->moved[ibucket].load(std::memory_order_acquire)) {
+                        t = o;
+                        return e;
+                    }
+                }
+                ibucket = t->index(h);
+                return optimistic_match(t->buckets + ibucket, key, tag, where, islot);
+            }
+
+            entryT* e;
+            MutexWaiter waiter;
+            while (true) {
+                bucketT& head = lock_bucket(h, t);
+                e = match(&head, key, tag, where, islot);
+                bool gotlock = (!e || e->try_lock(lockmode));
+                head.unlock();
+                if (gotlock) break;
+                waiter.wait();
+            }
+            ibucket = t->index(h);
+            return e;
+        }
+
+        void init() {
+            current.store(new tableT(nbucket0), std::memory_order_relaxed);
+            old.store(nullptr, std::memory_order_relaxed);
+            count.store(0, std::memory_order_relaxed);
+        }
+
+        void destroy() {
+            finish_resize();
+            tableT* t = current.load(std::memory_order_relaxed);
+            for (std::size_t i=0; i<t->nbucket; ++i) {
+                for (bucketT* b=t->buckets+i; b; b=b->next.load(std::memory_order_relaxed)) {
+                    for (int s=0; s<bucketT::NSLOT; ++s) {
+                        entryT* e = b->slot[s].load(std::memory_order_relaxed);
+                        if (entryT::live(e)) {
+                            e->~entryT();
+                            ::operator delete(e);
+                        }
+                    }
+                }
+            }
+            delete t;
+            for (tableT* r : retired) delete r;
+            retired.clear();
+            free_pool();
+        }
+
+    public:
+        ResizableHashMap(int n=1021, const hashfunT& hf = hashfunT())
+                : hashfun(hf)
+                , nbucket0(nbucket_pow2(n))
+                , nresize(0)
+                , free_entries(nullptr) {
+            init();
+        }
+
+        ResizableHashMap(const hashT& h)
+                : hashfun(h.hashfun)
+                , nbucket0(h.nbucket0)
+                , nresize(0)
+                , free_entries(nullptr) {
+            init();
+            *this = h;
+        }
+
+        virtual ~ResizableHashMap() {
+            destroy();
+        }
+
+        hashT& operator=(const hashT& h) {
+            if (this != &h) {
+                this->clear();
+                hashfun = h.hashfun;
+                for (const_iterator p=h.begin(); p!=h.end(); ++p) {
+                    insert(*p);
+                }
+            }
+            return *this;
+        }
+
+        std::pair<iterator,bool> insert(const datumT& datum) {
+            entryT* result;
+            return insert_entry(datum, entryT::NOLOCK, result);
+        }
+
+        /// Returns true if new pair was inserted; false if key is already in the map and the datum was not inserted
+        bool insert(accessor& result, const datumT& datum) {
+            result.release();
+            entryT* e;
+            bool inserted = insert_entry(datum, entryT::WRITELOCK, e).second;
+            result.set(e);
+            return inserted;
+        }
+
+        /// Returns true if new pair was inserted; false if key is already in the map and the datum was not inserted
+        bool insert(const_accessor& result, const datumT& datum) {
+            result.release();
+            entryT* e;
+            bool inserted = insert_entry(datum, entryT::READLOCK, e).second;
+            result.set(e);
+            return inserted;
+        }
+
+        /// Returns true if new pair was inserted; false if key is already in the map
+        inline bool insert(accessor& result, const keyT& key) {
+            return insert(result, datumT(key,valueT()));
+        }
+
+        /// Returns true if new pair was inserted; false if key is already in the map
+        inline bool insert(const_accessor& result, const keyT& key) {
+            return insert(result, datumT(key,valueT()));
+        }
+
+        std::size_t erase(const keyT& key) {
+            if (del(key,entryT::NOLOCK)) return 1;
+            else return 0;
+        }
+
+        void erase(const iterator& it) {
+            if (it == end()) MADNESS_EXCEPTION("ResizableHashMap: erase(iterator): at end", true);
+            erase(it->first);
+        }
+
+        void erase(accessor& item) {
+            del(item->first,entryT::WRITELOCK);
+            item.unset();
+        }
+
+        void erase(const_accessor& item) {
+            item.convert_read_lock_to_write_lock();
+            del(item->first,entryT::WRITELOCK);
+            item.unset();
+        }
+
+        iterator find(const keyT& key) {
+            tableT* t;
+            std::size_t ibucket;
+            bucketT* where = nullptr;
+            int islot = -1;
+            entryT* entry = find_entry(key,entryT::NOLOCK,t,ibucket,where,islot);
+            if (!entry) return end();
+            else return iterator(this,t,ibucket,where,islot,entry);
+        }
+
+        const_iterator find(const keyT& key) const {
+            tableT* t;
+            std::size_t ibucket;
+            bucketT* where = nullptr;
+            int islot = -1;
+            const entryT* entry = find_entry(key,entryT::NOLOCK,t,ibucket,where,islot);
+            if (!entry) return end();
+            else return const_iterator(this,t,ibucket,where,islot,entry);
+        }
+
+        bool find(accessor& result, const keyT& key) {
+            result.release();
+            tableT* t;
+            std::size_t ibucket;
+            bucketT* where = nullptr;
+            int islot = -1;
+            entryT* entry = find_entry(key,entryT::WRITELOCK,t,ibucket,where,islot);
+            bool foundit = entry;
+            if (foundit) result.set(entry);
+            return foundit;
+        }
+
+        bool find(const_accessor& result, const keyT& key) const {
+            result.release();
+            tableT* t;
+            std::size_t ibucket;
+            bucketT* where = nullptr;
+            int islot = -1;
+            entryT* entry = find_entry(key,entryT::READLOCK,t,ibucket,where,islot);
+            bool foundit = entry;
+            if (foundit) result.set(entry);
+            return foundit;
+        }
+
+        /// Removes all entries; not safe against concurrent access
+        void clear() {
+            destroy();
+            init();
+        }
+
+        size_t size() const {
+            return count.load(std::memory_order_relaxed);
+        }
+
+        valueT& operator[](const keyT& key) {
+            std::pair<iterator,bool> it = insert(datumT(key,valueT()));
+            return it.first->second;
+        }
+
+        iterator begin() {
+            finish_resize();
+            return iterator(this,current.load(std::memory_order_acquire));
+        }
+
+        const_iterator begin() const {
+            return cbegin();
+        }
+
+        const_iterator cbegin() const {
+            finish_resize();
+            return const_iterator(this,current.load(std::memory_order_acquire));
+        }
+
+        iterator end() {
+            return iterator(this);
+        }
+
+        const_iterator end() const {
+            return cend();
+        }
+
+        const_iterator cend() const {
+            return const_iterator(this);
+        }
+
+        const hashfunT& get_hash() const { return hashfun; }
+
+        /// Number of buckets of the current table
+        std::size_t nbuckets() const {
+            return current.load(std::memory_order_acquire)->nbucket;
+        }
+
+        void print_stats() const {
+            finish_resize();
+            const tableT* t = current.load(std::memory_order_acquire);
+            std::size_t nline = 0, longest = 0;
+            for (std::size_t i=0; i<t->nbucket; ++i) {
+                std::size_t n = 0;
+                for (const bucketT* b=t->buckets+i; b; b=b->next.load(std::memory_order_relaxed)) ++n;
+                nline += n;
+                if (n > longest) longest = n;
+            }
+            printf("entries %lu  buckets %lu  cache lines %lu  longest chain %lu  resizes %lu\n",
+                   (unsigned long) size(), (unsigned long) t->nbucket, (unsigned long) nline,
+                   (unsigned long) longest, (unsigned long) nresize.load());
+        }
+    };
+}
+
+namespace std {
+
+    template <typename hashT, typename distT>
+    inline void advance( madness::Hash_private::ResizableHashIterator<hashT>& it, const distT& dist ) {
+        it.advance(dist);
+    }
+
+    template <typename hashT>
+    inline int distance(const madness::Hash_private::ResizableHashIterator<hashT>& it, const madness::Hash_private::ResizableHashIterator<hashT>& jt) {
+        return it.distance(jt);
+    }
+}
+
+#endif // MADNESS_WORLD_RESIZABLE_HASHMAP_H__INCLUDED
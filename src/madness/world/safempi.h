@@ -86,13 +86,12 @@ namespace SafeMPI {
 
     /// tags in [1,999] ... allocated once by unique_reserved_tag
     ///
-    /// tags in [1000,1023] ... statically assigned here
+    /// tags in [1000,1023] ... statically assigned here (RMI uses [RMI_TAG-16,RMI_TAG]
+    ///                         for its receive engines and huge messages)
     ///
     /// tags in [1024,4095] ... allocated round-robin by unique_tag
     ///
-    /// tags in [4096,8191] ... reserved for huge msg exchange by RMI
-    ///
-    /// tags in [8192,MPI::TAG_UB] ... not used/managed by madness
+    /// tags in [4096,MPI::TAG_UB] ... not used/managed by madness
 
     static const int RMI_TAG = 1023;
     static const int MPIAR_TAG = 1001;
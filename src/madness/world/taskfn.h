@@ -84,11 +84,14 @@ namespace madness {
 
         /// Set task info
 
+        /// The task joins the completion scope current on the calling thread.
         /// \param w The world object that contains the task
         /// \param c Call this callback on completion
         void set_info(World* w, CallbackInterface* c) {
             world = w;
             completion = c;
+            completion_scope = CompletionScope::current();
+            if (completion_scope) completion_scope->ntask++;
         }
 
         /// Adds call back to schedule task when outstanding dependencies are satisfied
@@ -141,7 +144,10 @@ namespace madness {
 
         World* get_world() const { return const_cast<World*>(world); }
 
-        virtual ~TaskInterface() { if (completion) completion->notify(); }
+        virtual ~TaskInterface() {
+            if (completion) completion->notify();
+            if (completion_scope) completion_scope->ntask--; // Must be last; the scope may then end
+        }
 
     }; // class TaskInterface
 
@@ -33,6 +33,7 @@
 #include <madness/world/thread.h>
 #include <madness/world/worldhash.h>
 #include <madness/world/worldhashmap.h>
+#include <madness/world/resizable_hashmap.h>
 #include <madness/world/range.h>
 #include <madness/world/timers.h>
 #include <madness/world/atomicint.h>
@@ -58,12 +59,13 @@ double drand() {
     return random()*(1.0/RAND_MAX);
 }
 
-void split(const Range<ConcurrentHashMap<int,int>::iterator>& range) {
-    typedef Range<ConcurrentHashMap<int,int>::iterator> rangeT;
+template <typename iteratorT>
+void split(const Range<iteratorT>& range) {
+    typedef Range<iteratorT> rangeT;
     if (range.size() <= range.get_chunksize()) {
         int n = range.size();
         int c = 0;
-        for (rangeT::iterator it=range.begin();  it != range.end();  ++it) {
+        for (typename rangeT::iterator it=range.begin();  it != range.end();  ++it) {
             c++;
             if (c > n) throw "c > n inside range iteration";
         }
@@ -77,13 +79,15 @@ void split(const Range<ConcurrentHashMap<int,int>::iterator>& range) {
     }
 }
 
+template <template <class,class,class> class mapT>
 void test_coverage() {
     // This test aims for complete code coverage for whatever that
     // is worth, and tests for basic sequential correctness.
-    ConcurrentHashMap<int,int> a;
-    typedef ConcurrentHashMap<int,int>::datumT datumT;
-    typedef ConcurrentHashMap<int,int>::iterator iteratorT;
-    typedef ConcurrentHashMap<int,int>::const_iterator const_iteratorT;
+    typedef mapT<int,int,Hash<int> > hashT;
+    hashT a;
+    typedef typename hashT::datumT datumT;
+    typedef typename hashT::iterator iteratorT;
+    typedef typename hashT::const_iterator const_iteratorT;
 
 
     a[-1] = -99;
@@ -107,7 +111,7 @@ void test_coverage() {
         if (it->second != 99*i) cout << "value mismatch on find" << i << " " << it->second << endl;
     }
 
-    const ConcurrentHashMap<int,int>* ca = &a;
+    const hashT* ca = &a;
     for (int i=0; i<10000; ++i) {
         const_iteratorT it = ca->find(i);
         if (it == ca->end()) cout << "expected to find this element " << i << endl;
@@ -200,14 +204,16 @@ vector<int> random_perm(int n) {
 }
 
 
+template <template <class,class,class> class mapT>
 void test_time() {
     // Examine interaction between nbins and nentries by looping thru
     // bin sizes and measuring time to insert and then delete varying
     // number of keys in random order
-    typedef ConcurrentHashMap<int,int>::datumT datumT;
+    typedef mapT<int,double,Hash<int> > hashT;
+    typedef typename hashT::datumT datumT;
     for (int nbins=100; nbins<=10000; nbins*=10) {
         for (int nentries=nbins; nentries<=nbins*100; nentries*=10) {
-            ConcurrentHashMap<int,double> a(nbins);
+            hashT a(nbins);
             vector<int> v = random_perm(nentries);
             double insert_used = madness::cpu_time();
             for (int i=0; i<nentries; ++i) {
@@ -226,9 +232,10 @@ void test_time() {
     }
 }
 
-void do_test_random(ConcurrentHashMap<int,double>& a, size_t& count, double& sum) {
-    typedef ConcurrentHashMap<int,double>::datumT datumT;
-    typedef ConcurrentHashMap<int,double>::iterator iteratorT;
+template <typename hashT>
+void do_test_random(hashT& a, size_t& count, double& sum) {
+    typedef typename hashT::datumT datumT;
+    typedef typename hashT::iterator iteratorT;
     // Randomly generate keys in range 4*nbin and randomly insert or
     // delete that entry.  Maintain expected sum and count of values
     // and verify at end.
@@ -256,9 +263,11 @@ void do_test_random(ConcurrentHashMap<int,double>& a, size_t& count, double& sum
     }
 }
 
+template <template <class,class,class> class mapT>
 void test_random() {
-    ConcurrentHashMap<int,double> a(131);
-    typedef ConcurrentHashMap<int,double>::iterator iteratorT;
+    typedef mapT<int,double,Hash<int> > hashT;
+    hashT a(131);
+    typedef typename hashT::iterator iteratorT;
 
     size_t count;
     double sum;
@@ -279,14 +288,15 @@ void test_random() {
 
 madness::AtomicInt ndone;
 
+template <typename hashT>
 class Worker : public madness::ThreadBase {
 private:
-    ConcurrentHashMap<int,double>& a; // Better would be a shared pointer
+    hashT& a; // Better would be a shared pointer
     size_t& count;
     double& sum;
 
 public:
-    Worker(ConcurrentHashMap<int,double>& a, size_t& count, double& sum)
+    Worker(hashT& a, size_t& count, double& sum)
             : ThreadBase(), a(a), count(count), sum(sum) {
         start();
     }
@@ -300,19 +310,19 @@ public:
 
 
 
+template <template <class,class,class> class mapT>
 void test_thread() {
-    ConcurrentHashMap<int,double> a(131);
-    //typedef ConcurrentHashMap<int,double>::datumT datumT; // unused
-    typedef ConcurrentHashMap<int,double>::iterator iteratorT;
-    // typedef ConcurrentHashMap<int,double>::const_iterator const_iteratorT; // unused
+    typedef mapT<int,double,Hash<int> > hashT;
+    hashT a(131);
+    typedef typename hashT::iterator iteratorT;
     const int nthread = 2;
     size_t counts[nthread];
     double sums[nthread];
 
     ndone = 0;
 
-    Worker worker1(a,counts[0],sums[0]);
-    Worker worker2(a,counts[1],sums[1]);
+    Worker<hashT> worker1(a,counts[0],sums[0]);
+    Worker<hashT> worker2(a,counts[1],sums[1]);
     while (ndone != 2) sched_yield();
 
     size_t count = 0;
@@ -336,19 +346,20 @@ void test_thread() {
 }
 
 
+template <typename hashT>
 class Peasant : public madness::ThreadBase {
 private:
-    ConcurrentHashMap<int,double>& a; // Better would be a shared pointer
+    hashT& a; // Better would be a shared pointer
 
 public:
-    Peasant(ConcurrentHashMap<int,double>& a)
+    Peasant(hashT& a)
             : ThreadBase(), a(a) {
         start();
     }
 
     void run() {
         for (int i=0; i<10000000; ++i) {
-            ConcurrentHashMap<int,double>::accessor r;
+            typename hashT::accessor r;
             if (!a.find(r, 1)) MADNESS_EXCEPTION("OK ... where is it?", 0);
             r->second++;
         }
@@ -358,10 +369,11 @@ public:
 };
 
 
+template <template <class,class,class> class mapT>
 void test_accessors() {
-    ConcurrentHashMap<int,double> a(131);
-    // typedef ConcurrentHashMap<int,double>::datumT datumT; // unused
-    typedef ConcurrentHashMap<int,double>::accessor accessorT;
+    typedef mapT<int,double,Hash<int> > hashT;
+    hashT a(131);
+    typedef typename hashT::accessor accessorT;
 
     ndone = 0;
 
@@ -377,21 +389,94 @@ void test_accessors() {
     if (result->second != 0.0) MADNESS_EXCEPTION("should have been zero", static_cast<int>(result->second));
 
 
-    Peasant a1(a),a2(a);
+    Peasant<hashT> a1(a),a2(a);
     result.release();
     while (ndone != 2) sched_yield();
 
     if (a[1] != 20000000.0) MADNESS_EXCEPTION("Ooops", int(a[1]));
 }
 
+template <typename hashT>
+class Bencher : public madness::ThreadBase {
+private:
+    hashT& a;
+    const int me, nthread, nentries, nfind;
+    madness::AtomicInt& phase;
+
+public:
+    Bencher(hashT& a, int me, int nthread, int nentries, int nfind, madness::AtomicInt& phase)
+            : ThreadBase(), a(a), me(me), nthread(nthread), nentries(nentries), nfind(nfind), phase(phase) {
+        start();
+    }
+
+    void run() {
+        typedef typename hashT::datumT datumT;
+        // Insert an interleaved share of the keys
+        for (int i=me; i<nentries; i+=nthread) a.insert(datumT(i,i));
+        ndone++;
+        while (phase == 0) sched_yield();
+
+        // Look up keys scattered over the whole table
+        unsigned int key = me;
+        for (int i=0; i<nfind; ++i) {
+            key = key*1664525u + 1013904223u;
+            int k = int(key % (unsigned int)(nentries));
+            typename hashT::iterator it = a.find(k);
+            if (it == a.end() || it->second != k) MADNESS_EXCEPTION("Bencher: lost a key", k);
+        }
+        ndone++;
+    }
+};
+
+template <template <class,class,class> class mapT>
+void test_throughput(const char* name) {
+    // Microbenchmark of threaded insertion into a map that starts at the
+    // default size, followed by threaded lookups.  Reports millions of
+    // operations per second summed over all threads.
+    typedef mapT<int,double,Hash<int> > hashT;
+    const int nthread = std::max(2, std::min(8, ThreadBase::num_hw_processors()));
+    for (int nentries=1<<12; nentries<=1<<18; nentries<<=3) {
+        const int nfind = 1<<18;
+        hashT a;
+        madness::AtomicInt phase;
+        phase = 0;
+        ndone = 0;
+
+        std::vector<Bencher<hashT>*> threads(nthread);
+        double insert_used = madness::wall_time();
+        for (int t=0; t<nthread; ++t) threads[t] = new Bencher<hashT>(a, t, nthread, nentries, nfind, phase);
+        while (ndone != nthread) sched_yield();
+        insert_used = madness::wall_time() - insert_used;
+        if (a.size() != size_t(nentries)) MADNESS_EXCEPTION("test_throughput: wrong size", a.size());
+
+        double find_used = madness::wall_time();
+        phase = 1;
+        while (ndone != 2*nthread) sched_yield();
+        find_used = madness::wall_time() - find_used;
+        for (int t=0; t<nthread; ++t) delete threads[t];
+
+        printf("%-10s nthread=%d   nent=%8d   insert=%7.2f Mop/s   find=%7.2f Mop/s\n",
+               name, nthread, nentries, 1e-6*nentries/insert_used, 1e-6*nthread*nfind/find_used);
+    }
+}
+
 int main(int argc, char** argv) {
     madness::initialize(argc,argv);
     try {
-        test_coverage();
-        test_random();
-        test_time();
-        test_thread();
-        test_accessors();
+        test_coverage<ConcurrentHashMap>();
+        test_random<ConcurrentHashMap>();
+        test_time<ConcurrentHashMap>();
+        test_thread<ConcurrentHashMap>();
+        test_accessors<ConcurrentHashMap>();
+
+        test_coverage<ResizableHashMap>();
+        test_random<ResizableHashMap>();
+        test_time<ResizableHashMap>();
+        test_thread<ResizableHashMap>();
+        test_accessors<ResizableHashMap>();
+
+        test_throughput<ConcurrentHashMap>("concurrent");
+        test_throughput<ResizableHashMap>("resizable");
 
         cout << "Things seem to be working!\n";
     }
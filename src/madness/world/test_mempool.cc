@@ -0,0 +1,141 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#include <madness/world/world.h>
+#include <madness/world/thread.h>
+#include <madness/world/worldmem.h>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <stdint.h>
+#include <string.h>
+
+using namespace madness;
+using namespace std;
+
+int nerror = 0;
+
+#define CHECK(cond, msg) \
+    if (!(cond)) { cout << "FAIL: " << msg << endl; ++nerror; }
+
+/// Frees a block from a pool thread (so it goes onto the owner's return queue)
+class Freer : public PoolTaskInterface {
+    void* p;
+public:
+    Freer(void* p) : p(p) {}
+    void run(const TaskThreadEnv& env) {
+        PoolAllocator::deallocate(p);
+    }
+};
+
+void test_sizes() {
+    // Sizes around the MRA block sizes and across the size classes
+    const size_t sizes[] = {1, 8, 63, 64, 65, 192, 512, 1000, 4096, 8000,
+                            13824, 64000, 110592, 1000000, 1u<<24, (1u<<24)+1};
+    vector<void*> ptrs;
+    for (size_t size : sizes) {
+        char* p = (char*) PoolAllocator::allocate(size);
+        CHECK((uintptr_t(p) % PoolAllocator::alignment) == 0, "alignment " << size);
+        memset(p, 0xab, size);
+        ptrs.push_back(p);
+    }
+    for (size_t i=0; i<ptrs.size(); ++i) {
+        const unsigned char* p = (const unsigned char*) ptrs[i];
+        CHECK(p[0] == 0xab && p[sizes[i]-1] == 0xab, "overwritten " << sizes[i]);
+        PoolAllocator::deallocate(ptrs[i]);
+    }
+}
+
+void test_reuse() {
+    world_mem_info()->reset();
+    const int n = 100;
+    vector<void*> ptrs(n);
+    for (int i=0; i<n; ++i) ptrs[i] = PoolAllocator::allocate(6000);
+    for (int i=0; i<n; ++i) PoolAllocator::deallocate(ptrs[i]);
+    for (int i=0; i<n; ++i) ptrs[i] = PoolAllocator::allocate(6000);
+    WorldMemInfo* info = world_mem_info();
+    CHECK(info->pool_num_hits == unsigned(n), "same thread hits " << info->pool_num_hits);
+    CHECK(info->pool_cur_bytes_used >= n*6000ul, "bytes used " << info->pool_cur_bytes_used);
+
+    // Free from other threads then allocate again here
+    for (int i=0; i<n; ++i) ThreadPool::add(new Freer(ptrs[i]));
+    ThreadPool::await([] () { return ThreadPool::queue_size() == 0; });
+    while (world_mem_info()->pool_cur_bytes_used != 0) cpu_relax();
+    CHECK(world_mem_info()->pool_cur_bytes_cached >= n*6000ul, "bytes cached " << world_mem_info()->pool_cur_bytes_cached);
+
+    for (int i=0; i<n; ++i) ptrs[i] = PoolAllocator::allocate(6000);
+    info = world_mem_info();
+    CHECK(info->pool_num_hits == unsigned(2*n), "cross thread hits " << info->pool_num_hits);
+    CHECK(info->pool_num_misses == unsigned(n), "misses " << info->pool_num_misses);
+    for (int i=0; i<n; ++i) PoolAllocator::deallocate(ptrs[i]);
+    CHECK(world_mem_info()->pool_max_bytes_used >= n*6000ul, "high water mark");
+}
+
+void test_thread_exit() {
+    // A thread that exits must release the blocks cached for it
+    const unsigned long cached = world_mem_info()->pool_cur_bytes_cached;
+    const int n = 100;
+    void* survivor = 0;
+    std::thread t([&survivor] () {
+        vector<void*> ptrs(n);
+        for (int i=0; i<n; ++i) ptrs[i] = PoolAllocator::allocate(6000);
+        for (int i=0; i<n; ++i) PoolAllocator::deallocate(ptrs[i]);
+        survivor = PoolAllocator::allocate(6000);
+    });
+    t.join();
+    CHECK(world_mem_info()->pool_cur_bytes_cached == cached,
+          "bytes cached after thread exit " << world_mem_info()->pool_cur_bytes_cached << " " << cached);
+
+    // A block that outlives its thread can still be freed, and the next
+    // thread adopts the retired cache together with that block
+    memset(survivor, 0xab, 6000);
+    PoolAllocator::deallocate(survivor);
+    world_mem_info()->reset();
+    std::thread t2([] () {
+        PoolAllocator::deallocate(PoolAllocator::allocate(6000));
+    });
+    t2.join();
+    CHECK(world_mem_info()->pool_num_hits == 1ul, "adopted cache hits " << world_mem_info()->pool_num_hits);
+    CHECK(world_mem_info()->pool_cur_bytes_cached == cached, "bytes cached after second thread exit");
+}
+
+int main(int argc, char** argv) {
+    madness::initialize(argc,argv);
+
+    test_sizes();
+    test_reuse();
+    test_thread_exit();
+    if (nerror == 0) world_mem_info()->print_pool();
+
+    madness::finalize();
+    cout << (nerror ? "FAILED" : "PASSED") << endl;
+    return nerror;
+}
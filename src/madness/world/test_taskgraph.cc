@@ -0,0 +1,116 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file test_taskgraph.cc
+/// \brief Measures the throughput of task graphs whose tasks depend on futures.
+
+/// Each task of a layer depends on the results of \c ndep tasks of the
+/// previous layer, and each result is a dependency of \c ndep tasks of
+/// the next layer, so the callbacks of futures are registered and
+/// notified concurrently.  Prints the tasks per second for several
+/// \c ndep and which implementation of futures was compiled in (see
+/// \c ENABLE_LOCKFREE_FUTURES).
+
+#include <madness/world/MADworld.h>
+#include <madness/world/timers.h>
+#include <cstdio>
+#include <vector>
+
+using namespace madness;
+
+// Each task returns the average of its inputs, so every value is 1
+double dep1(double a) {return a;}
+double dep2(double a, double b) {return (a+b)/2;}
+double dep4(double a, double b, double c, double d) {return (a+b+c+d)/4;}
+double dep8(double a, double b, double c, double d, double e, double f, double g, double h) {
+    return (a+b+c+d+e+f+g+h)/8;
+}
+
+Future<double> add_task(World& world, const std::vector< Future<double> >& prev, int i, int ndep) {
+    const int width = prev.size();
+    const int stride = width/ndep;
+    std::vector< Future<double> > in(ndep);
+    for (int k=0; k<ndep; ++k) in[k] = prev[(i+k*stride+k)%width];
+
+    switch (ndep) {
+    case 1: return world.taskq.add(dep1, in[0]);
+    case 2: return world.taskq.add(dep2, in[0], in[1]);
+    case 4: return world.taskq.add(dep4, in[0], in[1], in[2], in[3]);
+    case 8: return world.taskq.add(dep8, in[0], in[1], in[2], in[3], in[4], in[5], in[6], in[7]);
+    }
+    MADNESS_EXCEPTION("add_task: unsupported number of dependencies", ndep);
+}
+
+/// Runs a graph of \c depth layers of \c width tasks and returns tasks per second
+double run_graph(World& world, int width, int depth, int ndep) {
+    world.gop.fence();
+    const double start = wall_time();
+
+    // The first layer waits on futures set only after the graph is built,
+    // so every dependency is registered before it is assigned
+    std::vector< Future<double> > roots(width), layer(width);
+    for (int i=0; i<width; ++i) layer[i] = roots[i];
+    for (int l=0; l<depth; ++l) {
+        std::vector< Future<double> > next(width);
+        for (int i=0; i<width; ++i) next[i] = add_task(world, layer, i, ndep);
+        layer.swap(next);
+    }
+    for (int i=0; i<width; ++i) roots[i].set(1.0);
+    world.taskq.fence();
+
+    const double used = wall_time() - start;
+    for (int i=0; i<width; ++i) MADNESS_ASSERT(layer[i].get() == 1.0);
+    return width*depth/used;
+}
+
+int main(int argc, char** argv) {
+    madness::initialize(argc, argv);
+    madness::World world(SafeMPI::COMM_WORLD);
+
+#ifdef MADNESS_LOCKFREE_FUTURES
+    const char* impl = "lock-free";
+#else
+    const char* impl = "spinlock";
+#endif
+    const int width = 1000, depth = 50;
+    run_graph(world, width, 5, 1); // warm up the allocators and the pool
+    for (int ndep=1; ndep<=8; ndep*=2) {
+        const double rate = run_graph(world, width, depth, ndep);
+        if (world.rank() == 0)
+            printf("futures=%-9s  nthread=%2d  ndep=%d  tasks/s=%10.0f\n",
+                   impl, int(ThreadPool::size()), ndep, rate);
+    }
+
+    world.gop.fence();
+    if (world.rank() == 0) print("OK!");
+    madness::finalize();
+    return 0;
+}
@@ -31,6 +31,9 @@
 
 #include <vector>
 #include <numeric>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 
 #define WORLD_INSTANTIATE_STATIC_TEMPLATES
 #include <madness/world/MADworld.h>
@@ -1120,10 +1123,232 @@ void test13(World& world) {
     fin.close();
     archive::ParallelOutputArchive::remove(world, "fred");
 
+    // Store and load in the indexed format, where every process reads
+    // part of the file and the entries go to their owners
+    fout.open(world,"fred");
+    fout.set_indexed(true);
+    fout & 2.0 & d;
+    fout.close();
+
+    WorldContainer<int,double> e(world);
+    fin.open(world,"fred");
+    fin & v & e;
+    fin.close();
+    MADNESS_ASSERT(v == 2.0);
+
+    for (int i=0; i<100; ++i) {
+        int key = me*100+i;
+        MADNESS_ASSERT(e.probe(key));
+        MADNESS_ASSERT(e.find(key).get()->second == key);
+    }
+    archive::ParallelOutputArchive::remove(world, "fred");
+
     print("Test13 OK");
     world.gop.fence();
 }
 
+void test14(World& world) {
+    PROFILE_FUNC;
+    // Tracing of tasks and fences, then a Chrome trace of the events
+    ProcessID me = world.rank();
+    const bool was_enabled = WorldTrace::enabled();
+    WorldTrace::enable();
+    const std::size_t n0 = WorldTrace::size();
+
+    std::vector< Future<double> > r;
+    for (int i=0; i<10; ++i) r.push_back(world.taskq.add(dumb,i,1,2,3,4,5,6));
+    world.gop.fence();
+    for (int i=0; i<10; ++i) MADNESS_ASSERT(r[i].get() == i+21);
+
+    if (!was_enabled) WorldTrace::disable();
+    MADNESS_ASSERT(WorldTrace::size() >= n0 + 2*10 + 2);
+
+    const std::string filename = "test_trace." + std::to_string(me) + ".json";
+    WorldTrace::write(filename, me);
+    std::ifstream in(filename.c_str());
+    std::stringstream ss;
+    ss << in.rdbuf();
+    in.close();
+    const std::string json = ss.str();
+    MADNESS_ASSERT(json.find("\"traceEvents\"") != std::string::npos);
+    MADNESS_ASSERT(json.find("\"fence\"") != std::string::npos);
+    MADNESS_ASSERT(json.find("thread_name") != std::string::npos);
+    MADNESS_ASSERT(json.find("TaskFn") != std::string::npos);
+    std::remove(filename.c_str());
+
+    // Wrap the buffer of this thread inside an interval and leave another
+    // open; the trace must still pair every begin with an end
+    WorldTrace::enable();
+    WorldTrace::begin("outer");
+    for (int full=0; full<2; ) {
+        const std::size_t n = WorldTrace::size();
+        for (int i=0; i<1024; ++i) {
+            WorldTrace::begin("inner");
+            WorldTrace::end();
+        }
+        if (WorldTrace::size() == n) ++full;
+    }
+    WorldTrace::end();
+    WorldTrace::begin("open");
+    WorldTrace::write(filename, me);
+    WorldTrace::end();
+    if (!was_enabled) WorldTrace::disable();
+
+    in.open(filename.c_str());
+    std::string line;
+    long nbegin = 0, nend = 0;
+    while (std::getline(in, line)) {
+        if (line.find("\"ph\":\"B\"") != std::string::npos) ++nbegin;
+        if (line.find("\"ph\":\"E\"") != std::string::npos) ++nend;
+        MADNESS_ASSERT(line.find("\"open\"") == std::string::npos);
+    }
+    in.close();
+    MADNESS_ASSERT(nbegin > 0 && nbegin == nend);
+    std::remove(filename.c_str());
+
+    print("Test14 OK");
+    world.gop.fence();
+}
+
+AtomicInt scoped_count;
+
+void scoped_node(World* world, int depth) {
+    scoped_count++;
+    if (depth > 0) {
+        world->taskq.add(scoped_node, world, depth-1);
+        world->taskq.add(scoped_node, world, depth-1);
+    }
+}
+
+int scoped_gate(int i) {
+    return i;
+}
+
+void test15(World& world) {
+    PROFILE_FUNC;
+    // A completion scope waits for its own tasks and those they spawn,
+    // but not for unrelated pending tasks
+    scoped_count = 0;
+    Future<int> gate;
+    Future<int> blocked = world.taskq.add(scoped_gate, gate);
+    {
+        CompletionScope scope(world);
+        {
+            CompletionScope::Guard guard(scope);
+            world.taskq.add(scoped_node, &world, 6);
+        }
+        scope.wait();
+        MADNESS_ASSERT(scoped_count == 127);
+        MADNESS_ASSERT(scope.probe_local());
+        MADNESS_ASSERT(!blocked.probe());
+
+        // The scope can be used again
+        {
+            CompletionScope::Guard guard(scope);
+            world.taskq.add(scoped_node, &world, 2);
+        }
+        scope.wait();
+        MADNESS_ASSERT(scoped_count == 127+7);
+    }
+    gate.set(1);
+    world.gop.fence();
+    MADNESS_ASSERT(blocked.get() == 1);
+
+    print("Test15 OK");
+}
+
+AtomicInt numa_count;
+
+void numa_task(int i) {
+    numa_count++;
+}
+
+void test16(World& world) {
+    PROFILE_FUNC;
+    // Tasks hinted to a NUMA domain all run, and with NUMA placement
+    // they are counted against their domain
+    const std::vector<NumaDomainStats> before = ThreadPool::get_numa_stats();
+    numa_count = 0;
+    const int ntask = 1000;
+    for (int i=0; i<ntask; ++i) {
+        TaskAttributes attr;
+        attr.set_numa_domain(i % NumaTopology::ndomain());
+        MADNESS_ASSERT(attr.get_numa_domain() == i % NumaTopology::ndomain());
+        world.taskq.add(numa_task, i, attr);
+    }
+    world.gop.fence();
+    MADNESS_ASSERT(numa_count == ntask);
+
+    const std::vector<NumaDomainStats> after = ThreadPool::get_numa_stats();
+    MADNESS_ASSERT(after.size() == before.size());
+    unsigned long n = 0;
+    for (std::size_t d=0; d<after.size(); ++d) {
+        MADNESS_ASSERT(after[d].nremote - before[d].nremote <= after[d].ntask - before[d].ntask);
+        n += after[d].ntask - before[d].ntask;
+    }
+    MADNESS_ASSERT(after.empty() || n == (unsigned long)ntask);
+
+    print("Test16 OK", after.size(), "NUMA domain queues");
+}
+
+class SizeTest : public WorldObject<SizeTest> {
+public:
+    SizeTest(World& world) : WorldObject<SizeTest>(world) {
+        this->process_pending();
+    }
+
+    double sum(const std::vector<unsigned char>& buf) const {
+        return std::accumulate(buf.begin(), buf.end(), 0.0);
+    }
+};
+
+void test17(World& world) {
+    PROFILE_FUNC;
+    // Messages just either side of the small and large recv buffer sizes,
+    // and a huge one, arrive intact and in the expected buffer class
+    if (world.size() < 2) return;
+
+    ProcessID me = world.rank();
+    ProcessID nproc = world.size();
+    SizeTest a(world);
+    world.gop.fence();
+
+    const std::size_t small = RMI::small_msg_len();
+    const std::size_t large = RMI::max_msg_len();
+    std::vector<std::size_t> sizes;
+    if (small) {
+        sizes.push_back(small - 512);
+        sizes.push_back(small + 512);
+    }
+    sizes.push_back(large - 1024);
+    sizes.push_back(large + 1024);
+    sizes.push_back(4*large);
+
+    const RMIStats before = RMI::get_stats();
+    std::vector< Future<double> > r;
+    std::vector<double> r_ref;
+    for (std::size_t s=0; s<sizes.size(); ++s) {
+        std::vector<unsigned char> buf(sizes[s]);
+        for (std::size_t i=0; i<buf.size(); ++i) buf[i] = (i*7 + me) % 251;
+        const double ref = a.sum(buf);
+        for (ProcessID p=0; p<nproc; ++p) {
+            if (p == me) continue;
+            r.push_back(a.send(p, &SizeTest::sum, buf));
+            r_ref.push_back(ref);
+        }
+    }
+    world.gop.fence();
+    for (std::size_t i=0; i<r.size(); ++i) MADNESS_ASSERT(r[i].get() == r_ref[i]);
+
+    // Each other process sent one small message and two huge ones
+    const RMIStats after = RMI::get_stats();
+    if (small) MADNESS_ASSERT(after.nmsg_recv_small - before.nmsg_recv_small >= uint64_t(nproc-1));
+    MADNESS_ASSERT(after.nmsg_recv_huge - before.nmsg_recv_huge == uint64_t(2*(nproc-1)));
+
+    if (me == 0) print("Test17 OK", sizes.size(), "message sizes");
+    world.gop.fence();
+}
+
 inline bool is_odd(int i) {
     return i & 0x1;
 }
@@ -1288,6 +1513,10 @@ int main(int argc, char** argv) {
         //test11(world);
         test12(world);
         test13(world);
+        test14(world);
+        test15(world);
+        test16(world);
+        test17(world);
 
         for (int i=0; i<10; ++i) {
           print("REPETITION",i);
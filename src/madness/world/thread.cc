@@ -225,6 +225,26 @@ namespace madness {
             return;
         }
 
+        // With NUMA placement a pool thread is bound to the cpus of its
+        // domain, or to one of them if pool threads are bound
+        if (logical_id == 2 && ind >= 0 && NumaTopology::enabled()) {
+            const std::vector<int>& cpus =
+                    NumaTopology::cpus(NumaTopology::domain_of_thread(ind));
+#ifndef ON_A_MAC
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            if (bind[2])
+                CPU_SET(cpus[(ind / NumaTopology::ndomain()) % cpus.size()], &mask);
+            else
+                for (int c : cpus) CPU_SET(c, &mask);
+            if (sched_setaffinity(0, sizeof(mask), &mask) == -1) {
+                perror("system error message");
+                std::cout << "ThreadBase: set_affinity: Could not set NUMA cpu affinity" << std::endl;
+            }
+#endif
+            return;
+        }
+
         if (!bind[logical_id]) return;
 
         // If binding the main or rmi threads the cpu id is a specific cpu.
@@ -338,9 +358,11 @@ namespace madness {
 #endif
     // The constructor is private to enforce the singleton model
     ThreadPool::ThreadPool(int nthread) :
-            threads(nullptr), main_thread(), nthreads(nthread), finish(false)
+            threads(nullptr), main_thread(), nthreads(nthread), finish(false),
+            work_stealing(false), ndomain(1), domains(nullptr)
     {
         nfinished = 0;
+        nidle = 0;
         instance_ptr = this;
         if (nthreads < 0) nthreads = default_nthread();
         MADNESS_ASSERT(nthreads >= 0);
@@ -393,9 +415,17 @@ namespace madness {
         }
 #else
 
+        const char* mad_task_scheduler = getenv("MAD_TASK_SCHEDULER");
+        if (mad_task_scheduler) {
+            if (strcmp(mad_task_scheduler, "steal") == 0)
+                work_stealing = true;
+            else if (strcmp(mad_task_scheduler, "dqueue") != 0)
+                MADNESS_EXCEPTION("MAD_TASK_SCHEDULER must be either dqueue or steal", 0);
+        }
+
         try {
             if (nthreads > 0)
-                threads = new ThreadPoolThread[nthreads];
+                threads = detail::new_aligned_array<ThreadPoolThread>(nthreads);
             else
                 threads = 0;
         }
@@ -403,6 +433,17 @@ namespace madness {
             MADNESS_EXCEPTION("memory allocation failed", 0);
         }
 
+        // Per-domain queues need the work-stealing scheduler; binding
+        // alone is done in set_affinity()
+        if (NumaTopology::enabled()) {
+            for (int i=0; i<nthreads; ++i)
+                threads[i].set_numa_domain(NumaTopology::domain_of_thread(i));
+            if (work_stealing && NumaTopology::ndomain() > 1) {
+                ndomain = NumaTopology::ndomain();
+                domains = detail::new_aligned_array<NumaDomain>(ndomain);
+            }
+        }
+
         for (int i=0; i<nthreads; ++i) {
             threads[i].set_pool_thread_index(i);
             threads[i].start(pool_thread_main, (void *)(threads+i));
@@ -494,6 +535,15 @@ namespace madness {
             }
         }
 
+#if !HAVE_INTEL_TBB && !HAVE_PARSEC
+        if(instance_ptr->work_stealing && SafeMPI::COMM_WORLD.Get_rank() == 0)
+            std::cout << "MADNESS task scheduler set to work stealing.\n";
+        if(NumaTopology::enabled() && SafeMPI::COMM_WORLD.Get_rank() == 0)
+            std::cout << "MADNESS pool threads placed on " << NumaTopology::ndomain()
+                      << " NUMA domains" << (instance_ptr->ndomain > 1 ? " with domain task queues" : "")
+                      << ".\n";
+#endif
+
 #ifdef MADNESS_TASK_PROFILING
         // Initialize the output file name for the task profiler.
         profiling::TaskProfiler::output_file_name_ =
@@ -553,9 +603,57 @@ namespace madness {
         instance_ptr = nullptr;
     }
 
+    // Returns the number of tasks in the queue(s)
+    std::size_t ThreadPool::queue_size() {
+        ThreadPool* const pool = instance();
+        std::size_t n = pool->queue.size();
+#if !HAVE_INTEL_TBB
+        if (pool->work_stealing) {
+            for (int i=0; i<pool->nthreads; ++i)
+                n += pool->threads[i].deque().size();
+        }
+#endif
+        return n;
+    }
+
     // Returns queue statistics
     const DQStats& ThreadPool::get_stats() {
-        return instance()->queue.get_stats();
+        ThreadPool* const pool = instance();
+        if (!pool->work_stealing) return pool->queue.get_stats();
+
+        // Fold the local deques into the statistics of the shared queue.
+        // Tasks pushed locally count as pushed to the back, and each pop or
+        // steal counts as a pop from the front.
+        pool->stats = pool->queue.get_stats();
+#if !HAVE_INTEL_TBB
+        for (int d=0; pool->domains && d<pool->ndomain; ++d) {
+            const DQStats s = pool->domains[d].queue.get_stats();
+            pool->stats.npush_back += s.npush_back;
+            pool->stats.npop_front += s.npop_front;
+            pool->stats.ngrow += s.ngrow;
+        }
+        for (int i=0; i<pool->nthreads; ++i) {
+            const WSDQStats s = pool->threads[i].deque().get_stats();
+            pool->stats.npush_back += s.npush;
+            pool->stats.npop_front += s.npop + s.nsteal;
+            pool->stats.ngrow += s.ngrow;
+            pool->stats.nsteal += s.nsteal;
+        }
+#endif
+        return pool->stats;
+    }
+
+    // Returns the task counts of the NUMA domains
+    std::vector<NumaDomainStats> ThreadPool::get_numa_stats() {
+        ThreadPool* const pool = instance();
+        std::vector<NumaDomainStats> result;
+        for (int d=0; pool->domains && d<pool->ndomain; ++d) {
+            NumaDomainStats s;
+            s.ntask = pool->domains[d].ntask;
+            s.nremote = pool->domains[d].nremote;
+            result.push_back(s);
+        }
+        return result;
     }
 
 } // namespace madness
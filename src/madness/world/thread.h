@@ -39,7 +39,11 @@
 */
 
 #include <madness/world/dqueue.h>
+#include <madness/world/wsdeque.h>
 #include <madness/world/function_traits.h>
+#include <madness/world/worldtrace.h>
+#include <madness/world/completion_scope.h>
+#include <madness/world/numa.h>
 #include <vector>
 #include <cstddef>
 #include <cstdio>
@@ -47,6 +51,8 @@
 #include <type_traits>
 #include <typeinfo>
 #include <new>
+#include <cstdlib>
+#include <madness/world/posixmem.h>
 
 //////////// Parsec Related Begin ////////////////////
 #ifdef HAVE_PARSEC
@@ -277,6 +283,9 @@ namespace madness {
     /// - \c nthread : indicates number of threads. 0 threads is interpreted
     ///   as 1 thread for backward compatibility and ease of specifying
     ///   defaults. The default value is 0 (==1).
+    /// - \c numa_domain : the NUMA domain owning the data of the task, a
+    ///   hint used only with NUMA placement (see \c NumaTopology). The
+    ///   default is none (-1).
     class TaskAttributes {
         unsigned long flags; ///< Byte-string storing the specified attributes.
 
@@ -285,6 +294,7 @@ namespace madness {
         static const unsigned long GENERATOR = 1ul<<8; ///< Mask for generator bit.
         static const unsigned long STEALABLE = GENERATOR<<1; ///< Mask for stealable bit.
         static const unsigned long HIGHPRIORITY = GENERATOR<<2; ///< Mask for priority bit.
+        static const unsigned long NUMADOMAIN = 0xfful<<16; ///< Mask for NUMA domain byte (domain+1, 0 if none).
 
         /// Sets the attributes to the desired values.
 
@@ -380,6 +390,21 @@ namespace madness {
         	return n;
         }
 
+        /// Sets the NUMA domain hint.
+
+        /// \param[in] domain The domain owning the data of the task, or -1 for none.
+        void set_numa_domain(int domain) {
+            MADNESS_ASSERT(domain>=-1 && domain<255);
+            flags = (flags & (~NUMADOMAIN)) | ((unsigned long)(domain+1) << 16);
+        }
+
+        /// Get the NUMA domain hint.
+
+        /// \return The domain owning the data of the task, or -1 for none.
+        int get_numa_domain() const {
+            return int((flags & NUMADOMAIN) >> 16) - 1;
+        }
+
         /// Serializes the attributes for I/O.
 
         /// tparam Archive The archive type.
@@ -861,6 +886,8 @@ namespace madness {
 
     protected:
 
+        CompletionScope::Counters* completion_scope; ///< Completion scope of the task, or null.
+
         /// \todo Brief description needed.
 
         /// \todo Descriptions needed.
@@ -920,7 +947,12 @@ namespace madness {
 #ifdef MADNESS_TASK_PROFILING
                 task_event_->start(id_, nthread, submit_time_);
 #endif // MADNESS_TASK_PROFILING
-                run(TaskThreadEnv(1,0,0));
+                {
+                    WorldTraceScope trace(this);
+                    CompletionScope::Counters* prev = CompletionScope::set_current(completion_scope);
+                    run(TaskThreadEnv(1,0,0));
+                    CompletionScope::set_current(prev);
+                }
 #ifdef MADNESS_TASK_PROFILING
                 task_event_->stop();
 #endif // MADNESS_TASK_PROFILING
@@ -936,7 +968,12 @@ namespace madness {
                     task_event_->start(id_, nthread, submit_time_);
 #endif // MADNESS_TASK_PROFILING
 
-                run(TaskThreadEnv(nthread, id, barrier));
+                {
+                    WorldTraceScope trace(this);
+                    CompletionScope::Counters* prev = CompletionScope::set_current(completion_scope);
+                    run(TaskThreadEnv(nthread, id, barrier));
+                    CompletionScope::set_current(prev);
+                }
 
 #ifdef MADNESS_TASK_PROFILING
                 const bool cleanup = barrier->enter(id);
@@ -953,6 +990,7 @@ namespace madness {
         /// Default constructor.
         PoolTaskInterface()
             : TaskAttributes()
+            , completion_scope(nullptr)
             , barrier(nullptr)
         {
 #if HAVE_PARSEC
@@ -966,6 +1004,7 @@ namespace madness {
         /// \param[in] attr The task attributes.
         explicit PoolTaskInterface(const TaskAttributes& attr)
             : TaskAttributes(attr)
+            , completion_scope(nullptr)
             , barrier(attr.get_nthread()>1 ? new Barrier(attr.get_nthread()) : 0)
         {
 #if HAVE_PARSEC
@@ -1021,7 +1060,7 @@ namespace madness {
     public:
 
         /// Default constructor.
-        PoolTaskInterface() : TaskAttributes() { 
+        PoolTaskInterface() : TaskAttributes(), completion_scope(nullptr) { 
 	}
 
         /// \todo Brief description needed.
@@ -1029,7 +1068,7 @@ namespace madness {
         /// \todo Descriptions needed.
         /// \param[in] attr Description needed.
         explicit PoolTaskInterface(const TaskAttributes& attr) :
-            TaskAttributes(attr)
+            TaskAttributes(attr), completion_scope(nullptr)
         {
 	}
 
@@ -1115,6 +1154,46 @@ namespace madness {
         }
     };
 
+    namespace detail {
+
+        /// Allocates and default-constructs an array of over-aligned objects.
+
+        /// Before C++17 \c new[] ignores alignments beyond that of
+        /// \c max_align_t, which the cache-line aligned queues need.
+        /// \tparam T The element type.
+        /// \param[in] n The number of elements.
+        /// \return The array; release it with \c delete_aligned_array().
+        template <typename T>
+        T* new_aligned_array(int n) {
+            void* p = nullptr;
+            if (posix_memalign(&p, alignof(T), n*sizeof(T))) throw std::bad_alloc();
+            T* a = static_cast<T*>(p);
+            int i = 0;
+            try {
+                for (; i<n; ++i) new (a+i) T();
+            }
+            catch (...) {
+                while (i--) a[i].~T();
+                free(p);
+                throw;
+            }
+            return a;
+        }
+
+        /// Destroys and frees an array made by \c new_aligned_array().
+
+        /// \tparam T The element type.
+        /// \param[in] a The array (may be \c nullptr).
+        /// \param[in] n The number of elements.
+        template <typename T>
+        void delete_aligned_array(T* a, int n) {
+            if (!a) return;
+            for (int i=n-1; i>=0; --i) a[i].~T();
+            free(a);
+        }
+
+    } // namespace detail
+
     /// \c ThreadPool thread object.
 
     /// This class holds thread local data for thread pool threads. It can be
@@ -1125,11 +1204,48 @@ namespace madness {
 #ifdef MADNESS_TASK_PROFILING
         profiling::TaskProfiler profiler_; ///< \todo Description needed.
 #endif // MADNESS_TASK_PROFILING
+        WSDeque<PoolTaskInterface*> deque_; ///< Local tasks for the work-stealing scheduler.
+        unsigned int seed_; ///< State of the random number generator used to pick victims.
+        int numa_domain_; ///< NUMA domain of the thread, or -1 without NUMA placement.
 
     public:
-        ThreadPoolThread() : Thread() { }
+        ThreadPoolThread() : Thread(), deque_(256), seed_(0), numa_domain_(-1) { }
         virtual ~ThreadPoolThread() = default;
 
+        /// NUMA domain of the thread.
+
+        /// \return The domain, or -1 without NUMA placement.
+        int numa_domain() const {
+            return numa_domain_;
+        }
+
+        /// Sets the NUMA domain of the thread.
+
+        /// \param[in] domain The domain.
+        void set_numa_domain(int domain) {
+            numa_domain_ = domain;
+        }
+
+        /// Work-stealing deque of this thread.
+
+        /// Only this thread may push or pop; other threads may steal.
+        /// \return The deque.
+        WSDeque<PoolTaskInterface*>& deque() {
+            return deque_;
+        }
+
+        /// Cheap thread-local pseudo-random number (xorshift).
+
+        /// \return A random number.
+        unsigned int random() {
+            unsigned int x = seed_;
+            if (x == 0) x = 2463534242u + 2654435761u*unsigned(get_pool_thread_index()+2);
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            return (seed_ = x);
+        }
+
 #ifdef MADNESS_TASK_PROFILING
         /// Task profiler accessor.
 
@@ -1141,6 +1257,12 @@ namespace madness {
 #endif // MADNESS_TASK_PROFILING
     };
 
+    /// Task counts of a NUMA domain.
+    struct NumaDomainStats {
+        unsigned long ntask;    ///< #tasks run with this domain as hint
+        unsigned long nremote;  ///< #those run by a thread of another domain
+    };
+
     /// A singleton pool of threads for dynamic execution of tasks.
 
     /// \attention You must instantiate the pool while running with just one
@@ -1156,17 +1278,36 @@ namespace madness {
      private:
         friend class WorldTaskQueue;
 
+        /// Task queue and counters of a NUMA domain.
+        struct NumaDomain {
+            DQueue<PoolTaskInterface*> queue; ///< Tasks hinted to this domain.
+            AtomicInt ntask; ///< #tasks run with this domain as hint.
+            AtomicInt nremote; ///< #those run by a thread of another domain.
+
+            NumaDomain() : queue(4096) {
+                ntask = 0;
+                nremote = 0;
+            }
+        };
+
         // Thread pool data
         ThreadPoolThread *threads; ///< Array of threads.
         ThreadPoolThread main_thread; ///< Placeholder for main thread tls.
-        DQueue<PoolTaskInterface*> queue; ///< Queue of tasks.
+        DQueue<PoolTaskInterface*> queue; ///< Queue of tasks (shared inbox when work stealing).
         int nthreads; ///< Number of threads.
         volatile bool finish; ///< Set to true when time to stop.
         AtomicInt nfinished; ///< Thread pool exit counter.
+        bool work_stealing; ///< True if pool threads keep their tasks in local work-stealing deques.
+        AtomicInt nidle; ///< Number of pool threads blocked on the shared queue (work stealing only).
+        DQStats stats; ///< Statistics combined over the shared queue and local deques.
+        int ndomain; ///< Number of NUMA domains with their own queue (1 without NUMA placement).
+        NumaDomain* domains; ///< The NUMA domains (\c nullptr if \c ndomain is 1).
 
         // Static data
         static ThreadPool* instance_ptr; ///< Singleton pointer.
         static const int nmax = 128; ///< Number of task a worker thread will pop from the task queue
+        static const int nspin = 64; ///< Number of steal attempts an idle worker makes before blocking
+        static const int nbatch_domain = 16; ///< Number of tasks a worker takes at once from a domain queue
         static double await_timeout; ///< Waiter timeout.
 
 #if defined(HAVE_IBMBGQ) and defined(HPM)
@@ -1233,8 +1374,24 @@ namespace madness {
             MADNESS_EXCEPTION("run_tasks should not be called when using Intel TBB", 1);
 #else
 
+            if (work_stealing) return run_tasks_ws(wait, this_thread);
+
             PoolTaskInterface* taskbuf[nmax];
             int ntask = queue.pop_front(nmax, taskbuf, wait);
+            run_task_list(ntask, taskbuf, this_thread);
+            return (ntask>0);
+#endif
+        }
+
+#if !HAVE_INTEL_TBB
+        /// Run a list of tasks popped from the queue.
+
+        /// \param[in] ntask The number of tasks.
+        /// \param[in] taskbuf The tasks; null pointers are skipped.
+        /// \param[in,out] this_thread The calling thread (used only for profiling).
+        void run_task_list(int ntask, PoolTaskInterface* const* taskbuf,
+                ThreadPoolThread* const this_thread)
+        {
 #ifdef MADNESS_TASK_PROFILING
             profiling::TaskEventList* event_list =
                     this_thread->profiler().new_list(ntask);
@@ -1244,14 +1401,144 @@ namespace madness {
 #ifdef MADNESS_TASK_PROFILING
                     taskbuf[i]->set_event(event_list->event());
 #endif // MADNESS_TASK_PROFILING
+                    if (ndomain > 1) count_numa(taskbuf[i], this_thread);
                     if (taskbuf[i]->run_multi_threaded()) {
                         delete taskbuf[i];
                     }
                 }
             }
+        }
+
+        /// Pool thread of the calling thread.
+
+        /// \return The pool thread, or \c nullptr if the caller is not in the pool.
+        ThreadPoolThread* local_thread() const {
+            ThreadBase* const self = ThreadBase::this_thread();
+            const int ind = (self ? self->get_pool_thread_index() : -1);
+            return (ind >= 0 ? threads + ind : nullptr);
+        }
+
+        /// Counts a task about to run against the NUMA domain of its hint.
+
+        /// \param[in] task The task.
+        /// \param[in] this_thread The thread running it.
+        void count_numa(const PoolTaskInterface* task, const ThreadPoolThread* this_thread) {
+            const int d = task->get_numa_domain();
+            if (d < 0 || d >= ndomain) return;
+            domains[d].ntask++;
+            if (!this_thread || this_thread->numa_domain() != d) domains[d].nremote++;
+        }
+
+        /// Try to steal a task from the deque of another pool thread.
+
+        /// Victims are visited round robin starting from a random thread.
+        /// \param[in,out] local The pool thread of the caller (\c nullptr if not in the pool).
+        /// \param[out] task The stolen task.
+        /// \param[in] domain Rob only threads of this NUMA domain, or any thread if -1.
+        /// \return True if a task was stolen.
+        bool steal(ThreadPoolThread* const local, PoolTaskInterface*& task, int domain = -1) {
+            if (nthreads == 0) return false;
+            ThreadPoolThread* const rng = (local ? local : &main_thread);
+            const int start = rng->random() % nthreads;
+            for (int i=0; i<nthreads; ++i) {
+                ThreadPoolThread* const victim = threads + ((start + i) % nthreads);
+                if (victim == local) continue;
+                if (domain >= 0 && victim->numa_domain() != domain) continue;
+                if (victim->deque().steal(task)) return true;
+            }
+            return false;
+        }
+
+        /// Find work away from the local deque.
+
+        /// With NUMA placement the caller's own domain comes first, its
+        /// queue and then its threads, before the other domains in turn.
+        /// \param[in,out] local The pool thread of the caller (\c nullptr if not in the pool).
+        /// \param[out] taskbuf Buffer for at least \c nbatch_domain tasks.
+        /// \return The number of tasks found.
+        int find_work(ThreadPoolThread* const local, PoolTaskInterface** taskbuf) {
+            if (ndomain == 1) return (steal(local, taskbuf[0]) ? 1 : 0);
+            const int mine = (local ? local->numa_domain() : 0);
+            for (int i=0; i<ndomain; ++i) {
+                const int d = (mine + i) % ndomain;
+                DQueue<PoolTaskInterface*>& q = domains[d].queue;
+                const int ntask = (q.empty() ? 0 : q.pop_front(nbatch_domain, taskbuf, false));
+                if (ntask) return ntask;
+                if (steal(local, taskbuf[0], d)) return 1;
+            }
+            return 0;
+        }
+
+        /// Push a single-threaded task onto the local deque of the caller.
+
+        /// Tasks submitted by threads outside the pool (main, RMI server), or
+        /// while a pool thread is blocked waiting for work, go into the shared
+        /// queue instead so that they are seen and wake a sleeper.
+        /// \param[in] task The task.
+        void add_local(PoolTaskInterface* task) {
+            ThreadPoolThread* const local = local_thread();
+            const int domain = (ndomain > 1 ? task->get_numa_domain() : -1);
+            if (domain >= 0 && domain < ndomain && !(local && local->numa_domain() == domain)) {
+                // The task belongs to another domain ... leave it in the
+                // queue of that domain, waking a sleeper as below
+                domains[domain].queue.push_back(task);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (nidle > 0) queue.push_back(new PoolTaskNull);
+                return;
+            }
+            if (!local || nidle > 0) {
+                queue.push_back(task);
+                return;
+            }
+            local->deque().push(task);
+
+            // A thread might have gone to sleep after we checked nidle but
+            // before it could see our push ... if so, wake it up.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (nidle > 0) queue.push_back(new PoolTaskNull);
+        }
+
+        /// Run the next task(s) using the work-stealing scheduler.
+
+        /// Tasks in the shared queue (high-priority, multi-threaded and
+        /// externally submitted tasks) are taken first in batches, then the
+        /// local deque is popped LIFO, and finally other threads are robbed
+        /// FIFO (with NUMA placement, see find_work()).  If \c wait is true
+        /// an idle thread spins for a while trying to steal before blocking
+        /// on the shared queue.
+        /// \param[in] wait Block until a task is available.
+        /// \param[in,out] this_thread The calling thread (used only for profiling).
+        /// \return True if a task was run.
+        bool run_tasks_ws(bool wait, ThreadPoolThread* const this_thread) {
+            PoolTaskInterface* taskbuf[nmax];
+            ThreadPoolThread* const local = local_thread();
+
+            for (int pass=0; pass <= (wait ? nspin : 0); ++pass) {
+                if (pass) {
+                    if (finish) return false;
+                    for (int i=0; i<300; ++i) cpu_relax();
+                }
+                int ntask = (queue.empty() ? 0 : queue.pop_front(nmax, taskbuf, false));
+                if (ntask == 0 && local && local->deque().pop(taskbuf[0])) ntask = 1;
+                if (ntask == 0) ntask = find_work(local, taskbuf);
+                if (ntask) {
+                    run_task_list(ntask, taskbuf, this_thread);
+                    return true;
+                }
+            }
+            if (!wait) return false;
+
+            // Announce that we are going to sleep and then look once more,
+            // so that a concurrent push to a local deque is either seen here
+            // or redirected to the shared queue by add_local().
+            ++nidle;
+            int ntask = find_work(local, taskbuf);
+            if (ntask == 0) ntask = queue.pop_front(nmax, taskbuf, true);
+            nidle--;
+            run_task_list(ntask, taskbuf, this_thread);
             return (ntask>0);
-#endif
         }
+#endif // !HAVE_INTEL_TBB
 
         /// \todo Brief description needed.
 
@@ -1333,6 +1620,9 @@ namespace madness {
             if (task->is_high_priority() && (task_threads == 1)) {
                 instance()->queue.push_front(task);
             }
+            else if (task_threads == 1 && instance()->work_stealing) {
+                instance()->add_local(task);
+            }
             else {
                 instance()->queue.push_back(task, task_threads);
             }
@@ -1405,8 +1695,15 @@ namespace madness {
         /// Returns the number of tasks in the queue.
 
         /// \return The number of tasks in the queue.
-        static std::size_t queue_size() {
-            return instance()->queue.size();
+        static std::size_t queue_size();
+
+        /// Returns true if the pool is using the work-stealing scheduler.
+
+        /// Selected at startup with the environment variable
+        /// \c MAD_TASK_SCHEDULER (\c dqueue, the default, or \c steal).
+        /// \return True if pool threads have local work-stealing deques.
+        static bool is_work_stealing() {
+            return instance()->work_stealing;
         }
 
         /// Returns queue statistics.
@@ -1414,6 +1711,11 @@ namespace madness {
         /// \return Queue statistics.
         static const DQStats& get_stats();
 
+        /// Returns the task counts of the NUMA domains.
+
+        /// \return One entry per domain; empty without NUMA placement of tasks.
+        static std::vector<NumaDomainStats> get_numa_stats();
+
         /// Gracefully wait for a condition to become true, executing any tasks in the queue.
 
         /// Probe should be an object that, when called, returns the status.
@@ -1481,6 +1783,7 @@ namespace madness {
             tbb_scheduler->terminate();
             delete(tbb_scheduler);
 #endif
+            detail::delete_aligned_array(domains, ndomain);
         }
     };
 
@@ -41,6 +41,8 @@
 #include <madness/world/worldam.h>
 #include <madness/world/world_task_queue.h>
 #include <madness/world/worldgop.h>
+#include <madness/world/async_writer.h>
+#include <madness/world/worldtrace.h>
 #include <cstdlib>
 #include <sstream>
 
@@ -209,6 +211,8 @@ namespace madness {
         // Construct the default world
         World::default_world = new World(comm);
 
+        if (getenv("MAD_TRACE")) WorldTrace::enable();
+
         madness_initialized_ = true;
         if(SafeMPI::COMM_WORLD.Get_rank() == 0)
             std::cout << "MADNESS runtime initialized with " << ThreadPool::size()
@@ -218,8 +222,16 @@ namespace madness {
     }
 
     void finalize() {
+        AsyncWriter::end();
         World::default_world->gop.fence();
 
+        const char* trace = getenv("MAD_TRACE");
+        if (trace) {
+            WorldTrace::disable();
+            const int rank = World::default_world->rank();
+            WorldTrace::write(std::string(trace) + "." + std::to_string(rank) + ".json", rank);
+        }
+
         // Destroy the default world
         delete World::default_world;
         World::default_world = nullptr;
@@ -282,38 +294,76 @@ namespace madness {
         world.gop.min(min_nbyte_recv);
         world.gop.min(min_server_q);
 
+        // Use of the RMI receive buffer classes
+        double rmi_class[4] = {double(rmi.nmsg_recv_small), double(rmi.nmsg_recv_huge),
+                               double(rmi.nrecv_buf_small), double(rmi.nrecv_buf_large)};
+        double max_rmi_class[4], min_rmi_class[4];
+        std::copy(rmi_class, rmi_class+4, max_rmi_class);
+        std::copy(rmi_class, rmi_class+4, min_rmi_class);
+        world.gop.sum(rmi_class, 4);
+        world.gop.max(max_rmi_class, 4);
+        world.gop.min(min_rmi_class, 4);
+
+        // Per receive engine message counts (engine e serves sources with rank%nengine == e)
+        const int nengine = RMI::nengine();
+        std::vector<double> engine_nmsg(nengine+1), max_engine_nmsg, min_engine_nmsg;
+        if (nengine > 1) {
+            for (int e=0; e<nengine; ++e) engine_nmsg[e] = RMI::get_stats(e).nmsg_recv;
+            max_engine_nmsg = min_engine_nmsg = engine_nmsg;
+            world.gop.sum(&engine_nmsg[0], nengine);
+            world.gop.max(&max_engine_nmsg[0], nengine);
+            world.gop.min(&min_engine_nmsg[0], nengine);
+        }
+
+        // Per NUMA domain task counts (empty without NUMA task placement)
+        const std::vector<NumaDomainStats> numa = ThreadPool::get_numa_stats();
+        int ndomain = numa.size();
+        world.gop.max(ndomain);
+        std::vector<double> numa_ntask(2*ndomain+1, 0.0);
+        for (std::size_t d=0; d<numa.size(); ++d) {
+            numa_ntask[2*d] = numa[d].ntask;
+            numa_ntask[2*d+1] = numa[d].nremote;
+        }
+        if (ndomain) world.gop.sum(&numa_ntask[0], 2*ndomain);
+
         double npush_back = q.npush_back;
         double npush_front = q.npush_front;
         double npop_front = q.npop_front;
         double ntask = q.npush_back + q.npush_front;
         double nmax = q.nmax;
+        double nsteal = q.nsteal;
         world.gop.sum(npush_back);
         world.gop.sum(npush_front);
         world.gop.sum(npop_front);
         world.gop.sum(ntask);
         world.gop.sum(nmax);
+        world.gop.sum(nsteal);
 
         double max_npush_back = q.npush_back;
         double max_npush_front = q.npush_front;
         double max_npop_front = q.npop_front;
         double max_ntask = q.npush_back + q.npush_front;
         double max_nmax = q.nmax;
+        double max_nsteal = q.nsteal;
         world.gop.max(max_npush_back);
         world.gop.max(max_npush_front);
         world.gop.max(max_npop_front);
         world.gop.max(max_ntask);
         world.gop.max(max_nmax);
+        world.gop.max(max_nsteal);
 
         double min_npush_back = q.npush_back;
         double min_npush_front = q.npush_front;
         double min_npop_front = q.npop_front;
         double min_ntask = q.npush_back + q.npush_front;
         double min_nmax = q.nmax;
+        double min_nsteal = q.nsteal;
         world.gop.min(min_npush_back);
         world.gop.min(min_npush_front);
         world.gop.min(min_npop_front);
         world.gop.min(min_ntask);
         world.gop.min(min_nmax);
+        world.gop.min(min_nsteal);
 
 #ifdef HAVE_PAPI
         double val[NUMEVENTS], max_val[NUMEVENTS], min_val[NUMEVENTS];
@@ -334,6 +384,10 @@ namespace madness {
                 printf("       #threads per node    %d+main = %d\n", int(ThreadPool::size()), int(ThreadPool::size()+1));
                 printf("          #total threads    %d\n", int(ThreadPool::size()+1));
             }
+            else if (nengine > 1) {
+                printf("       #threads per node    %d+main+%d servers = %d\n", int(ThreadPool::size()), nengine, int(ThreadPool::size()+1+nengine));
+                printf("          #total threads    %d\n", int(ThreadPool::size()+1+nengine)*world.size());
+            }
             else {
                 printf("       #threads per node    %d+main+server = %d\n", int(ThreadPool::size()), int(ThreadPool::size()+2));
                 printf("          #total threads    %d\n", int(ThreadPool::size()+2)*world.size());
@@ -352,6 +406,14 @@ namespace madness {
                    min_nmsg_recv, nmsg_recv/world.size(), max_nmsg_recv);
             printf("    #bytes recv per node    %.2e / %.2e / %.2e\n",
                    min_nbyte_recv, nbyte_recv/world.size(), max_nbyte_recv);
+            const char* rmi_class_name[4] = {"#msgs recv small buf", "#huge msgs recv",
+                                             "#small bufs posted", "#large bufs posted"};
+            for (int c=0; c<4; ++c)
+                printf("%24s    %.2e / %.2e / %.2e\n", rmi_class_name[c],
+                       min_rmi_class[c], rmi_class[c]/world.size(), max_rmi_class[c]);
+            for (int e=0; nengine>1 && e<nengine; ++e)
+                printf(" #msgs recv by engine %2d    %.2e / %.2e / %.2e\n", e,
+                       min_engine_nmsg[e], engine_nmsg[e]/world.size(), max_engine_nmsg[e]);
             printf("        #msgs systemwide    %.2e\n", nmsg_sent);
             printf("       #bytes systemwide    %.2e\n", nbyte_sent);
             printf("\n");
@@ -363,6 +425,12 @@ namespace madness {
                    min_nmax, nmax/world.size(), max_nmax);
             printf("  #hi-pri tasks per node    %.2e / %.2e / %.2e\n",
                    min_npush_front, npush_front/world.size(), max_npush_front);
+            if (ThreadPool::is_work_stealing())
+                printf("  #stolen tasks per node    %.2e / %.2e / %.2e\n",
+                       min_nsteal, nsteal/world.size(), max_nsteal);
+            for (int d=0; d<ndomain; ++d)
+                printf("  NUMA domain %2d #tasks    %.2e   #run remotely %.2e\n", d,
+                       numa_ntask[2*d], numa_ntask[2*d+1]);
             printf("\n");
 #ifdef HAVE_PAPI
             printf("         PAPI statistics (min / avg / max)\n");
@@ -384,6 +452,7 @@ namespace madness {
 #ifdef WORLD_GATHER_MEM_STATS
             world_mem_info()->print();
 #endif
+            if (PoolAllocator::enabled()) world_mem_info()->print_pool();
 
             printf("         Total wall time    %.1fs\n", total_wall_time);
             printf("         Total  cpu time    %.1fs\n", total_cpu_time);
@@ -56,17 +56,28 @@ namespace madness {
         /// To eliminate synchronization when a distributed object is first
         /// constructed, we buffer pending messages for containers that
         /// don't have their ID yet registered.
+        ///
+        /// A deferred message counts as a pending task of its completion
+        /// scope until its handler has run.
         struct PendingMsg {
             uniqueidT id;
             am_handlerT handler;
             AmArg* arg;
+            CompletionScope::Counters* scope;
 
             PendingMsg(uniqueidT id, am_handlerT handler, const AmArg& arg)
-                    : id(id), handler(handler), arg(copy_am_arg(arg)) {}
+                    : id(id), handler(handler), arg(copy_am_arg(arg))
+                    , scope(CompletionScope::current())
+            {
+                if (scope) scope->ntask++;
+            }
 
             void invokehandler() {
+                CompletionScope::Counters* prev = CompletionScope::set_current(scope);
                 handler(*arg);
+                CompletionScope::set_current(prev);
                 free_am_arg(arg);
+                if (scope) scope->ntask--;
             }
         };
 
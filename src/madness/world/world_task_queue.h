@@ -1387,6 +1387,7 @@ namespace madness {
 
         /// While waiting, the calling thread will run tasks.
         void fence() {
+            MADNESS_TRACE_BLOCK("task queue fence");
             try {
                 ThreadPool::await(ProbeAllDone(this), true);
             } catch(...) {
@@ -38,6 +38,7 @@
 #include <madness/world/buffer_archive.h>
 #include <madness/world/worldrmi.h>
 #include <madness/world/world.h>
+#include <madness/world/completion_scope.h>
 #include <vector>
 #include <cstddef>
 #include <memory>
@@ -90,9 +91,10 @@ namespace madness {
         am_handlerT func;       // User function to call
         ProcessID src;          // Rank of process sending the message
         unsigned int flags;     // Misc. bit flags
+        unsigned long scope;    // Id of the completion scope, or zero if none
 
-        // On 32 bit machine AmArg is HEADER_LEN+4+4+4+4+4=84 bytes
-        // On 64 bit machine AmArg is HEADER_LEN+8+8+8+4+4=96 bytes
+        // On 32 bit machine AmArg is HEADER_LEN+4+4+4+4+4+4=88 bytes
+        // On 64 bit machine AmArg is HEADER_LEN+8+8+8+4+4+8=104 bytes
 
         // No copy constructor or assignment
         AmArg(const AmArg&);
@@ -115,6 +117,10 @@ namespace madness {
 
         void clear_flags() { flags = 0; }
 
+        void set_scope(unsigned long id) { scope = id; }
+
+        unsigned long get_scope() const { return scope; }
+
         am_handlerT get_func() const { return func; }
 
         archive::BufferInputArchive make_input_arch() const {
@@ -194,11 +200,14 @@ namespace madness {
     inline AmArg* new_am_arg(const argT&... args) {
         // compute size
         archive::BufferOutputArchive count;
+        count.set_active_message();
         serialize_am_args(count, args...);
 
-        // Serialize arguments
+        // Serialize arguments with the encodings chosen while counting
         AmArg* am_args = alloc_am_arg(count.size());
-        serialize_am_args(*am_args, args...);
+        archive::BufferOutputArchive ar(am_args->buf(), am_args->size());
+        ar.set_active_message(count.wire_mode());
+        serialize_am_args(ar, args...);
         return am_args;
     }
 
@@ -252,8 +261,9 @@ namespace madness {
 
         /// This handles all incoming RMI messages for all instances
         static void handler(void *buf, std::size_t nbyte) {
-            // It will be singled threaded since only the RMI receiver
-            // thread will invoke it ... however note that nrecv will
+            // With several RMI receive engines, or unordered messages
+            // handed to the thread pool, handlers may run concurrently
+            // so nrecv is updated under the lock.  Note that nrecv will
             // be read by the main thread during fence operations.
             AmArg* arg = static_cast<AmArg*>(buf);
             am_handlerT func = arg->get_func();
@@ -261,8 +271,14 @@ namespace madness {
             MADNESS_ASSERT(arg->size() + sizeof(AmArg) == nbyte);
             MADNESS_ASSERT(w);
             MADNESS_ASSERT(func);
+            // Work started by the message belongs to the scope of the message
+            CompletionScope::Counters* scope = arg->get_scope() ?
+                CompletionScope::find(arg->get_worldid(), arg->get_scope()) : nullptr;
+            CompletionScope::Counters* prev = CompletionScope::set_current(scope);
             func(*arg);
-            w->am.nrecv++;  // Must be AFTER execution of the function
+            CompletionScope::set_current(prev);
+            if (scope) scope->nrecv++; // Must be AFTER execution of the function
+            w->am.lock(); w->am.nrecv++; w->am.unlock();  // Must be AFTER execution of the function
         }
 
     public:
@@ -285,6 +301,10 @@ namespace madness {
                 argx->set_src(rank);
                 argx->set_func(op);
                 argx->clear_flags(); // Is this the right place for this?
+
+                CompletionScope::Counters* scope = CompletionScope::current();
+                argx->set_scope(scope ? scope->id : 0);
+                if (scope) scope->nsent++; // Must be BEFORE the message can be handled
             }
 
             // Sanity check
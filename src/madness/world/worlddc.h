@@ -42,6 +42,7 @@
 
 #include <madness/world/parallel_archive.h>
 #include <madness/world/worldhashmap.h>
+#include <madness/world/resizable_hashmap.h>
 #include <madness/world/mpi_archive.h>
 #include <madness/world/world_object.h>
 #include <set>
@@ -177,6 +178,15 @@ namespace madness {
         }
     };
 
+    /// Hash deciding the NUMA domain owning a key (see WorldContainer::task)
+
+    /// By default the hash of the container; overload it for keys whose
+    /// neighbours should share a domain.
+    template <typename keyT, typename hashfunT>
+    hashT numa_hash(const keyT& key, const hashfunT& hf) {
+        return hf(key);
+    }
+
     /// Default process map is "random" using madness::hash(key)
 
     /// \ingroup worlddc
@@ -343,7 +353,11 @@ namespace madness {
         typedef const pairT const_pairT;
         typedef WorldContainerImpl<keyT,valueT,hashfunT> implT;
 
+#ifdef MADNESS_RESIZABLE_HASHMAP
+        typedef ResizableHashMap< keyT,valueT,hashfunT > internal_containerT;
+#else
         typedef ConcurrentHashMap< keyT,valueT,hashfunT > internal_containerT;
+#endif
 
 	//typedef WorldObject< WorldContainerImpl<keyT, valueT, hashfunT> > worldobjT;
 
@@ -427,7 +441,7 @@ namespace madness {
             return pmap;
         }
 
-        hashfunT& get_hash() const { return local.get_hash(); }
+        const hashfunT& get_hash() const { return local.get_hash(); }
 
         bool is_local(const keyT& key) const {
             return owner(key) == me;
@@ -719,6 +733,17 @@ namespace madness {
         inline void check_initialized() const {
             MADNESS_ASSERT(p);
         }
+
+        /// Adds the NUMA domain owning \c key to the attributes of a task on it
+
+        /// Only with NUMA placement (see NumaTopology), and only if the
+        /// caller gave no domain.
+        TaskAttributes numa_attr(const keyT& key, const TaskAttributes& attr) const {
+            if (!NumaTopology::enabled() || attr.get_numa_domain() >= 0) return attr;
+            TaskAttributes result(attr);
+            result.set_numa_domain(NumaTopology::domain_of_hash(numa_hash(key, p->get_hash())));
+            return result;
+        }
     public:
 
         /// Makes an uninitialized container (no communication)
@@ -961,7 +986,7 @@ namespace madness {
         }
 
         /// Returns a reference to the hashing functor
-        hashfunT& get_hash() const {
+        const hashfunT& get_hash() const {
             check_initialized();
             return p->get_hash();
         }
@@ -1219,7 +1244,7 @@ namespace madness {
         task(const keyT& key, memfunT memfun, const TaskAttributes& attr = TaskAttributes()) {
             check_initialized();
             MEMFUN_RETURNT(memfunT)(implT::*itemfun)(const keyT&, memfunT) = &implT:: template itemfun<memfunT>;
-            return p->task(owner(key), itemfun, key, memfun, attr);
+            return p->task(owner(key), itemfun, key, memfun, numa_attr(key, attr));
         }
 
         /// Adds task "resultT memfun(arg1T)" in process owning item (non-blocking comm if remote)
@@ -1238,7 +1263,7 @@ namespace madness {
             check_initialized();
             typedef REMFUTURE(arg1T) a1T;
             MEMFUN_RETURNT(memfunT)(implT::*itemfun)(const keyT&, memfunT, const a1T&) = &implT:: template itemfun<memfunT,a1T>;
-            return p->task(owner(key), itemfun, key, memfun, arg1, attr);
+            return p->task(owner(key), itemfun, key, memfun, arg1, numa_attr(key, attr));
         }
 
         /// Adds task "resultT memfun(arg1T,arg2T)" in process owning item (non-blocking comm if remote)
@@ -1258,7 +1283,7 @@ namespace madness {
             typedef REMFUTURE(arg1T) a1T;
             typedef REMFUTURE(arg2T) a2T;
             MEMFUN_RETURNT(memfunT)(implT::*itemfun)(const keyT&, memfunT, const a1T&, const a2T&) = &implT:: template itemfun<memfunT,a1T,a2T>;
-            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, attr);
+            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, numa_attr(key, attr));
         }
 
         /// Adds task "resultT memfun(arg1T,arg2T,arg3T)" in process owning item (non-blocking comm if remote)
@@ -1279,7 +1304,7 @@ namespace madness {
             typedef REMFUTURE(arg2T) a2T;
             typedef REMFUTURE(arg3T) a3T;
             MEMFUN_RETURNT(memfunT)(implT::*itemfun)(const keyT&, memfunT, const a1T&, const a2T&, const a3T&) = &implT:: template itemfun<memfunT,a1T,a2T,a3T>;
-            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, attr);
+            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, numa_attr(key, attr));
         }
 
         /// Adds task "resultT memfun(arg1T,arg2T,arg3T,arg4T)" in process owning item (non-blocking comm if remote)
@@ -1301,7 +1326,7 @@ namespace madness {
             typedef REMFUTURE(arg3T) a3T;
             typedef REMFUTURE(arg4T) a4T;
             MEMFUN_RETURNT(memfunT)(implT::*itemfun)(const keyT&, memfunT, const a1T&, const a2T&, const a3T&, const a4T&) = &implT:: template itemfun<memfunT,a1T,a2T,a3T,a4T>;
-            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, arg4, attr);
+            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, arg4, numa_attr(key, attr));
         }
 
         /// Adds task "resultT memfun(arg1T,arg2T,arg3T,arg4T,arg5T)" in process owning item (non-blocking comm if remote)
@@ -1324,7 +1349,7 @@ namespace madness {
             typedef REMFUTURE(arg4T) a4T;
             typedef REMFUTURE(arg5T) a5T;
             MEMFUN_RETURNT(memfunT)(implT::*itemfun)(const keyT&, memfunT, const a1T&, const a2T&, const a3T&, const a4T&, const a5T&) = &implT:: template itemfun<memfunT,a1T,a2T,a3T,a4T,a5T>;
-            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, arg4, arg5, attr);
+            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, arg4, arg5, numa_attr(key, attr));
         }
 
         /// Adds task "resultT memfun(arg1T,arg2T,arg3T,arg4T,arg5T,arg6T)" in process owning item (non-blocking comm if remote)
@@ -1348,7 +1373,7 @@ namespace madness {
             typedef REMFUTURE(arg5T) a5T;
             typedef REMFUTURE(arg6T) a6T;
             MEMFUN_RETURNT(memfunT)(implT::*itemfun)(const keyT&, memfunT, const a1T&, const a2T&, const a3T&, const a4T&, const a5T&, const a6T&) = &implT:: template itemfun<memfunT,a1T,a2T,a3T,a4T,a5T,a6T>;
-            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, arg4, arg5, arg6, attr);
+            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, arg4, arg5, arg6, numa_attr(key, attr));
         }
 
         /// Adds task "resultT memfun(arg1T,arg2T,arg3T,arg4T,arg5T,arg6T,arg7T)" in process owning item (non-blocking comm if remote)
@@ -1373,7 +1398,7 @@ namespace madness {
             typedef REMFUTURE(arg6T) a6T;
             typedef REMFUTURE(arg7T) a7T;
             MEMFUN_RETURNT(memfunT)(implT::*itemfun)(const keyT&, memfunT, const a1T&, const a2T&, const a3T&, const a4T&, const a5T&, const a6T&, const a7T&) = &implT:: template itemfun<memfunT,a1T,a2T,a3T,a4T,a5T,a6T,a7T>;
-            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, arg4, arg5, arg6, arg7, attr);
+            return p->task(owner(key), itemfun, key, memfun, arg1, arg2, arg3, arg4, arg5, arg6, arg7, numa_attr(key, attr));
         }
 
         /// Adds task "resultT memfun() const" in process owning item (non-blocking comm if remote)
@@ -1544,6 +1569,9 @@ namespace madness {
         /// before doing IO, and that all IO has completed before
         /// subsequent modifications. Also, there is always at least
         /// some synchronization between a client and its IO server.
+        ///
+        /// If ar.is_indexed() is true the container is instead written
+        /// to its own file in the indexed format, see store_indexed.
         template <class keyT, class valueT>
         struct ArchiveStoreImpl< ParallelOutputArchive, WorldContainer<keyT,valueT> > {
             static void store(const ParallelOutputArchive& ar, const WorldContainer<keyT,valueT>& t) {
@@ -1552,6 +1580,12 @@ namespace madness {
                 // typedef typename dcT::const_iterator iterator; // unused?
                 typedef typename dcT::pairT pairT;
                 World* world = ar.get_world();
+                if (ar.is_indexed()) {
+                    if (ar.dofence()) world->gop.fence();
+                    store_indexed(ar, t);
+                    if (ar.dofence()) world->gop.fence();
+                    return;
+                }
                 Tag tag = world->mpi.unique_tag();
                 ProcessID me = world->rank();
                 if (ar.dofence()) world->gop.fence();
@@ -1592,6 +1626,104 @@ namespace madness {
                 }
                 if (ar.dofence()) world->gop.fence();
             }
+
+            /// Write the local entries of every process directly into a shared file
+
+            /// Process zero writes the cookie and the sequence number of the
+            /// container to the local archive. The file starts with a header
+            /// of eight longs (cookie, version, number of entries, key size,
+            /// offset of the index, offset of the data, two unused), followed
+            /// by the index and the data. The index holds one record per
+            /// entry: the key serialized into a fixed number of bytes, and
+            /// the offset (relative to the data) and length of the serialized
+            /// value. Every process serializes its entries into one buffer
+            /// and writes its part of the index and of the data at offsets
+            /// given by a global prefix sum, so the entries of a process are
+            /// contiguous in both. If ar.is_async() is true the serialized
+            /// buffers are handed to the archive instead, which queues them
+            /// for the I/O thread in close_async.
+            static void store_indexed(const ParallelOutputArchive& ar, const WorldContainer<keyT,valueT>& t) {
+                const long magic = -5881829; // Sitar, plus one for the index
+                World* world = ar.get_world();
+                const ProcessID me = world->rank();
+                const int seq = ar.next_indexed();
+                if (me == 0) ar.local_archive() & magic & seq;
+
+                // Count the bytes of the serialized keys and values
+                unsigned long nlocal = 0, keybytes = 0, databytes = 0;
+                for (auto it=t.begin(); it!=t.end(); ++it) {
+                    BufferOutputArchive keycount, valuecount;
+                    keycount & it->first;
+                    valuecount & it->second;
+                    keybytes = std::max(keybytes, (unsigned long)(keycount.size()));
+                    databytes += valuecount.size();
+                    ++nlocal;
+                }
+                world->gop.max(keybytes);
+                const unsigned long entrybytes = keybytes + 2*sizeof(unsigned long);
+
+                // Offsets of this process in the index and the data
+                std::vector<unsigned long> counts(2*world->size(), 0ul);
+                counts[2*me] = nlocal;
+                counts[2*me+1] = databytes;
+                world->gop.sum(&counts[0], counts.size());
+                unsigned long nentry = 0, firstentry = 0, datasize = 0, firstdata = 0;
+                for (ProcessID p=0; p<world->size(); ++p) {
+                    if (p == me) {
+                        firstentry = nentry;
+                        firstdata = datasize;
+                    }
+                    nentry += counts[2*p];
+                    datasize += counts[2*p+1];
+                }
+
+                unsigned long header[8] = {(unsigned long)(magic), 1ul, nentry, keybytes,
+                                           8*sizeof(unsigned long), 0ul, 0ul, 0ul};
+                header[5] = header[4] + nentry*entrybytes;
+
+                // Serialize the index records and values
+                std::vector<unsigned char> index(nlocal*entrybytes, 0), data(databytes);
+                if (nlocal) {
+                    BufferOutputArchive dataar(&data[0], databytes);
+                    unsigned char* record = &index[0];
+                    for (auto it=t.begin(); it!=t.end(); ++it) {
+                        BufferOutputArchive keyar(record, keybytes);
+                        keyar & it->first;
+                        unsigned long location[2];
+                        location[0] = firstdata + dataar.size();
+                        dataar & it->second;
+                        location[1] = firstdata + dataar.size() - location[0];
+                        memcpy(record+keybytes, location, sizeof(location));
+                        record += entrybytes;
+                    }
+                }
+
+                // Process zero creates the file, then everyone writes their part
+                const std::string filename = ar.indexed_filename(seq);
+                int fd = -1;
+                if (me == 0) {
+                    fd = detail::open_indexed(filename, O_WRONLY | O_CREAT | O_TRUNC);
+                    detail::pwrite_all(fd, header, sizeof(header), 0);
+                }
+                if (ar.is_async()) {
+                    // The buffers are the snapshot; the I/O thread writes them later
+                    if (me == 0) ::close(fd);
+                    world->gop.barrier();
+                    if (nlocal) {
+                        ar.defer(filename, header[4] + firstentry*entrybytes, index);
+                        ar.defer(filename, header[5] + firstdata, data);
+                    }
+                    return;
+                }
+                world->gop.barrier();
+                if (me != 0) fd = detail::open_indexed(filename, O_WRONLY);
+                if (nlocal) {
+                    detail::pwrite_all(fd, &index[0], index.size(), header[4] + firstentry*entrybytes);
+                    detail::pwrite_all(fd, &data[0], data.size(), header[5] + firstdata);
+                }
+                ::close(fd);
+                world->gop.barrier();
+            }
         };
 
         template <class keyT, class valueT>
@@ -1605,18 +1737,34 @@ namespace madness {
             /// can always run a separate job to copy to a different number.
             ///
             /// The IO node simply reads all data and inserts entries.
+            ///
+            /// Containers written in the indexed format are recognized by
+            /// their cookie and read with load_indexed, by any number of
+            /// processes.
             static void load(const ParallelInputArchive& ar, WorldContainer<keyT,valueT>& t) {
                 const long magic = -5881828; // Sitar Indian restaurant in Knoxville (negative to indicate parallel!)
+                const long magic_indexed = -5881829;
                 // typedef WorldContainer<keyT,valueT> dcT; // unused
                 // typedef typename dcT::iterator iterator; // unused
                 // typedef typename dcT::pairT pairT; // unused
                 World* world = ar.get_world();
                 if (ar.dofence()) world->gop.fence();
-                if (ar.is_io_node()) {
-                    long cookie = 0l;
+
+                // Process zero decides the format for everyone
+                long cookie = 0l;
+                if (world->rank() == 0) ar.local_archive() & cookie;
+                world->gop.broadcast(cookie, 0);
+                if (cookie == magic_indexed) {
+                    int seq = 0;
+                    if (world->rank() == 0) ar.local_archive() & seq;
+                    world->gop.broadcast(seq, 0);
+                    load_indexed(ar, seq, t);
+                }
+                else if (ar.is_io_node()) {
                     int nclient = 0;
                     BinaryFstreamInputArchive& localar = ar.local_archive();
-                    localar & cookie & nclient;
+                    if (world->rank() != 0) localar & cookie;
+                    localar & nclient;
                     MADNESS_ASSERT(cookie == magic);
                     while (nclient--) {
                         localar & t;
@@ -1624,6 +1772,50 @@ namespace madness {
                 }
                 if (ar.dofence()) world->gop.fence();
             }
+
+            /// Read a container written by store_indexed
+
+            /// Every process reads an equal, contiguous part of the index and
+            /// the data it points to with two reads, and inserts the entries,
+            /// which sends them to their owners under the current process map.
+            static void load_indexed(const ParallelInputArchive& ar, int seq, WorldContainer<keyT,valueT>& t) {
+                const long magic = -5881829; // Sitar, plus one for the index
+                World* world = ar.get_world();
+                const std::string filename = ar.indexed_filename(seq);
+                int fd = detail::open_indexed(filename, O_RDONLY);
+
+                unsigned long header[8];
+                detail::pread_all(fd, header, sizeof(header), 0);
+                if (header[0] != (unsigned long)(magic) || header[1] != 1ul)
+                    MADNESS_EXCEPTION("load_indexed: bad header in container file", header[1]);
+                const unsigned long nentry = header[2], keybytes = header[3];
+                const unsigned long entrybytes = keybytes + 2*sizeof(unsigned long);
+
+                const unsigned long nproc = world->size(), me = world->rank();
+                const unsigned long lo = (nentry*me)/nproc, hi = (nentry*(me+1))/nproc;
+                if (hi > lo) {
+                    std::vector<unsigned char> index((hi-lo)*entrybytes);
+                    detail::pread_all(fd, &index[0], index.size(), header[4] + lo*entrybytes);
+
+                    unsigned long first[2], last[2];
+                    memcpy(first, &index[keybytes], sizeof(first));
+                    memcpy(last, &index[index.size()-2*sizeof(unsigned long)], sizeof(last));
+                    std::vector<unsigned char> data(last[0] + last[1] - first[0]);
+                    if (data.size())
+                        detail::pread_all(fd, &data[0], data.size(), header[5] + first[0]);
+
+                    for (const unsigned char* record=&index[0]; record<&index[0]+index.size(); record+=entrybytes) {
+                        unsigned long location[2];
+                        memcpy(location, record+keybytes, sizeof(location));
+                        keyT key;
+                        valueT value;
+                        BufferInputArchive(record, keybytes) & key;
+                        BufferInputArchive(data.data() + (location[0] - first[0]), location[1]) & value;
+                        t.replace(key, value);
+                    }
+                }
+                ::close(fd);
+            }
         };
     }
 
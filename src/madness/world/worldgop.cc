@@ -48,6 +48,7 @@ namespace madness {
     /// flight.
     void WorldGopInterface::fence() {
         PROFILE_MEMBER_FUNC(WorldGopInterface);
+        MADNESS_TRACE_BLOCK("fence");
         unsigned long nsent_prev=0, nrecv_prev=1; // invalid initial condition
         SafeMPI::Request req0, req1;
         ProcessID parent, child0, child1;
@@ -159,6 +159,12 @@ namespace madness {
         struct AllReduceTag { };
         struct GroupAllReduceTag { };
 
+        /// Arrays of at least this many bytes are reduced around a ring
+        static const std::size_t ring_reduce_min_bytes = 1ul << 20;
+
+        /// Size of the messages into which segments are split by the ring reduce
+        static const std::size_t ring_reduce_chunk_bytes = 1ul << 18;
+
 
         /// Delayed send callback object
 
@@ -612,6 +618,95 @@ namespace madness {
             return Future<result_type>::default_initializer();
         }
 
+        /// Offset of segment \c i when \c nelem elements are split into \c nseg nearly equal segments
+        static std::size_t segment_offset(std::size_t nelem, std::size_t nseg, std::size_t i) {
+            return i*(nelem/nseg) + std::min(i, nelem%nseg);
+        }
+
+        /// One step of the ring: sends \c slen elements to \c right while receiving \c rlen from \c left
+
+        /// Both transfers are split into chunks of at most \c chunk
+        /// elements and the receive of the next chunk is posted before
+        /// waiting on the current one.  If \c tmp is null data is received
+        /// directly into \c rbuf, otherwise it is received into \c tmp
+        /// (which must hold two chunks) and combined into \c rbuf with \c op.
+        template <typename T, class opT>
+        void ring_step(const T* sbuf, std::size_t slen, ProcessID right,
+                T* rbuf, std::size_t rlen, ProcessID left, Tag tag,
+                T* tmp, std::size_t chunk, opT op)
+        {
+            const std::size_t nsend = (slen + chunk - 1)/chunk;
+            const std::size_t nrecv = (rlen + chunk - 1)/chunk;
+            SafeMPI::Request rreq[2], sreq;
+
+            if (nrecv > 0) {
+                T* dst = tmp ? tmp : rbuf;
+                rreq[0] = world_.mpi.Irecv(dst, std::min(chunk,rlen)*sizeof(T), MPI_BYTE, left, tag);
+            }
+            for (std::size_t c=0; c<std::max(nsend,nrecv); ++c) {
+                if (c < nsend) {
+                    const std::size_t n = std::min(chunk, slen - c*chunk);
+                    sreq = world_.mpi.Isend(const_cast<T*>(sbuf + c*chunk), n*sizeof(T), MPI_BYTE, right, tag);
+                }
+                if (c+1 < nrecv) {
+                    const std::size_t n = std::min(chunk, rlen - (c+1)*chunk);
+                    T* dst = tmp ? tmp + ((c+1)%2)*chunk : rbuf + (c+1)*chunk;
+                    rreq[(c+1)%2] = world_.mpi.Irecv(dst, n*sizeof(T), MPI_BYTE, left, tag);
+                }
+                if (c < nrecv) {
+                    World::await(rreq[c%2]);
+                    if (tmp) {
+                        const std::size_t n = std::min(chunk, rlen - c*chunk);
+                        const T* src = tmp + (c%2)*chunk;
+                        T* dst = rbuf + c*chunk;
+                        for (std::size_t i=0; i<n; ++i) dst[i] = op(dst[i],src[i]);
+                    }
+                }
+                if (c < nsend) World::await(sreq);
+            }
+        }
+
+        /// Inplace global reduction as a ring reduce-scatter followed by a ring allgather
+
+        /// Each process sends and receives 2(P-1)/P of the array in
+        /// total, instead of the whole array log(P) times, and the only
+        /// extra memory is two chunks.  Every segment is reduced in a
+        /// fixed order and then copied, so all processes get identical
+        /// results.
+        template <typename T, class opT>
+        void ring_reduce(T* buf, std::size_t nelem, opT op) {
+            const ProcessID np = world_.size();
+            const ProcessID me = world_.rank();
+            const ProcessID right = (me + 1) % np;
+            const ProcessID left = (me + np - 1) % np;
+            const Tag tag = world_.mpi.unique_tag();
+            std::size_t chunk = ring_reduce_chunk_bytes/sizeof(T);
+            if (chunk == 0) chunk = 1;
+            std::vector<T> tmp(2*chunk);
+
+            // Reduce-scatter: afterwards this process holds the reduced segment me+1
+            for (ProcessID s=0; s<np-1; ++s) {
+                const std::size_t sseg = (me - s + np) % np;
+                const std::size_t rseg = (me - s - 1 + 2*np) % np;
+                const std::size_t slo = segment_offset(nelem, np, sseg);
+                const std::size_t rlo = segment_offset(nelem, np, rseg);
+                ring_step(buf + slo, segment_offset(nelem, np, sseg+1) - slo, right,
+                          buf + rlo, segment_offset(nelem, np, rseg+1) - rlo, left,
+                          tag, &tmp[0], chunk, op);
+            }
+
+            // Allgather: pass the reduced segments around the ring
+            for (ProcessID s=0; s<np-1; ++s) {
+                const std::size_t sseg = (me + 1 - s + np) % np;
+                const std::size_t rseg = (me - s + np) % np;
+                const std::size_t slo = segment_offset(nelem, np, sseg);
+                const std::size_t rlo = segment_offset(nelem, np, rseg);
+                ring_step(buf + slo, segment_offset(nelem, np, sseg+1) - slo, right,
+                          buf + rlo, segment_offset(nelem, np, rseg+1) - rlo, left,
+                          tag, static_cast<T*>(0), chunk, op);
+            }
+        }
+
 
     public:
 
@@ -708,9 +803,17 @@ namespace madness {
 
         /// Inplace global reduction (like MPI all_reduce) while still processing AM & tasks
 
-        /// Optimizations can be added for long messages and to reduce the memory footprint
+        /// Short arrays are reduced up a binary tree and broadcast back
+        /// down.  Arrays of at least \c ring_reduce_min_bytes are reduced
+        /// with a chunked ring reduce-scatter and allgather (see ring_reduce()).
         template <typename T, class opT>
         void reduce(T* buf, size_t nelem, opT op) {
+            if (world_.size() > 1 && nelem >= std::size_t(world_.size()) &&
+                nelem*sizeof(T) >= ring_reduce_min_bytes) {
+                ring_reduce(buf, nelem, op);
+                return;
+            }
+
             SafeMPI::Request req0, req1;
             ProcessID parent, child0, child1;
             world_.mpi.binary_tree_info(0, parent, child0, child1);
@@ -36,8 +36,13 @@
 #include <cstdlib>
 //#include <cstdio>
 #include <climits>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
 
 /*
 
@@ -59,10 +64,11 @@
  */
 
 
-static madness::WorldMemInfo stats = {0, 0, 0, 0, 0, 0, ULONG_MAX, false};
+static madness::WorldMemInfo stats = {0, 0, 0, 0, 0, 0, ULONG_MAX, false, 0, 0, 0, 0, 0};
 
 namespace madness {
     WorldMemInfo* world_mem_info() {
+        PoolAllocator::get_stats(stats);
         return &stats;
     }
 
@@ -100,6 +106,20 @@ namespace madness {
             << cur_num_bytes << " " << std::setw(12) << max_num_bytes << "\n";
     }
 
+    void WorldMemInfo::print_pool() const {
+        std::cout.flush();
+        std::cout << "\n    MADNESS tensor pool statistics\n";
+        std::cout << "    ------------------------------\n";
+        const double ncall = double(pool_num_hits + pool_num_misses);
+        std::cout << "              hits and misses " << std::setw(12)
+            << pool_num_hits << " " << std::setw(12) << pool_num_misses
+            << "  hit rate " << int(ncall > 0 ? 100.0*pool_num_hits/ncall + 0.5 : 0.0) << "%\n";
+        std::cout << "       cur and max bytes used " << std::setw(12)
+            << pool_cur_bytes_used << " " << std::setw(12) << pool_max_bytes_used << "\n";
+        std::cout << "             cur bytes cached " << std::setw(12)
+            << pool_cur_bytes_cached << "\n";
+    }
+
     void WorldMemInfo::reset() {
         num_new_calls = 0;
         num_del_calls = 0;
@@ -107,6 +127,286 @@ namespace madness {
         max_num_frags = 0;
         cur_num_bytes = 0;
         max_num_bytes = 0;
+        PoolAllocator::reset_stats();
+    }
+
+
+    namespace {
+
+        struct PoolCache;
+
+        /// Header in front of each pool block (padded to PoolAllocator::alignment)
+        struct PoolBlock {
+            PoolCache* owner;   ///< Cache of the thread that allocated the block
+            int sclass;         ///< Size class or -1 if allocated directly
+            std::size_t size;   ///< Bytes including the header
+            PoolBlock* next;    ///< Link in a free list or return queue
+        };
+
+        const std::size_t header_size = PoolAllocator::alignment;
+
+        // Four size classes per power of two starting at min_class_size
+        const int min_class_log2 = 8;
+        const std::size_t min_class_size = std::size_t(1)<<min_class_log2;
+        const int nclass = 4*(24 - min_class_log2) + 1;
+
+        /// Bytes (including header) held by a block of size class c
+        std::size_t class_size(int c) {
+            if (c == 0) return min_class_size;
+            const int e = min_class_log2 + (c-1)/4;
+            const int q = (c-1)%4 + 1;
+            return (std::size_t(1)<<e) + q*(std::size_t(1)<<(e-2));
+        }
+
+        /// Smallest size class that can hold n bytes (including header)
+        int size_class(std::size_t n) {
+            if (n <= min_class_size) return 0;
+            int e = min_class_log2;
+            while ((std::size_t(1)<<(e+1)) < n) ++e;
+            // Now 2^e < n <= 2^(e+1)
+            const std::size_t step = std::size_t(1)<<(e-2);
+            const int q = int((n - (std::size_t(1)<<e) + step - 1)/step);
+            return 1 + 4*(e - min_class_log2) + (q-1);
+        }
+
+        /// Max. number of cached blocks of class c per thread (about 8 MB)
+        long class_limit(int c) {
+            const long n = long((std::size_t(8)<<20)/class_size(c));
+            return n < 4 ? 4 : n;
+        }
+
+        /// One per thread ... only the owning thread touches the free lists
+        struct PoolCache {
+            PoolBlock* free[nclass];                    ///< Free list per class
+            long count[nclass];                         ///< Length of each free list
+            std::atomic<PoolBlock*> returned;           ///< Blocks freed by other threads
+            std::atomic<unsigned long> nhit;            ///< Allocations from the free lists
+            std::atomic<unsigned long> nmiss;           ///< Allocations from the system
+            std::atomic<long> nbyte_cached;             ///< Bytes in the free lists and return queue
+
+            PoolCache() : returned(nullptr), nhit(0), nmiss(0), nbyte_cached(0) {
+                for (int c=0; c<nclass; ++c) {
+                    free[c] = nullptr;
+                    count[c] = 0;
+                }
+            }
+        };
+
+        std::mutex pool_caches_mutex;
+        std::vector<PoolCache*> pool_caches;           ///< All caches ever created (for statistics)
+        std::vector<PoolCache*> retired_caches;        ///< Caches of exited threads, for reuse
+        std::atomic<long> pool_nbyte_used(0);
+        std::atomic<long> pool_max_nbyte_used(0);
+
+        thread_local PoolCache* pool_cache = nullptr;
+
+        /// Free the cached blocks of an exiting thread and keep its cache for reuse
+
+        /// Blocks still in use keep pointing at the cache, so the cache itself
+        /// cannot be freed; blocks returned to it later are drained by the
+        /// next thread that adopts it.
+        void retire_pool_cache(PoolCache* cache) {
+            for (int c=0; c<nclass; ++c) {
+                PoolBlock* b = cache->free[c];
+                while (b) {
+                    PoolBlock* next = b->next;
+                    std::free(b);
+                    b = next;
+                }
+                cache->nbyte_cached -= cache->count[c]*long(class_size(c));
+                cache->free[c] = nullptr;
+                cache->count[c] = 0;
+            }
+            PoolBlock* b = cache->returned.exchange(nullptr, std::memory_order_acquire);
+            while (b) {
+                PoolBlock* next = b->next;
+                cache->nbyte_cached -= class_size(b->sclass);
+                std::free(b);
+                b = next;
+            }
+            std::lock_guard<std::mutex> lock(pool_caches_mutex);
+            retired_caches.push_back(cache);
+        }
+
+        /// Retires the cache of a thread when the thread exits
+        struct PoolCacheOwner {
+            PoolCache* cache = nullptr;
+            ~PoolCacheOwner() {
+                if (cache) {
+                    pool_cache = nullptr;
+                    retire_pool_cache(cache);
+                }
+            }
+        };
+
+        thread_local PoolCacheOwner pool_cache_owner;
+
+        PoolCache* get_pool_cache() {
+            if (!pool_cache) {
+                PoolCache* cache = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(pool_caches_mutex);
+                    if (!retired_caches.empty()) {
+                        cache = retired_caches.back();
+                        retired_caches.pop_back();
+                    }
+                    else {
+                        cache = new PoolCache;
+                        pool_caches.push_back(cache);
+                    }
+                }
+                pool_cache = cache;
+                pool_cache_owner.cache = cache;
+            }
+            return pool_cache;
+        }
+
+        void* user_pointer(PoolBlock* b) {
+            return static_cast<void*>(reinterpret_cast<char*>(b) + header_size);
+        }
+
+        PoolBlock* block_header(void* p) {
+            return reinterpret_cast<PoolBlock*>(static_cast<char*>(p) - header_size);
+        }
+
+        /// Move the blocks other threads returned into the free lists (owner only)
+        void drain_returned(PoolCache* cache) {
+            PoolBlock* b = cache->returned.exchange(nullptr, std::memory_order_acquire);
+            while (b) {
+                PoolBlock* next = b->next;
+                const int c = b->sclass;
+                if (cache->count[c] < class_limit(c)) {
+                    b->next = cache->free[c];
+                    cache->free[c] = b;
+                    ++(cache->count[c]);
+                }
+                else {
+                    cache->nbyte_cached -= class_size(c);
+                    std::free(b);
+                }
+                b = next;
+            }
+        }
+
+        void note_used(long nbyte) {
+            const long used = (pool_nbyte_used += nbyte);
+            long max = pool_max_nbyte_used.load(std::memory_order_relaxed);
+            while (used > max && !pool_max_nbyte_used.compare_exchange_weak(max, used, std::memory_order_relaxed));
+        }
+
+    } // namespace
+
+
+    bool PoolAllocator::enabled() {
+        static const bool on = [] {
+            const char* env = std::getenv("MAD_TENSOR_POOL");
+            if (!env) return false;
+            return std::strcmp(env, "1") == 0 || std::strcmp(env, "on") == 0 || std::strcmp(env, "yes") == 0;
+        }();
+        return on;
+    }
+
+    void* PoolAllocator::allocate(std::size_t nbyte) {
+        const std::size_t total = nbyte + header_size;
+        PoolCache* cache = get_pool_cache();
+
+        if (total > max_class_size) {
+            void* p;
+            if (posix_memalign(&p, alignment, total)) throw std::bad_alloc();
+            PoolBlock* b = static_cast<PoolBlock*>(p);
+            b->owner = cache;
+            b->sclass = -1;
+            b->size = total;
+            ++(cache->nmiss);
+            note_used(total);
+            return user_pointer(b);
+        }
+
+        const int c = size_class(total);
+        const std::size_t size = class_size(c);
+        if (!cache->free[c]) drain_returned(cache);
+
+        PoolBlock* b = cache->free[c];
+        if (b) {
+            cache->free[c] = b->next;
+            --(cache->count[c]);
+            cache->nbyte_cached -= size;
+            ++(cache->nhit);
+        }
+        else {
+            void* p;
+            if (posix_memalign(&p, alignment, size)) throw std::bad_alloc();
+            b = static_cast<PoolBlock*>(p);
+            b->owner = cache;
+            b->sclass = c;
+            b->size = size;
+            ++(cache->nmiss);
+        }
+        note_used(size);
+        return user_pointer(b);
+    }
+
+    void PoolAllocator::deallocate(void* p) {
+        if (!p) return;
+        PoolBlock* b = block_header(p);
+        if (b->sclass < 0) {
+            pool_nbyte_used -= long(b->size);
+            std::free(b);
+            return;
+        }
+
+        const int c = b->sclass;
+        const std::size_t size = b->size;
+        pool_nbyte_used -= size;
+        PoolCache* owner = b->owner;
+        if (owner == pool_cache) {
+            if (owner->count[c] < class_limit(c)) {
+                b->next = owner->free[c];
+                owner->free[c] = b;
+                ++(owner->count[c]);
+                owner->nbyte_cached += size;
+            }
+            else {
+                std::free(b);
+            }
+        }
+        else {
+            // Lock-free push onto the owner's return queue
+            owner->nbyte_cached += size;
+            PoolBlock* head = owner->returned.load(std::memory_order_relaxed);
+            do {
+                b->next = head;
+            } while (!owner->returned.compare_exchange_weak(head, b, std::memory_order_release,
+                                                            std::memory_order_relaxed));
+        }
+    }
+
+    void PoolAllocator::get_stats(WorldMemInfo& info) {
+        unsigned long nhit = 0, nmiss = 0;
+        long nbyte_cached = 0;
+        {
+            std::lock_guard<std::mutex> lock(pool_caches_mutex);
+            for (PoolCache* cache : pool_caches) {
+                nhit += cache->nhit;
+                nmiss += cache->nmiss;
+                nbyte_cached += cache->nbyte_cached;
+            }
+        }
+        info.pool_num_hits = nhit;
+        info.pool_num_misses = nmiss;
+        info.pool_cur_bytes_cached = (nbyte_cached > 0) ? nbyte_cached : 0;
+        const long used = pool_nbyte_used;
+        info.pool_cur_bytes_used = (used > 0) ? used : 0;
+        info.pool_max_bytes_used = pool_max_nbyte_used;
+    }
+
+    void PoolAllocator::reset_stats() {
+        std::lock_guard<std::mutex> lock(pool_caches_mutex);
+        for (PoolCache* cache : pool_caches) {
+            cache->nhit = 0;
+            cache->nmiss = 0;
+        }
+        pool_max_nbyte_used = long(pool_nbyte_used);
     }
 
 }  // namespace madness
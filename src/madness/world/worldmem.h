@@ -90,9 +90,19 @@ namespace madness {
         unsigned long max_mem_limit;   ///< if size+cur_num_bytes>max_mem_limit new will throw MadnessException
         bool trace;
 
+        // The following are filled in from the PoolAllocator by world_mem_info()
+        unsigned long pool_num_hits;           ///< Pool allocations served from a thread cache
+        unsigned long pool_num_misses;         ///< Pool allocations passed on to the system
+        unsigned long pool_cur_bytes_cached;   ///< Bytes held in the thread caches
+        unsigned long pool_cur_bytes_used;     ///< Bytes handed out by the pool and not yet returned
+        unsigned long pool_max_bytes_used;     ///< Lifetime maximum of pool_cur_bytes_used
+
         /// Prints memory use statistics to std::cout
         void print() const;
 
+        /// Prints the PoolAllocator statistics to std::cout
+        void print_pool() const;
+
         /// Resets all counters to zero
         void reset();
 
@@ -110,6 +120,44 @@ namespace madness {
     /// Returns pointer to internal structure
     WorldMemInfo* world_mem_info();
 
+
+    /// Size-classed, thread-caching allocator used for Tensor storage
+
+    /// MRA creates and destroys very many tensors of a few sizes (k^NDIM
+    /// and (2k)^NDIM coefficients), so this allocator rounds each request up
+    /// to one of four size classes per power of two and keeps freed blocks
+    /// in per-thread free lists.  A block freed by a thread other than the
+    /// one that allocated it is pushed onto a lock-free return queue of the
+    /// allocating thread, which reclaims it when its free list for that
+    /// class runs dry.  Each thread caches a bounded number of blocks per
+    /// class; blocks beyond that and requests larger than max_class_size
+    /// go straight to the system.  When a thread exits, its cached blocks
+    /// are freed and its cache is handed to the next new thread.
+    ///
+    /// The pool is used only if the environment variable \c MAD_TENSOR_POOL
+    /// is set to \c 1, \c on or \c yes when the first tensor is allocated.
+    /// Its statistics are reported through world_mem_info().
+    class PoolAllocator {
+    public:
+        static const std::size_t alignment = 64;                ///< Alignment of all blocks
+        static const std::size_t max_class_size = 1ul<<24;     ///< Larger requests bypass the pool
+
+        /// Returns true if tensors should be allocated from the pool
+        static bool enabled();
+
+        /// Allocate \c nbyte bytes aligned to \c alignment (throws std::bad_alloc on failure)
+        static void* allocate(std::size_t nbyte);
+
+        /// Return a block obtained from allocate() ... may be called by any thread
+        static void deallocate(void* p);
+
+        /// Fill in the pool statistics of \c info
+        static void get_stats(WorldMemInfo& info);
+
+        /// Resets the hit and miss counters and the high-water mark
+        static void reset_stats();
+    };
+
     namespace detail {
       template <typename Char> const Char* Vm_cstr();
     }
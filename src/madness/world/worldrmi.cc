@@ -45,12 +45,52 @@
 namespace madness {
 
     RMI::RmiTask* RMI::task_ptr = nullptr;
+    std::vector<RMI::RmiTask*> RMI::engines;
     RMIStats RMI::stats;
     volatile bool RMI::debugging = false;
-    std::list< std::unique_ptr<RMISendReq> > RMI::send_req;
+    thread_local std::list< std::unique_ptr<RMISendReq> > RMI::send_req;
 
     thread_local bool RMI::is_server_thread = false;
 
+    thread_local RMI::RmiTask* RMI::RmiTask::this_engine = nullptr;
+
+    class RMI::RmiTask::HandlerBatch : public PoolTaskInterface {
+        RmiTask* engine;
+        std::vector<qmsg> msgs;
+    public:
+        HandlerBatch(RmiTask* engine, std::vector<qmsg>& batch)
+            : PoolTaskInterface(TaskAttributes::hipri())
+            , engine(engine)
+        {
+            msgs.swap(batch);
+            engine->nbatch++;
+        }
+
+        void run(const TaskThreadEnv& env) {
+            std::vector<int> bufs(msgs.size());
+            for (unsigned int m=0; m<msgs.size(); ++m) {
+                msgs[m].func(engine->recv_buf[msgs[m].i], msgs[m].len);
+                bufs[m] = msgs[m].i;
+            }
+            engine->return_recv_bufs(bufs);
+            engine->nbatch--;
+        }
+    };
+
+    void RMI::RmiTask::return_recv_bufs(const std::vector<int>& bufs) {
+        ScopedMutex<Spinlock> lock(returned_mutex);
+        returned.insert(returned.end(), bufs.begin(), bufs.end());
+    }
+
+    void RMI::RmiTask::post_returned_recv_bufs() {
+        std::vector<int> bufs;
+        {
+            ScopedMutex<Spinlock> lock(returned_mutex);
+            bufs.swap(returned);
+        }
+        for (unsigned int m=0; m<bufs.size(); ++m) post_recv_buf(bufs[m]);
+    }
+
 #if HAVE_INTEL_TBB
     tbb::task* RMI::tbb_rmi_parent_task = nullptr;
 #endif
@@ -59,6 +99,9 @@ namespace madness {
 
         const bool print_debug_info = RMI::debugging;
 
+        this_engine = this;
+        post_returned_recv_bufs();
+
         if (print_debug_info && n_in_q)
             std::cerr << rank << ":RMI: about to call Testsome with "
                       << n_in_q << " messages in the queue" << std::endl;
@@ -75,9 +118,13 @@ namespace madness {
 	  narrived = SafeMPI::Request::Testsome(maxq_, recv_req.get(), ind.get(), status.get());
           if (narrived) break;
 	  ++iterations;
-          clear_send_req();
-	  myusleep(RMI::testsome_backoff_us);
+          clear_send_req(stats);
+	  myusleep(idle_us);
+          // Several engines polling compete with the workers for the
+          // cores and the MPI lock, so an idle one polls less and less
+          if (nengine > 1) idle_us = std::min(2*idle_us + 1, int(MAX_IDLE_US));
         }
+        if (narrived) idle_us = RMI::testsome_backoff_us;
 
 #ifndef HAVE_CRAYXT
         waiter.reset();
@@ -88,20 +135,40 @@ namespace madness {
                       << " messages just arrived" << std::endl;
 
         if (narrived) {
+            MADNESS_TRACE_BLOCK("rmi messages");
+            // With several engines unordered messages are handed to the
+            // pool as one batch, unless there are no pool threads to run
+            // them.  A single engine runs them inline as it always did.
+            const bool use_pool = nengine > 1 && ThreadPool::size() > 0;
+            std::vector<qmsg> batch;
+            std::size_t nsmall_arrived = 0, nlarge_arrived = 0;
+
             for (int m=0; m<narrived; ++m) {
                 const int src = status[m].Get_source();
                 const size_t len = status[m].Get_count(MPI_BYTE);
                 const int i = ind[m];
 
-                ++(RMI::stats.nmsg_recv);
-                RMI::stats.nbyte_recv += len;
+                ++(stats.nmsg_recv);
+                stats.nbyte_recv += len;
+                WorldTrace::recv(src, len);
+                if (i == (int)nrecv_)
+                    ++(stats.nmsg_recv_huge);
+                else if (i >= (int)nlarge_) {
+                    ++(stats.nmsg_recv_small);
+                    ++nsmall_arrived;
+                }
+                else
+                    ++nlarge_arrived;
 
                 const header* h = (const header*)(recv_buf[i]);
                 rmi_handlerT func = h->func;
                 const attrT attr = h->attr;
                 const counterT count = (attr>>16); //&&0xffff;
 
-                if (!is_ordered(attr) || count==recv_counters[src]) {
+                if (use_pool && !is_ordered(attr)) {
+                    batch.push_back(qmsg(len, func, i, src, attr, count));
+                }
+                else if (!is_ordered(attr) || count==recv_counters[src]) {
                     // Unordered and in order messages should be digested as soon as possible.
                     if (print_debug_info)
                         std::cerr << rank
@@ -173,36 +240,57 @@ namespace madness {
             }
             n_in_q = nleftover;
 
+            if (!batch.empty()) ThreadPool::add(new HandlerBatch(this, batch));
+
+            // If every buffer of a class filled up in one sweep traffic
+            // is outrunning us, so double the buffers of that class
+            if (nlarge_arrived == nlarge_posted_) add_recv_bufs(false, nlarge_posted_);
+            if (nsmall_arrived == nsmall_posted_) add_recv_bufs(true, nsmall_posted_);
+
             post_pending_huge_msg();
 
-            clear_send_req();
+            clear_send_req(stats);
         }
     }
 
     void RMI::RmiTask::post_pending_huge_msg() {
         if (recv_buf[nrecv_]) return;      // Message already pending
         if (!hugeq.empty()) {
-            const auto& hugemsg = hugeq.front();
-            const int src = std::get<0>(hugemsg);
-            const size_t nbyte = std::get<1>(hugemsg);
-            const int tag = std::get<2>(hugemsg);
+            const int src = hugeq.front().first;
+            const size_t nbyte = hugeq.front().second;
             hugeq.pop_front();
             if (posix_memalign(&recv_buf[nrecv_], ALIGNMENT, nbyte))
                 MADNESS_EXCEPTION("RMI: failed allocating huge message", 1);
-            recv_req[nrecv_] = comm.Irecv(recv_buf[nrecv_], nbyte, MPI_BYTE, src, tag);
-            int nada=0;
-            // make unique tags to ensure that ack msgs do not collide with normal recv msgs
-#ifdef MADNESS_USE_BSEND_ACKS
-            comm.Bsend(&nada, sizeof(nada), MPI_BYTE, src, tag + unique_tag_period());
-#else
-            comm.Send(&nada, sizeof(nada), MPI_BYTE, src, tag + unique_tag_period());
-#endif // MADNESS_USE_BSEND_ACKS
+            // The payload was sent right after its control message, so the
+            // next payload from src is this one
+            recv_req[nrecv_] = comm.Irecv(recv_buf[nrecv_], nbyte, MPI_BYTE, src, RMI_HUGE_TAG);
         }
     }
 
+    void RMI::RmiTask::add_recv_bufs(bool small, std::size_t n) {
+        const std::size_t lo = small ? nlarge_ : 0;
+        const std::size_t hi = small ? nrecv_ : nlarge_;
+        std::size_t& nposted = small ? nsmall_posted_ : nlarge_posted_;
+        n = std::min(n, hi - lo - nposted);
+        for (std::size_t k=0; k<n; ++k) {
+            const int i = lo + nposted;
+            if (posix_memalign(&recv_buf[i], ALIGNMENT, small ? small_msg_len_ : max_msg_len_))
+                MADNESS_EXCEPTION("RMI:initialize:failed allocating aligned recv buffer", 1);
+            ++nposted;
+            post_recv_buf(i);
+        }
+        if (small)
+            stats.nrecv_buf_small = nposted;
+        else
+            stats.nrecv_buf_large = nposted;
+    }
+
     void RMI::RmiTask::post_recv_buf(int i) {
-        if (i < (int)nrecv_) {
-            recv_req[i] = comm.Irecv(recv_buf[i], max_msg_len_, MPI_BYTE, MPI_ANY_SOURCE, SafeMPI::RMI_TAG);
+        if (i < (int)nlarge_) {
+            recv_req[i] = comm.Irecv(recv_buf[i], max_msg_len_, MPI_BYTE, MPI_ANY_SOURCE, engine_tag(engine));
+        }
+        else if (i < (int)nrecv_) {
+            recv_req[i] = comm.Irecv(recv_buf[i], small_msg_len_, MPI_BYTE, MPI_ANY_SOURCE, engine_small_tag(engine));
         }
         else if (i == (int)nrecv_) {
             free(recv_buf[i]);
@@ -226,15 +314,21 @@ namespace madness {
 
     static volatile bool rmi_task_is_running = false;
 
-    RMI::RmiTask::RmiTask()
-            : comm(SafeMPI::COMM_WORLD.Clone())
+    RMI::RmiTask::RmiTask(int engine, int nengine)
+            : comm(engine == 0 ? SafeMPI::COMM_WORLD.Clone() : RMI::task_ptr->comm)
             , nproc(comm.Get_size())
             , rank(comm.Get_rank())
+            , engine(engine)
+            , nengine(nengine)
             , finished(false)
             , send_counters(new volatile counterT[nproc])
             , recv_counters(new counterT[nproc])
             , max_msg_len_(DEFAULT_MAX_MSG_LEN)
+            , small_msg_len_(DEFAULT_SMALL_MSG_LEN)
             , nrecv_(DEFAULT_NRECV)
+            , nlarge_(DEFAULT_NRECV)
+            , nlarge_posted_(0)
+            , nsmall_posted_(0)
             , maxq_(DEFAULT_NRECV + 1)
             , recv_buf()
             , recv_req()
@@ -242,6 +336,7 @@ namespace madness {
             , ind()
             , q()
             , n_in_q(0)
+            , idle_us(RMI::testsome_backoff_us)
     {
         // Get the maximum buffer size from the MAD_BUFFER_SIZE environment
         // variable.
@@ -293,17 +388,40 @@ namespace madness {
             maxq_ = nrecv_ + 1;
         }
 
+        // Divide the receive buffers between the engines
+        if (nengine > 1) {
+            nrecv_ = std::max(std::size_t(32), nrecv_/nengine);
+        }
+
+        // Get the size of the small receive buffers from the
+        // MAD_SMALL_BUFFER_SIZE environment variable (0 = no small buffers)
+        const char* mad_small_buffer_size = getenv("MAD_SMALL_BUFFER_SIZE");
+        if(mad_small_buffer_size) {
+            std::stringstream ss(mad_small_buffer_size);
+            ss >> small_msg_len_;
+            const std::size_t unaligned = small_msg_len_ % ALIGNMENT;
+            if(unaligned != 0)
+                small_msg_len_ += ALIGNMENT - unaligned;
+        }
+        if (small_msg_len_ >= max_msg_len_) small_msg_len_ = 0;
+
+        // Slots for up to nrecv_ large buffers followed by up to 4*nrecv_
+        // small buffers, then the huge message slot
+        nlarge_ = nrecv_;
+        if (small_msg_len_) nrecv_ += 4*nlarge_;
+        maxq_ = nrecv_ + 1;
+
         // Get environment variable controlling use of synchronous send (MAD_NSSEND)
         // negative=sends synchronous message every MAD_RECV_BUFFER sends (default)
         //        0=never send synchronous message
         //      n>0=sends synchronous message every n sends (n=1 always uses ssend)
-        nssend_ = nrecv_;
+        nssend_ = nlarge_;
         const char* mad_nssend = getenv("MAD_NSSEND");
         if (mad_nssend) {
             std::stringstream ss(mad_nssend);
             ss >> nssend_;
             if (nssend_ < 0) {
-                nssend_ = nrecv_;
+                nssend_ = nlarge_;
             }
         }
 
@@ -320,14 +438,13 @@ namespace madness {
         ind.reset(new int[maxq_]);
         q.reset(new qmsg[maxq_]);
 
-        // Allocate receive buffers
+        nbatch = 0;
+
+        // Allocate the initial receive buffers, unused slots have null requests
+        std::fill_n(recv_buf.get(), maxq_, nullptr);
         if(nproc > 1) {
-            for(int i = 0; i < (int)nrecv_; ++i) {
-                if(posix_memalign(&recv_buf[i], ALIGNMENT, max_msg_len_))
-                    MADNESS_EXCEPTION("RMI:initialize:failed allocating aligned recv buffer", 1);
-                post_recv_buf(i);
-            }
-            recv_buf[nrecv_] = 0;
+            add_recv_bufs(false, small_msg_len_ ? 16 : nlarge_);
+            add_recv_bufs(true, 64);
         }
     }
 
@@ -337,18 +454,13 @@ namespace madness {
         int nword = HEADER_LEN/sizeof(size_t);
         const int src = info[nword];
         const size_t nbyte = info[nword+1];
-        const int tag = info[nword+2];
-
-        // extra dose of paranoia: assert that we never process so many huge messages
-        // that the tag wraparound somewhere becomes possible ...
-        // the worst case is where only one node sends huge messages to every node in the communicator
-        // AND it has enough threads to use up all tags
-        // NB list::size() is O(1) in c++11, but O(N) in older libstdc++
-        MADNESS_ASSERT(ThreadPool::size() < RMI::RmiTask::unique_tag_period() ||
-                       RMI::task_ptr->hugeq.size() <
-                       std::size_t(RMI::RmiTask::unique_tag_period() / RMI::task_ptr->comm.Get_size()));
-        RMI::task_ptr->hugeq.push_back(std::make_tuple(src, nbyte, tag));
-        RMI::task_ptr->post_pending_huge_msg();
+
+        // the huge message is received by the engine serving src, which is
+        // running this handler in order with the other messages from src
+        RmiTask* task = this_engine;
+        MADNESS_ASSERT(task);
+        task->hugeq.push_back(std::make_pair(src, nbyte));
+        task->post_pending_huge_msg();
     }
 
     namespace detail {
@@ -395,6 +507,25 @@ namespace madness {
             }
 
             MADNESS_ASSERT(task_ptr == nullptr);
+
+            int nengine = DEFAULT_NENGINE;
+            buf = getenv("MAD_RMI_ENGINES");
+            if (buf) {
+                std::stringstream ss(buf);
+                ss >> nengine;
+                if (nengine < 1) nengine = 1;
+                if (nengine > MAX_NENGINE) nengine = MAX_NENGINE;
+            }
+#if HAVE_INTEL_TBB
+            nengine = 1; // the TBB task below is the only server
+#endif // HAVE_INTEL_TBB
+            // senders choose the engine from their own rank, so all must agree
+            int nengine_min, nengine_max;
+            SafeMPI::COMM_WORLD.Allreduce(&nengine, &nengine_min, 1, MPI_INT, MPI_MIN);
+            SafeMPI::COMM_WORLD.Allreduce(&nengine, &nengine_max, 1, MPI_INT, MPI_MAX);
+            if (nengine_min != nengine_max)
+                MADNESS_EXCEPTION("RMI: MAD_RMI_ENGINES must be the same on all processes", nengine);
+
 #if HAVE_INTEL_TBB
 
             // Force the RMI task to be picked up by someone other then main thread
@@ -405,6 +536,7 @@ namespace madness {
                 new (tbb::task::allocate_root()) tbb::empty_task;
             tbb_rmi_parent_task->set_ref_count(2);
             task_ptr = new (tbb_rmi_parent_task->allocate_child()) RmiTask();
+            engines.push_back(task_ptr);
             tbb::task::enqueue(*task_ptr, tbb::priority_high);
 
             task_ptr->comm.Barrier();
@@ -436,9 +568,20 @@ namespace madness {
             tbb::task::destroy(*empty_root);
             task_ptr->comm.Barrier();
 #else
-            task_ptr = new RmiTask();
-            task_ptr->start();
+            // All engines post their receives before any is started
+            task_ptr = new RmiTask(0, nengine);
+            engines.push_back(task_ptr);
+            for (int e=1; e<nengine; ++e) engines.push_back(new RmiTask(e, nengine));
+            for (int e=0; e<nengine; ++e) engines[e]->start();
 #endif // HAVE_INTEL_TBB
+
+            // senders choose the recv buffer class from these sizes, so all must agree
+            unsigned long len[2] = {task_ptr->max_msg_len_, task_ptr->small_msg_len_};
+            unsigned long len_min[2] = {0, 0}, len_max[2] = {0, 0};
+            SafeMPI::COMM_WORLD.Allreduce(len, len_min, 2, MPI_UNSIGNED_LONG, MPI_MIN);
+            SafeMPI::COMM_WORLD.Allreduce(len, len_max, 2, MPI_UNSIGNED_LONG, MPI_MAX);
+            if (len_min[0] != len_max[0] || len_min[1] != len_max[1])
+                MADNESS_EXCEPTION("RMI: MAD_BUFFER_SIZE and MAD_SMALL_BUFFER_SIZE must be the same on all processes", 0);
         }
 
 
@@ -448,33 +591,19 @@ namespace madness {
 
     RMI::Request
     RMI::RmiTask::RmiTask::isend(const void* buf, size_t nbyte, ProcessID dest, rmi_handlerT func, attrT attr) {
-        int tag = SafeMPI::RMI_TAG;
         static std::size_t numsent = 0; // for tracking synchronous sends
 
-        if (nbyte > max_msg_len_) {
-            // Huge message protocol ... send message to dest indicating size and origin of huge message.
-            // Remote end posts a buffer then acks the request.  This end can then send.
-            const int nword = HEADER_LEN/sizeof(size_t);
-            size_t info[nword+3];
-            info[nword  ] = rank;
-            info[nword+1] = nbyte;
-            tag = unique_tag();
-            info[nword+2] = tag;
-
-            int ack;
-            // make unique tags to ensure that ack msgs do not collide with normal recv msgs
-            Request req_ack = comm.Irecv(&ack, sizeof(ack), MPI_BYTE, dest, tag + unique_tag_period());
-            Request req_send = isend(info, sizeof(info), dest, RMI::RmiTask::huge_msg_handler, ATTR_UNORDERED);
-
-            MutexWaiter waiter;
-            while (!req_send.Test()) waiter.wait();
-            waiter.reset();
-            while (!req_ack.Test()) waiter.wait();
-        }
-        else if (nbyte < HEADER_LEN) {
+        if (nbyte < HEADER_LEN) {
             MADNESS_EXCEPTION("RMI::isend --- your buffer is too small to hold the header", static_cast<int>(nbyte));
         }
 
+        // dest serves messages from this process with engine rank%nengine,
+        // in a small or large buffer according to the size
+        const int e = rank % nengine;
+        int tag = (nbyte <= small_msg_len_) ? engine_small_tag(e) : engine_tag(e);
+        const bool huge = nbyte > max_msg_len_;
+        WorldTrace::send(dest, nbyte);
+
         if (RMI::debugging)
             std::cerr << rank
                       << ":RMI: sending buf=" << buf
@@ -483,12 +612,36 @@ namespace madness {
                       << " func=" << func
                       << " ordered=" << is_ordered(attr)
                       << " count=" << int(send_counters[dest])
+                      << " huge=" << huge
                       << std::endl;
 
+        // Huge message protocol ... send an ordered message to dest
+        // indicating size and origin of the huge message, immediately
+        // followed by the payload itself.  Both are sent under the lock so
+        // that payloads leave in the same order as their control messages.
+        const int nword = HEADER_LEN/sizeof(size_t);
+        size_t info[nword+2];
+        Request req_info;
+
         // Since most uses are ordered and we need the mutex to accumulate stats
         // we presently always get the lock
         lock();
 
+        if (huge) {
+            info[nword  ] = rank;
+            info[nword+1] = nbyte;
+            header* hinfo = (header*)(info);
+            hinfo->func = RMI::RmiTask::huge_msg_handler;
+            hinfo->attr = ATTR_ORDERED | ((send_counters[dest]++)<<16);
+
+            ++(RMI::stats.nmsg_sent);
+            RMI::stats.nbyte_sent += sizeof(info);
+
+            const int info_tag = (sizeof(info) <= small_msg_len_) ? engine_small_tag(e) : engine_tag(e);
+            req_info = comm.Isend(info, sizeof(info), MPI_BYTE, dest, info_tag);
+            tag = RMI_HUGE_TAG;
+        }
+
         // If ordering need the mutex to enclose sending the message
         // otherwise there is a livelock scenario due to a starved thread
         // holding an early counter.
@@ -517,17 +670,12 @@ namespace madness {
 
         unlock();
 
-        return result;
-    }
+        // The control message lives on this stack
+        if (huge) {
+            MutexWaiter waiter;
+            while (!req_info.Test()) waiter.wait();
+        }
 
-    int RMI::RmiTask::unique_tag() const {
-        constexpr int first_tag = 4096;
-        static int tag = first_tag;
-        /// should be able to do this with atomics
-        lock();
-        tag = (tag == first_tag+unique_tag_period()-1) ? first_tag : tag + 1;
-        const int result = tag;
-        unlock();
         return result;
     }
 
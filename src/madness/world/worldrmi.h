@@ -38,15 +38,44 @@
 #include <sstream>
 #include <utility>
 #include <list>
+#include <vector>
 #include <memory>
 #include <tuple>
 #include <pthread.h>
 
 /*
-  There is just one server thread and it is the only one
+  By default there is just one server thread and it is the only one
   messing with the recv buffers, so there is no need for
   mutex on recv related data.
 
+  Optionally (MAD_RMI_ENGINES=N) there are N server threads, or
+  receive engines.  Engine e owns its own recv buffers, posted
+  with tags RMI_TAG-e (large) and RMI_TAG-MAX_NENGINE-e (small),
+  and receives all messages from the processes with rank%N == e.
+  Thus each source is served by exactly one engine, which keeps
+  that source's ordered messages in sequence, and no recv
+  related data is shared between engines.  Only engine 0 sends.
+  The engines hand their unordered messages to the thread pool
+  in batches, and an engine that finds no messages sleeps longer
+  between polls (up to MAX_IDLE_US) so that idle engines do not
+  compete with the workers for the cores and the MPI lock.
+
+  Each engine has two classes of recv buffer.  Messages of at
+  most MAD_SMALL_BUFFER_SIZE bytes are sent with the small tag
+  and land in small buffers, the rest with the large tag.  An
+  engine starts with a few buffers of each class and posts more
+  (up to a limit) whenever one sweep finds all buffers of a
+  class filled.
+
+  Messages larger than MAD_BUFFER_SIZE are huge.  The sender
+  sends an ordered control message with the size and then at
+  once sends the payload with tag RMI_HUGE_TAG.  Since control
+  messages from one source are processed in order and MPI does
+  not reorder messages with the same source and tag, the
+  receiver just posts a receive for the next payload from that
+  source directly into a buffer of the exact size.  There is no
+  acknowledgement round trip and no per-message tag.
+
   Multiple threads (including the server) may send hence
   we need to be careful about send-related data.
 
@@ -80,7 +109,7 @@
   - to start the server thread
 
   void RMI::end()
-  - to terminate the server thread
+  - to terminate the server thread(s)
 
   bool RMI::get_debug()
   - to get the debug flag
@@ -122,16 +151,21 @@ namespace madness {
     }; // struct qmsg
 
 
-    // Holds message passing statistics
+    // Holds message passing statistics (recv counts are per receive engine)
     struct RMIStats {
         uint64_t nmsg_sent;
         uint64_t nbyte_sent;
         uint64_t nmsg_recv;
         uint64_t nbyte_recv;
         uint64_t max_serv_send_q;
+        uint64_t nmsg_recv_small;   // Received into small buffers
+        uint64_t nmsg_recv_huge;    // Received by the huge message protocol
+        uint64_t nrecv_buf_small;   // Small buffers posted
+        uint64_t nrecv_buf_large;   // Large buffers posted
 
         RMIStats()
-            : nmsg_sent(0), nbyte_sent(0), nmsg_recv(0), nbyte_recv(0), max_serv_send_q(0) {}
+            : nmsg_sent(0), nbyte_sent(0), nmsg_recv(0), nbyte_recv(0), max_serv_send_q(0)
+            , nmsg_recv_small(0), nmsg_recv_huge(0), nrecv_buf_small(0), nrecv_buf_large(0) {}
     };
 
     /// This for RMI server thread to manage lifetime of WorldAM messages that it is sending
@@ -165,11 +199,14 @@ namespace madness {
         static void set_this_thread_is_server(bool flag = true) {is_server_thread = flag;}
         static bool get_this_thread_is_server() {return is_server_thread;}
 
-        static std::list< std::unique_ptr<RMISendReq> > send_req; // List of outstanding world active messages sent by the server
+        static const int MAX_NENGINE = 8; //!< the max # of receive engines; tags (RMI_HUGE_TAG,RMI_TAG] are reserved for them
+        static const int RMI_HUGE_TAG = SafeMPI::RMI_TAG - 2*MAX_NENGINE; //!< the tag of huge message payloads
+
+        static thread_local std::list< std::unique_ptr<RMISendReq> > send_req; // List of outstanding world active messages sent by this server thread
 
     private:
 
-        static void clear_send_req() {
+        static void clear_send_req(RMIStats& stats) {
             //std::cout << "clearing server messages " << pthread_self() << std::endl;
             stats.max_serv_send_q = std::max(stats.max_serv_send_q,uint64_t(send_req.size()));
             auto it=send_req.begin();
@@ -196,18 +233,25 @@ namespace madness {
                 attrT attr;
             }; // struct header
 
-            /// q of huge messages, each msg = {source,nbytes,tag}
-            std::list< std::tuple<int,size_t,int> > hugeq;
+            /// q of huge messages, each msg = {source,nbytes}
+            std::list< std::pair<int,size_t> > hugeq;
 
             SafeMPI::Intracomm comm;
             const int nproc;            // No. of processes in comm world
             const ProcessID rank;       // Rank of this process
+            const int engine;           // Index of this receive engine
+            const int nengine;          // No. of receive engines
             volatile bool finished;     // True if finished
+            RMIStats stats;             // Receive statistics of this engine
 
             std::unique_ptr<volatile counterT[]> send_counters;
             std::unique_ptr<counterT[]> recv_counters;
             std::size_t max_msg_len_;
-            std::size_t nrecv_;
+            std::size_t small_msg_len_; // Size of small recv buffers, 0 if none
+            std::size_t nrecv_;         // Slots for recv buffers, the first nlarge_ are large
+            std::size_t nlarge_;
+            std::size_t nlarge_posted_; // Large buffers in use, slots [0,nlarge_posted_)
+            std::size_t nsmall_posted_; // Small buffers in use, slots [nlarge_,nlarge_+nsmall_posted_)
             long nssend_;
             std::size_t maxq_;
             std::unique_ptr<void*[]> recv_buf; // Will be at least ALIGNMENT aligned ... +1 for huge messages
@@ -217,12 +261,37 @@ namespace madness {
             std::unique_ptr<int[]> ind;
             std::unique_ptr<qmsg[]> q;
             int n_in_q;
+            int idle_us;                // Sleep between polls while no message arrives
+
+            static const int MAX_IDLE_US = 1000; // Longest sleep of an idle engine when there are several
+
+            static thread_local RmiTask* this_engine; // The engine running on this thread
+
+            std::vector<int> returned;  // Recv buffers handed back by handler batches
+            Spinlock returned_mutex;    // Protects returned
+            AtomicInt nbatch;           // No. of handler batches still running
 
             static inline bool is_ordered(attrT attr) { return attr & ATTR_ORDERED; }
 
+            /// The tag on which engine \c e receives messages that need a large buffer
+            static inline int engine_tag(int e) { return SafeMPI::RMI_TAG - e; }
+
+            /// The tag on which engine \c e receives messages that fit in a small buffer
+            static inline int engine_small_tag(int e) { return SafeMPI::RMI_TAG - MAX_NENGINE - e; }
+
+            /// Allocates and posts up to \c n more recv buffers of the given class
+            void add_recv_bufs(bool small, std::size_t n);
+
             void process_some();
 
-            RmiTask();
+            /// Runs a batch of unordered handlers in the thread pool then returns their buffers
+            class HandlerBatch;
+
+            void return_recv_bufs(const std::vector<int>& bufs);
+
+            void post_returned_recv_bufs();
+
+            RmiTask(int engine = 0, int nengine = 1);
             virtual ~RmiTask();
 
             static void set_rmi_task_is_running(bool flag = true);
@@ -257,12 +326,16 @@ namespace madness {
 
             void exit() {
                 if (debugging)
-                    std::cerr << rank << ":RMI: sending exit request to server thread" << std::endl;
+                    std::cerr << rank << ":RMI: sending exit request to server thread " << engine << std::endl;
 
                 // Set finished flag
                 finished = true;
                 while(finished)
                     myusleep(1000);
+
+                // Handler batches still hold pointers to this engine
+                while (nbatch != 0)
+                    myusleep(1000);
             }
 
             static void huge_msg_handler(void *buf, size_t nbytein);
@@ -273,27 +346,21 @@ namespace madness {
 
             void post_recv_buf(int i);
 
-        private:
-
-            /// thread-safely round-robins through tags in [first_tag, first_tag+period) range
-            /// @returns new tag to be used in messaging
-            int unique_tag() const;
-            /// the period of tags returned by unique_tag()
-            /// @warning this bounds how many huge messages each RmiTask will be able to process
-            static constexpr int unique_tag_period() { return 2048; }
-
         }; // class RmiTask
 
 #if HAVE_INTEL_TBB
         static tbb::task* tbb_rmi_parent_task;
 #endif // HAVE_INTEL_TBB
 
-        static RmiTask* task_ptr;    // Pointer to the singleton instance
-        static RMIStats stats;
+        static RmiTask* task_ptr;    // Pointer to the singleton instance (engine 0, which also sends)
+        static std::vector<RmiTask*> engines; // All receive engines, engines[0] == task_ptr
+        static RMIStats stats;       // Send statistics
         static volatile bool debugging;    // True if debugging
 
         static const size_t DEFAULT_MAX_MSG_LEN = 3*512*1024;  //!< the default size of recv buffers, in bytes; the actual size can be configured by the user via envvar MAD_BUFFER_SIZE
         static const int DEFAULT_NRECV = 128;  //!< the default # of recv buffers; the actual number can be configured by the user via envvar MAD_RECV_BUFFERS
+        static const int DEFAULT_NENGINE = 1;  //!< the default # of receive engines; the actual number can be configured by the user via envvar MAD_RMI_ENGINES
+        static const size_t DEFAULT_SMALL_MSG_LEN = 32*1024;  //!< the default size of small recv buffers, in bytes; the actual size can be configured by the user via envvar MAD_SMALL_BUFFER_SIZE
 
         // Not allowed
         RMI(const RMI&);
@@ -315,14 +382,35 @@ namespace madness {
             return task_ptr->maxq_;
         }
 
-        /// Returns the number of recv buffers
+        /// Returns the maximum number of large recv buffers
 
-        /// @return The number of recv buffers
+        /// @return The maximum number of large recv buffers
         /// @note The default value is given by RMI::DEFAULT_NRECV, can be overridden at runtime by the user via environment variable MAD_RECV_BUFFERS
         /// @warning Cannot be smaller than 32.
+        /// @note The buffers are divided between the receive engines, each getting at least 32.
+        /// Only a few are posted at first, more are added as traffic requires.
+        /// Each engine may also post up to four times as many small buffers.
         static std::size_t nrecv() {
             MADNESS_ASSERT(task_ptr);
-            return task_ptr->nrecv_;
+            return task_ptr->nlarge_*engines.size();
+        }
+
+        /// Returns the size of small recv buffers, in bytes
+
+        /// @return The size of small recv buffers, 0 if all messages use large buffers
+        /// @note The default value is given by RMI::DEFAULT_SMALL_MSG_LEN, can be overridden at runtime by the user via environment variable MAD_SMALL_BUFFER_SIZE.
+        static std::size_t small_msg_len() {
+            MADNESS_ASSERT(task_ptr);
+            return task_ptr->small_msg_len_;
+        }
+
+        /// Returns the number of receive engines
+
+        /// @return The number of receive engines (server threads)
+        /// @note The default value is given by RMI::DEFAULT_NENGINE, can be overridden at runtime by the user via environment variable MAD_RMI_ENGINES
+        /// @warning Must be the same on all processes and cannot be larger than RMI::MAX_NENGINE.
+        static int nengine() {
+            return engines.size();
         }
 
         /// Send a remote method invocation (again you should probably be looking at worldam.h instead)
@@ -350,13 +438,18 @@ namespace madness {
 
         static void end() {
             if(task_ptr) {
-                task_ptr->exit();
 #if HAVE_INTEL_TBB
+                task_ptr->exit();
                 tbb_rmi_parent_task->wait_for_all();
                 tbb::task::destroy(*tbb_rmi_parent_task);
 #else
-                delete task_ptr;
+                // Engine 0 owns the communicator so goes last
+                for (int e=engines.size()-1; e>=0; --e) {
+                    engines[e]->exit();
+                    delete engines[e];
+                }
 #endif // HAVE_INTEL_TBB
+                engines.clear();
                 task_ptr = nullptr;
             }
         }
@@ -365,7 +458,27 @@ namespace madness {
 
         static bool get_debug() { return debugging; }
 
-        static const RMIStats& get_stats() { return stats; }
+        /// Returns the send statistics and the receive statistics summed over engines
+        static RMIStats get_stats() {
+            RMIStats result = stats;
+            for (unsigned int e=0; e<engines.size(); ++e) {
+                const RMIStats& s = engines[e]->stats;
+                result.nmsg_recv += s.nmsg_recv;
+                result.nbyte_recv += s.nbyte_recv;
+                result.max_serv_send_q = std::max(result.max_serv_send_q, s.max_serv_send_q);
+                result.nmsg_recv_small += s.nmsg_recv_small;
+                result.nmsg_recv_huge += s.nmsg_recv_huge;
+                result.nrecv_buf_small += s.nrecv_buf_small;
+                result.nrecv_buf_large += s.nrecv_buf_large;
+            }
+            return result;
+        }
+
+        /// Returns the receive statistics of engine \c e
+        static RMIStats get_stats(int e) {
+            MADNESS_ASSERT(e >= 0 && e < int(engines.size()));
+            return engines[e]->stats;
+        }
     }; // class RMI
 
 } // namespace madness
@@ -0,0 +1,246 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file worldtrace.cc
+ \brief Implementation of \c WorldTrace.
+ \ingroup parallel_runtime
+*/
+
+#include <madness/world/worldtrace.h>
+#include <madness/world/worldrmi.h>
+#include <madness/world/thread.h>
+#include <madness/world/timers.h>
+#include <madness/world/worldmutex.h>
+#include <madness/world/madness_exception.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <cxxabi.h>
+#include <pthread.h>
+
+namespace madness {
+
+    namespace {
+
+        /// The ring buffer of one thread
+        struct TraceBuffer {
+            std::vector<WorldTrace::Event> events;
+            std::atomic<std::uint64_t> n;   ///< Number of events ever recorded
+            std::string name;               ///< Name of the thread
+            int tid;                        ///< Track number within the process
+
+            TraceBuffer(std::size_t size, const std::string& name, int tid)
+                : events(size), n(0), name(name), tid(tid) {}
+        };
+
+        Spinlock trace_mutex;                                   // Guards buffers and the origin
+        std::vector<std::unique_ptr<TraceBuffer> > buffers;     // All buffers, never freed
+        std::uint64_t trace_origin = 0;                         // cycle_count() at the first enable
+        bool trace_has_origin = false;
+        thread_local TraceBuffer* my_buffer = nullptr;
+        const pthread_t trace_main_thread = pthread_self(); // Static initialization runs on the main thread
+
+        /// Power of two number of events held per thread
+        std::size_t buffer_size() {
+            std::size_t size = std::size_t(1) << 18;
+            const char* buf = getenv("MAD_TRACE_EVENTS");
+            if (buf) {
+                std::stringstream ss(buf);
+                std::size_t n;
+                if (ss >> n && n > 0) {
+                    size = 1;
+                    while (size < n) size <<= 1;
+                }
+            }
+            return size;
+        }
+
+        /// Makes the buffer of the calling thread
+        TraceBuffer* make_buffer() {
+            std::string name;
+            const ThreadBase* thread = ThreadBase::this_thread();
+            const int pool_index = thread ? thread->get_pool_thread_index() : -1;
+            if (RMI::get_this_thread_is_server())
+                name = "RMI server";
+            else if (pool_index >= 0)
+                name = "pool thread " + std::to_string(pool_index);
+            else if (pthread_equal(pthread_self(), trace_main_thread))
+                name = "main thread";
+
+            ScopedMutex<Spinlock> lock(trace_mutex);
+            const int tid = buffers.size();
+            if (name.empty()) name = "thread " + std::to_string(tid);
+            buffers.emplace_back(new TraceBuffer(buffer_size(), name, tid));
+            return buffers.back().get();
+        }
+
+        /// Writes a string as a JSON string
+        void write_json_string(FILE* file, const char* s) {
+            fputc('"', file);
+            for (; *s; ++s) {
+                if (*s == '"' || *s == '\\') fputc('\\', file);
+                if ((unsigned char)(*s) >= 0x20) fputc(*s, file);
+            }
+            fputc('"', file);
+        }
+
+        /// Demangles a type name, caching the result
+        const char* demangle(std::map<const char*, std::string>& cache, const char* mangled) {
+            auto it = cache.find(mangled);
+            if (it == cache.end()) {
+                int status = 0;
+                char* name = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+                it = cache.insert(std::make_pair(mangled, std::string(status == 0 ? name : mangled))).first;
+                free(name);
+            }
+            return it->second.c_str();
+        }
+
+    } // namespace
+
+    std::atomic<bool> WorldTrace::on(false);
+
+    void WorldTrace::record(Kind kind, const char* name, std::int64_t nbyte, std::int32_t proc) {
+        TraceBuffer* b = my_buffer;
+        if (!b) b = my_buffer = make_buffer();
+        const std::uint64_t n = b->n.load(std::memory_order_relaxed);
+        Event& e = b->events[n & (b->events.size()-1)];
+        e.time = cycle_count();
+        e.name = name;
+        e.nbyte = nbyte;
+        e.proc = proc;
+        e.kind = kind;
+        b->n.store(n+1, std::memory_order_release);
+    }
+
+    void WorldTrace::enable() {
+        {
+            ScopedMutex<Spinlock> lock(trace_mutex);
+            if (!trace_has_origin) {
+                trace_origin = cycle_count();
+                trace_has_origin = true;
+            }
+        }
+        on.store(true, std::memory_order_relaxed);
+    }
+
+    void WorldTrace::disable() {
+        on.store(false, std::memory_order_relaxed);
+    }
+
+    void WorldTrace::clear() {
+        ScopedMutex<Spinlock> lock(trace_mutex);
+        for (auto& b : buffers) b->n.store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t WorldTrace::size() {
+        ScopedMutex<Spinlock> lock(trace_mutex);
+        std::size_t n = 0;
+        for (auto& b : buffers)
+            n += std::min<std::uint64_t>(b->n.load(std::memory_order_acquire), b->events.size());
+        return n;
+    }
+
+    void WorldTrace::write(const std::string& filename, int rank) {
+        FILE* file = fopen(filename.c_str(), "w");
+        if (!file) MADNESS_EXCEPTION("WorldTrace: failed to open the trace file", rank);
+
+        ScopedMutex<Spinlock> lock(trace_mutex);
+        const double us_per_cycle = 1e6/cpu_frequency();
+        std::map<const char*, std::string> names;
+
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"rank %d\"}}",
+                rank, rank);
+        for (auto& b : buffers) {
+            fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                    rank, b->tid);
+            write_json_string(file, b->name.c_str());
+            fprintf(file, "}}");
+
+            const std::uint64_t n = b->n.load(std::memory_order_acquire);
+            const std::uint64_t size = b->events.size();
+            const std::uint64_t first = (n > size) ? n - size : 0;
+
+            // Once the buffer has wrapped the start of an interval may be
+            // overwritten while its end is kept, and intervals may still be
+            // open; such unmatched events are dropped
+            std::vector<bool> keep(n - first, true);
+            std::vector<std::uint64_t> open;
+            for (std::uint64_t i=first; i<n; ++i) {
+                const int kind = b->events[i & (size-1)].kind;
+                if (kind == BEGIN || kind == TASK) {
+                    open.push_back(i);
+                }
+                else if (kind == END) {
+                    if (open.empty())
+                        keep[i - first] = false;
+                    else
+                        open.pop_back();
+                }
+            }
+            for (std::uint64_t i : open) keep[i - first] = false;
+
+            for (std::uint64_t i=first; i<n; ++i) {
+                if (!keep[i - first]) continue;
+                const Event& e = b->events[i & (size-1)];
+                const double ts = (double(e.time) - double(trace_origin))*us_per_cycle;
+                switch (e.kind) {
+                case BEGIN:
+                case TASK:
+                    fprintf(file, ",\n{\"ph\":\"B\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"name\":",
+                            rank, b->tid, ts);
+                    write_json_string(file, e.kind == TASK ? demangle(names, e.name) : e.name);
+                    fprintf(file, "}");
+                    break;
+                case END:
+                    fprintf(file, ",\n{\"ph\":\"E\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}", rank, b->tid, ts);
+                    break;
+                case SEND:
+                case RECV:
+                    fprintf(file, ",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,"
+                            "\"name\":\"%s\",\"args\":{\"%s\":%d,\"bytes\":%lld}}",
+                            rank, b->tid, ts, e.kind == SEND ? "am send" : "am recv",
+                            e.kind == SEND ? "dest" : "src", int(e.proc), (long long)(e.nbyte));
+                    break;
+                }
+            }
+        }
+        fprintf(file, "\n]}\n");
+        if (fclose(file)) MADNESS_EXCEPTION("WorldTrace: failed to write the trace file", rank);
+    }
+
+} // namespace madness
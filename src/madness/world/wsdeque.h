@@ -0,0 +1,217 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_WSDEQUE_H__INCLUDED
+#define MADNESS_WORLD_WSDEQUE_H__INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+/// \file wsdeque.h
+/// \brief Implements WSDeque, a Chase-Lev work-stealing deque
+
+namespace madness {
+
+    /// Statistics for a single work-stealing deque
+    struct WSDQStats {
+        uint64_t npush;         ///< #calls to push by the owner
+        uint64_t npop;          ///< #successful pops by the owner
+        uint64_t nsteal;        ///< #successful steals by other threads
+        uint64_t ngrow;         ///< #calls to grow
+
+        WSDQStats()
+                : npush(0), npop(0), nsteal(0), ngrow(0) {}
+    };
+
+
+    /// A lock-free, single-owner, multi-thief double-ended queue.
+
+    /// This is the dynamic circular work-stealing deque of Chase and Lev
+    /// (SPAA 2005) using the C11 memory orderings given by Le, Pop, Cohen
+    /// and Zappa Nardelli (PPoPP 2013).  Only the owning thread may call
+    /// \c push() and \c pop(), which operate LIFO on the bottom of the deque;
+    /// any thread may call \c steal(), which takes FIFO from the top.
+    ///
+    /// The buffer grows as needed but does not shrink.  Retired buffers are
+    /// kept until destruction since a concurrent thief may still be reading
+    /// from them.
+    ///
+    /// \tparam T The element type, which must be trivially copyable (in
+    ///     practice it is always a pointer).
+    template <typename T>
+    class WSDeque {
+        /// Circular array of atomic elements
+        struct Array {
+            const long size;            ///< Capacity (power of 2)
+            const long mask;            ///< size-1
+            std::atomic<T>* const buf;  ///< The elements
+
+            Array(long size)
+                : size(size), mask(size-1), buf(new std::atomic<T>[size]) {}
+
+            ~Array() { delete [] buf; }
+
+            T get(long i) const {
+                return buf[i & mask].load(std::memory_order_relaxed);
+            }
+
+            void put(long i, T value) {
+                buf[i & mask].store(value, std::memory_order_relaxed);
+            }
+        };
+
+        char pad0[64];                                    ///< Keep top away from neighbors
+        std::atomic<long> top __attribute__((aligned(64)));  ///< Index thieves steal from
+        char pad1[64];                                    ///< Keep top and bottom in separate cache lines
+        std::atomic<long> bottom __attribute__((aligned(64)));  ///< Index the owner pushes to
+        std::atomic<Array*> array;                        ///< Current buffer
+        std::vector<Array*> retired;                      ///< Old buffers (owner only)
+        WSDQStats stats;                                  ///< Owner statistics
+        std::atomic<uint64_t> nsteal;                     ///< Steal counter (all threads)
+
+        // Disable copy and assignment
+        WSDeque(const WSDeque&);
+        WSDeque& operator=(const WSDeque&);
+
+        /// Double the buffer (owner only)
+        Array* grow(Array* a, long b, long t) {
+            Array* na = new Array(a->size*2);
+            for (long i=t; i<b; ++i) na->put(i, a->get(i));
+            retired.push_back(a);
+            array.store(na, std::memory_order_release);
+            ++(stats.ngrow);
+            return na;
+        }
+
+    public:
+        /// Construct an empty deque
+
+        /// \param[in] hint Initial capacity, rounded up to a power of 2
+        WSDeque(size_t hint=1024)
+            : top(0), bottom(0), array(nullptr), nsteal(0)
+        {
+            long sz = 2;
+            while (sz < long(hint)) sz <<= 1;
+            array.store(new Array(sz), std::memory_order_relaxed);
+        }
+
+        ~WSDeque() {
+            delete array.load(std::memory_order_relaxed);
+            for (size_t i=0; i<retired.size(); ++i) delete retired[i];
+        }
+
+        /// Push a value onto the bottom of the deque (owner only)
+        void push(T value) {
+            long b = bottom.load(std::memory_order_relaxed);
+            long t = top.load(std::memory_order_acquire);
+            Array* a = array.load(std::memory_order_relaxed);
+            if (b - t > a->size - 1) a = grow(a, b, t);
+            a->put(b, value);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b+1, std::memory_order_relaxed);
+            ++(stats.npush);
+        }
+
+        /// Pop a value off the bottom of the deque (owner only)
+
+        /// \param[out] value The popped value, if any
+        /// \return True if a value was popped
+        bool pop(T& value) {
+            long b = bottom.load(std::memory_order_relaxed) - 1;
+            Array* a = array.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long t = top.load(std::memory_order_relaxed);
+            bool got = false;
+            if (t <= b) {
+                value = a->get(b);
+                got = true;
+                if (t == b) {
+                    // Last element ... race against thieves for it
+                    if (!top.compare_exchange_strong(t, t+1,
+                            std::memory_order_seq_cst, std::memory_order_relaxed))
+                        got = false;
+                    bottom.store(b+1, std::memory_order_relaxed);
+                }
+            }
+            else {
+                bottom.store(b+1, std::memory_order_relaxed);
+            }
+            if (got) ++(stats.npop);
+            return got;
+        }
+
+        /// Steal a value from the top of the deque (any thread)
+
+        /// Might fail spuriously if racing with another thief or the owner.
+        /// \param[out] value The stolen value, if any
+        /// \return True if a value was stolen
+        bool steal(T& value) {
+            long t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long b = bottom.load(std::memory_order_acquire);
+            if (t < b) {
+                Array* a = array.load(std::memory_order_acquire);
+                T v = a->get(t);
+                if (!top.compare_exchange_strong(t, t+1,
+                        std::memory_order_seq_cst, std::memory_order_relaxed))
+                    return false;
+                value = v;
+                nsteal.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        /// Approximate number of elements (exact if called by the owner when quiescent)
+        size_t size() const {
+            long b = bottom.load(std::memory_order_relaxed);
+            long t = top.load(std::memory_order_relaxed);
+            return (b > t) ? size_t(b - t) : 0;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        /// Returns statistics ... only consistent when the deque is quiescent
+        WSDQStats get_stats() const {
+            WSDQStats s = stats;
+            s.nsteal = nsteal.load(std::memory_order_relaxed);
+            return s;
+        }
+    };
+
+}
+
+#endif // MADNESS_WORLD_WSDEQUE_H__INCLUDED